@@ -40,79 +40,62 @@ constexpr size_t array_size(const T(&)[N])
     return N;
 }
 
-PowerLog::PowerLog(uint32_t sampleRate,
-        uint32_t channelCount,
-        audio_format_t format,
-        size_t entries,
-        size_t framesPerEntry)
-    : mCurrentTime(0)
-    , mCurrentEnergy(0)
-    , mCurrentFrames(0)
-    , mIdx(0)
-    , mConsecutiveZeroes(0)
-    , mSampleRate(sampleRate)
-    , mChannelCount(channelCount)
-    , mFormat(format)
-    , mFramesPerEntry(framesPerEntry)
-    , mEntries(entries)
-{
-    (void)mSampleRate; // currently unused, for future use
-    LOG_ALWAYS_FATAL_IF(!audio_utils_is_compute_power_format_supported(format),
-            "unsupported format: %#x", format);
-}
+using PowerLogEntry = std::pair<int64_t /* real time ns */, float /* energy */>;
 
-void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
+// Adds frames to the energy accumulation of PowerLog and SingleWriterPowerLog,
+// calling writeEntry(timeNs, energy) for each completed entry.
+template <typename WriteEntry>
+static void accumulateEnergy(const void *buffer, size_t frames, int64_t nowNs,
+        audio_format_t format, uint32_t channelCount, size_t framesPerEntry,
+        int64_t *currentTime, float *currentEnergy, size_t *currentFrames,
+        size_t *consecutiveZeroes, WriteEntry writeEntry)
 {
-    std::lock_guard<std::mutex> guard(mLock);
-
-    const size_t bytes_per_sample = audio_bytes_per_sample(mFormat);
+    const size_t bytes_per_sample = audio_bytes_per_sample(format);
     while (frames > 0) {
         // check partial computation
-        size_t required = mFramesPerEntry - mCurrentFrames;
+        size_t required = framesPerEntry - *currentFrames;
         size_t process = std::min(required, frames);
 
-        if (mCurrentTime == 0) {
-            mCurrentTime = nowNs;
+        if (*currentTime == 0) {
+            *currentTime = nowNs;
         }
-        mCurrentEnergy +=
-                audio_utils_compute_energy_mono(buffer, mFormat, process * mChannelCount);
-        mCurrentFrames += process;
+        *currentEnergy +=
+                audio_utils_compute_energy_mono(buffer, format, process * channelCount);
+        *currentFrames += process;
 
-        ALOGV("nowNs:%lld, required:%zu, process:%zu, mCurrentEnergy:%f, mCurrentFrames:%zu",
-                (long long)nowNs, required, process, mCurrentEnergy, mCurrentFrames);
+        ALOGV("nowNs:%lld, required:%zu, process:%zu, currentEnergy:%f, currentFrames:%zu",
+                (long long)nowNs, required, process, *currentEnergy, *currentFrames);
         if (process < required) {
             return;
         }
 
         // We store the data as normalized energy per sample. The energy sequence is
         // zero terminated. Consecutive zeroes are ignored.
-        if (mCurrentEnergy == 0.f) {
-            if (mConsecutiveZeroes++ == 0) {
-                mEntries[mIdx++] = std::make_pair(nowNs, 0.f);
+        if (*currentEnergy == 0.f) {
+            if ((*consecutiveZeroes)++ == 0) {
+                writeEntry(nowNs, 0.f);
                 // zero terminate the signal sequence.
             }
         } else {
-            mConsecutiveZeroes = 0;
-            mEntries[mIdx++] = std::make_pair(mCurrentTime, mCurrentEnergy);
-            ALOGV("writing %lld %f", (long long)mCurrentTime, mCurrentEnergy);
-        }
-        if (mIdx >= mEntries.size()) {
-            mIdx -= mEntries.size();
+            *consecutiveZeroes = 0;
+            writeEntry(*currentTime, *currentEnergy);
+            ALOGV("writing %lld %f", (long long)*currentTime, *currentEnergy);
         }
-        mCurrentTime = 0;
-        mCurrentEnergy = 0;
-        mCurrentFrames = 0;
+        *currentTime = 0;
+        *currentEnergy = 0;
+        *currentFrames = 0;
         frames -= process;
-        buffer = (const uint8_t *)buffer + mCurrentFrames * mChannelCount * bytes_per_sample;
+        buffer = (const uint8_t *)buffer + *currentFrames * channelCount * bytes_per_sample;
     }
 }
 
-std::string PowerLog::dumpToString(const char *prefix, size_t lines, int64_t limitNs) const
+// Formats a copy of the ring of entries, of which idx is the next to write.
+static std::string dumpEntries(const std::vector<PowerLogEntry> &entries, size_t idx,
+        uint32_t channelCount, size_t framesPerEntry,
+        const char *prefix, size_t lines, int64_t limitNs)
 {
-    std::lock_guard<std::mutex> guard(mLock);
-
     const size_t maxColumns = 10;
-    const size_t numberOfEntries = mEntries.size();
+    const size_t numberOfEntries = entries.size();
     if (lines == 0) lines = SIZE_MAX;
 
     // compute where to start logging
@@ -125,9 +108,9 @@ std::string PowerLog::dumpToString(const char *prefix, size_t lines, int64_t lim
     size_t nonzeros = 0;
     ssize_t offset; // TODO doesn't dump if # entries exceeds SSIZE_MAX
     for (offset = 0; offset < (ssize_t)numberOfEntries && count < lines; ++offset) {
-        const size_t idx = (mIdx + numberOfEntries - offset - 1) % numberOfEntries; // reverse direction
-        const int64_t time = mEntries[idx].first;
-        const float energy = mEntries[idx].second;
+        const size_t i = (idx + numberOfEntries - offset - 1) % numberOfEntries; // reverse
+        const int64_t time = entries[i].first;
+        const float energy = entries[i].second;
 
         if (state == AT_END) {
             if (energy == 0.f) {
@@ -177,9 +160,9 @@ std::string PowerLog::dumpToString(const char *prefix, size_t lines, int64_t lim
         bool start = false;
         float cumulative = 0.f;
         for (; offset >= 0; --offset) {
-            const size_t idx = (mIdx + numberOfEntries - offset - 1) % numberOfEntries;
-            const int64_t time = mEntries[idx].first;
-            const float energy = mEntries[idx].second;
+            const size_t i = (idx + numberOfEntries - offset - 1) % numberOfEntries;
+            const int64_t time = entries[i].first;
+            const float energy = entries[i].second;
 
             if (energy == 0.f) {
                 if (!first) {
@@ -215,7 +198,7 @@ std::string PowerLog::dumpToString(const char *prefix, size_t lines, int64_t lim
             cumulative += energy;
             // convert energy to power and print
             const float power =
-                    audio_utils_power_from_energy(energy / (mChannelCount * mFramesPerEntry));
+                    audio_utils_power_from_energy(energy / (channelCount * framesPerEntry));
             ss << std::setw(6) << power;
             ALOGV("state: %d %lld %f", state, (long long)time, power);
             // Add an entry to the ASCII art power log graph.
@@ -228,6 +211,54 @@ std::string PowerLog::dumpToString(const char *prefix, size_t lines, int64_t lim
     return ss.str();
 }
 
+PowerLog::PowerLog(uint32_t sampleRate,
+        uint32_t channelCount,
+        audio_format_t format,
+        size_t entries,
+        size_t framesPerEntry)
+    : mCurrentTime(0)
+    , mCurrentEnergy(0)
+    , mCurrentFrames(0)
+    , mIdx(0)
+    , mConsecutiveZeroes(0)
+    , mSampleRate(sampleRate)
+    , mChannelCount(channelCount)
+    , mFormat(format)
+    , mFramesPerEntry(framesPerEntry)
+    , mEntries(entries)
+{
+    (void)mSampleRate; // currently unused, for future use
+    LOG_ALWAYS_FATAL_IF(!audio_utils_is_compute_power_format_supported(format),
+            "unsupported format: %#x", format);
+}
+
+void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
+{
+    std::lock_guard<std::mutex> guard(mLock);
+
+    accumulateEnergy(buffer, frames, nowNs, mFormat, mChannelCount, mFramesPerEntry,
+            &mCurrentTime, &mCurrentEnergy, &mCurrentFrames, &mConsecutiveZeroes,
+            [this](int64_t timeNs, float energy) {
+                mEntries[mIdx++] = std::make_pair(timeNs, energy);
+                if (mIdx >= mEntries.size()) {
+                    mIdx -= mEntries.size();
+                }
+            });
+}
+
+std::string PowerLog::dumpToString(const char *prefix, size_t lines, int64_t limitNs) const
+{
+    // Format a copy, so that log() is only blocked for the copy.
+    std::vector<PowerLogEntry> entries;
+    size_t idx;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        entries = mEntries;
+        idx = mIdx;
+    }
+    return dumpEntries(entries, idx, mChannelCount, mFramesPerEntry, prefix, lines, limitNs);
+}
+
 status_t PowerLog::dump(int fd, const char *prefix, size_t lines, int64_t limitNs) const
 {
     // Since dumpToString and write are thread safe, this function
@@ -241,6 +272,93 @@ status_t PowerLog::dump(int fd, const char *prefix, size_t lines, int64_t limitN
     return NO_ERROR;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+SingleWriterPowerLog::SingleWriterPowerLog(uint32_t sampleRate,
+        uint32_t channelCount,
+        audio_format_t format,
+        size_t entries,
+        size_t framesPerEntry)
+    : mCurrentTime(0)
+    , mCurrentEnergy(0)
+    , mCurrentFrames(0)
+    , mConsecutiveZeroes(0)
+    , mIdx(0)
+    , mChannelCount(channelCount)
+    , mFormat(format)
+    , mFramesPerEntry(framesPerEntry)
+    , mEntryCount(entries)
+    , mEntries(new Entry[entries])
+{
+    (void)sampleRate; // currently unused, for future use
+    LOG_ALWAYS_FATAL_IF(!audio_utils_is_compute_power_format_supported(format),
+            "unsupported format: %#x", format);
+}
+
+void SingleWriterPowerLog::writeEntry(int64_t timeNs, float energy)
+{
+    const uint64_t idx = mIdx.load(std::memory_order_relaxed); // only the writer changes it
+    Entry &entry = mEntries[idx % mEntryCount];
+
+    // Orders the previous publication of mIdx before the entry stores, so a reader which
+    // copies the new values also observes that this slot is being overwritten.
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.mTime.store(timeNs, std::memory_order_relaxed);
+    entry.mEnergy.store(energy, std::memory_order_relaxed);
+    mIdx.store(idx + 1, std::memory_order_release);
+}
+
+uint64_t SingleWriterPowerLog::snapshotEntries(std::vector<PowerLogEntry> *entries) const
+{
+    entries->resize(mEntryCount);
+    const uint64_t begin = mIdx.load(std::memory_order_acquire);
+    for (size_t i = 0; i < mEntryCount; ++i) {
+        (*entries)[i] = std::make_pair(mEntries[i].mTime.load(std::memory_order_relaxed),
+                mEntries[i].mEnergy.load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t end = mIdx.load(std::memory_order_relaxed);
+
+    // Entries begin through end (the latter possibly in progress) may have been written
+    // during the copy. They replace the oldest entries, so drop those; a zero energy
+    // entry is a signal boundary for the dump.
+    const uint64_t overwritten = std::min<uint64_t>(end - begin + 1, mEntryCount);
+    for (uint64_t i = 0; i < overwritten; ++i) {
+        (*entries)[(begin + i) % mEntryCount] = std::make_pair(0, 0.f);
+    }
+    return begin;
+}
+
+void SingleWriterPowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
+{
+    accumulateEnergy(buffer, frames, nowNs, mFormat, mChannelCount, mFramesPerEntry,
+            &mCurrentTime, &mCurrentEnergy, &mCurrentFrames, &mConsecutiveZeroes,
+            [this](int64_t timeNs, float energy) { writeEntry(timeNs, energy); });
+}
+
+std::string SingleWriterPowerLog::dumpToString(
+        const char *prefix, size_t lines, int64_t limitNs) const
+{
+    // Work on a snapshot, so that log() is never blocked.
+    std::vector<PowerLogEntry> entries;
+    const size_t idx = snapshotEntries(&entries) % mEntryCount;
+    return dumpEntries(entries, idx, mChannelCount, mFramesPerEntry, prefix, lines, limitNs);
+}
+
+status_t SingleWriterPowerLog::dump(
+        int fd, const char *prefix, size_t lines, int64_t limitNs) const
+{
+    // Since dumpToString and write are thread safe, this function
+    // is conceptually thread-safe but simultaneous calls to dump
+    // by different threads to the same file descriptor may not write
+    // the two logs in time order.
+    const std::string s = dumpToString(prefix, lines, limitNs);
+    if (s.size() > 0 && write(fd, s.c_str(), s.size()) < 0) {
+        return -errno;
+    }
+    return NO_ERROR;
+}
+
 } // namespace android
 
 using namespace android;
@@ -14,10 +14,19 @@
  * limitations under the License.
  */
 
+#include <stdbool.h>
 #include <string.h>
 #include <audio_utils/channels.h>
 #include "private/private.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
+
 /*
  * Clamps a 24-bit value from a 32-bit sample
  */
@@ -352,6 +361,603 @@ static inline uint8x3_t int32_to_uint8x3(int32_t in) {
     return num_out_samples * sizeof(*(out_buff)); \
 }
 
+#if defined(USE_NEON) || defined(USE_SSE)
+
+/*
+ * Vectorized kernels for the channel count pairs converted most often per buffer:
+ * mono <-> stereo, stereo -> 8 channels and 6 channels -> stereo, for 16 bit samples and
+ * for 32 bit (int32_t or float) samples.
+ *
+ * Each kernel processes whole blocks with SIMD and finishes the remaining frames with a
+ * scalar loop.  The results are bit exact with the macros above.  Expanding kernels run
+ * from the back of the buffer to the front and contracting and non-destructive kernels run
+ * from the front to the back; every block is loaded before it is stored, so the in-place
+ * (in_buff == out_buff) conversions behave as for the macros.
+ *
+ * Data movement is done on whole stereo frames where possible: a 16 bit stereo frame is
+ * moved as one 32 bit lane, and a 32 bit stereo frame as one 64 bit lane.
+ */
+
+#ifdef USE_SSE
+/* _mm_shuffle_ps() on integer vectors: lanes 0, 1 are selected from a and lanes 2, 3 from b. */
+#define SSE_SHUFFLE_EPI32(a, b, imm) \
+        _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), (imm)))
+
+/* Splits 8 interleaved int16_t stereo frames into their left and right channels. */
+static inline void sse_deinterleave_i16(__m128i v0, __m128i v1, __m128i* left, __m128i* right)
+{
+    /* the samples are sign extended to 32 bits so the saturating pack is exact */
+    *left = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16),
+            _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16));
+    *right = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+}
+
+/* Splits 4 interleaved int32_t stereo frames into their left and right channels. */
+static inline void sse_deinterleave_i32(__m128i v0, __m128i v1, __m128i* left, __m128i* right)
+{
+    *left = SSE_SHUFFLE_EPI32(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+    *right = SSE_SHUFFLE_EPI32(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+}
+#endif /* USE_SSE */
+
+/* Mono to stereo by duplication, as EXPAND_MONO_TO_MULTI() with out_buff_chans == 2. */
+static void mono_to_stereo_i16(const int16_t* in_buff, int16_t* out_buff, size_t frames)
+{
+    size_t i = frames;
+    for (; i % 8 != 0; --i) {
+        const int16_t sample = in_buff[i - 1];
+        out_buff[2 * i - 2] = sample;
+        out_buff[2 * i - 1] = sample;
+    }
+    while (i != 0) {
+        i -= 8;
+#ifdef USE_NEON
+        const int16x8_t v = vld1q_s16(in_buff + i);
+        const int16x8x2_t out = { { v, v } };
+        vst2q_s16(out_buff + 2 * i, out);
+#else
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in_buff + i));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i + 8), _mm_unpackhi_epi16(v, v));
+#endif
+    }
+}
+
+static void mono_to_stereo_i32(const int32_t* in_buff, int32_t* out_buff, size_t frames)
+{
+    size_t i = frames;
+    for (; i % 4 != 0; --i) {
+        const int32_t sample = in_buff[i - 1];
+        out_buff[2 * i - 2] = sample;
+        out_buff[2 * i - 1] = sample;
+    }
+    while (i != 0) {
+        i -= 4;
+#ifdef USE_NEON
+        const int32x4_t v = vld1q_s32(in_buff + i);
+        const int32x4x2_t out = { { v, v } };
+        vst2q_s32(out_buff + 2 * i, out);
+#else
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in_buff + i));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i), _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i + 4), _mm_unpackhi_epi32(v, v));
+#endif
+    }
+}
+
+/* Stereo to 8 channels, zero filling channels 2 to 7, as EXPAND_CHANNELS(). */
+static void stereo_to_octo_i16(const int16_t* in_buff, int16_t* out_buff, size_t frames)
+{
+    size_t i = frames;
+    for (; i % 4 != 0; --i) {
+        int16_t frame[8] = { in_buff[2 * i - 2], in_buff[2 * i - 1] };
+        memcpy(out_buff + 8 * i - 8, frame, sizeof(frame));
+    }
+    while (i != 0) {
+        i -= 4;
+#ifdef USE_NEON
+        const uint32x4_t zero = vdupq_n_u32(0);
+        const uint32x4x4_t out = { { vld1q_u32((const uint32_t*)(in_buff + 2 * i)),
+                zero, zero, zero } };
+        vst4q_u32((uint32_t*)(out_buff + 8 * i), out);
+#else
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in_buff + 2 * i));
+        const __m128i mask = _mm_cvtsi32_si128(-1);
+        __m128i* out = (__m128i*)(out_buff + 8 * i);
+        _mm_storeu_si128(out, _mm_and_si128(v, mask));
+        _mm_storeu_si128(out + 1, _mm_and_si128(_mm_srli_si128(v, 4), mask));
+        _mm_storeu_si128(out + 2, _mm_and_si128(_mm_srli_si128(v, 8), mask));
+        _mm_storeu_si128(out + 3, _mm_srli_si128(v, 12));
+#endif
+    }
+}
+
+static void stereo_to_octo_i32(const int32_t* in_buff, int32_t* out_buff, size_t frames)
+{
+    size_t i = frames;
+    for (; i % 2 != 0; --i) {
+        int32_t frame[8] = { in_buff[2 * i - 2], in_buff[2 * i - 1] };
+        memcpy(out_buff + 8 * i - 8, frame, sizeof(frame));
+    }
+    while (i != 0) {
+        i -= 2;
+#ifdef USE_NEON
+        const int32x4_t v = vld1q_s32(in_buff + 2 * i);
+        const int32x2_t zero2 = vdup_n_s32(0);
+        const int32x4_t zero = vdupq_n_s32(0);
+        int32_t* out = out_buff + 8 * i;
+        vst1q_s32(out, vcombine_s32(vget_low_s32(v), zero2));
+        vst1q_s32(out + 4, zero);
+        vst1q_s32(out + 8, vcombine_s32(vget_high_s32(v), zero2));
+        vst1q_s32(out + 12, zero);
+#else
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in_buff + 2 * i));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i* out = (__m128i*)(out_buff + 8 * i);
+        _mm_storeu_si128(out, _mm_move_epi64(v));
+        _mm_storeu_si128(out + 1, zero);
+        _mm_storeu_si128(out + 2, _mm_unpackhi_epi64(v, zero));
+        _mm_storeu_si128(out + 3, zero);
+#endif
+    }
+}
+
+/* Stereo to mono by averaging, as CONTRACT_TO_MONO() with in_buff_chans == 2. */
+static void stereo_to_mono_i16(const int16_t* in_buff, int16_t* out_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+#ifdef USE_NEON
+        /* the halving add truncates, as does the half adder in CONTRACT_TO_MONO() */
+        const int16x8x2_t v = vld2q_s16(in_buff + 2 * i);
+        vst1q_s16(out_buff + i, vhaddq_s16(v.val[0], v.val[1]));
+#else
+        __m128i left, right;
+        sse_deinterleave_i16(_mm_loadu_si128((const __m128i*)(in_buff + 2 * i)),
+                _mm_loadu_si128((const __m128i*)(in_buff + 2 * i + 8)), &left, &right);
+        _mm_storeu_si128((__m128i*)(out_buff + i), _mm_add_epi16(_mm_and_si128(left, right),
+                _mm_srai_epi16(_mm_xor_si128(left, right), 1)));
+#endif
+    }
+    for (; i < frames; ++i) {
+        const int32_t temp0 = in_buff[2 * i];
+        const int32_t temp1 = in_buff[2 * i + 1];
+        out_buff[i] = (temp0 & temp1) + ((temp0 ^ temp1) >> 1);
+    }
+}
+
+static void stereo_to_mono_i32(const int32_t* in_buff, int32_t* out_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+#ifdef USE_NEON
+        const int32x4x2_t v = vld2q_s32(in_buff + 2 * i);
+        vst1q_s32(out_buff + i, vhaddq_s32(v.val[0], v.val[1]));
+#else
+        __m128i left, right;
+        sse_deinterleave_i32(_mm_loadu_si128((const __m128i*)(in_buff + 2 * i)),
+                _mm_loadu_si128((const __m128i*)(in_buff + 2 * i + 4)), &left, &right);
+        _mm_storeu_si128((__m128i*)(out_buff + i), _mm_add_epi32(_mm_and_si128(left, right),
+                _mm_srai_epi32(_mm_xor_si128(left, right), 1)));
+#endif
+    }
+    for (; i < frames; ++i) {
+        const int32_t temp0 = in_buff[2 * i];
+        const int32_t temp1 = in_buff[2 * i + 1];
+        out_buff[i] = (temp0 & temp1) + ((temp0 ^ temp1) >> 1);
+    }
+}
+
+/*
+ * 6 channels to stereo, as CONTRACT_CHANNELS().
+ * If removed_buff is not NULL, channels 2 to 5 of each frame are stored there,
+ * as CONTRACT_CHANNELS_NON_DESTRUCTIVE().
+ */
+static void six_to_stereo_i16(const int16_t* in_buff, int16_t* out_buff,
+                              int16_t* removed_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+#ifdef USE_NEON
+        const uint32x4x3_t v = vld3q_u32((const uint32_t*)(in_buff + 6 * i));
+        vst1q_u32((uint32_t*)(out_buff + 2 * i), v.val[0]);
+        if (removed_buff != NULL) {
+            const uint32x4x2_t removed = { { v.val[1], v.val[2] } };
+            vst2q_u32((uint32_t*)(removed_buff + 4 * i), removed);
+        }
+#else
+        const __m128i* in = (const __m128i*)(in_buff + 6 * i);
+        const __m128i v0 = _mm_loadu_si128(in);
+        const __m128i v1 = _mm_loadu_si128(in + 1);
+        const __m128i v2 = _mm_loadu_si128(in + 2);
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i), SSE_SHUFFLE_EPI32(v0,
+                SSE_SHUFFLE_EPI32(v1, v2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0)));
+        if (removed_buff != NULL) {
+            __m128i* removed = (__m128i*)(removed_buff + 4 * i);
+            _mm_storeu_si128(removed, SSE_SHUFFLE_EPI32(v0, v1, _MM_SHUFFLE(1, 0, 2, 1)));
+            _mm_storeu_si128(removed + 1, SSE_SHUFFLE_EPI32(
+                    SSE_SHUFFLE_EPI32(v1, v2, _MM_SHUFFLE(0, 0, 3, 3)), v2,
+                    _MM_SHUFFLE(3, 2, 2, 0)));
+        }
+#endif
+    }
+    for (; i < frames; ++i) {
+        memmove(out_buff + 2 * i, in_buff + 6 * i, 2 * sizeof(*in_buff));
+        if (removed_buff != NULL) {
+            memcpy(removed_buff + 4 * i, in_buff + 6 * i + 2, 4 * sizeof(*in_buff));
+        }
+    }
+}
+
+static void six_to_stereo_i32(const int32_t* in_buff, int32_t* out_buff,
+                              int32_t* removed_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+#ifdef USE_NEON
+        const int32_t* in = in_buff + 6 * i;
+        const int32x4_t v0 = vld1q_s32(in);
+        const int32x4_t v1 = vld1q_s32(in + 4);
+        const int32x4_t v2 = vld1q_s32(in + 8);
+        vst1q_s32(out_buff + 2 * i, vcombine_s32(vget_low_s32(v0), vget_high_s32(v1)));
+        if (removed_buff != NULL) {
+            vst1q_s32(removed_buff + 4 * i, vcombine_s32(vget_high_s32(v0), vget_low_s32(v1)));
+            vst1q_s32(removed_buff + 4 * i + 4, v2);
+        }
+#else
+        /* a stereo frame is one double lane */
+        const double* in = (const double*)(in_buff + 6 * i);
+        const __m128d v0 = _mm_loadu_pd(in);
+        const __m128d v1 = _mm_loadu_pd(in + 2);
+        const __m128d v2 = _mm_loadu_pd(in + 4);
+        /* _mm_shuffle_pd() selects lane 0 from the first and lane 1 from the second operand */
+        _mm_storeu_pd((double*)(out_buff + 2 * i), _mm_shuffle_pd(v0, v1, 2));
+        if (removed_buff != NULL) {
+            _mm_storeu_pd((double*)(removed_buff + 4 * i), _mm_shuffle_pd(v0, v1, 1));
+            _mm_storeu_pd((double*)(removed_buff + 4 * i + 4), v2);
+        }
+#endif
+    }
+    for (; i < frames; ++i) {
+        memmove(out_buff + 2 * i, in_buff + 6 * i, 2 * sizeof(*in_buff));
+        if (removed_buff != NULL) {
+            memcpy(removed_buff + 4 * i, in_buff + 6 * i + 2, 4 * sizeof(*in_buff));
+        }
+    }
+}
+
+/* Interleaves two mono buffers to stereo, as EXPAND_CHANNELS_NON_DESTRUCTIVE() for 1 -> 2. */
+static void interleave_i16(const int16_t* left, const int16_t* right,
+                           int16_t* out_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+#ifdef USE_NEON
+        const int16x8x2_t out = { { vld1q_s16(left + i), vld1q_s16(right + i) } };
+        vst2q_s16(out_buff + 2 * i, out);
+#else
+        const __m128i l = _mm_loadu_si128((const __m128i*)(left + i));
+        const __m128i r = _mm_loadu_si128((const __m128i*)(right + i));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+#endif
+    }
+    for (; i < frames; ++i) {
+        const int16_t l = left[i];
+        const int16_t r = right[i];
+        out_buff[2 * i] = l;
+        out_buff[2 * i + 1] = r;
+    }
+}
+
+static void interleave_i32(const int32_t* left, const int32_t* right,
+                           int32_t* out_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+#ifdef USE_NEON
+        const int32x4x2_t out = { { vld1q_s32(left + i), vld1q_s32(right + i) } };
+        vst2q_s32(out_buff + 2 * i, out);
+#else
+        const __m128i l = _mm_loadu_si128((const __m128i*)(left + i));
+        const __m128i r = _mm_loadu_si128((const __m128i*)(right + i));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i), _mm_unpacklo_epi32(l, r));
+        _mm_storeu_si128((__m128i*)(out_buff + 2 * i + 4), _mm_unpackhi_epi32(l, r));
+#endif
+    }
+    for (; i < frames; ++i) {
+        const int32_t l = left[i];
+        const int32_t r = right[i];
+        out_buff[2 * i] = l;
+        out_buff[2 * i + 1] = r;
+    }
+}
+
+/* Splits stereo into two mono buffers, as CONTRACT_CHANNELS_NON_DESTRUCTIVE() for 2 -> 1. */
+static void deinterleave_i16(const int16_t* in_buff, int16_t* left, int16_t* right,
+                             size_t frames)
+{
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+#ifdef USE_NEON
+        const int16x8x2_t v = vld2q_s16(in_buff + 2 * i);
+        vst1q_s16(left + i, v.val[0]);
+        vst1q_s16(right + i, v.val[1]);
+#else
+        __m128i l, r;
+        sse_deinterleave_i16(_mm_loadu_si128((const __m128i*)(in_buff + 2 * i)),
+                _mm_loadu_si128((const __m128i*)(in_buff + 2 * i + 8)), &l, &r);
+        _mm_storeu_si128((__m128i*)(left + i), l);
+        _mm_storeu_si128((__m128i*)(right + i), r);
+#endif
+    }
+    for (; i < frames; ++i) {
+        const int16_t r = in_buff[2 * i + 1];
+        left[i] = in_buff[2 * i];
+        right[i] = r;
+    }
+}
+
+static void deinterleave_i32(const int32_t* in_buff, int32_t* left, int32_t* right,
+                             size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+#ifdef USE_NEON
+        const int32x4x2_t v = vld2q_s32(in_buff + 2 * i);
+        vst1q_s32(left + i, v.val[0]);
+        vst1q_s32(right + i, v.val[1]);
+#else
+        __m128i l, r;
+        sse_deinterleave_i32(_mm_loadu_si128((const __m128i*)(in_buff + 2 * i)),
+                _mm_loadu_si128((const __m128i*)(in_buff + 2 * i + 4)), &l, &r);
+        _mm_storeu_si128((__m128i*)(left + i), l);
+        _mm_storeu_si128((__m128i*)(right + i), r);
+#endif
+    }
+    for (; i < frames; ++i) {
+        const int32_t r = in_buff[2 * i + 1];
+        left[i] = in_buff[2 * i];
+        right[i] = r;
+    }
+}
+
+/*
+ * Stereo to 8 channels with channels 2 to 7 taken in order from extra_buff,
+ * as EXPAND_CHANNELS_NON_DESTRUCTIVE() for 2 -> 8.
+ */
+static void stereo_to_octo_non_destructive_i16(const int16_t* in_buff,
+        const int16_t* extra_buff, int16_t* out_buff, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+#ifdef USE_NEON
+        const uint32x4x3_t extra = vld3q_u32((const uint32_t*)(extra_buff + 6 * i));
+        const uint32x4x4_t out = { { vld1q_u32((const uint32_t*)(in_buff + 2 * i)),
+                extra.val[0], extra.val[1], extra.val[2] } };
+        vst4q_u32((uint32_t*)(out_buff + 8 * i), out);
+#else
+        const __m128i f = _mm_loadu_si128((const __m128i*)(in_buff + 2 * i));
+        const __m128i* extra = (const __m128i*)(extra_buff + 6 * i);
+        const __m128i e0 = _mm_loadu_si128(extra);
+        const __m128i e1 = _mm_loadu_si128(extra + 1);
+        const __m128i e2 = _mm_loadu_si128(extra + 2);
+        __m128i* out = (__m128i*)(out_buff + 8 * i);
+        _mm_storeu_si128(out, SSE_SHUFFLE_EPI32(
+                SSE_SHUFFLE_EPI32(f, e0, _MM_SHUFFLE(0, 0, 0, 0)), e0,
+                _MM_SHUFFLE(2, 1, 2, 0)));
+        _mm_storeu_si128(out + 1, SSE_SHUFFLE_EPI32(
+                SSE_SHUFFLE_EPI32(f, e0, _MM_SHUFFLE(3, 3, 1, 1)), e1,
+                _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_si128(out + 2, SSE_SHUFFLE_EPI32(
+                SSE_SHUFFLE_EPI32(f, e1, _MM_SHUFFLE(2, 2, 2, 2)),
+                SSE_SHUFFLE_EPI32(e1, e2, _MM_SHUFFLE(0, 0, 3, 3)),
+                _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_si128(out + 3, SSE_SHUFFLE_EPI32(
+                SSE_SHUFFLE_EPI32(f, e2, _MM_SHUFFLE(1, 1, 3, 3)), e2,
+                _MM_SHUFFLE(3, 2, 2, 0)));
+#endif
+    }
+    for (; i < frames; ++i) {
+        int16_t frame[8];
+        memcpy(frame, in_buff + 2 * i, 2 * sizeof(*in_buff));
+        memcpy(frame + 2, extra_buff + 6 * i, 6 * sizeof(*in_buff));
+        memcpy(out_buff + 8 * i, frame, sizeof(frame));
+    }
+}
+
+static void stereo_to_octo_non_destructive_i32(const int32_t* in_buff,
+        const int32_t* extra_buff, int32_t* out_buff, size_t frames)
+{
+    for (size_t i = 0; i < frames; ++i) {
+        const int32_t* extra = extra_buff + 6 * i;
+#ifdef USE_NEON
+        const int32x4_t out0 = vcombine_s32(vld1_s32(in_buff + 2 * i), vld1_s32(extra));
+        const int32x4_t out1 = vld1q_s32(extra + 2);
+        vst1q_s32(out_buff + 8 * i, out0);
+        vst1q_s32(out_buff + 8 * i + 4, out1);
+#else
+        const __m128i out0 = _mm_unpacklo_epi64(
+                _mm_loadl_epi64((const __m128i*)(in_buff + 2 * i)),
+                _mm_loadl_epi64((const __m128i*)extra));
+        const __m128i out1 = _mm_loadu_si128((const __m128i*)(extra + 2));
+        _mm_storeu_si128((__m128i*)(out_buff + 8 * i), out0);
+        _mm_storeu_si128((__m128i*)(out_buff + 8 * i + 4), out1);
+#endif
+    }
+}
+
+/*
+ * Returns the number of whole frames in num_in_bytes, or 0 if the conversion has no
+ * vectorized kernel (it is then left to the generic macros).
+ */
+static size_t simd_frames(size_t in_buff_chans, size_t out_buff_chans,
+                          unsigned sample_size_in_bytes, size_t num_in_bytes)
+{
+    if (sample_size_in_bytes != 2 && sample_size_in_bytes != 4) {
+        return 0;
+    }
+    if (!(in_buff_chans == 1 && out_buff_chans == 2)
+            && !(in_buff_chans == 2 && out_buff_chans == 1)
+            && !(in_buff_chans == 2 && out_buff_chans == 8)
+            && !(in_buff_chans == 6 && out_buff_chans == 2)) {
+        return 0;
+    }
+    const size_t frame_size = in_buff_chans * sample_size_in_bytes;
+    return num_in_bytes % frame_size == 0 ? num_in_bytes / frame_size : 0;
+}
+
+/* Returns the number of bytes generated, or 0 if there is no vectorized kernel. */
+static size_t contract_channels_simd(const void* in_buff, size_t in_buff_chans,
+                                     void* out_buff, size_t out_buff_chans,
+                                     unsigned sample_size_in_bytes, size_t num_in_bytes)
+{
+    const size_t frames = simd_frames(in_buff_chans, out_buff_chans,
+            sample_size_in_bytes, num_in_bytes);
+    if (frames == 0 || out_buff_chans > in_buff_chans) {
+        return 0;
+    }
+    if (sample_size_in_bytes == 2) {
+        if (out_buff_chans == 1) {
+            stereo_to_mono_i16((const int16_t*)in_buff, (int16_t*)out_buff, frames);
+        } else {
+            six_to_stereo_i16((const int16_t*)in_buff, (int16_t*)out_buff, NULL, frames);
+        }
+    } else {
+        if (out_buff_chans == 1) {
+            stereo_to_mono_i32((const int32_t*)in_buff, (int32_t*)out_buff, frames);
+        } else {
+            six_to_stereo_i32((const int32_t*)in_buff, (int32_t*)out_buff, NULL, frames);
+        }
+    }
+    return frames * out_buff_chans * sample_size_in_bytes;
+}
+
+/* Returns the number of bytes generated, or 0 if there is no vectorized kernel. */
+static size_t expand_channels_simd(const void* in_buff, size_t in_buff_chans,
+                                   void* out_buff, size_t out_buff_chans,
+                                   unsigned sample_size_in_bytes, size_t num_in_bytes)
+{
+    const size_t frames = simd_frames(in_buff_chans, out_buff_chans,
+            sample_size_in_bytes, num_in_bytes);
+    if (frames == 0 || out_buff_chans < in_buff_chans) {
+        return 0;
+    }
+    if (sample_size_in_bytes == 2) {
+        if (in_buff_chans == 1) {
+            mono_to_stereo_i16((const int16_t*)in_buff, (int16_t*)out_buff, frames);
+        } else {
+            stereo_to_octo_i16((const int16_t*)in_buff, (int16_t*)out_buff, frames);
+        }
+    } else {
+        if (in_buff_chans == 1) {
+            mono_to_stereo_i32((const int32_t*)in_buff, (int32_t*)out_buff, frames);
+        } else {
+            stereo_to_octo_i32((const int32_t*)in_buff, (int32_t*)out_buff, frames);
+        }
+    }
+    return frames * out_buff_chans * sample_size_in_bytes;
+}
+
+/*
+ * Returns the number of bytes generated, or 0 if there is no vectorized kernel.
+ * removed_buff receives the contracted channels; if in-place it must not overlap out_buff.
+ */
+static size_t contract_channels_non_destructive_kernel(const void* in_buff,
+        size_t out_buff_chans, void* out_buff, void* removed_buff,
+        unsigned sample_size_in_bytes, size_t frames)
+{
+    if (sample_size_in_bytes == 2) {
+        if (out_buff_chans == 1) {
+            deinterleave_i16((const int16_t*)in_buff, (int16_t*)out_buff,
+                    (int16_t*)removed_buff, frames);
+        } else {
+            six_to_stereo_i16((const int16_t*)in_buff, (int16_t*)out_buff,
+                    (int16_t*)removed_buff, frames);
+        }
+    } else {
+        if (out_buff_chans == 1) {
+            deinterleave_i32((const int32_t*)in_buff, (int32_t*)out_buff,
+                    (int32_t*)removed_buff, frames);
+        } else {
+            six_to_stereo_i32((const int32_t*)in_buff, (int32_t*)out_buff,
+                    (int32_t*)removed_buff, frames);
+        }
+    }
+    return frames * out_buff_chans * sample_size_in_bytes;
+}
+
+static size_t contract_channels_non_destructive_simd(const void* in_buff, size_t in_buff_chans,
+        void* out_buff, size_t out_buff_chans,
+        unsigned sample_size_in_bytes, size_t num_in_bytes)
+{
+    const size_t frames = simd_frames(in_buff_chans, out_buff_chans,
+            sample_size_in_bytes, num_in_bytes);
+    if (frames == 0 || out_buff_chans > in_buff_chans) {
+        return 0;
+    }
+    const size_t num_out_bytes = frames * out_buff_chans * sample_size_in_bytes;
+    if (in_buff != out_buff) {
+        return contract_channels_non_destructive_kernel(in_buff, out_buff_chans, out_buff,
+                (uint8_t*)out_buff + num_out_bytes, sample_size_in_bytes, frames);
+    }
+    /* if in-place, store the removed channels in a temp buffer, as the macro does */
+    const size_t num_temp_bytes = num_in_bytes - num_out_bytes;
+    int32_t temp_buff[num_temp_bytes / sizeof(int32_t) + 1];
+    contract_channels_non_destructive_kernel(in_buff, out_buff_chans, out_buff, temp_buff,
+            sample_size_in_bytes, frames);
+    memcpy((uint8_t*)out_buff + num_out_bytes, temp_buff, num_temp_bytes);
+    return num_out_bytes;
+}
+
+static size_t expand_channels_non_destructive_kernel(const void* in_buff,
+        size_t in_buff_chans, const void* extra_buff, void* out_buff,
+        unsigned sample_size_in_bytes, size_t frames)
+{
+    if (sample_size_in_bytes == 2) {
+        if (in_buff_chans == 1) {
+            interleave_i16((const int16_t*)in_buff, (const int16_t*)extra_buff,
+                    (int16_t*)out_buff, frames);
+        } else {
+            stereo_to_octo_non_destructive_i16((const int16_t*)in_buff,
+                    (const int16_t*)extra_buff, (int16_t*)out_buff, frames);
+        }
+        return frames * (in_buff_chans == 1 ? 2 : 8) * sizeof(int16_t);
+    }
+    if (in_buff_chans == 1) {
+        interleave_i32((const int32_t*)in_buff, (const int32_t*)extra_buff,
+                (int32_t*)out_buff, frames);
+    } else {
+        stereo_to_octo_non_destructive_i32((const int32_t*)in_buff,
+                (const int32_t*)extra_buff, (int32_t*)out_buff, frames);
+    }
+    return frames * (in_buff_chans == 1 ? 2 : 8) * sizeof(int32_t);
+}
+
+static size_t expand_channels_non_destructive_simd(const void* in_buff, size_t in_buff_chans,
+        void* out_buff, size_t out_buff_chans,
+        unsigned sample_size_in_bytes, size_t num_in_bytes)
+{
+    const size_t frames = simd_frames(in_buff_chans, out_buff_chans,
+            sample_size_in_bytes, num_in_bytes);
+    if (frames == 0 || out_buff_chans < in_buff_chans) {
+        return 0;
+    }
+    /* the extra channels are interleaved from the back of the input buffer */
+    const void* extra_buff = (const uint8_t*)in_buff + num_in_bytes;
+    if (in_buff != out_buff) {
+        return expand_channels_non_destructive_kernel(in_buff, in_buff_chans, extra_buff,
+                out_buff, sample_size_in_bytes, frames);
+    }
+    /* if in-place, copy input channels to a temp buffer, as the macro does */
+    int32_t temp_buff[num_in_bytes / sizeof(int32_t) + 1];
+    memcpy(temp_buff, in_buff, num_in_bytes);
+    return expand_channels_non_destructive_kernel(temp_buff, in_buff_chans, extra_buff,
+            out_buff, sample_size_in_bytes, frames);
+}
+
+#endif /* USE_NEON || USE_SSE */
+
 /*
  * Convert a buffer of N-channel, interleaved samples to M-channel
  * (where N > M).
@@ -372,6 +978,14 @@ static size_t contract_channels(const void* in_buff, size_t in_buff_chans,
                                 void* out_buff, size_t out_buff_chans,
                                 unsigned sample_size_in_bytes, size_t num_in_bytes)
 {
+#if defined(USE_NEON) || defined(USE_SSE)
+    const size_t simd_bytes = contract_channels_simd(in_buff, in_buff_chans,
+            out_buff, out_buff_chans, sample_size_in_bytes, num_in_bytes);
+    if (simd_bytes != 0) {
+        return simd_bytes;
+    }
+#endif
+
     switch (sample_size_in_bytes) {
     case 1:
         if (out_buff_chans == 1) {
@@ -444,6 +1058,14 @@ static size_t contract_channels_non_destructive(const void* in_buff, size_t in_b
                                 void* out_buff, size_t out_buff_chans,
                                 unsigned sample_size_in_bytes, size_t num_in_bytes)
 {
+#if defined(USE_NEON) || defined(USE_SSE)
+    const size_t simd_bytes = contract_channels_non_destructive_simd(in_buff, in_buff_chans,
+            out_buff, out_buff_chans, sample_size_in_bytes, num_in_bytes);
+    if (simd_bytes != 0) {
+        return simd_bytes;
+    }
+#endif
+
     switch (sample_size_in_bytes) {
     case 1:
         CONTRACT_CHANNELS_NON_DESTRUCTIVE((const uint8_t*)in_buff, in_buff_chans,
@@ -492,6 +1114,14 @@ static size_t expand_channels(const void* in_buff, size_t in_buff_chans,
 {
     static const uint8x3_t packed24_zero; /* zero 24 bit sample */
 
+#if defined(USE_NEON) || defined(USE_SSE)
+    const size_t simd_bytes = expand_channels_simd(in_buff, in_buff_chans, out_buff,
+            out_buff_chans, sample_size_in_bytes, num_in_bytes);
+    if (simd_bytes != 0) {
+        return simd_bytes;
+    }
+#endif
+
     switch (sample_size_in_bytes) {
     case 1:
         if (in_buff_chans == 1) {
@@ -625,6 +1255,14 @@ static size_t expand_channels_non_destructive(const void* in_buff, size_t in_buf
                               void* out_buff, size_t out_buff_chans,
                               unsigned sample_size_in_bytes, size_t num_in_bytes)
 {
+#if defined(USE_NEON) || defined(USE_SSE)
+    const size_t simd_bytes = expand_channels_non_destructive_simd(in_buff, in_buff_chans,
+            out_buff, out_buff_chans, sample_size_in_bytes, num_in_bytes);
+    if (simd_bytes != 0) {
+        return simd_bytes;
+    }
+#endif
+
     switch (sample_size_in_bytes) {
     case 1:
 
@@ -0,0 +1,752 @@
+/*
+** Copyright 2011, The Android Open-Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "echo_reference"
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <log/log.h>
+#include <system/audio.h>
+#include <audio_utils/channels.h>
+#include <audio_utils/fifo.h>
+#include <audio_utils/format.h>
+#include <audio_utils/resampler.h>
+#include <audio_utils/echo_reference.h>
+#include <audio_utils/Statistics.h>
+
+// echo reference state: bit field indicating if read, write or both are active.
+enum state {
+    ECHOREF_IDLE = 0x00,        // idle
+    ECHOREF_READING = 0x01,     // reading is active
+    ECHOREF_WRITING = 0x02      // writing is active
+};
+
+// frames buffered between writer and reader, in ms at the read sampling rate
+#define ECHO_REFERENCE_BUFFER_MS 1000
+// write() processes its buffer by chunks of this many frames, through fixed size scratch buffers
+#define ECHO_REFERENCE_CHUNK_FRAMES 256
+/* additional space in resampler output allowing for extra samples to be returned
+ * when sample rates ratio is not an integer.
+ */
+#define RESAMPLER_HEADROOM_SAMPLES   10
+
+// forgetting factor of the drift estimators, per time stamp: about 50 s of 10 ms buffers
+#define ECHO_REFERENCE_DRIFT_ALPHA 0.9998
+// history needed before a drift estimate is used
+#define ECHO_REFERENCE_DRIFT_MIN_SPAN_NS 2000000000LL
+// deviation from the fit of a new time stamp restarting the estimation, e.g. after an underrun
+#define ECHO_REFERENCE_DRIFT_DISCONTINUITY_NS 20000000LL
+// ratio correction for the residual misalignment of the reference, in ppm per ms
+#define ECHO_REFERENCE_DRIFT_GAIN_PPM_PER_MS 20.
+// smoothing of the misalignment observed by read(), per read
+#define ECHO_REFERENCE_DRIFT_DELTA_ALPHA 0.95
+
+/*
+ * Rate of the audio clock of one side against CLOCK_MONOTONIC, from a least squares fit of
+ * the frames transferred against their time stamps, as TimestampVerifier does.
+ */
+struct echo_reference_drift {
+    android::audio_utils::LinearLeastSquaresFit<double> fit{ECHO_REFERENCE_DRIFT_ALPHA};
+    int64_t origin_ns = 0;          // time of the first time stamp of the fit
+    int64_t last_ns = 0;            // time of the last time stamp of the fit
+    int64_t frames = 0;             // frames transferred since the first time stamp
+};
+
+/*
+ * The writer (playback) and reader (capture) threads share only the FIFO and the atomic fields
+ * below, so that neither ever waits for the other; the reader may choose to wait for data.
+ * Everything needed by the audio path is allocated by create_echo_reference().
+ */
+struct echo_reference {
+    struct echo_reference_itfe itfe;
+    audio_format_t rd_format;       // read sample format
+    uint32_t rd_channel_count;      // read number of channels
+    uint32_t rd_sampling_rate;      // read sampling rate in Hz
+    size_t rd_frame_size;           // read frame size (bytes per sample)
+    audio_format_t wr_format;       // write sample format
+    uint32_t wr_channel_count;      // write number of channels
+    uint32_t wr_sampling_rate;      // write sampling rate in Hz
+    size_t wr_frame_size;           // write frame size (bytes per sample)
+    uint32_t buf_size;              // FIFO and reader buffer size in frames
+
+    // shared by writer and reader
+    std::atomic<uint32_t> state;    // active state: reading, writing or both
+    // published by write() for read(), consistent through render_seq, odd while updating
+    std::atomic<uint32_t> render_seq;
+    std::atomic<int64_t> render_time_ns;   // latest render time indicated by write()
+    std::atomic<int32_t> playback_delay;   // playback buffer delay indicated by last write()
+    std::atomic<int32_t> resampler_delay;  // delay of the frames held by the resampler
+    // published by read() for write()
+    std::atomic<double> rd_rate_ratio;     // measured capture rate over nominal, 0 if unknown
+    std::atomic<int32_t> rd_delta_ns;      // smoothed misalignment of the reference
+    std::unique_ptr<uint8_t[]> fifo_buffer;
+    audio_utils_fifo_padded fifo;   // write() to read(), rd_format frames
+
+    // used by write() only
+    audio_utils_cache_line_aligned<audio_utils_fifo_writer> writer;
+    int64_t wr_render_time_ns;      // latest render time indicated by write()
+    struct resampler_itfe *resampler;          // input resampler
+    audio_format_t wr_rsmp_format;  // format resampled in, or read format without resampler
+    // channel and format conversion output, ECHO_REFERENCE_CHUNK_FRAMES of up to float samples
+    std::unique_ptr<uint8_t[]> wr_buf;
+    // resampler output, wr_rsmp_frames of up to float samples
+    std::unique_ptr<uint8_t[]> wr_rsmp_buf;
+    size_t wr_rsmp_frames;
+    bool wr_bypass;                 // resampler not used yet, the rates being equal
+    // last frames queued while bypassed, in wr_rsmp_format, ECHO_REFERENCE_CHUNK_FRAMES of
+    // up to float samples: the resampler history when it takes over
+    std::unique_ptr<uint8_t[]> wr_tail;
+    size_t wr_tail_frames;          // valid frames in wr_tail
+    int32_t wr_ratio_ppm;           // drift compensation applied to the resampler
+    struct echo_reference_drift wr_drift;   // frames written against render time
+
+    // used by read() only
+    audio_utils_cache_line_aligned<audio_utils_fifo_reader> reader;
+    std::unique_ptr<uint8_t[]> buffer;  // frames taken from the FIFO, buf_size frames
+    size_t frames_in;               // number of frames in buffer
+    int16_t prev_delta_sign;        // sign of previous delay difference:
+                                    //  1: positive, -1: negative, 0: unknown
+    uint16_t delta_count;           // number of consecutive delay differences with same sign
+    double rd_delta_avg;            // smoothed misalignment in ns
+    struct echo_reference_drift rd_drift;   // frames read against capture time
+
+    echo_reference(uint32_t frames, size_t frameSize)
+        : state(ECHOREF_IDLE), render_seq(0), render_time_ns(0), playback_delay(0),
+          resampler_delay(0), rd_rate_ratio(0.), rd_delta_ns(0),
+          fifo_buffer(new uint8_t[frames * frameSize]),
+          fifo(frames, frameSize, fifo_buffer.get()),
+          writer(fifo), wr_render_time_ns(0), resampler(NULL),
+          wr_rsmp_format(AUDIO_FORMAT_INVALID), wr_rsmp_frames(0), wr_bypass(false),
+          wr_tail_frames(0), wr_ratio_ppm(0),
+          reader(fifo), buffer(new uint8_t[frames * frameSize]), frames_in(0),
+          prev_delta_sign(0), delta_count(0), rd_delta_avg(0.) { }
+};
+
+static int64_t echo_reference_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static void echo_reference_drift_reset(struct echo_reference_drift *drift)
+{
+    drift->fit.reset();
+    drift->frames = 0;
+}
+
+// Adds frames transferred from time timeNs on.
+static void echo_reference_drift_add(struct echo_reference_drift *drift, int64_t timeNs,
+        size_t frames, uint32_t sampleRate)
+{
+    if (drift->fit.getN() == 0) {
+        drift->origin_ns = timeNs;
+    } else if (timeNs - drift->origin_ns >= ECHO_REFERENCE_DRIFT_MIN_SPAN_NS) {
+        const double predictedNs =
+                drift->fit.getXFromY((double)drift->frames) * 1e9 + drift->origin_ns;
+        if (fabs(timeNs - predictedNs) > ECHO_REFERENCE_DRIFT_DISCONTINUITY_NS) {
+            ALOGV("echo_reference drift discontinuity %.0f ns", timeNs - predictedNs);
+            echo_reference_drift_reset(drift);
+            drift->origin_ns = timeNs;
+        }
+    } else if (timeNs < drift->last_ns ||
+            timeNs - drift->last_ns > ECHO_REFERENCE_DRIFT_DISCONTINUITY_NS
+                    + (int64_t)frames * 1000000000 / sampleRate) {
+        // not enough history to predict, restart on a gap or retrograde time stamp
+        echo_reference_drift_reset(drift);
+        drift->origin_ns = timeNs;
+    }
+    drift->fit.add({(timeNs - drift->origin_ns) * 1e-9, (double)drift->frames});
+    drift->last_ns = timeNs;
+    drift->frames += frames;
+}
+
+// Returns the rate in frames per second, or 0 if not enough history.
+static double echo_reference_drift_rate(const struct echo_reference_drift *drift)
+{
+    if (drift->fit.getN() < 3 || drift->last_ns - drift->origin_ns
+            < ECHO_REFERENCE_DRIFT_MIN_SPAN_NS) {
+        return 0.;
+    }
+    double a, b, r2;
+    drift->fit.computeYLine(a, b, r2);
+    return b;
+}
+
+// Called by write() only: publishes the render time and delays for read().
+static void echo_reference_publish(struct echo_reference *er, int64_t renderTimeNs,
+        int32_t playbackDelay, int32_t resamplerDelay)
+{
+    const uint32_t seq = er->render_seq.load(std::memory_order_relaxed);
+    er->render_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    er->render_time_ns.store(renderTimeNs, std::memory_order_relaxed);
+    er->playback_delay.store(playbackDelay, std::memory_order_relaxed);
+    er->resampler_delay.store(resamplerDelay, std::memory_order_relaxed);
+    er->render_seq.store(seq + 2, std::memory_order_release);
+}
+
+// Called by read() only: returns a consistent snapshot of the values published by write().
+static void echo_reference_snapshot(struct echo_reference *er, int64_t *renderTimeNs,
+        int32_t *playbackDelay, int32_t *resamplerDelay)
+{
+    uint32_t seq;
+    do {
+        seq = er->render_seq.load(std::memory_order_acquire);
+        *renderTimeNs = er->render_time_ns.load(std::memory_order_relaxed);
+        *playbackDelay = er->playback_delay.load(std::memory_order_relaxed);
+        *resamplerDelay = er->resampler_delay.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != er->render_seq.load(std::memory_order_relaxed));
+}
+
+// Called by read() only: discards the frames buffered by the reader and in the FIFO.
+static void echo_reference_reset_reader(struct echo_reference *er)
+{
+    ALOGV("echo_reference_reset_reader()");
+    er->reader.flush();
+    er->frames_in = 0;
+    er->delta_count = 0;
+    er->prev_delta_sign = 0;
+    er->rd_delta_avg = 0.;
+    er->rd_delta_ns.store(0, std::memory_order_relaxed);
+    echo_reference_drift_reset(&er->rd_drift);
+    er->rd_rate_ratio.store(0., std::memory_order_relaxed);
+}
+
+// Called by read() only: publishes the smoothed misalignment of the reference for write().
+static void echo_reference_update_delta(struct echo_reference *er, int64_t deltaNs)
+{
+    er->rd_delta_avg = ECHO_REFERENCE_DRIFT_DELTA_ALPHA * er->rd_delta_avg
+            + (1. - ECHO_REFERENCE_DRIFT_DELTA_ALPHA) * deltaNs;
+    er->rd_delta_ns.store((int32_t)fmin(fmax(er->rd_delta_avg, INT32_MIN), INT32_MAX),
+            std::memory_order_relaxed);
+}
+
+// Called by write() only: converts count frames from the write to the read channel count,
+// keeping the write format.
+static void echo_reference_adjust_channels(struct echo_reference *er, const void *src,
+        void *dst, size_t count)
+{
+    if (er->wr_format == AUDIO_FORMAT_PCM_FLOAT && er->rd_channel_count == 1) {
+        // adjust_channels() mixes to mono as integers, average the first two channels here
+        const float *srcFloat = (const float *)src;
+        float *dstFloat = (float *)dst;
+        for (size_t i = 0; i < count; ++i) {
+            dstFloat[i] = (srcFloat[0] + srcFloat[1]) * 0.5f;
+            srcFloat += er->wr_channel_count;
+        }
+        return;
+    }
+    adjust_channels(src, er->wr_channel_count, dst, er->rd_channel_count,
+            audio_bytes_per_sample(er->wr_format), count * er->wr_frame_size);
+}
+
+// Called by write() only: queues frames in read format for read(), dropping those that
+// do not fit rather than waiting for the reader.
+static void echo_reference_queue(struct echo_reference *er, const void *frames, size_t count)
+{
+    const ssize_t written = er->writer.write(frames, count);
+    if (written < (ssize_t)count) {
+        ALOGV("echo_reference_write() FIFO full, dropped %zd frames", count - written);
+    }
+}
+
+// Called by write() only: keeps the last of the frames queued while bypassed, which are in
+// read format, as the resampler history for when it takes over.
+static void echo_reference_keep_tail(struct echo_reference *er, const void *frames,
+        size_t count)
+{
+    const size_t frameSize = audio_bytes_per_sample(er->wr_rsmp_format) * er->rd_channel_count;
+    size_t keep = 0;
+    if (count >= ECHO_REFERENCE_CHUNK_FRAMES) {
+        frames = (const uint8_t *)frames
+                + (count - ECHO_REFERENCE_CHUNK_FRAMES) * er->rd_frame_size;
+        count = ECHO_REFERENCE_CHUNK_FRAMES;
+    } else {
+        keep = std::min(er->wr_tail_frames, ECHO_REFERENCE_CHUNK_FRAMES - count);
+        memmove(er->wr_tail.get(),
+                er->wr_tail.get() + (er->wr_tail_frames - keep) * frameSize, keep * frameSize);
+    }
+    memcpy_by_audio_format(er->wr_tail.get() + keep * frameSize, er->wr_rsmp_format,
+            frames, er->rd_format, count * er->rd_channel_count);
+    er->wr_tail_frames = keep + count;
+}
+
+// Called by write() only: adjusts the resampling ratio to the drift between the playback and
+// capture clocks, as measured by the writer and the reader, and to the residual misalignment
+// of the reference observed by the reader.
+static void echo_reference_track_drift(struct echo_reference *er)
+{
+    const double wrRate = echo_reference_drift_rate(&er->wr_drift);
+    const double rdRatio = er->rd_rate_ratio.load(std::memory_order_relaxed);
+    if (er->resampler == NULL || wrRate == 0. || rdRatio == 0.) {
+        return;
+    }
+    double ppm = (wrRate / er->wr_sampling_rate / rdRatio - 1.) * 1e6
+            + er->rd_delta_ns.load(std::memory_order_relaxed) * 1e-6
+                    * ECHO_REFERENCE_DRIFT_GAIN_PPM_PER_MS;
+    ppm = fmin(fmax(ppm, -RESAMPLER_RATIO_PPM_MAX), RESAMPLER_RATIO_PPM_MAX);
+    const int32_t ratioPpm = (int32_t)lround(ppm);
+    if (ratioPpm == er->wr_ratio_ppm) {
+        return;
+    }
+    int rc = er->resampler->set_ratio_ppm(er->resampler, ratioPpm);
+    if (rc == 0 && er->wr_bypass) {
+        // continue from the frames already queued rather than from silence
+        if (er->wr_rsmp_format == AUDIO_FORMAT_PCM_FLOAT) {
+            rc = er->resampler->reset_with_history_float(er->resampler,
+                    (const float *)er->wr_tail.get(), er->wr_tail_frames);
+        } else {
+            rc = er->resampler->reset_with_history(er->resampler,
+                    (const int16_t *)er->wr_tail.get(), er->wr_tail_frames);
+        }
+        if (rc == 0) {
+            ALOGV("echo_reference_track_drift() start resampling at %d ppm", ratioPpm);
+            er->wr_bypass = false;
+        }
+    }
+    if (rc != 0) {
+        ALOGW("echo_reference_track_drift() cannot resample at %d ppm: %d", ratioPpm, rc);
+        return;
+    }
+    er->wr_ratio_ppm = ratioPpm;
+}
+
+static int echo_reference_write(struct echo_reference_itfe *echo_reference,
+                         struct echo_reference_buffer *buffer)
+{
+    struct echo_reference *er = (struct echo_reference *)echo_reference;
+
+    if (er == NULL) {
+        return -EINVAL;
+    }
+
+    if (buffer == NULL) {
+        ALOGV("echo_reference_write() stop write");
+        er->state.fetch_and(~ECHOREF_WRITING);
+        er->wr_render_time_ns = 0;
+        echo_reference_publish(er, 0, 0, 0);
+        return 0;
+    }
+
+    ALOGV("echo_reference_write() START trying to write %zu frames", buffer->frame_count);
+    ALOGV("echo_reference_write() playbackTimestamp:[%d].[%d], delay_ns:[%d]",
+            (int)buffer->time_stamp.tv_sec,
+            (int)buffer->time_stamp.tv_nsec, buffer->delay_ns);
+
+    // discard writes until a valid time stamp is provided.
+    const int64_t renderTimeNs = echo_reference_ns(&buffer->time_stamp);
+    if (renderTimeNs == 0 && er->wr_render_time_ns == 0) {
+        return 0;
+    }
+
+    uint32_t currentState = er->state.load();
+    if ((currentState & ECHOREF_WRITING) == 0) {
+        ALOGV("echo_reference_write() start write");
+        if (er->resampler != NULL) {
+            er->resampler->reset(er->resampler);
+        }
+        er->wr_tail_frames = 0;
+        echo_reference_drift_reset(&er->wr_drift);
+        currentState = er->state.fetch_or(ECHOREF_WRITING) | ECHOREF_WRITING;
+    }
+
+    // the frames written are rendered by renderTimeNs + delay_ns
+    echo_reference_drift_add(&er->wr_drift, renderTimeNs + buffer->delay_ns,
+            buffer->frame_count, er->wr_sampling_rate);
+
+    if ((currentState & ECHOREF_READING) == 0) {
+        return 0;
+    }
+
+    er->wr_render_time_ns = renderTimeNs;
+    echo_reference_track_drift(er);
+
+    // adjust channels, format and sampling rate if necessary, a chunk at a time
+    for (size_t done = 0; done < buffer->frame_count; ) {
+        size_t frames = buffer->frame_count - done;
+        if (frames > ECHO_REFERENCE_CHUNK_FRAMES) {
+            frames = ECHO_REFERENCE_CHUNK_FRAMES;
+        }
+        const void *src = (const uint8_t *)buffer->raw + done * er->wr_frame_size;
+        done += frames;
+
+        // channels first, so that only the channels read are converted and resampled
+        if (er->rd_channel_count != er->wr_channel_count) {
+            echo_reference_adjust_channels(er, src, er->wr_buf.get(), frames);
+            src = er->wr_buf.get();
+        }
+        const bool resample = er->resampler != NULL && !er->wr_bypass;
+        const audio_format_t format = resample ? er->wr_rsmp_format : er->rd_format;
+        if (er->wr_format != format) {
+            memcpy_by_audio_format(er->wr_buf.get(), format, src, er->wr_format,
+                    frames * er->rd_channel_count);
+            src = er->wr_buf.get();
+        }
+        if (!resample) {
+            echo_reference_queue(er, src, frames);
+            if (er->wr_bypass) {
+                echo_reference_keep_tail(er, src, frames);
+            }
+            continue;
+        }
+        const size_t rsmpFrameSize =
+                audio_bytes_per_sample(er->wr_rsmp_format) * er->rd_channel_count;
+        while (frames > 0) {
+            size_t inFrames = frames;
+            size_t outFrames = er->wr_rsmp_frames;
+            int rc;
+            if (er->wr_rsmp_format == AUDIO_FORMAT_PCM_FLOAT) {
+                rc = er->resampler->resample_from_input_float(er->resampler, (float *)src,
+                        &inFrames, (float *)er->wr_rsmp_buf.get(), &outFrames);
+            } else {
+                rc = er->resampler->resample_from_input(er->resampler, (int16_t *)src,
+                        &inFrames, (int16_t *)er->wr_rsmp_buf.get(), &outFrames);
+            }
+            if (rc != 0) {
+                ALOGW("echo_reference_write() resampling error %d", rc);
+                return rc;
+            }
+            if (er->rd_format != er->wr_rsmp_format) {
+                memcpy_by_audio_format(er->wr_rsmp_buf.get(), er->rd_format,
+                        er->wr_rsmp_buf.get(), er->wr_rsmp_format,
+                        outFrames * er->rd_channel_count);
+            }
+            echo_reference_queue(er, er->wr_rsmp_buf.get(), outFrames);
+            src = (const uint8_t *)src + inFrames * rsmpFrameSize;
+            frames -= inFrames;
+        }
+    }
+
+    echo_reference_publish(er, renderTimeNs, buffer->delay_ns,
+            er->resampler != NULL && !er->wr_bypass ? er->resampler->delay_ns(er->resampler) : 0);
+
+    ALOGV("echo_reference_write() END frames written:[%zu], render time:[%" PRId64 "]",
+          buffer->frame_count, renderTimeNs);
+    return 0;
+}
+
+// delay jump threshold to update ref buffer: 6 samples at 8kHz in nsecs
+#define MIN_DELAY_DELTA_NS (375000*2)
+// number of consecutive delta with same sign between expected and actual delay before adjusting
+// the buffer
+#define MIN_DELTA_NUM 4
+
+// Called by read() only: moves the frames available in the FIFO to the reader buffer,
+// waiting up to timeoutNs for at least count frames in total.
+static void echo_reference_fill(struct echo_reference *er, size_t count, int64_t timeoutNs)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const struct timespec *timeout = NULL;  // first drain what is there without blocking
+    struct timespec remaining;
+    for (;;) {
+        const ssize_t frames = er->reader.read(er->buffer.get() + er->frames_in * er->rd_frame_size,
+                er->buf_size - er->frames_in, timeout);
+        if (frames > 0) {
+            er->frames_in += frames;
+        }
+        if (er->frames_in >= count || er->frames_in == er->buf_size) {
+            break;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const int64_t left = timeoutNs - (echo_reference_ns(&now) - echo_reference_ns(&start));
+        if (left <= 0) {
+            ALOGV("echo_reference_read() waited %" PRId64 " ns but still not enough frames"
+                    " er->frames_in: %zu, count = %zu", timeoutNs, er->frames_in, count);
+            break;
+        }
+        remaining.tv_sec = left / 1000000000;
+        remaining.tv_nsec = left % 1000000000;
+        timeout = &remaining;
+    }
+}
+
+static int echo_reference_read(struct echo_reference_itfe *echo_reference,
+                         struct echo_reference_buffer *buffer)
+{
+    struct echo_reference *er = (struct echo_reference *)echo_reference;
+
+    if (er == NULL) {
+        return -EINVAL;
+    }
+
+    if (buffer == NULL) {
+        ALOGV("echo_reference_read() stop read");
+        er->state.fetch_and(~ECHOREF_READING);
+        return 0;
+    }
+    if (buffer->frame_count > er->buf_size) {
+        ALOGW("echo_reference_read() %zu frames exceeds buffer size %u",
+                buffer->frame_count, er->buf_size);
+        return -EINVAL;
+    }
+
+    ALOGV("echo_reference_read() START, delayCapture:[%d], "
+            "er->frames_in:[%zu],buffer->frame_count:[%zu]",
+    buffer->delay_ns, er->frames_in, buffer->frame_count);
+
+    uint32_t currentState = er->state.load();
+    if ((currentState & ECHOREF_READING) == 0) {
+        ALOGV("echo_reference_read() start read");
+        echo_reference_reset_reader(er);
+        currentState = er->state.fetch_or(ECHOREF_READING) | ECHOREF_READING;
+    }
+
+    if ((currentState & ECHOREF_WRITING) == 0) {
+        // anything buffered predates the stop of the writer
+        echo_reference_reset_reader(er);
+        memset(buffer->raw, 0, er->rd_frame_size * buffer->frame_count);
+        buffer->delay_ns = 0;
+        return 0;
+    }
+
+    // allow some time for new frames to arrive if not enough frames are ready for read
+    echo_reference_fill(er, buffer->frame_count,
+            (1000000000LL * buffer->frame_count) / er->rd_sampling_rate / 2);
+
+    int64_t renderTimeNs;
+    int32_t playbackDelay;
+    int32_t rsmpDelay;
+    echo_reference_snapshot(er, &renderTimeNs, &playbackDelay, &rsmpDelay);
+    const int64_t captureTimeNs = echo_reference_ns(&buffer->time_stamp);
+    if (captureTimeNs != 0) {
+        // the frames read were captured from captureTimeNs - delay_ns on
+        echo_reference_drift_add(&er->rd_drift, captureTimeNs - buffer->delay_ns,
+                buffer->frame_count, er->rd_sampling_rate);
+        er->rd_rate_ratio.store(echo_reference_drift_rate(&er->rd_drift) / er->rd_sampling_rate,
+                std::memory_order_relaxed);
+    }
+
+    if (renderTimeNs == 0 || captureTimeNs == 0) {
+        ALOGV("echo_reference_read(): NEW:timestamp is zero---------setting timeDiff = 0, "
+             "not updating delay this time");
+    } else {
+        const int64_t timeDiff = captureTimeNs - renderTimeNs;
+
+        // Resampler already compensates part of the delay
+        int64_t expectedDelayNs = playbackDelay + buffer->delay_ns - timeDiff - rsmpDelay;
+
+        ALOGV("echo_reference_read(): expectedDelayNs[%" PRId64 "] = "
+                "playback_delay[%d] + delayCapture[%d"
+                "] - timeDiff[%" PRId64 "]",
+                expectedDelayNs, playbackDelay, buffer->delay_ns, timeDiff);
+
+        if (expectedDelayNs > 0) {
+            int64_t delayNs = ((int64_t)er->frames_in * 1000000000) / er->rd_sampling_rate;
+
+            int64_t  deltaNs = delayNs - expectedDelayNs;
+
+            ALOGV("echo_reference_read(): EchoPathDelayDeviation between reference and DMA [%"
+                    PRId64 "]", deltaNs);
+            if (llabs(deltaNs) >= MIN_DELAY_DELTA_NS) {
+                // smooth the variation and update the reference buffer only
+                // if a deviation in the same direction is observed for more than MIN_DELTA_NUM
+                // consecutive reads.
+                int16_t delay_sign = (deltaNs >= 0) ? 1 : -1;
+                if (delay_sign == er->prev_delta_sign) {
+                    er->delta_count++;
+                } else {
+                    er->delta_count = 1;
+                }
+                er->prev_delta_sign = delay_sign;
+                echo_reference_update_delta(er, deltaNs);
+
+                if (er->delta_count > MIN_DELTA_NUM) {
+                    // realigned below, smooth the misalignment from there
+                    er->rd_delta_avg = 0.;
+                    er->rd_delta_ns.store(0, std::memory_order_relaxed);
+                    size_t previousFrameIn = er->frames_in;
+                    er->frames_in = (size_t)((expectedDelayNs * er->rd_sampling_rate)/1000000000);
+                    if (er->frames_in > er->buf_size) {
+                        er->frames_in = er->buf_size;
+                    }
+                    int offset = er->frames_in - previousFrameIn;
+
+                    ALOGV("echo_reference_read(): deltaNs ENOUGH and %s: "
+                            "er->frames_in: %zu, previousFrameIn = %zu",
+                         delay_sign ? "positive" : "negative", er->frames_in, previousFrameIn);
+
+                    if (deltaNs < 0) {
+                        // Less data available in the reference buffer than expected
+                        if (offset > 0) {
+                            memset(er->buffer.get() + previousFrameIn * er->rd_frame_size,
+                                   0, offset * er->rd_frame_size);
+                            ALOGV("echo_reference_read(): pushing ref buffer by [%d]", offset);
+                        }
+                    } else {
+                        // More data available in the reference buffer than expected
+                        offset = -offset;
+                        if (offset > 0) {
+                            memmove(er->buffer.get(),
+                                    er->buffer.get() + (offset * er->rd_frame_size),
+                                    er->frames_in * er->rd_frame_size);
+                            ALOGV("echo_reference_read(): shifting ref buffer by [%zu]",
+                                  er->frames_in);
+                        }
+                    }
+                }
+            } else {
+                er->delta_count = 0;
+                er->prev_delta_sign = 0;
+                echo_reference_update_delta(er, deltaNs);
+                ALOGV("echo_reference_read(): Constant EchoPathDelay - difference "
+                        "between reference and DMA %" PRId64, deltaNs);
+            }
+        } else {
+            ALOGV("echo_reference_read(): NEGATIVE expectedDelayNs[%" PRId64
+                 "] = playback_delay[%d] + delayCapture[%d"
+                 "] - timeDiff[%" PRId64 "]",
+                 expectedDelayNs, playbackDelay, buffer->delay_ns, timeDiff);
+        }
+    }
+
+    if (er->frames_in < buffer->frame_count) {
+        // filling up the reference buffer with 0s to match the expected delay.
+        memset(er->buffer.get() + er->frames_in * er->rd_frame_size,
+            0, (buffer->frame_count - er->frames_in) * er->rd_frame_size);
+        er->frames_in = buffer->frame_count;
+    }
+
+    memcpy(buffer->raw,
+           er->buffer.get(),
+           buffer->frame_count * er->rd_frame_size);
+
+    er->frames_in -= buffer->frame_count;
+    memmove(er->buffer.get(),
+           er->buffer.get() + buffer->frame_count * er->rd_frame_size,
+           er->frames_in * er->rd_frame_size);
+
+    // As the reference buffer is now time aligned to the microphone signal there is a zero delay
+    buffer->delay_ns = 0;
+
+    ALOGV("echo_reference_read() END %zu frames, total frames in %zu",
+          buffer->frame_count, er->frames_in);
+
+    return 0;
+}
+
+
+int create_echo_reference(audio_format_t rdFormat,
+                            uint32_t rdChannelCount,
+                            uint32_t rdSamplingRate,
+                            audio_format_t wrFormat,
+                            uint32_t wrChannelCount,
+                            uint32_t wrSamplingRate,
+                            struct echo_reference_itfe **echo_reference)
+{
+    struct echo_reference *er;
+
+    ALOGV("create_echo_reference()");
+
+    if (echo_reference == NULL) {
+        return -EINVAL;
+    }
+
+    *echo_reference = NULL;
+
+    if ((rdFormat != AUDIO_FORMAT_PCM_16_BIT && rdFormat != AUDIO_FORMAT_PCM_FLOAT) ||
+            (wrFormat != AUDIO_FORMAT_PCM_16_BIT && wrFormat != AUDIO_FORMAT_PCM_FLOAT)) {
+        ALOGW("create_echo_reference bad format rd %#x, wr %#x", rdFormat, wrFormat);
+        return -EINVAL;
+    }
+    if (rdChannelCount == 0 || rdChannelCount > AUDIO_CHANNEL_COUNT_MAX ||
+            wrChannelCount == 0 || wrChannelCount > AUDIO_CHANNEL_COUNT_MAX) {
+        ALOGW("create_echo_reference bad channel count rd %d, wr %d", rdChannelCount,
+                wrChannelCount);
+        return -EINVAL;
+    }
+    if (rdSamplingRate == 0 || wrSamplingRate == 0) {
+        ALOGW("create_echo_reference bad sampling rate rd %u, wr %u", rdSamplingRate,
+                wrSamplingRate);
+        return -EINVAL;
+    }
+
+    const size_t rdFrameSize = audio_bytes_per_sample(rdFormat) * rdChannelCount;
+    const uint32_t bufSize = (uint32_t)((uint64_t)rdSamplingRate * ECHO_REFERENCE_BUFFER_MS / 1000);
+    er = new struct echo_reference(bufSize, rdFrameSize);
+
+    er->itfe.read = echo_reference_read;
+    er->itfe.write = echo_reference_write;
+
+    er->rd_format = rdFormat;
+    er->rd_channel_count = rdChannelCount;
+    er->rd_sampling_rate = rdSamplingRate;
+    er->wr_format = wrFormat;
+    er->wr_channel_count = wrChannelCount;
+    er->wr_sampling_rate = wrSamplingRate;
+    er->rd_frame_size = rdFrameSize;
+    er->wr_frame_size = audio_bytes_per_sample(wrFormat) * wrChannelCount;
+    er->buf_size = bufSize;
+
+    // everything write() needs is allocated here, so that it never allocates
+    er->wr_buf.reset(new uint8_t[ECHO_REFERENCE_CHUNK_FRAMES * rdChannelCount * sizeof(float)]);
+    // the resampler works in float, resample in int16 only if neither side is float
+    er->wr_rsmp_format = rdFormat == AUDIO_FORMAT_PCM_FLOAT || wrFormat == AUDIO_FORMAT_PCM_FLOAT
+            ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    // the resampler also compensates the drift between the playback and capture clocks:
+    // with equal rates, it is bypassed until drift is measured
+    ALOGV("create_echo_reference() new ReSampler(%d, %d)", wrSamplingRate, rdSamplingRate);
+    int rc = create_resampler_with_format(wrSamplingRate,
+                              rdSamplingRate,
+                              rdChannelCount,
+                              RESAMPLER_QUALITY_DEFAULT,
+                              er->wr_rsmp_format,
+                              RESAMPLER_FLAG_VARIABLE_RATIO,
+                              NULL /* provider */,
+                              &er->resampler);
+    if (rc != 0) {
+        ALOGW("create_echo_reference() failure to create resampler %d", rc);
+        release_echo_reference(&er->itfe);
+        return -ENODEV;
+    }
+    er->wr_bypass = rdSamplingRate == wrSamplingRate;
+    if (er->wr_bypass) {
+        er->wr_tail.reset(new uint8_t[ECHO_REFERENCE_CHUNK_FRAMES * rdChannelCount
+                * sizeof(float)]);
+    }
+    // the ratio may be up to RESAMPLER_RATIO_PPM_MAX above nominal
+    er->wr_rsmp_frames = (size_t)ECHO_REFERENCE_CHUNK_FRAMES * rdSamplingRate
+            / wrSamplingRate * (1000000 + RESAMPLER_RATIO_PPM_MAX) / 1000000
+            + RESAMPLER_HEADROOM_SAMPLES;
+    er->wr_rsmp_buf.reset(new uint8_t[er->wr_rsmp_frames * rdChannelCount * sizeof(float)]);
+
+    *echo_reference = &er->itfe;
+    return 0;
+}
+
+void release_echo_reference(struct echo_reference_itfe *echo_reference) {
+    struct echo_reference *er = (struct echo_reference *)echo_reference;
+
+    if (er == NULL) {
+        return;
+    }
+
+    ALOGV("EchoReference dstor");
+    if (er->resampler != NULL) {
+        release_resampler(er->resampler);
+    }
+    delete er;
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A floating point implementation of Fast Fourier Transform (FFT), the counterpart of
+ * fixedfft.cpp for sizes up to 16384 points. The complex transform is a radix-2
+ * decimation in time Cooley-Tukey algorithm: the input is permuted in bit reversed order,
+ * the first two stages are done together as a radix-4 pass and the others by butterflies
+ * on two complex numbers per SIMD register. A real transform of n points is a complex
+ * transform of n / 2 points followed by a split pass.
+ *
+ * The twiddle factors of each stage are stored contiguously in the order they are used, so
+ * the stages of a transform of n / 2 points are a prefix of those of n points and one plan
+ * serves the complex and the real transforms. For the same reason the bit reversal of
+ * n / 2 points is read from the table of n points: reversing 2 * i on log2(n) bits is
+ * reversing i on log2(n / 2) bits.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <memory>
+#include <new>
+
+#include <audio_utils/fft.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
+
+static_assert(FFT_SIZE_MAX <= UINT16_MAX + 1, "bit reversal table entries are uint16_t");
+
+struct fft_plan {
+    size_t n;
+    // bit reversed index of each of the n points
+    std::unique_ptr<uint16_t[]> bitrev;
+    // twiddle factors of the stages of half size h = 4, 8, ..., n / 2, starting at 4 * (h - 4).
+    // Each pair of factors w[j], w[j + 1] of a stage is stored as
+    // { re w[j], re w[j], re w[j + 1], re w[j + 1], -im w[j], im w[j], -im w[j + 1], im w[j + 1] }
+    // so that a complex multiplication is two multiplications and a swap of the components.
+    std::unique_ptr<float[]> twiddles;
+    // exp(-2 pi i k / n) for k = 0 to n / 4, as real and imaginary parts, for the split pass
+    std::unique_ptr<float[]> split;
+};
+
+int create_fft_plan(size_t n, struct fft_plan **plan)
+{
+    if (plan == NULL || n < FFT_SIZE_MIN || n > FFT_SIZE_MAX || (n & (n - 1)) != 0) {
+        return -EINVAL;
+    }
+    struct fft_plan *p = new (std::nothrow) fft_plan;
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    p->n = n;
+
+    // the tables are allocated without throwing, so that failures return -ENOMEM
+    p->bitrev.reset(new (std::nothrow) uint16_t[n]);
+    if (n >= 8) {
+        p->twiddles.reset(new (std::nothrow) float[4 * (n - 4)]);
+    }
+    p->split.reset(new (std::nothrow) float[2 * (n / 4 + 1)]);
+    if (p->bitrev == nullptr || (n >= 8 && p->twiddles == nullptr) || p->split == nullptr) {
+        delete p;
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0, r = 0; i < n; ++i) {
+        p->bitrev[i] = r;
+        // increment r in bit reversed order
+        size_t bit = n >> 1;
+        for (; r & bit; bit >>= 1) {
+            r ^= bit;
+        }
+        r |= bit;
+    }
+
+    if (n >= 8) {
+        for (size_t h = 4; h < n; h <<= 1) {
+            float *w = &p->twiddles[4 * (h - 4)];
+            for (size_t j = 0; j < h; j += 2, w += 8) {
+                for (size_t l = 0; l < 2; ++l) {
+                    const double phase = -M_PI * (j + l) / h;
+                    const float re = cos(phase);
+                    const float im = sin(phase);
+                    w[2 * l] = re;
+                    w[2 * l + 1] = re;
+                    w[4 + 2 * l] = -im;
+                    w[4 + 2 * l + 1] = im;
+                }
+            }
+        }
+    }
+
+    for (size_t k = 0; k <= n / 4; ++k) {
+        const double phase = -2 * M_PI * k / n;
+        p->split[2 * k] = cos(phase);
+        p->split[2 * k + 1] = sin(phase);
+    }
+
+    *plan = p;
+    return 0;
+}
+
+void release_fft_plan(struct fft_plan *plan)
+{
+    delete plan;
+}
+
+size_t fft_plan_size(const struct fft_plan *plan)
+{
+    return plan->n;
+}
+
+/* Copies m complex points in bit reversed order, or permutes them in place if in == out. */
+static void permute(const struct fft_plan *plan, const float *in, float *out, size_t m)
+{
+    const uint16_t *bitrev = plan->bitrev.get();
+    const size_t stride = plan->n / m;
+    if (in != out) {
+        for (size_t i = 0; i < m; ++i) {
+            const size_t r = bitrev[i * stride];
+            out[2 * r] = in[2 * i];
+            out[2 * r + 1] = in[2 * i + 1];
+        }
+        return;
+    }
+    for (size_t i = 0; i < m; ++i) {
+        const size_t r = bitrev[i * stride];
+        if (i < r) {
+            const float re = out[2 * i];
+            const float im = out[2 * i + 1];
+            out[2 * i] = out[2 * r];
+            out[2 * i + 1] = out[2 * r + 1];
+            out[2 * r] = re;
+            out[2 * r + 1] = im;
+        }
+    }
+}
+
+/* The stages of half size 1 and 2 on each group of 4 points, where the twiddle factors are
+ * 1 and -i, or i for the inverse. */
+template <bool INVERSE>
+static void radix4_pass(float *x, size_t m)
+{
+    for (size_t g = 0; g < m; g += 4, x += 8) {
+        const float ar = x[0] + x[2], ai = x[1] + x[3];
+        const float br = x[0] - x[2], bi = x[1] - x[3];
+        const float cr = x[4] + x[6], ci = x[5] + x[7];
+        // d times -i, or i for the inverse
+        const float tr = INVERSE ? x[7] - x[5] : x[5] - x[7];
+        const float ti = INVERSE ? x[4] - x[6] : x[6] - x[4];
+        x[0] = ar + cr;
+        x[1] = ai + ci;
+        x[4] = ar - cr;
+        x[5] = ai - ci;
+        x[2] = br + tr;
+        x[3] = bi + ti;
+        x[6] = br - tr;
+        x[7] = bi - ti;
+    }
+}
+
+/* The butterflies of the stage of half size h >= 4 on 2 complex points at a time. */
+template <bool INVERSE>
+static void radix2_stage(float *x, size_t m, size_t h, const float *twiddles)
+{
+    for (size_t k = 0; k < m; k += 2 * h) {
+        float *u = x + 2 * k;
+        float *v = u + 2 * h;
+        const float *w = twiddles;
+        for (size_t j = 0; j < 2 * h; j += 4, w += 8) {
+#if defined(USE_NEON)
+            const float32x4_t a = vld1q_f32(u + j);
+            const float32x4_t b = vld1q_f32(v + j);
+            const float32x4_t bw = vmulq_f32(b, vld1q_f32(w));
+            const float32x4_t t = INVERSE ? vmlsq_f32(bw, vrev64q_f32(b), vld1q_f32(w + 4))
+                    : vmlaq_f32(bw, vrev64q_f32(b), vld1q_f32(w + 4));
+            vst1q_f32(u + j, vaddq_f32(a, t));
+            vst1q_f32(v + j, vsubq_f32(a, t));
+#elif defined(USE_SSE)
+            const __m128 a = _mm_loadu_ps(u + j);
+            const __m128 b = _mm_loadu_ps(v + j);
+            const __m128 bw = _mm_mul_ps(b, _mm_loadu_ps(w));
+            const __m128 bs = _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)),
+                    _mm_loadu_ps(w + 4));
+            const __m128 t = INVERSE ? _mm_sub_ps(bw, bs) : _mm_add_ps(bw, bs);
+            _mm_storeu_ps(u + j, _mm_add_ps(a, t));
+            _mm_storeu_ps(v + j, _mm_sub_ps(a, t));
+#else
+            for (size_t l = 0; l < 4; l += 2) {
+                const float br = v[j + l], bi = v[j + l + 1];
+                const float wr = w[l], wi = w[4 + l + 1];
+                const float tr = INVERSE ? br * wr + bi * wi : br * wr - bi * wi;
+                const float ti = INVERSE ? bi * wr - br * wi : bi * wr + br * wi;
+                const float ar = u[j + l], ai = u[j + l + 1];
+                u[j + l] = ar + tr;
+                u[j + l + 1] = ai + ti;
+                v[j + l] = ar - tr;
+                v[j + l + 1] = ai - ti;
+            }
+#endif
+        }
+    }
+}
+
+/* Transforms m complex points, m a power of 2 dividing the size of the plan. */
+template <bool INVERSE>
+static void fft_complex(const struct fft_plan *plan, const float *in, float *out, size_t m)
+{
+    permute(plan, in, out, m);
+    if (m == 2) {
+        const float re = out[0], im = out[1];
+        out[0] = re + out[2];
+        out[1] = im + out[3];
+        out[2] = re - out[2];
+        out[3] = im - out[3];
+        return;
+    }
+    if (m >= 4) {
+        radix4_pass<INVERSE>(out, m);
+    }
+    for (size_t h = 4; h < m; h <<= 1) {
+        radix2_stage<INVERSE>(out, m, h, plan->twiddles.get() + 4 * (h - 4));
+    }
+}
+
+void fft_complex_forward(const struct fft_plan *plan, const float *in, float *out)
+{
+    fft_complex<false>(plan, in, out, plan->n);
+}
+
+void fft_complex_inverse(const struct fft_plan *plan, const float *in, float *out)
+{
+    fft_complex<true>(plan, in, out, plan->n);
+}
+
+/*
+ * The even and odd real points are transformed as the real and imaginary parts of
+ * z[j] = x[2 j] + i x[2 j + 1], and with Z[k] its transform of m = n / 2 points and
+ * w = exp(-2 pi i k / n), the split pass computes for 0 < k < m
+ *     X[k] = E + O, X[m - k] = conj(E - O),
+ *     E = (Z[k] + conj(Z[m - k])) / 2, O = -i w (Z[k] - conj(Z[m - k])) / 2.
+ */
+void fft_real_forward(const struct fft_plan *plan, const float *in, float *out)
+{
+    const size_t m = plan->n / 2;
+    fft_complex<false>(plan, in, out, m);
+
+    const float re = out[0], im = out[1];
+    out[0] = re + im;
+    out[1] = re - im;
+    const float *w = plan->split.get();
+    for (size_t k = 1; k <= m / 2; ++k) {
+        float *a = out + 2 * k;
+        float *b = out + 2 * (m - k);
+        const float er = 0.5f * (a[0] + b[0]), ei = 0.5f * (a[1] - b[1]);
+        const float dr = 0.5f * (a[0] - b[0]), di = 0.5f * (a[1] + b[1]);
+        // -i w = im w - i re w
+        const float wr = w[2 * k + 1], wi = -w[2 * k];
+        const float or_ = dr * wr - di * wi, oi = dr * wi + di * wr;
+        a[0] = er + or_;
+        a[1] = ei + oi;
+        b[0] = er - or_;
+        b[1] = oi - ei;
+    }
+}
+
+/* The inverse of the split pass, without the factors 1 / 2, then an inverse transform. */
+void fft_real_inverse(const struct fft_plan *plan, const float *in, float *out)
+{
+    const size_t m = plan->n / 2;
+
+    const float x0 = in[0], xm = in[1];
+    out[0] = x0 + xm;
+    out[1] = x0 - xm;
+    const float *w = plan->split.get();
+    for (size_t k = 1; k <= m / 2; ++k) {
+        const float *a = in + 2 * k;
+        const float *b = in + 2 * (m - k);
+        const float er = a[0] + b[0], ei = a[1] - b[1];
+        const float or_ = a[0] - b[0], oi = a[1] + b[1];
+        // i conj(w) = im w + i re w
+        const float wr = w[2 * k + 1], wi = w[2 * k];
+        const float dr = or_ * wr - oi * wi, di = or_ * wi + oi * wr;
+        float *za = out + 2 * k;
+        float *zb = out + 2 * (m - k);
+        za[0] = er + dr;
+        za[1] = ei + di;
+        zb[0] = er - dr;
+        zb[1] = di - ei;
+    }
+
+    fft_complex<true>(plan, out, out, m);
+}
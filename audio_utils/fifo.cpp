@@ -194,9 +194,15 @@ ssize_t audio_utils_fifo_writer::write(const void *buffer, size_t count,
     return availToWrite;
 }
 
-// iovec == NULL is not part of the public API, but internally it means don't set mObtained
 ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count,
         const struct timespec *timeout)
+{
+    return obtain(iovec, count, timeout, 0 /*spinNs*/);
+}
+
+// iovec == NULL is not part of the public API, but internally it means don't set mObtained
+ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout, int64_t spinNs)
         __attribute__((no_sanitize("integer")))
 {
     int err = 0;
@@ -244,7 +250,7 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
                 if (timeout->tv_sec == LONG_MAX) {
                     timeout = NULL;
                 }
-                err = mFifo.mThrottleFront->wait(op, front, timeout);
+                err = mFifo.mThrottleFront->wait(op, front, timeout, spinNs);
                 if (err < 0) {
                     switch (errno) {
                     case EWOULDBLOCK:
@@ -434,10 +440,16 @@ audio_utils_fifo_reader::~audio_utils_fifo_reader()
 
 ssize_t audio_utils_fifo_reader::read(void *buffer, size_t count, const struct timespec *timeout,
         size_t *lost)
+{
+    return read(buffer, count, timeout, lost, 0 /*spinNs*/);
+}
+
+ssize_t audio_utils_fifo_reader::read(void *buffer, size_t count, const struct timespec *timeout,
+        size_t *lost, int64_t spinNs)
         __attribute__((no_sanitize("integer")))
 {
     audio_utils_iovec iovec[2];
-    ssize_t availToRead = obtain(iovec, count, timeout, lost);
+    ssize_t availToRead = obtain(iovec, count, timeout, lost, spinNs);
     if (availToRead > 0) {
         memcpy(buffer, (char *) mFifo.mBuffer + iovec[0].mOffset * mFifo.mFrameSize,
                 iovec[0].mLength * mFifo.mFrameSize);
@@ -513,15 +525,29 @@ void audio_utils_fifo_reader::release(size_t count)
 // iovec == NULL is not part of the public API, but internally it means don't set mObtained
 ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count,
         const struct timespec *timeout, size_t *lost)
+{
+    return obtain(iovec, count, timeout, lost, 0 /*spinNs*/);
+}
+
+ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout, size_t *lost, int64_t spinNs)
+        __attribute__((no_sanitize("integer")))
+{
+    uint32_t rear;
+    int err = waitForRear(mLocalFront, count, timeout, &rear, spinNs);
+    return obtainAt(rear, iovec, count, lost, err);
+}
+
+int audio_utils_fifo_reader::waitForRear(uint32_t front, size_t count,
+        const struct timespec *timeout, uint32_t *rear, int64_t spinNs)
         __attribute__((no_sanitize("integer")))
 {
     int err = 0;
     int retries = kRetries;
-    uint32_t rear;
     for (;;) {
-        rear = mFifo.mWriterRear.loadAcquire();
+        *rear = mFifo.mWriterRear.loadAcquire();
         // TODO pull out "count == 0"
-        if (count == 0 || rear != mLocalFront || timeout == NULL ||
+        if (count == 0 || *rear != front || timeout == NULL ||
                 (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
             break;
         }
@@ -545,7 +571,7 @@ ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count
             if (timeout->tv_sec == LONG_MAX) {
                 timeout = NULL;
             }
-            err = mFifo.mWriterRear.wait(op, rear, timeout);
+            err = mFifo.mWriterRear.wait(op, *rear, timeout, spinNs);
             if (err < 0) {
                 switch (errno) {
                 case EWOULDBLOCK:
@@ -573,6 +599,13 @@ ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count
         }
         timeout = NULL;
     }
+    return err;
+}
+
+ssize_t audio_utils_fifo_reader::obtainAt(uint32_t rear, audio_utils_iovec iovec[2], size_t count,
+        size_t *lost, int err)
+        __attribute__((no_sanitize("integer")))
+{
     size_t ourLost;
     if (lost == NULL) {
         lost = &ourLost;
@@ -659,3 +692,202 @@ void audio_utils_fifo_reader::getHysteresis(int32_t *armLevel, uint32_t *trigger
     *armLevel = mArmLevel;
     *triggerLevel = mTriggerLevel;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo_spinning_writer::audio_utils_fifo_spinning_writer(audio_utils_fifo& fifo,
+        int64_t spinNs) :
+    audio_utils_fifo_writer(fifo),
+    mSpinNs(spinNs > 0 ? spinNs : 0)
+{
+}
+
+audio_utils_fifo_spinning_writer::~audio_utils_fifo_spinning_writer()
+{
+}
+
+ssize_t audio_utils_fifo_spinning_writer::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout)
+{
+    return audio_utils_fifo_writer::obtain(iovec, count, timeout, mSpinNs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo_spinning_reader::audio_utils_fifo_spinning_reader(audio_utils_fifo& fifo,
+        int64_t spinNs, bool throttlesWriter, bool flush) :
+    audio_utils_fifo_reader(fifo, throttlesWriter, flush),
+    mSpinNs(spinNs > 0 ? spinNs : 0)
+{
+}
+
+audio_utils_fifo_spinning_reader::~audio_utils_fifo_spinning_reader()
+{
+}
+
+ssize_t audio_utils_fifo_spinning_reader::read(void *buffer, size_t count,
+        const struct timespec *timeout, size_t *lost)
+{
+    return audio_utils_fifo_reader::read(buffer, count, timeout, lost, mSpinNs);
+}
+
+ssize_t audio_utils_fifo_spinning_reader::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout)
+{
+    return audio_utils_fifo_reader::obtain(iovec, count, timeout, NULL /*lost*/, mSpinNs);
+}
+
+ssize_t audio_utils_fifo_spinning_reader::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout, size_t *lost)
+{
+    return audio_utils_fifo_reader::obtain(iovec, count, timeout, lost, mSpinNs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo_reader_group::audio_utils_fifo_reader_group(audio_utils_fifo& fifo,
+        size_t readerCount, bool throttlesWriter, bool flush) :
+    mFifo(fifo),
+    mThrottleFront(throttlesWriter ? mFifo.mThrottleFront : NULL),
+    mRear(0),
+    mLocalFront(0),
+    mArmLevel(-1), mTriggerLevel(mFifo.mFrameCount),
+    mIsArmed(true) // because initial fill level of zero is > mArmLevel
+{
+    LOG_ALWAYS_FATAL_IF(readerCount == 0);
+    mReaders.reserve(readerCount);
+    for (size_t i = 0; i < readerCount; ++i) {
+        mReaders.emplace_back(new audio_utils_fifo_reader(fifo, false /*throttlesWriter*/, flush));
+    }
+    // Same initial position as audio_utils_fifo_reader: a throttling group sees all data
+    // currently in the buffer, otherwise each reader starts at the writer's current rear.
+    if (mThrottleFront != NULL) {
+        for (auto& reader : mReaders) {
+            reader->mLocalFront = 0;
+        }
+    } else {
+        mRear = mReaders[0]->mLocalFront;
+    }
+}
+
+audio_utils_fifo_reader_group::~audio_utils_fifo_reader_group()
+{
+}
+
+ssize_t audio_utils_fifo_reader_group::obtain(audio_utils_iovec (*iovecs)[2], ssize_t obtained[],
+        size_t count, const struct timespec *timeout, size_t lost[])
+        __attribute__((no_sanitize("integer")))
+{
+    uint32_t rear = mFifo.mWriterRear.loadAcquire();
+    int err = 0;
+    bool waited = false;
+    for (;;) {
+        ssize_t maxObtained = 0;
+        int firstErr = 0;
+        for (size_t i = 0; i < mReaders.size(); ++i) {
+            obtained[i] = mReaders[i]->obtainAt(rear, iovecs[i], count,
+                    lost != NULL ? &lost[i] : NULL, err);
+            if (obtained[i] > maxObtained) {
+                maxObtained = obtained[i];
+            } else if (obtained[i] < 0 && firstErr == 0) {
+                firstErr = obtained[i];
+            }
+        }
+        mRear = rear;
+        if (maxObtained > 0) {
+            return maxObtained;
+        }
+        if (firstErr != 0 || waited) {
+            return firstErr != 0 ? firstErr : err;
+        }
+        // Every reader is empty, so each front equals rear: wait once for the writer on behalf
+        // of the whole group, then retry with the new rear.
+        err = mReaders[0]->waitForRear(rear, count, timeout, &rear, 0 /*spinNs*/);
+        if (rear == mRear) {
+            return err;
+        }
+        waited = true;
+    }
+}
+
+void audio_utils_fifo_reader_group::release(const size_t counts[])
+        __attribute__((no_sanitize("integer")))
+{
+    // The slowest reader is the one with the most frames left to read as of mRear.
+    // No reader can be ahead of mRear, as each only releases frames obtained up to mRear.
+    int32_t slowestFilled = -1;
+    uint32_t front = mLocalFront;
+    for (size_t i = 0; i < mReaders.size(); ++i) {
+        audio_utils_fifo_reader *reader = mReaders[i].get();
+        // readers don't throttle, so this only advances their local front
+        reader->audio_utils_fifo_reader::release(counts[i]);
+        if (mThrottleFront != NULL) {
+            // returns -EIO if mIsShutdown
+            int32_t filled = mFifo.diff(mRear, reader->mLocalFront);
+            if (filled > slowestFilled) {
+                slowestFilled = filled;
+                front = reader->mLocalFront;
+            }
+        }
+    }
+    if (slowestFilled < 0 || front == mLocalFront) {
+        return;
+    }
+    int32_t filled = mFifo.diff(mRear, mLocalFront);
+    uint32_t count = filled - slowestFilled;
+    mLocalFront = front;
+    mThrottleFront->storeRelease(mLocalFront);
+    int op = FUTEX_WAKE;
+    switch (mFifo.mThrottleFrontSync) {
+    case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+        break;
+    case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+        op = FUTEX_WAKE_PRIVATE;
+        FALLTHROUGH_INTENDED;
+    case AUDIO_UTILS_FIFO_SYNC_SHARED:
+        if (filled > mArmLevel) {
+            mIsArmed = true;
+        }
+        if (mIsArmed && filled - count < mTriggerLevel) {
+            int err = mThrottleFront->wake(op, 1 /*waiters*/);
+            // err is number of processes woken up
+            if (err < 0 || err > 1) {
+                LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d", __func__, err, errno);
+            }
+            mIsArmed = false;
+        }
+        break;
+    default:
+        LOG_ALWAYS_FATAL("mFifo.mThrottleFrontSync=%d", mFifo.mThrottleFrontSync);
+        break;
+    }
+}
+
+void audio_utils_fifo_reader_group::setHysteresis(int32_t armLevel, uint32_t triggerLevel)
+{
+    // cap to range [0, mFifo.mFrameCount]
+    if (armLevel < 0) {
+        armLevel = -1;
+    } else if ((uint32_t) armLevel > mFifo.mFrameCount) {
+        armLevel = mFifo.mFrameCount;
+    }
+    if (triggerLevel > mFifo.mFrameCount) {
+        triggerLevel = mFifo.mFrameCount;
+    }
+    // Arm on the fill level of the slowest reader as of the most recent obtain(), as release()
+    // would; an arming by the previous level remains valid.
+    if (mThrottleFront != NULL) {
+        int32_t filled = mFifo.diff(mRear, mLocalFront);
+        if (filled > armLevel) {
+            mIsArmed = true;
+        }
+    }
+    mArmLevel = armLevel;
+    mTriggerLevel = triggerLevel;
+}
+
+void audio_utils_fifo_reader_group::getHysteresis(int32_t *armLevel, uint32_t *triggerLevel) const
+{
+    *armLevel = mArmLevel;
+    *triggerLevel = mTriggerLevel;
+}
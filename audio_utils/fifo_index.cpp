@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <sched.h>
 #include <audio_utils/fifo_index.h>
 #include <audio_utils/futex.h>
 
@@ -38,6 +39,64 @@ int audio_utils_fifo_index::wait(int op, uint32_t expected, const struct timespe
     return sys_futex(&mIndex, op, expected, timeout, NULL, 0);
 }
 
+static inline int64_t monotonicNs()
+{
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Hint to the processor that we are in a spin-wait loop.
+static inline void cpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+int audio_utils_fifo_index::wait(int op, uint32_t expected, const struct timespec *timeout,
+        int64_t spinNs)
+{
+    if (spinNs <= 0) {
+        return wait(op, expected, timeout);
+    }
+    int64_t timeoutNs = INT64_MAX;
+    if (timeout != NULL && timeout->tv_sec < INT64_MAX / 1000000000LL - 1) {
+        timeoutNs = timeout->tv_sec * 1000000000LL + timeout->tv_nsec;
+    }
+    if (spinNs > timeoutNs) {
+        spinNs = timeoutNs;
+    }
+    const int64_t startNs = monotonicNs();
+    int64_t elapsedNs = 0;
+    while (elapsedNs < spinNs) {
+        if (loadAcquire() != expected) {
+            return 0;
+        }
+        if (elapsedNs < spinNs / 2) {
+            cpuRelax();
+        } else {
+            (void) sched_yield();
+        }
+        elapsedNs = monotonicNs() - startNs;
+    }
+    if (timeout == NULL) {
+        return sys_futex(&mIndex, op, expected, NULL, NULL, 0);
+    }
+    const int64_t remainingNs = timeoutNs - elapsedNs;
+    if (remainingNs <= 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    const struct timespec remaining = {
+        .tv_sec = (time_t) (remainingNs / 1000000000LL),
+        .tv_nsec = (long) (remainingNs % 1000000000LL),
+    };
+    return sys_futex(&mIndex, op, expected, &remaining, NULL, 0);
+}
+
 int audio_utils_fifo_index::wake(int op, int waiters)
 {
     return sys_futex(&mIndex, op, waiters, NULL, NULL, 0);
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <audio_utils/fifo_reader_T.h>
+#include "private/fifo_T.h"
+
+template <typename T>
+audio_utils_fifo_reader_T<T>::audio_utils_fifo_reader_T(audio_utils_fifo& fifo) :
+    mLocalFront(fifo.mWriterRear.loadAcquire()), mRear(mLocalFront), mTotalLost(0),
+    mFrameCountP2(fifo.mFrameCountP2), mBuffer((const T *) fifo.mBuffer),
+    mWriterRear(fifo.mWriterRear)
+{
+    if (fifo.mFrameSize != sizeof(T) || fifo.mFudgeFactor != 0) {
+        abort();
+    }
+}
+
+template <typename T>
+audio_utils_fifo_reader_T<T>::~audio_utils_fifo_reader_T()
+{
+}
+
+template <typename T>
+uint32_t audio_utils_fifo_reader_T<T>::loadAcquire()
+        __attribute__((no_sanitize("integer")))     // mRear - mLocalFront can wrap
+{
+    mRear = mWriterRear.loadAcquire();
+    uint32_t filled = mRear - mLocalFront;
+    if (filled > mFrameCountP2) {
+        // catch up with writer, but preserve the still valid frames in buffer
+        mTotalLost += filled - mFrameCountP2;
+        mLocalFront = mRear - mFrameCountP2;
+        filled = mFrameCountP2;
+    }
+    return filled;
+}
+
+template <typename T>
+uint32_t audio_utils_fifo_reader_T<T>::read(T *buffer, uint32_t count)
+        __attribute__((no_sanitize("integer")))     // mLocalFront += can wrap
+{
+    uint32_t availToRead = available();
+    if (availToRead > count) {
+        availToRead = count;
+    }
+    uint32_t frontOffset = mLocalFront & (mFrameCountP2 - 1);
+    uint32_t part1 = mFrameCountP2 - frontOffset;
+    if (part1 > availToRead) {
+        part1 = availToRead;
+    }
+    memcpyWords(buffer, &mBuffer[frontOffset], part1);
+    uint32_t part2 = availToRead - part1;
+    memcpyWords(&buffer[part1], &mBuffer[0], part2);
+    mLocalFront += availToRead;
+    return availToRead;
+}
+
+// Instantiate for the specific types we need, which is currently int32_t, int64_t and float.
+
+template class audio_utils_fifo_reader_T<int32_t>;
+template class audio_utils_fifo_reader_T<int64_t>;
+template class audio_utils_fifo_reader_T<float>;
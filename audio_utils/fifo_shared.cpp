@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_shared"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#endif
+
+#include <audio_utils/fifo_shared.h>
+#include <log/log.h>
+
+// Offsets of each part of the region, see audio_utils_fifo_shared.
+static constexpr uint32_t kRearOffset = AUDIO_UTILS_FIFO_SHARED_ALIGNMENT;
+static constexpr uint32_t kFrontOffset = kRearOffset + AUDIO_UTILS_FIFO_SHARED_ALIGNMENT;
+static constexpr uint32_t kBufferOffset = kFrontOffset + AUDIO_UTILS_FIFO_SHARED_ALIGNMENT;
+static_assert(sizeof(audio_utils_fifo_shared_header) <= AUDIO_UTILS_FIFO_SHARED_ALIGNMENT,
+        "header must fit before the rear index");
+
+#ifdef __linux__
+// Seals which guarantee that the region can't be resized after it is validated by attach().
+static constexpr int kSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+#endif
+
+// memfd_create() is called directly, as it is not in the C library for all supported API levels.
+static int memfdCreate(const char *name)
+{
+#ifdef __linux__
+    return syscall(__NR_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    (void) name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+size_t audio_utils_fifo_shared::regionSize(uint32_t frameCount, uint32_t frameSize)
+{
+    const size_t pageSize = getpagesize();
+    const uint64_t size = kBufferOffset + (uint64_t) frameCount * frameSize;
+    return (size + pageSize - 1) & ~(uint64_t) (pageSize - 1);
+}
+
+std::unique_ptr<audio_utils_fifo_shared> audio_utils_fifo_shared::create(uint32_t frameCount,
+        uint32_t frameSize, bool throttlesWriter, const char *name)
+{
+    // same limits as audio_utils_fifo
+    LOG_ALWAYS_FATAL_IF(frameCount == 0 || frameSize == 0 ||
+            frameCount > ((uint32_t) INT32_MAX) / frameSize);
+
+    const int fd = memfdCreate(name);
+    if (fd < 0) {
+        ALOGE("%s: memfd_create failed errno=%d", __func__, errno);
+        return nullptr;
+    }
+    const size_t size = regionSize(frameCount, frameSize);
+    if (ftruncate(fd, size) < 0) {
+        ALOGE("%s: ftruncate(%zu) failed errno=%d", __func__, size, errno);
+        (void) close(fd);
+        return nullptr;
+    }
+#ifdef __linux__
+    if (fcntl(fd, F_ADD_SEALS, kSeals) < 0) {
+        ALOGE("%s: F_ADD_SEALS failed errno=%d", __func__, errno);
+        (void) close(fd);
+        return nullptr;
+    }
+#endif
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t) 0);
+    if (base == MAP_FAILED) {
+        ALOGE("%s: mmap(%zu) failed errno=%d", __func__, size, errno);
+        (void) close(fd);
+        return nullptr;
+    }
+
+    // The indices must be constructed exactly once, so only the creator does so.
+    (void) new((char *) base + kRearOffset) audio_utils_fifo_index();
+    (void) new((char *) base + kFrontOffset) audio_utils_fifo_index();
+
+    audio_utils_fifo_shared_header header;
+    header.mMagic = AUDIO_UTILS_FIFO_SHARED_MAGIC;
+    header.mVersion = AUDIO_UTILS_FIFO_SHARED_VERSION;
+    header.mFrameCount = frameCount;
+    header.mFrameSize = frameSize;
+    header.mThrottlesWriter = throttlesWriter ? 1 : 0;
+    header.mRearOffset = kRearOffset;
+    header.mFrontOffset = kFrontOffset;
+    header.mBufferOffset = kBufferOffset;
+    memcpy(base, &header, sizeof(header));
+
+    return std::unique_ptr<audio_utils_fifo_shared>(
+            new audio_utils_fifo_shared(fd, base, size, header));
+}
+
+std::unique_ptr<audio_utils_fifo_shared> audio_utils_fifo_shared::attach(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ALOGE("%s: fstat(%d) failed errno=%d", __func__, fd, errno);
+        return nullptr;
+    }
+#ifdef __linux__
+    // Without the seals, the creator could shrink the region after validation.
+    const int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & kSeals) != kSeals) {
+        ALOGE("%s: fd %d is not sealed, seals=%d errno=%d", __func__, fd, seals, errno);
+        return nullptr;
+    }
+#endif
+    const size_t size = st.st_size;
+    if (st.st_size < (off_t) kBufferOffset) {
+        ALOGE("%s: region size %zu is too small", __func__, size);
+        return nullptr;
+    }
+    const int ourFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (ourFd < 0) {
+        ALOGE("%s: dup(%d) failed errno=%d", __func__, fd, errno);
+        return nullptr;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ourFd, (off_t) 0);
+    if (base == MAP_FAILED) {
+        ALOGE("%s: mmap(%zu) failed errno=%d", __func__, size, errno);
+        (void) close(ourFd);
+        return nullptr;
+    }
+
+    // Validate a private copy, so that the other process can't change it after validation.
+    audio_utils_fifo_shared_header header;
+    memcpy(&header, base, sizeof(header));
+    if (header.mMagic != AUDIO_UTILS_FIFO_SHARED_MAGIC ||
+            header.mVersion != AUDIO_UTILS_FIFO_SHARED_VERSION ||
+            header.mFrameCount == 0 || header.mFrameSize == 0 ||
+            header.mFrameCount > ((uint32_t) INT32_MAX) / header.mFrameSize ||
+            header.mRearOffset != kRearOffset || header.mFrontOffset != kFrontOffset ||
+            header.mBufferOffset != kBufferOffset ||
+            regionSize(header.mFrameCount, header.mFrameSize) > size) {
+        ALOGE("%s: invalid header magic=%#x version=%u frameCount=%u frameSize=%u size=%zu",
+                __func__, header.mMagic, header.mVersion, header.mFrameCount, header.mFrameSize,
+                size);
+        (void) munmap(base, size);
+        (void) close(ourFd);
+        return nullptr;
+    }
+
+    return std::unique_ptr<audio_utils_fifo_shared>(
+            new audio_utils_fifo_shared(ourFd, base, size, header));
+}
+
+audio_utils_fifo_shared::audio_utils_fifo_shared(int fd, void *base, size_t size,
+        const audio_utils_fifo_shared_header& header) :
+    mFd(fd), mBase(base), mSize(size),
+    mFifo(new audio_utils_fifo(header.mFrameCount, header.mFrameSize,
+            (char *) base + header.mBufferOffset,
+            *(audio_utils_fifo_index *) ((char *) base + header.mRearOffset),
+            header.mThrottlesWriter ?
+                    (audio_utils_fifo_index *) ((char *) base + header.mFrontOffset) : NULL))
+{
+}
+
+audio_utils_fifo_shared::~audio_utils_fifo_shared()
+{
+    mFifo.reset();
+    (void) munmap(mBase, mSize);
+    (void) close(mFd);
+}
+
+std::unique_ptr<audio_utils_fifo_writer> audio_utils_fifo_shared::createWriter()
+{
+    return std::unique_ptr<audio_utils_fifo_writer>(new audio_utils_fifo_writer(*mFifo));
+}
+
+std::unique_ptr<audio_utils_fifo_reader> audio_utils_fifo_shared::createReader(
+        bool throttlesWriter, bool flush)
+{
+    return std::unique_ptr<audio_utils_fifo_reader>(
+            new audio_utils_fifo_reader(*mFifo, throttlesWriter, flush));
+}
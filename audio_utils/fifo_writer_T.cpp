@@ -18,26 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <audio_utils/fifo_writer_T.h>
-
-template <typename T>
-static inline void memcpyWords(T *dst, const T *src, uint32_t count)
-{
-    switch (count) {
-    case 0: break;
-// TODO templatize here also, but first confirm no performance regression compared to current
-#define _(n) \
-    case n: { \
-        struct s##n { T a[n]; }; \
-        *(struct s##n *)dst = *(const struct s##n *)src; \
-        break; \
-    }
-    _(1) _(2) _(3) _(4) _(5) _(6) _(7) _(8) _(9) _(10) _(11) _(12) _(13) _(14) _(15) _(16)
-#undef _
-    default:
-        memcpy(dst, src, count * sizeof(T));
-        break;
-    }
-}
+#include "private/fifo_T.h"
 
 template <typename T>
 audio_utils_fifo_writer_T<T>::audio_utils_fifo_writer_T(audio_utils_fifo& fifo) :
@@ -74,7 +55,8 @@ void audio_utils_fifo_writer_T<T>::write(const T *buffer, uint32_t count)
     mLocalRear += availToWrite;
 }
 
-// Instantiate for the specific types we need, which is currently just int32_t and int64_t.
+// Instantiate for the specific types we need, which is currently int32_t, int64_t and float.
 
 template class audio_utils_fifo_writer_T<int32_t>;
 template class audio_utils_fifo_writer_T<int64_t>;
+template class audio_utils_fifo_writer_T<float>;
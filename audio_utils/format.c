@@ -17,6 +17,9 @@
 /* #define LOG_NDEBUG 0 */
 #define LOG_TAG "audio_utils_format"
 
+#include <errno.h>
+#include <stdbool.h>
+
 #include <log/log.h>
 
 #include <audio_utils/format.h>
@@ -164,6 +167,77 @@ void memcpy_by_audio_format(void *dst, audio_format_t dst_format,
             src_format, dst_format);
 }
 
+/* Frames are converted in blocks through a buffer small enough to stay in the L1 cache. */
+#define FORMAT_AND_CHANNEL_BLOCK_BYTES 4096
+
+void memcpy_by_audio_format_and_channel_mask(void *dst, audio_format_t dst_format,
+        audio_channel_mask_t dst_channel_mask,
+        const void *src, audio_format_t src_format,
+        audio_channel_mask_t src_channel_mask, size_t count)
+{
+    const size_t dst_channels = __builtin_popcount(audio_channel_mask_get_bits(dst_channel_mask));
+    const size_t src_channels = __builtin_popcount(audio_channel_mask_get_bits(src_channel_mask));
+    const size_t dst_sample_size = audio_bytes_per_sample(dst_format);
+    const size_t src_sample_size = audio_bytes_per_sample(src_format);
+    if (dst_channel_mask == src_channel_mask) {
+        memcpy_by_audio_format(dst, dst_format, src, src_format, count * src_channels);
+        return;
+    }
+    if (dst_sample_size == 0 || src_sample_size == 0) {
+        LOG_ALWAYS_FATAL("invalid src format %#x for dst format %#x", src_format, dst_format);
+    }
+
+    int8_t idxary[MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX];
+    if (memcpy_by_index_array_initialization_from_channel_mask(idxary,
+            MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX, dst_channel_mask, src_channel_mask)
+            != dst_channels || dst_channels > MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX) {
+        LOG_ALWAYS_FATAL("invalid src channel mask %#x for dst channel mask %#x",
+                src_channel_mask, dst_channel_mask);
+    }
+    /* Contract channels before converting when the remix only moves samples,
+     * otherwise convert first so that zero fill has the destination format representation. */
+    bool remix_first = dst_channels < src_channels;
+    for (size_t i = 0; remix_first && i < dst_channels; ++i) {
+        remix_first = idxary[i] >= 0;
+    }
+    memcpy_by_index_array_plan_t plan;
+    if (memcpy_by_index_array_plan_init(&plan, dst_channels, src_channels, idxary,
+            remix_first ? src_sample_size : dst_sample_size) != 0) {
+        LOG_ALWAYS_FATAL("invalid src channel mask %#x for dst channel mask %#x",
+                src_channel_mask, dst_channel_mask);
+    }
+    if (plan.type == MEMCPY_BY_INDEX_ARRAY_IDENTITY) {
+        /* different masks with the same layout, e.g. position and index masks */
+        memcpy_by_audio_format(dst, dst_format, src, src_format, count * src_channels);
+        return;
+    }
+    if (dst_format == src_format) {
+        memcpy_by_index_array_with_plan(dst, src, &plan, count);
+        return;
+    }
+
+    uint32_t block[FORMAT_AND_CHANNEL_BLOCK_BYTES / sizeof(uint32_t)];
+    const size_t block_frames = sizeof(block)
+            / (remix_first ? dst_channels * src_sample_size : src_channels * dst_sample_size);
+    const size_t dst_frame_size = dst_channels * dst_sample_size;
+    const size_t src_frame_size = src_channels * src_sample_size;
+    uint8_t *udst = (uint8_t *)dst;
+    const uint8_t *usrc = (const uint8_t *)src;
+    while (count > 0) {
+        const size_t frames = count < block_frames ? count : block_frames;
+        if (remix_first) {
+            memcpy_by_index_array_with_plan(block, usrc, &plan, frames);
+            memcpy_by_audio_format(udst, dst_format, block, src_format, frames * dst_channels);
+        } else {
+            memcpy_by_audio_format(block, dst_format, usrc, src_format, frames * src_channels);
+            memcpy_by_index_array_with_plan(udst, block, &plan, frames);
+        }
+        udst += frames * dst_frame_size;
+        usrc += frames * src_frame_size;
+        count -= frames;
+    }
+}
+
 size_t memcpy_by_index_array_initialization_from_channel_mask(int8_t *idxary, size_t arysize,
         audio_channel_mask_t dst_channel_mask, audio_channel_mask_t src_channel_mask)
 {
@@ -203,3 +277,18 @@ size_t memcpy_by_index_array_initialization_from_channel_mask(int8_t *idxary, si
         return 0;
     }
 }
+
+int memcpy_by_index_array_plan_init_from_channel_mask(memcpy_by_index_array_plan_t *plan,
+        audio_channel_mask_t dst_channel_mask, audio_channel_mask_t src_channel_mask,
+        size_t sample_size)
+{
+    int8_t idxary[MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX];
+    const size_t dst_channels = memcpy_by_index_array_initialization_from_channel_mask(
+            idxary, MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX, dst_channel_mask, src_channel_mask);
+    if (dst_channels == 0 || dst_channels > MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX) {
+        return -EINVAL;
+    }
+    /* the index array refers to source channels by their order within the mask bits */
+    const size_t src_channels = __builtin_popcount(audio_channel_mask_get_bits(src_channel_mask));
+    return memcpy_by_index_array_plan_init(plan, dst_channels, src_channels, idxary, sample_size);
+}
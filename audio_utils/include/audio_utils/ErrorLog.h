@@ -19,9 +19,11 @@
 
 #ifdef __cplusplus
 
+#include <atomic>
 #include <iomanip>
 #include <mutex>
 #include <sstream>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -30,6 +32,9 @@
 
 namespace android {
 
+template <typename T>
+class SingleWriterErrorLog;
+
 /**
  * ErrorLog captures audio errors codes, combining consecutive identical error codes
  * (within a specified time) into a single entry (to reduce log spamming).
@@ -38,6 +43,9 @@ namespace android {
  * together with the first time the error code occurs and the last time the error code occurs.
  *
  * The type T represents the error code type and is an int32_t for the C API.
+ *
+ * The public methods are internally protected by a mutex to be thread-safe.
+ * See SingleWriterErrorLog for logging without a lock.
  */
 template <typename T>
 class ErrorLog {
@@ -98,17 +106,79 @@ public:
     std::string dumpToString(const char *prefix = "", size_t lines = 0, int64_t limitNs = 0) const
     {
         std::lock_guard<std::mutex> guard(mLock);
+        return dumpEntries(mErrors, mIdx, mEntries, prefix, lines, limitNs);
+    }
 
+    /**
+     * \brief Dumps the log to a raw file descriptor.
+     * \param fd                file descriptor to use.
+     * \param prefix            the prefix to use for each line
+     *                          (generally a null terminated string of spaces).
+     * \param lines             maximum number of lines to output (0 disables).
+     * \param limitNs           limit dump to data more recent than limitNs (0 disables).
+     * \return
+     *   NO_ERROR on success or a negative number (-errno) on failure of write().
+     */
+    status_t dump(int fd, const char *prefix = "", size_t lines = 0, int64_t limitNs = 0) const
+    {
+        // thread safe but not necessarily serial with respect to concurrent dumps to the same fd.
+        const std::string s = dumpToString(prefix, lines, limitNs);
+        if (s.size() > 0 && write(fd, s.c_str(), s.size()) < 0) {
+            return -errno;
+        }
+        return NO_ERROR;
+    }
+
+    struct Entry {
+        Entry()
+            : mCode(0)
+            , mCount(0)
+            , mFirstTime(0)
+            , mLastTime(0)
+        {
+        }
+
+        // Initialize entry with code as the first error at the given time.
+        void setFirstError(T code, int64_t time) {
+            mCode = code;
+            mCount = 1;
+            mFirstTime = time;
+            mLastTime = time;
+        }
+
+        T mCode;            // error code
+        uint32_t mCount;    // number of consecutive errors of the same code.
+        int64_t mFirstTime; // first time of the error code.
+        int64_t mLastTime;  // last time of the error code.
+    };
+
+private:
+    template <typename U> friend class SingleWriterErrorLog;
+
+    /**
+     * \brief Formats the state of an error log, for dumpToString().
+     *
+     * \param errors            total number of errors registered.
+     * \param idx               index of the active entry.
+     * \param entries           circular buffer of error entries.
+     * \param prefix            see dumpToString().
+     * \param lines             see dumpToString().
+     * \param limitNs           see dumpToString().
+     * \return std::string of the dump.
+     */
+    static std::string dumpEntries(int64_t errors, size_t idx, const std::vector<Entry> &entries,
+            const char *prefix, size_t lines, int64_t limitNs)
+    {
         std::stringstream ss;
-        const size_t numberOfEntries = mEntries.size();
+        const size_t numberOfEntries = entries.size();
         const size_t headerLines = 2;
 
         if (lines == 0) {
             lines = SIZE_MAX;
         }
-        ss << prefix << "Errors: " << mErrors << "\n";
+        ss << prefix << "Errors: " << errors << "\n";
 
-        if (mErrors == 0 || lines <= headerLines) {
+        if (errors == 0 || lines <= headerLines) {
             return ss.str();
         }
 
@@ -117,7 +187,7 @@ public:
         ssize_t offset;
         for (offset = 0; offset < (ssize_t)lines; ++offset) {
             const auto &entry =
-                    mEntries[(mIdx + numberOfEntries - offset) % numberOfEntries];
+                    entries[(idx + numberOfEntries - offset) % numberOfEntries];
             if (entry.mCount == 0 || entry.mLastTime < limitNs) {
                 break;
             }
@@ -127,7 +197,7 @@ public:
             ss << prefix << " Code  Freq          First time           Last time\n";
             for (; offset >= 0; --offset) {
                 const auto &entry =
-                        mEntries[(mIdx + numberOfEntries - offset) % numberOfEntries];
+                        entries[(idx + numberOfEntries - offset) % numberOfEntries];
 
                 ss << prefix << std::setw(5) <<  entry.mCode
                         << " " << std::setw(5) << entry.mCount
@@ -138,15 +208,107 @@ public:
         return ss.str();
     }
 
+    mutable std::mutex mLock;     // monitor mutex
+    int64_t mErrors;              // total number of errors registered
+    size_t mIdx;                  // current index into mEntries (active)
+    const int64_t mAggregateNs;   // number of nanoseconds to aggregate consecutive error codes.
+    std::vector<Entry> mEntries;  // circular buffer of error entries.
+};
+
+/**
+ * Same as ErrorLog, but log() never locks or waits, provided that it is only ever called from
+ * one thread at a time, for example an audio thread reporting underruns.
+ * Identical error codes are aggregated as each is logged, exactly as by ErrorLog.
+ *
+ * The log state is protected by a sequence lock: dumping copies the state and retries
+ * if log() changed it meanwhile, so dumping never blocks log(). After kDumpRetries failed
+ * attempts, the last copy is dumped, and counted by inconsistentDumps().
+ *
+ * T must be trivially copyable.
+ */
+template <typename T>
+class SingleWriterErrorLog {
+public:
+    using Entry = typename ErrorLog<T>::Entry;
+
+    /** Number of attempts of dumpToString() to copy a consistent state. */
+    static constexpr int kDumpRetries = 16;
+
     /**
-     * \brief Dumps the log to a raw file descriptor.
-     * \param fd                file descriptor to use.
-     * \param prefix            the prefix to use for each line
-     *                          (generally a null terminated string of spaces).
-     * \param lines             maximum number of lines to output (0 disables).
-     * \param limitNs           limit dump to data more recent than limitNs (0 disables).
-     * \return
-     *   NO_ERROR on success or a negative number (-errno) on failure of write().
+     * \brief Creates a SingleWriterErrorLog object, see ErrorLog::ErrorLog.
+     */
+    explicit SingleWriterErrorLog(size_t entries,
+            int64_t aggregateNs = 1000000000 /* one second */)
+        : mSequence(0)
+        , mErrors(0)
+        , mIdx(0)
+        , mAggregateNs(aggregateNs)
+        , mEntries(entries)
+        , mInconsistentDumps(0)
+    {
+    }
+
+    /**
+     * \brief Adds new error code to the error log, from the single writer thread.
+     *
+     * Consecutive errors with the same code will be aggregated
+     * if they occur within aggregateNs.
+     *
+     * \param code              error code of type T.
+     * \param nowNs             current time in nanoseconds.
+     */
+    void log(const T &code, int64_t nowNs)
+    {
+        // Only the writer changes the state, so it reads it without the sequence lock.
+        size_t idx = mIdx.load(std::memory_order_relaxed);
+        Entry entry = mEntries[idx].load();
+
+        // Within mAggregateNs (1 second by default), aggregate error codes together.
+        if (code == entry.mCode && nowNs - entry.mLastTime < mAggregateNs) {
+            entry.mCount++;
+            entry.mLastTime = nowNs;
+        } else {
+            // Add new error entry.
+            if (++idx >= mEntries.size()) {
+                idx = 0;
+            }
+            entry.setFirstError(code, nowNs);
+        }
+
+        const uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed); // odd: update in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        mErrors.store(mErrors.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        mIdx.store(idx, std::memory_order_relaxed);
+        mEntries[idx].store(entry);
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * \brief Dumps the log to a std::string, see ErrorLog::dumpToString.
+     */
+    std::string dumpToString(const char *prefix = "", size_t lines = 0, int64_t limitNs = 0) const
+    {
+        int64_t errors;
+        size_t idx;
+        std::vector<Entry> entries;
+        if (!snapshot(&errors, &idx, &entries)) {
+            mInconsistentDumps.fetch_add(1, std::memory_order_relaxed);
+        }
+        return ErrorLog<T>::dumpEntries(errors, idx, entries, prefix, lines, limitNs);
+    }
+
+    /**
+     * \brief Returns the number of dumps which gave up on a consistent copy of the state,
+     * and may so mix several calls to log().
+     */
+    int64_t inconsistentDumps() const
+    {
+        return mInconsistentDumps.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Dumps the log to a raw file descriptor, see ErrorLog::dump.
      */
     status_t dump(int fd, const char *prefix = "", size_t lines = 0, int64_t limitNs = 0) const
     {
@@ -158,35 +320,60 @@ public:
         return NO_ERROR;
     }
 
-    struct Entry {
-        Entry()
-            : mCode(0)
-            , mCount(0)
-            , mFirstTime(0)
-            , mLastTime(0)
-        {
+private:
+    // Entry storage read by dumpToString() while log() may write it, see mSequence.
+    struct AtomicEntry {
+        std::atomic<T> mCode{};
+        std::atomic<uint32_t> mCount{0};
+        std::atomic<int64_t> mFirstTime{0};
+        std::atomic<int64_t> mLastTime{0};
+
+        Entry load() const {
+            Entry entry;
+            entry.mCode = mCode.load(std::memory_order_relaxed);
+            entry.mCount = mCount.load(std::memory_order_relaxed);
+            entry.mFirstTime = mFirstTime.load(std::memory_order_relaxed);
+            entry.mLastTime = mLastTime.load(std::memory_order_relaxed);
+            return entry;
         }
 
-        // Initialize entry with code as the first error at the given time.
-        void setFirstError(T code, int64_t time) {
-            mCode = code;
-            mCount = 1;
-            mFirstTime = time;
-            mLastTime = time;
+        void store(const Entry &entry) {
+            mCode.store(entry.mCode, std::memory_order_relaxed);
+            mCount.store(entry.mCount, std::memory_order_relaxed);
+            mFirstTime.store(entry.mFirstTime, std::memory_order_relaxed);
+            mLastTime.store(entry.mLastTime, std::memory_order_relaxed);
         }
-
-        T mCode;            // error code
-        uint32_t mCount;    // number of consecutive errors of the same code.
-        int64_t mFirstTime; // first time of the error code.
-        int64_t mLastTime;  // last time of the error code.
     };
 
-private:
-    mutable std::mutex mLock;     // monitor mutex
-    int64_t mErrors;              // total number of errors registered
-    size_t mIdx;                  // current index into mEntries (active)
-    const int64_t mAggregateNs;   // number of nanoseconds to aggregate consecutive error codes.
-    std::vector<Entry> mEntries;  // circular buffer of error entries.
+    // Copies the state of the log, retrying up to kDumpRetries times if log() runs
+    // concurrently. Returns whether the copy is consistent.
+    bool snapshot(int64_t *errors, size_t *idx, std::vector<Entry> *entries) const
+    {
+        entries->resize(mEntries.size());
+        for (int attempt = 0; ; ++attempt) {
+            const uint32_t sequence = mSequence.load(std::memory_order_acquire);
+            *errors = mErrors.load(std::memory_order_relaxed);
+            *idx = mIdx.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < mEntries.size(); ++i) {
+                (*entries)[i] = mEntries[i].load();
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((sequence & 1) == 0 && mSequence.load(std::memory_order_relaxed) == sequence) {
+                return true;
+            }
+            if (attempt + 1 >= kDumpRetries) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<uint32_t> mSequence;  // sequence lock, odd while log() updates the state
+    std::atomic<int64_t> mErrors;     // total number of errors registered
+    std::atomic<size_t> mIdx;         // current index into mEntries (active)
+    const int64_t mAggregateNs;       // number of nanoseconds to aggregate consecutive error codes.
+    std::vector<AtomicEntry> mEntries; // circular buffer of error entries.
+    mutable std::atomic<int64_t> mInconsistentDumps; // dumps of an inconsistent copy
 };
 
 } // namespace android
@@ -19,6 +19,8 @@
 
 #ifdef __cplusplus
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <system/audio.h>
@@ -37,6 +39,7 @@ namespace android {
  * summed together for energy purposes.
  *
  * The public methods are internally protected by a mutex to be thread-safe.
+ * See SingleWriterPowerLog for logging from a real-time thread.
  */
 class PowerLog {
 public:
@@ -101,6 +104,73 @@ private:
     std::vector<std::pair<int64_t /* real time ns */, float /* energy */>> mEntries;
 };
 
+/**
+ * Same as PowerLog, but log() is wait-free and may be called from a real-time
+ * (e.g. SCHED_FIFO) audio thread, provided that it is only ever called from one thread
+ * at a time. The energy entries are kept in a ring which is read with a seqlock style
+ * snapshot, so dumping never blocks log().
+ */
+class SingleWriterPowerLog {
+public:
+    /**
+     * \brief Creates a SingleWriterPowerLog object, see PowerLog::PowerLog.
+     */
+    SingleWriterPowerLog(uint32_t sampleRate,
+            uint32_t channelCount,
+            audio_format_t format,
+            size_t entries,
+            size_t framesPerEntry);
+
+    /**
+     * \brief Adds new audio data to the power log, from the single writer thread.
+     *
+     * \param buffer            pointer to the audio data buffer.
+     * \param frames            buffer size in audio frames.
+     * \param nowNs             current time in nanoseconds.
+     */
+    void log(const void *buffer, size_t frames, int64_t nowNs);
+
+    /**
+     * \brief Dumps the log to a std::string, see PowerLog::dumpToString.
+     */
+    std::string dumpToString(
+            const char *prefix = "", size_t lines = 0, int64_t limitNs = 0) const;
+
+    /**
+     * \brief Dumps the log to a raw file descriptor, see PowerLog::dump.
+     */
+    status_t dump(int fd, const char *prefix = "", size_t lines = 0, int64_t limitNs = 0) const;
+
+private:
+    // An entry of the ring, the fields are atomic so that a reader may copy them
+    // while the writer overwrites; such copies are detected and discarded.
+    struct Entry {
+        std::atomic<int64_t> mTime{0};  // real time ns
+        std::atomic<float> mEnergy{0.f};
+    };
+
+    // Writes the next entry of the ring, called only by the writer.
+    void writeEntry(int64_t timeNs, float energy);
+
+    // Copies the ring into entries, and returns the total entries written at the time
+    // of the copy. Entries overwritten during the copy are zeroed.
+    uint64_t snapshotEntries(
+            std::vector<std::pair<int64_t /* real time ns */, float /* energy */>> *entries) const;
+
+    // writer state, accessed only by log()
+    int64_t mCurrentTime;         // time of first frame in buffer
+    float mCurrentEnergy;         // local energy accumulation
+    size_t mCurrentFrames;        // number of frames in the energy
+    size_t mConsecutiveZeroes;    // current run of consecutive zero entries
+    // shared with readers
+    std::atomic<uint64_t> mIdx;   // total entries written, mIdx % mEntryCount is next to write
+    const uint32_t mChannelCount; // audio data channel count
+    const audio_format_t mFormat; // audio data format
+    const size_t mFramesPerEntry; // number of audio frames per entry
+    const size_t mEntryCount;     // number of entries in the ring
+    const std::unique_ptr<Entry[]> mEntries;
+};
+
 } // namespace android
 
 #endif // __cplusplus
@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/time.h>
 
+#include <system/audio.h>
+
 __BEGIN_DECLS
 
 /** Buffer descriptor used by read() and write() methods, including the time stamp and delay. */
@@ -52,6 +54,19 @@ struct echo_reference_itfe {
     int (*write)(struct echo_reference_itfe *echo_reference, struct echo_reference_buffer *buffer);
 };
 
+/**
+ * Create an echo reference: frames written by the playback path in the write format,
+ * channel count and sampling rate are read by the capture path in the read ones.
+ * Formats are AUDIO_FORMAT_PCM_16_BIT or AUDIO_FORMAT_PCM_FLOAT, each side independently.
+ * Channel counts are 1 to AUDIO_CHANNEL_COUNT_MAX and are converted as by adjust_channels():
+ * extra write channels are dropped and extra read channels are zero, except that a mono read
+ * averages the first two write channels and a mono write goes to the first two read channels.
+ * Resampling is done in float when either format is float.
+ * The rates of the playback and capture clocks are estimated from the time stamps and frame
+ * counts of write() and read(), and their drift is compensated by adjusting the resampling
+ * ratio, resampling equal rates too once drift is measured.
+ * \return 0 on success, -EINVAL for unsupported parameters, -ENODEV if no resampler.
+ */
 int create_echo_reference(audio_format_t rdFormat,
                           uint32_t rdChannelCount,
                           uint32_t rdSamplingRate,
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FFT_H
+#define ANDROID_AUDIO_FFT_H
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+/** \cond */
+__BEGIN_DECLS
+/** \endcond */
+
+/** Smallest number of points of a transform. */
+#define FFT_SIZE_MIN 2
+/** Largest number of points of a transform. */
+#define FFT_SIZE_MAX 16384
+
+/**
+ * A plan holds the twiddle factors and bit reversal table of the transforms of one size,
+ * both complex and real. A plan is not modified by the transforms and may be shared by
+ * several threads.
+ */
+struct fft_plan;
+
+/**
+ * Creates a plan for transforms of n points.
+ *
+ * \param n       number of points, a power of 2 from FFT_SIZE_MIN to FFT_SIZE_MAX.
+ * \param plan    set to the new plan on success.
+ * \return 0 on success, -EINVAL if n is not supported.
+ */
+int create_fft_plan(size_t n, struct fft_plan **plan);
+
+/** Releases a plan created by create_fft_plan(). */
+void release_fft_plan(struct fft_plan *plan);
+
+/** Returns the number of points of the transforms of the plan. */
+size_t fft_plan_size(const struct fft_plan *plan);
+
+/**
+ * Computes the discrete Fourier transform X[k] = sum x[j] exp(-2 pi i j k / n) of n complex
+ * points, stored as interleaved real and imaginary parts (2 * n floats).
+ * in and out may be the same buffer but must not otherwise overlap; neither needs any
+ * alignment.
+ */
+void fft_complex_forward(const struct fft_plan *plan, const float *in, float *out);
+
+/**
+ * Computes the inverse transform x[j] = sum X[k] exp(2 pi i j k / n) of n complex points.
+ * The inverse is not normalized: a forward then inverse transform scales the input by n.
+ */
+void fft_complex_inverse(const struct fft_plan *plan, const float *in, float *out);
+
+/**
+ * Computes the transform of n real points. Since X[n - k] = conj(X[k]), only the bins
+ * 0 to n / 2 are stored, packed in n floats:
+ * out[0] = X[0] and out[1] = X[n / 2], both real, then out[2 * k] and out[2 * k + 1] are the
+ * real and imaginary parts of X[k] for 0 < k < n / 2.
+ * in and out may be the same buffer but must not otherwise overlap.
+ */
+void fft_real_forward(const struct fft_plan *plan, const float *in, float *out);
+
+/**
+ * Computes the n real points of the inverse transform of a spectrum packed as by
+ * fft_real_forward(). As for fft_complex_inverse(), the output is scaled by n.
+ */
+void fft_real_inverse(const struct fft_plan *plan, const float *in, float *out);
+
+/** \cond */
+__END_DECLS
+/** \endcond */
+
+#endif  // ANDROID_AUDIO_FFT_H
@@ -17,7 +17,9 @@
 #ifndef ANDROID_AUDIO_FIFO_H
 #define ANDROID_AUDIO_FIFO_H
 
+#include <memory>
 #include <stdlib.h>
+#include <vector>
 #include <audio_utils/fifo_index.h>
 
 #ifndef __cplusplus
@@ -138,7 +140,9 @@ protected:
 class audio_utils_fifo : public audio_utils_fifo_base {
 
     friend class audio_utils_fifo_reader;
+    friend class audio_utils_fifo_reader_group;
     friend class audio_utils_fifo_writer;
+    template <typename T> friend class audio_utils_fifo_reader_T;
     template <typename T> friend class audio_utils_fifo_writer_T;
 
 public:
@@ -205,6 +209,38 @@ private:
     audio_utils_fifo_index      mSingleProcessSharedFront;
 };
 
+/**
+ * Same as the single-process audio_utils_fifo, but the writer's rear index and the throttling
+ * reader's front index are each alone on their own cache line, separate from the FIFO fields
+ * which are read by both sides.  This avoids false sharing between the writer and reader cores.
+ * Combine with audio_utils_cache_line_aligned for the writer and reader objects.
+ */
+class audio_utils_fifo_padded : private audio_utils_fifo_padded_indices, public audio_utils_fifo {
+
+public:
+    /**
+     * Construct a FIFO object: single-process, with padded indices.
+     * The parameters are the same as for the single-process audio_utils_fifo constructor.
+     */
+    audio_utils_fifo_padded(uint32_t frameCount, uint32_t frameSize, void *buffer,
+            bool throttlesWriter = true) :
+        audio_utils_fifo(frameCount, frameSize, buffer, mRear, throttlesWriter ? &mFront : NULL)
+    {
+    }
+};
+
+/**
+ * Wrapper which gives an object of type T its own cache line(s), for example a writer or reader
+ * whose local indices are updated by one core while an adjacent object is updated by another.
+ * The constructors are those of T.  Heap allocation requires C++17 aligned new.
+ */
+template <typename T>
+class alignas(AUDIO_UTILS_CACHE_LINE_SIZE) audio_utils_cache_line_aligned : public T {
+
+public:
+    using T::T;
+};
+
 /**
  * Describes one virtually contiguous fragment of a logically contiguous slice.
  * Compare to struct iovec for readv(2) and writev(2).
@@ -436,6 +472,14 @@ public:
      */
     void getHysteresis(uint32_t *armLevel, uint32_t *triggerLevel) const;
 
+protected:
+    /**
+     * Same as obtain(), except polls the throttling reader's front index for up to \p spinNs
+     * before blocking, see audio_utils_fifo_index::wait.
+     */
+    ssize_t obtain(audio_utils_iovec iovec[2], size_t count, const struct timespec *timeout,
+            int64_t spinNs);
+
 private:
     // Accessed by writer only using ordinary operations
     uint32_t    mLocalRear; // frame index of next frame slot available to write, or write index
@@ -459,6 +503,8 @@ private:
  */
 class audio_utils_fifo_reader : public audio_utils_fifo_provider {
 
+    friend class audio_utils_fifo_reader_group;
+
 public:
     /**
      * Single-process and multi-process use same constructor here,
@@ -612,7 +658,46 @@ public:
     uint64_t totalFlushed() const
             { return mTotalFlushed; }
 
+protected:
+    /**
+     * Same as read() and obtain(), except poll the writer's rear index for up to \p spinNs
+     * before blocking, see audio_utils_fifo_index::wait.
+     */
+    ssize_t read(void *buffer, size_t count, const struct timespec *timeout, size_t *lost,
+            int64_t spinNs);
+    ssize_t obtain(audio_utils_iovec iovec[2], size_t count, const struct timespec *timeout,
+            size_t *lost, int64_t spinNs);
+
 private:
+    /**
+     * Wait until the writer's rear index differs from \p front, or the timeout expires.
+     *
+     * \param front   The front index to compare against.
+     * \param count   See audio_utils_fifo_provider::obtain; no wait if zero.
+     * \param timeout See audio_utils_fifo_provider::obtain.
+     * \param rear    Set to the most recently loaded value of the writer's rear index.
+     * \param spinNs  Time to poll the rear index before blocking, see audio_utils_fifo_index::wait.
+     *
+     * \return 0 on success, or a negative error code as for audio_utils_fifo_provider::obtain.
+     */
+    int waitForRear(uint32_t front, size_t count, const struct timespec *timeout, uint32_t *rear,
+            int64_t spinNs);
+
+    /**
+     * Same as obtain(), except uses the supplied snapshot \p rear of the writer's rear index
+     * instead of loading it, and doesn't block.
+     *
+     * \param rear    Snapshot of the writer's rear index.
+     * \param iovec   See audio_utils_fifo_provider::obtain; NULL means don't set mObtained.
+     * \param count   See audio_utils_fifo_provider::obtain.
+     * \param lost    See obtain().
+     * \param err     Error code to return if no frames are available.
+     *
+     * \return See audio_utils_fifo_provider::obtain for 'Returns' and 'Return values'.
+     */
+    ssize_t obtainAt(uint32_t rear, audio_utils_iovec iovec[2], size_t count, size_t *lost,
+            int err);
+
     // Accessed by reader only using ordinary operations
     uint32_t     mLocalFront;   // frame index of first frame slot available to read, or read index
 
@@ -630,4 +715,187 @@ private:
     uint64_t    mTotalFlushed;      // total flushed frames, does not include lost frames
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Same as audio_utils_fifo_writer, except that before each futex wait for the throttling reader
+ * the writer polls the reader's front index for a spin budget, see audio_utils_fifo_index::wait.
+ * With short periods, this avoids the scheduler wakeup latency at a cost in CPU time.
+ * The budget is local to the writer, and has no effect for AUDIO_UTILS_FIFO_SYNC_SLEEP.
+ */
+class audio_utils_fifo_spinning_writer : public audio_utils_fifo_writer {
+
+public:
+    /**
+     * \param fifo   Associated FIFO.  Passed by reference because it must be non-NULL.
+     * \param spinNs Spin budget in nanoseconds, or zero to block immediately.
+     */
+    audio_utils_fifo_spinning_writer(audio_utils_fifo& fifo, int64_t spinNs);
+    virtual ~audio_utils_fifo_spinning_writer();
+
+    // Implement audio_utils_fifo_provider; also used by write()
+    virtual ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL);
+
+    /** Set the spin budget in nanoseconds, or zero to block immediately. */
+    void setSpinNs(int64_t spinNs)
+            { mSpinNs = spinNs > 0 ? spinNs : 0; }
+
+    /** Return the spin budget in nanoseconds. */
+    int64_t spinNs() const
+            { return mSpinNs; }
+
+private:
+    int64_t     mSpinNs;
+};
+
+/**
+ * Same as audio_utils_fifo_reader, except that before each futex wait for the writer
+ * the reader polls the writer's rear index for a spin budget, see audio_utils_fifo_index::wait.
+ * The budget is local to the reader, and has no effect for AUDIO_UTILS_FIFO_SYNC_SLEEP.
+ */
+class audio_utils_fifo_spinning_reader : public audio_utils_fifo_reader {
+
+public:
+    /**
+     * \param fifo            Associated FIFO.  Passed by reference because it must be non-NULL.
+     * \param spinNs          Spin budget in nanoseconds, or zero to block immediately.
+     * \param throttlesWriter See audio_utils_fifo_reader.
+     * \param flush           See audio_utils_fifo_reader.
+     */
+    audio_utils_fifo_spinning_reader(audio_utils_fifo& fifo, int64_t spinNs,
+            bool throttlesWriter = true, bool flush = false);
+    virtual ~audio_utils_fifo_spinning_reader();
+
+    /** See audio_utils_fifo_reader::read. */
+    ssize_t read(void *buffer, size_t count, const struct timespec *timeout = NULL,
+            size_t *lost = NULL);
+
+    // Implement audio_utils_fifo_provider
+    virtual ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL);
+
+    /** See audio_utils_fifo_reader::obtain. */
+    ssize_t obtain(audio_utils_iovec iovec[2], size_t count, const struct timespec *timeout,
+            size_t *lost);
+
+    /** Set the spin budget in nanoseconds, or zero to block immediately. */
+    void setSpinNs(int64_t spinNs)
+            { mSpinNs = spinNs > 0 ? spinNs : 0; }
+
+    /** Return the spin budget in nanoseconds. */
+    int64_t spinNs() const
+            { return mSpinNs; }
+
+private:
+    int64_t     mSpinNs;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Used to read from a FIFO on behalf of a group of readers served by a single thread,
+ * for example one capture writer fanned out to echo cancellation, recording and metering.
+ * The group loads the writer's rear index once per obtain() for all of its readers,
+ * and if the group throttles the writer, then it publishes only the front index of the slowest
+ * reader, once per release(), with at most one wakeup of the writer.
+ * The group is multi-thread safe with respect to the writer and any other readers,
+ * but not with respect to multiple threads calling the group API.
+ */
+class audio_utils_fifo_reader_group {
+
+public:
+    /**
+     * \param fifo            Associated FIFO.  Passed by reference because it must be non-NULL.
+     * \param readerCount     Number of readers in the group > 0.
+     * \param throttlesWriter Whether the slowest reader of the group throttles the writer.
+     *                        At most one reader or group can specify throttlesWriter == true.
+     * \param flush           Whether readers flush (discard) the entire buffer on -EOVERFLOW.
+     */
+    audio_utils_fifo_reader_group(audio_utils_fifo& fifo, size_t readerCount,
+            bool throttlesWriter = true, bool flush = false);
+    ~audio_utils_fifo_reader_group();
+
+    /** Return the number of readers in the group. */
+    size_t size() const
+            { return mReaders.size(); }
+
+    /**
+     * Return a reader of the group, for its counters and for direct access to the buffer.
+     * Use the group obtain() and release() rather than the reader's own transfer methods.
+     *
+     * \param index Index of the reader < size().
+     */
+    const audio_utils_fifo_reader& reader(size_t index) const
+            { return *mReaders[index]; }
+
+    /**
+     * Obtain a slice for each reader of the group, from a single snapshot of the writer's rear.
+     * It is permitted to call obtain() multiple times without an intervening release().
+     *
+     * \param iovecs   Array of size() pairs of fragment descriptors, one pair per reader,
+     *                 see audio_utils_fifo_provider::obtain.
+     * \param obtained Array of size() results, one per reader, set as for
+     *                 audio_utils_fifo_provider::obtain: the number of frames obtained,
+     *                 or a negative error code.
+     * \param count    The maximum number of frames to obtain per reader.
+     * \param timeout  Indicates the maximum time to block until at least one reader has a frame.
+     *                 See audio_utils_fifo_provider::obtain.
+     * \param lost     If non-NULL, array of size() values set as for
+     *                 audio_utils_fifo_reader::obtain.
+     *
+     * \return Largest number of frames obtained by any reader, if greater than or equal to zero.
+     *         If no reader obtained any frames, then the error code of the wait or of the first
+     *         reader that failed, see audio_utils_fifo_provider::obtain.
+     */
+    ssize_t obtain(audio_utils_iovec (*iovecs)[2], ssize_t obtained[], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL, size_t lost[] = NULL);
+
+    /**
+     * Release access to a portion of each reader's most recently obtained slice.
+     * If the group throttles the writer, then the slowest reader's front index is published,
+     * and the writer is woken subject to hysteresis, see setHysteresis().
+     *
+     * \param counts Array of size() frame counts, one per reader, each as for
+     *               audio_utils_fifo_provider::release.
+     */
+    void release(const size_t counts[]);
+
+    /**
+     * Set the hysteresis levels for a throttling group to wake a blocked writer,
+     * with the same meaning as audio_utils_fifo_reader::setHysteresis,
+     * where the fill level is that of the slowest reader.
+     *
+     * \param armLevel      Arm for wakeup when fill level > this value.
+     *                      Capped to range [-1, mFifo.mFrameCount].
+     * \param triggerLevel  Trigger wakeup when armed and fill level < this value.
+     *                      Capped to range [0, mFifo.mFrameCount].
+     */
+    void setHysteresis(int32_t armLevel, uint32_t triggerLevel);
+
+    /**
+     * Get the hysteresis levels for waking the writer.
+     *
+     * \param armLevel      Set to the current arm level in frames.
+     * \param triggerLevel  Set to the current trigger level in frames.
+     */
+    void getHysteresis(int32_t *armLevel, uint32_t *triggerLevel) const;
+
+private:
+    audio_utils_fifo&   mFifo;
+
+    // Each reader is non-throttling; the group throttles on behalf of all of them.
+    std::vector<std::unique_ptr<audio_utils_fifo_reader>> mReaders;
+
+    // Points to shared front index if this group throttles writer, or NULL if we don't throttle
+    audio_utils_fifo_index*     mThrottleFront;
+
+    uint32_t    mRear;              // writer's rear index as of the most recent obtain()
+    uint32_t    mLocalFront;        // front index of slowest reader, as last published
+
+    int32_t     mArmLevel;          // arm if filled > arm level before release()
+    uint32_t    mTriggerLevel;      // trigger if armed and filled < trigger level after release()
+    bool        mIsArmed;           // whether currently armed
+};
+
 #endif  // !ANDROID_AUDIO_FIFO_H
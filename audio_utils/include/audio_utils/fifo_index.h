@@ -65,6 +65,23 @@ public:
      */
     int wait(int op, uint32_t expected, const struct timespec *timeout);
 
+    /**
+     * Same as wait(), except first polls the index for up to \p spinNs.
+     *
+     * \param op      See wait().
+     * \param expected See wait().
+     * \param timeout See wait().
+     * \param spinNs  Maximum time in nanoseconds to poll the index before blocking in the kernel,
+     *                included in \p timeout.  Polling spins for the first half of this time,
+     *                and yields the processor for the second half.  Zero means block immediately.
+     *                With short periods, a spin budget a little longer than the expected wait
+     *                avoids a futex wait and the scheduler wakeup latency, at a cost in CPU.
+     *
+     * \return Zero for success, or a negative error code as specified at "man 2 futex".
+     *         Success includes the case where the value changed while polling.
+     */
+    int wait(int op, uint32_t expected, const struct timespec *timeout, int64_t spinNs);
+
     // TODO op should be set in the constructor.
     /**
      * Wake up any threads waiting for the value of index to change.
@@ -90,6 +107,26 @@ private:
 static_assert(sizeof(audio_utils_fifo_index) == sizeof(uint32_t),
         "audio_utils_fifo_index must be 32 bits");
 
+/**
+ * Separation in bytes between data written by different cores, to avoid false sharing.
+ * This is larger than the common 64-byte cache line, to also cover processors with 128-byte lines
+ * and those which prefetch cache lines in adjacent pairs.
+ */
+#define AUDIO_UTILS_CACHE_LINE_SIZE 128
+
+/**
+ * Storage for a FIFO's writer rear index and throttling reader front index,
+ * each alone on its own cache line.  Use with the audio_utils_fifo constructor that takes
+ * the indices, or see audio_utils_fifo_padded for a single-process FIFO.
+ */
+struct audio_utils_fifo_padded_indices {
+    alignas(AUDIO_UTILS_CACHE_LINE_SIZE) audio_utils_fifo_index mRear;
+    alignas(AUDIO_UTILS_CACHE_LINE_SIZE) audio_utils_fifo_index mFront;
+};
+
+static_assert(sizeof(audio_utils_fifo_padded_indices) == 2 * AUDIO_UTILS_CACHE_LINE_SIZE,
+        "each index must be alone on its cache line");
+
 // TODO
 // From a design POV, these next two classes should be related.
 // Extract a base class (that shares their property of being a reference to a fifo index)
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FIFO_READER_T_H
+#define ANDROID_AUDIO_FIFO_READER_T_H
+
+#include <audio_utils/fifo.h>
+
+/**
+ * Optimized FIFO reader for small multiples of fixed-sized POD such as primitives,
+ * the counterpart of audio_utils_fifo_writer_T.
+ *
+ * Has these restrictions compared to the ordinary FIFO reader:
+ *  - buffer must be aligned on an appropriate boundary for T
+ *  - frame size must be sizeof(T)
+ *  - capacity must be power-of-2
+ *  - does not throttle the writer, and thus must keep up with the writer or lose frames
+ *  - no blocking reads
+ *  - does not implement the provider interface
+ *  - does not implement the ordinary reader interface
+ *  - no implied load-acquire; must be done explicitly
+ *  - frames are lost silently, see totalLost()
+ *
+ * Usage:
+ *  - construct an ordinary FIFO that follows the restrictions above
+ *  - construct a writer_T or ordinary writer based on that FIFO
+ *  - construct one or more reader_T using the FIFO
+ *  - use loadAcquire to observe the writer's commits, followed by a sequence of read and read1
+ */
+template <typename T>
+class audio_utils_fifo_reader_T /* : public audio_utils_fifo_provider */ {
+
+public:
+    /**
+     * Construct a reader_T from a FIFO.
+     * Like a non-throttling reader, it does not see any data written prior to construction.
+     */
+    explicit audio_utils_fifo_reader_T(audio_utils_fifo& fifo);
+    /*virtual*/ ~audio_utils_fifo_reader_T();
+
+    /**
+     * Observe all frames committed by the writer so far, with memory order 'acquire'.
+     * If the reader fell more than capacity frames behind the writer, it skips ahead to the
+     * oldest frame still in the buffer, and the skipped frames are counted in totalLost().
+     *
+     * \return Number of frames available to read, <= capacity.
+     */
+    uint32_t loadAcquire();
+
+    /**
+     * Return the number of frames available to read, as of the most recent loadAcquire,
+     * less the number of frames read since then.
+     */
+    uint32_t available() const
+            __attribute__((no_sanitize("integer")))     // mRear - mLocalFront can wrap
+    {
+        return mRear - mLocalFront;
+    }
+
+    /**
+     * Read an array of T from FIFO.
+     *
+     * \param buffer Destination for up to \p count frames.
+     * \param count  Desired number of frames to read.
+     *
+     * \return Actual number of frames read, the smaller of \p count and available().
+     */
+    uint32_t read(T *buffer, uint32_t count);
+
+    /**
+     * Read one T value from FIFO.  available() must be greater than zero.
+     */
+    T read1()
+            __attribute__((no_sanitize("integer")))     // mLocalFront ++ can wrap
+    {
+        return mBuffer[mLocalFront++ & (mFrameCountP2 - 1)];
+    }
+
+    /**
+     * Return the total number of frames lost because the reader did not keep up with the writer.
+     * Frames overwritten by the writer after loadAcquire but before they were read are not
+     * detected, so loadAcquire and read promptly relative to the capacity.
+     */
+    uint64_t totalLost() const
+            { return mTotalLost; }
+
+private:
+    // Accessed by reader only using ordinary operations
+    uint32_t    mLocalFront;    // frame index of next frame slot available to read, or read index
+    uint32_t    mRear;          // writer's rear index as of most recent loadAcquire
+    uint64_t    mTotalLost;     // total lost frames
+
+    // These fields are copied from fifo for better performance (avoids an extra de-reference)
+    const uint32_t          mFrameCountP2;
+    const T * const         mBuffer;
+    audio_utils_fifo_index& mWriterRear;
+};
+
+using audio_utils_fifo_reader32 = audio_utils_fifo_reader_T<int32_t>;
+using audio_utils_fifo_reader64 = audio_utils_fifo_reader_T<int64_t>;
+
+#endif // ANDROID_AUDIO_FIFO_READER_T_H
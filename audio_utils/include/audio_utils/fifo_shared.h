@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FIFO_SHARED_H
+#define ANDROID_AUDIO_FIFO_SHARED_H
+
+#include <memory>
+#include <audio_utils/fifo.h>
+
+/**
+ * Header at the start of a shared memory FIFO region.
+ * The fields are written once by the creator, and validated by each process that attaches.
+ */
+struct audio_utils_fifo_shared_header {
+    /** Always AUDIO_UTILS_FIFO_SHARED_MAGIC. */
+    uint32_t    mMagic;
+    /** Layout version, AUDIO_UTILS_FIFO_SHARED_VERSION. */
+    uint32_t    mVersion;
+    /** Capacity in frames, see audio_utils_fifo. */
+    uint32_t    mFrameCount;
+    /** Size of each frame in bytes. */
+    uint32_t    mFrameSize;
+    /** Non-zero if a reader throttles the writer. */
+    uint32_t    mThrottlesWriter;
+    /** Offset in bytes of the writer's rear index from the start of the region. */
+    uint32_t    mRearOffset;
+    /** Offset in bytes of the throttling reader's front index from the start of the region. */
+    uint32_t    mFrontOffset;
+    /** Offset in bytes of the frame buffer from the start of the region. */
+    uint32_t    mBufferOffset;
+};
+
+#define AUDIO_UTILS_FIFO_SHARED_MAGIC   0x46494641  // 'AFIF' in little-endian memory order
+#define AUDIO_UTILS_FIFO_SHARED_VERSION 1
+/** Alignment in bytes of each part of the region, at least the largest cache line size. */
+#define AUDIO_UTILS_FIFO_SHARED_ALIGNMENT AUDIO_UTILS_CACHE_LINE_SIZE
+
+/**
+ * A FIFO whose indices and buffer are in a single memfd-backed shared memory region,
+ * so that a writer in one process and reader(s) in other processes exchange frames
+ * with no copies other than into and out of the ring itself.
+ *
+ * Region layout, each part starting on its own AUDIO_UTILS_FIFO_SHARED_ALIGNMENT boundary
+ * so that the writer and the throttling reader do not share a cache line:
+ *  - audio_utils_fifo_shared_header
+ *  - writer's rear index
+ *  - throttling reader's front index
+ *  - frame buffer
+ *
+ * One process calls create(), then passes fd() to the other processes, for example with binder
+ * or SCM_RIGHTS, which call attach().  Each process then creates its writer or reader(s).
+ * The indices are constructed once by create(), and the region is sealed against resizing.
+ * The audio_utils_fifo_shared must outlive any writer or reader created from it.
+ */
+class audio_utils_fifo_shared {
+
+public:
+    /**
+     * Create a new shared memory FIFO.
+     *
+     * \param frameCount      Capacity in frames > 0, see audio_utils_fifo.
+     * \param frameSize       Size of each frame in bytes > 0, see audio_utils_fifo.
+     * \param throttlesWriter Whether there is one reader that throttles the writer.
+     * \param name            Name of the memfd, for debugging only.
+     *
+     * \return The FIFO, or nullptr if the shared memory could not be allocated.
+     */
+    static std::unique_ptr<audio_utils_fifo_shared> create(uint32_t frameCount,
+            uint32_t frameSize, bool throttlesWriter = true, const char *name = "audio_utils_fifo");
+
+    /**
+     * Attach to a shared memory FIFO created by another process.
+     * The header is validated, and its values are copied so later changes to it are ignored.
+     *
+     * \param fd File descriptor of the region as returned by fd() of the creator.
+     *           The caller retains ownership of \p fd; it is duplicated.
+     *
+     * \return The FIFO, or nullptr if \p fd is not a valid shared memory FIFO.
+     */
+    static std::unique_ptr<audio_utils_fifo_shared> attach(int fd);
+
+    ~audio_utils_fifo_shared();
+
+    /**
+     * Return the file descriptor of the region, to share with other processes.
+     * The descriptor remains owned by this object.
+     */
+    int fd() const
+            { return mFd; }
+
+    /** Return the FIFO, which refers to the indices and buffer in shared memory. */
+    audio_utils_fifo& fifo()
+            { return *mFifo; }
+
+    /**
+     * Create the writer.  There should be exactly one writer per FIFO, across all processes.
+     *
+     * \return A writer on fifo().
+     */
+    std::unique_ptr<audio_utils_fifo_writer> createWriter();
+
+    /**
+     * Create a reader.
+     *
+     * \param throttlesWriter Whether this reader throttles the writer, see audio_utils_fifo_reader.
+     *                        At most one reader across all processes can specify true,
+     *                        and only if the FIFO was created with throttlesWriter true.
+     * \param flush           See audio_utils_fifo_reader.
+     *
+     * \return A reader on fifo().
+     */
+    std::unique_ptr<audio_utils_fifo_reader> createReader(bool throttlesWriter = true,
+            bool flush = false);
+
+private:
+    audio_utils_fifo_shared(int fd, void *base, size_t size,
+            const audio_utils_fifo_shared_header& header);
+
+    /** Return the size in bytes of a region for the specified capacity and frame size. */
+    static size_t regionSize(uint32_t frameCount, uint32_t frameSize);
+
+    const int       mFd;        // owned file descriptor of the region
+    void * const    mBase;      // start of the local mapping of the region
+    const size_t    mSize;      // size of the mapping in bytes
+    std::unique_ptr<audio_utils_fifo> mFifo;
+};
+
+#endif  // !ANDROID_AUDIO_FIFO_SHARED_H
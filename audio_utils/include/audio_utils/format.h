@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/cdefs.h>
 #include <system/audio.h>
+#include <audio_utils/primitives.h>
 
 /** \cond */
 __BEGIN_DECLS
@@ -64,6 +65,34 @@ __BEGIN_DECLS
 void memcpy_by_audio_format(void *dst, audio_format_t dst_format,
         const void *src, audio_format_t src_format, size_t count);
 
+/**
+ * Copy frames with conversion between buffer sample formats and channel masks in one sweep,
+ * equivalent to memcpy_by_audio_format() followed by memcpy_by_index_array() with
+ * the index array of memcpy_by_index_array_initialization_from_channel_mask(),
+ * without an intermediate buffer for the whole transfer.
+ *
+ *  \param dst               Destination buffer
+ *  \param dst_format        Destination buffer format
+ *  \param dst_channel_mask  Destination channel position or index mask
+ *  \param src               Source buffer
+ *  \param src_format        Source buffer format
+ *  \param src_channel_mask  Source channel position or index mask
+ *  \param count             Number of frames to copy
+ *
+ * The allowed format conversions are those of memcpy_by_audio_format(), and the
+ * destination mask may have at most MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX channels.
+ * Destination channels not present in the source are zero filled.
+ *
+ * The destination and source buffers must be completely separate (non-overlapping),
+ * unless the channel masks are equal, in which case this is memcpy_by_audio_format().
+ *
+ * Logs a fatal error if the formats or channel masks are not allowed.
+ */
+void memcpy_by_audio_format_and_channel_mask(void *dst, audio_format_t dst_format,
+        audio_channel_mask_t dst_channel_mask,
+        const void *src, audio_format_t src_format,
+        audio_channel_mask_t src_channel_mask, size_t count);
+
 
 /**
  * This function creates an index array for converting audio data with different
@@ -85,6 +114,24 @@ void memcpy_by_audio_format(void *dst, audio_format_t dst_format,
 size_t memcpy_by_index_array_initialization_from_channel_mask(int8_t *idxary, size_t arysize,
         audio_channel_mask_t dst_channel_mask, audio_channel_mask_t src_channel_mask);
 
+/**
+ * This function prepares a remix plan for converting audio data with different
+ * channel position and index masks, used by memcpy_by_index_array_with_plan().
+ * The index array is created by memcpy_by_index_array_initialization_from_channel_mask().
+ *
+ * Parameters:
+ *  \param plan              Plan to initialize
+ *  \param dst_channel_mask  Bit mask corresponding to destination channels present
+ *  \param src_channel_mask  Bit mask corresponding to source channels present
+ *  \param sample_size       Size of each sample in bytes.  Must be 1, 2, 3, or 4.
+ *
+ * \return 0 on success, or -EINVAL if the input masks are unrecognized
+ * or the sample size is out of range.
+ */
+int memcpy_by_index_array_plan_init_from_channel_mask(memcpy_by_index_array_plan_t *plan,
+        audio_channel_mask_t dst_channel_mask, audio_channel_mask_t src_channel_mask,
+        size_t sample_size);
+
 /** \cond */
 __END_DECLS
 /** \endcond */
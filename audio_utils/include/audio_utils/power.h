@@ -62,6 +62,28 @@ float audio_utils_compute_power_mono(const void *buffer, audio_format_t format,
 
 float audio_utils_compute_energy_mono(const void *buffer, audio_format_t format, size_t samples);
 
+/**
+ * \brief Compute signal energy (sum of squared amplitudes) and peak amplitude
+ *        for each channel of an interleaved buffer, in a single pass.
+ *
+ *   \param buffer           buffer of interleaved samples.
+ *   \param format           one of AUDIO_FORMAT_PCM_8_BIT, AUDIO_FORMAT_PCM_16_BIT,
+ *                           AUDIO_FORMAT_PCM_24_BIT_PACKED, AUDIO_FORMAT_PCM_8_24_BIT,
+ *                           AUDIO_FORMAT_PCM_32_BIT, AUDIO_FORMAT_PCM_FLOAT.
+ *   \param channelCount     number of interleaved channels, between 1 and
+ *                           AUDIO_CHANNEL_COUNT_MAX inclusive.
+ *   \param frames           number of audio frames in buffer.
+ *   \param energyPerChannel array of channelCount elements set to the signal energy
+ *                           of each channel, computed as in audio_utils_compute_energy_mono().
+ *                           May be NULL if not needed.
+ *   \param peakPerChannel   array of channelCount elements set to the absolute peak
+ *                           amplitude of each channel, normalized so that full scale is 1.f.
+ *                           May be NULL if not needed.
+ */
+
+void audio_utils_compute_energy_multichannel(const void *buffer, audio_format_t format,
+        size_t channelCount, size_t frames, float *energyPerChannel, float *peakPerChannel);
+
 /**
  * \brief  Returns true if the format is supported for compute_energy_for_mono()
  *         and compute_power_for_mono().
@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_PRIMITIVES_H
 
 #include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <sys/cdefs.h>
@@ -172,6 +173,66 @@ void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count);
  */
 void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count);
 
+/** Number of independent random generators in an audio_dither_t, one per vector lane. */
+#define AUDIO_DITHER_LANES 8
+
+/** Maximum number of channels of an audio_dither_t with noise shaping. */
+#define AUDIO_DITHER_CHANNELS_MAX 32
+
+/**
+ * Per stream state of the dithered conversions memcpy_to_i16_from_float_with_dither()
+ * and memcpy_to_p24_from_float_with_dither(), initialized by audio_dither_init().
+ * The fields are private to the conversions.
+ */
+typedef struct {
+    /** xorshift32 generator states, used in turn by consecutive samples. */
+    uint32_t state[AUDIO_DITHER_LANES];
+    /** Generator used by the next sample. */
+    uint32_t lane;
+    uint32_t channel_count;
+    /** Channel of the next sample. */
+    uint32_t channel;
+    bool noise_shaping;
+    /** Requantization error of the last sample of each channel, in output LSBs. */
+    float error[AUDIO_DITHER_CHANNELS_MAX];
+} audio_dither_t;
+
+/**
+ * Initializes the dither state of a stream.
+ *
+ *  \param dither         Dither state
+ *  \param seed           Seed of the random generators; streams should use different seeds
+ *                        so that their dither is uncorrelated.
+ *  \param channel_count  Number of interleaved channels, used by noise shaping.
+ *  \param noise_shaping  Whether to feed back the requantization error of each channel,
+ *                        first order, moving the noise power toward high frequencies.
+ *
+ * \return 0 on success, or -EINVAL if noise shaping is requested with channel_count
+ * zero or above AUDIO_DITHER_CHANNELS_MAX.
+ */
+int audio_dither_init(audio_dither_t *dither, uint32_t seed, uint32_t channel_count,
+        bool noise_shaping);
+
+/**
+ * Shrink and copy samples from single-precision floating-point to signed 16-bit
+ * as memcpy_to_i16_from_float(), adding triangular (TPDF) dither of +/- 1 LSB
+ * before rounding, optionally noise shaped.
+ *
+ *  \param dst     Destination buffer
+ *  \param src     Source buffer
+ *  \param count   Number of samples to copy.  Need not be a multiple of the channel count,
+ *                 the channel position carries over to the next call.
+ *  \param dither  Dither state of the stream, updated
+ *
+ * Without noise shaping the dither is generated and applied with vector instructions;
+ * noise shaping runs sample by sample because each sample depends on the previous one.
+ *
+ * The destination and source buffers must either be completely separate (non-overlapping), or
+ * they must both start at the same address.  Partially overlapping buffers are not supported.
+ */
+void memcpy_to_i16_from_float_with_dither(int16_t *dst, const float *src, size_t count,
+        audio_dither_t *dither);
+
 /**
  * Copy samples from signed fixed-point 32-bit Q4.27 to single-precision floating-point.
  * The nominal output float range is [-1.0, 1.0] if the fixed-point range is
@@ -288,6 +349,16 @@ void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count);
  */
 void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count);
 
+/**
+ * Copy samples from single-precision floating-point to signed fixed-point packed 24 bit Q0.23
+ * as memcpy_to_p24_from_float(), adding triangular (TPDF) dither of +/- 1 LSB before
+ * rounding, optionally noise shaped.  The dither is added in float, whose precision limits
+ * its resolution for loud samples, where the requantization error is masked anyway.
+ * See memcpy_to_i16_from_float_with_dither() for the parameters.
+ */
+void memcpy_to_p24_from_float_with_dither(uint8_t *dst, const float *src, size_t count,
+        audio_dither_t *dither);
+
 /**
  * Copy samples from signed fixed-point 32-bit Q8.23 to signed fixed-point packed 24 bit Q0.23.
  * The packed 24 bit output is assumed to be a native-endian uint8_t byte array.
@@ -671,6 +742,88 @@ size_t memcpy_by_index_array_initialization_src_index(int8_t *idxary, size_t idx
 size_t memcpy_by_index_array_initialization_dst_index(int8_t *idxary, size_t idxcount,
         uint32_t dst_mask, uint32_t src_mask);
 
+/** Maximum number of destination channels of a memcpy_by_index_array_plan_t. */
+#define MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX 32
+
+/** Maximum frame size in bytes for which a plan is applied as a vector byte shuffle. */
+#define MEMCPY_BY_INDEX_ARRAY_PLAN_SHUFFLE_BYTES 64
+
+/**
+ * The kind of channel remix described by an index array, as classified by
+ * memcpy_by_index_array_plan_init().
+ */
+typedef enum {
+    /** Any mapping, including zero fill (-1) in the middle of the destination frame. */
+    MEMCPY_BY_INDEX_ARRAY_GENERIC,
+    /** Destination frame equals source frame: idxary[i] == i, dst_channels == src_channels. */
+    MEMCPY_BY_INDEX_ARRAY_IDENTITY,
+    /** Leading source channels are kept: idxary[i] == i, dst_channels < src_channels. */
+    MEMCPY_BY_INDEX_ARRAY_PREFIX,
+    /** Leading source channels are kept, followed by zero filled channels: idxary[i] == i
+     *  for i < copy_channels, and idxary[i] == -1 for the remaining destination channels. */
+    MEMCPY_BY_INDEX_ARRAY_ZERO_FILL,
+    /** Every destination channel comes from the source: idxary[i] >= 0.  This includes
+     *  reordering, dropping and duplicating channels. */
+    MEMCPY_BY_INDEX_ARRAY_PERMUTATION,
+} memcpy_by_index_array_plan_type_t;
+
+/**
+ * A channel remix precomputed from an index array by memcpy_by_index_array_plan_init(),
+ * to be applied to each buffer by memcpy_by_index_array_with_plan().
+ * The fields are read-only after initialization.
+ */
+typedef struct {
+    memcpy_by_index_array_plan_type_t type;
+    uint32_t dst_channels;
+    uint32_t src_channels;
+    /** Number of leading channels copied, for MEMCPY_BY_INDEX_ARRAY_PREFIX and _ZERO_FILL. */
+    uint32_t copy_channels;
+    size_t sample_size;
+    int8_t idxary[MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX];
+    /** Number of 16 byte vectors loaded from each source frame and stored to each
+     *  destination frame by the byte shuffle, or zero if the plan has no byte shuffle. */
+    uint32_t shuffle_src_vectors;
+    uint32_t shuffle_dst_vectors;
+    /** Each destination vector takes bytes only from the source vector at the same offset. */
+    bool shuffle_local;
+    /** Source frame byte offset of each destination frame byte, 0xff for zero fill. */
+    uint8_t shuffle[MEMCPY_BY_INDEX_ARRAY_PLAN_SHUFFLE_BYTES];
+} memcpy_by_index_array_plan_t;
+
+/**
+ * Prepares a remix plan from an index array as used by memcpy_by_index_array(),
+ * classifying the mapping so that memcpy_by_index_array_with_plan() avoids the per sample
+ * index checks.  Frames of up to MEMCPY_BY_INDEX_ARRAY_PLAN_SHUFFLE_BYTES bytes are
+ * remixed with a precomputed byte shuffle on SSSE3 and AArch64 NEON.
+ *
+ *  \param plan          Plan to initialize
+ *  \param dst_channels  Number of destination channels per frame,
+ *                       at most MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX.
+ *  \param src_channels  Number of source channels per frame
+ *  \param idxary        Array of dst_channels indices of channels in the source frame,
+ *                       or -1 for zero fill.
+ *  \param sample_size   Size of each sample in bytes.  Must be 1, 2, 3, or 4.
+ *
+ * \return 0 on success, or -EINVAL if the channel counts, an index or the sample size
+ * is out of range, in which case the plan is not usable.
+ */
+int memcpy_by_index_array_plan_init(memcpy_by_index_array_plan_t *plan,
+        uint32_t dst_channels, uint32_t src_channels, const int8_t *idxary, size_t sample_size);
+
+/**
+ * Copy frames as memcpy_by_index_array() with the index array, channel counts and
+ * sample size of a plan prepared by memcpy_by_index_array_plan_init().
+ *
+ *  \param dst    Destination buffer
+ *  \param src    Source buffer
+ *  \param plan   Remix plan
+ *  \param count  Number of frames to copy
+ *
+ * The destination and source buffers must be completely separate (non-overlapping).
+ */
+void memcpy_by_index_array_with_plan(void *dst, const void *src,
+        const memcpy_by_index_array_plan_t *plan, size_t count);
+
 /**
  * Add and clamp signed 16-bit samples.
  *
@@ -743,6 +896,92 @@ void accumulate_i32(int32_t *dst, const int32_t *src, size_t count);
  */
 void accumulate_float(float *dst, const float *src, size_t count);
 
+/**
+ * Scale samples by a gain and add them to the destination in one pass, with the
+ * clamping of accumulate_i16(): dst[i] = clamp(dst[i] + src[i] * gain).
+ *
+ *  \param dst     Destination buffer
+ *  \param src     Source buffer
+ *  \param gain    Linear gain applied to the source samples
+ *  \param count   Number of samples to add
+ *
+ * The sum is computed in float and rounded to the nearest integer, 0.5 away from zero.
+ * A gain of 1.0 gives the same result as accumulate_i16().
+ *
+ * The destination and source buffers must either be completely separate (non-overlapping), or
+ * they must both start at the same address.  Partially overlapping buffers are not supported.
+ */
+void accumulate_with_gain_i16(int16_t *dst, const int16_t *src, float gain, size_t count);
+
+/**
+ * Scale 32-bit Q8.23 samples by a gain and add them to the destination, with the
+ * clamping of accumulate_q8_23().
+ *
+ * The sum is computed in double and rounded to the nearest integer, 0.5 away from zero.
+ * See accumulate_with_gain_i16() for the parameters.
+ */
+void accumulate_with_gain_q8_23(int32_t *dst, const int32_t *src, float gain, size_t count);
+
+/**
+ * Scale signed 32-bit Q0.31 samples by a gain and add them to the destination, with the
+ * clamping of accumulate_i32().
+ *
+ * The sum is computed in double and rounded to the nearest integer, 0.5 away from zero.
+ * See accumulate_with_gain_i16() for the parameters.
+ */
+void accumulate_with_gain_i32(int32_t *dst, const int32_t *src, float gain, size_t count);
+
+/**
+ * Scale float samples by a gain and add them to the destination.  Result is not clamped.
+ * See accumulate_with_gain_i16() for the parameters.
+ */
+void accumulate_with_gain_float(float *dst, const float *src, float gain, size_t count);
+
+/**
+ * Scale interleaved frames by a gain per channel, optionally ramped linearly,
+ * and add them to the destination in one pass, with the clamping of accumulate_i16().
+ *
+ *  \param dst            Destination buffer
+ *  \param src            Source buffer
+ *  \param gains          Array of channel_count gains, for the first frame
+ *  \param increments     Array of channel_count gain increments per frame,
+ *                        or NULL for constant gains.  The gain of channel c in
+ *                        frame i is gains[c] + i * increments[c], so the gains for
+ *                        a following buffer are gains[c] + frame_count * increments[c].
+ *  \param channel_count  Number of channels per frame
+ *  \param frame_count    Number of frames to add
+ *
+ * Ramps should be shorter than 2^24 frames so that the frame index is exact in float.
+ * The destination and source buffers must either be completely separate (non-overlapping), or
+ * they must both start at the same address.  Partially overlapping buffers are not supported.
+ */
+void accumulate_with_channel_gains_i16(int16_t *dst, const int16_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count);
+
+/**
+ * Scale interleaved 32-bit Q8.23 frames by a gain per channel, optionally ramped linearly,
+ * and add them to the destination, with the clamping of accumulate_q8_23().
+ * See accumulate_with_channel_gains_i16() for the parameters.
+ */
+void accumulate_with_channel_gains_q8_23(int32_t *dst, const int32_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count);
+
+/**
+ * Scale interleaved signed 32-bit Q0.31 frames by a gain per channel, optionally ramped
+ * linearly, and add them to the destination, with the clamping of accumulate_i32().
+ * See accumulate_with_channel_gains_i16() for the parameters.
+ */
+void accumulate_with_channel_gains_i32(int32_t *dst, const int32_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count);
+
+/**
+ * Scale interleaved float frames by a gain per channel, optionally ramped linearly,
+ * and add them to the destination.  Result is not clamped.
+ * See accumulate_with_channel_gains_i16() for the parameters.
+ */
+void accumulate_with_channel_gains_float(float *dst, const float *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count);
+
 /**
  * Clamp (aka hard limit or clip) a signed 32-bit sample to 16-bit range.
  */
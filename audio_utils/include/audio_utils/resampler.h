@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/time.h>
 
+#include <system/audio.h>
+
 __BEGIN_DECLS
 
 
@@ -29,11 +31,22 @@ __BEGIN_DECLS
 #define RESAMPLER_QUALITY_VOIP 3
 #define RESAMPLER_QUALITY_DESKTOP 5
 
+/** largest ratio adjustment accepted by set_ratio_ppm(), 1% */
+#define RESAMPLER_RATIO_PPM_MAX 10000
+
+/**
+ * flag for create_resampler_with_format(): the ratio will be adjusted by set_ratio_ppm().
+ * The resampler then uses an interpolated filter from creation, which follows any ratio
+ * at a slightly higher cost than the exact filter of a fixed ratio.
+ */
+#define RESAMPLER_FLAG_VARIABLE_RATIO 0x1
+
 struct resampler_buffer {
     union {
         void*       raw;
         short*      i16;
         int8_t*     i8;
+        float*      f32;
     };
     size_t frame_count;
 };
@@ -67,6 +80,7 @@ struct resampler_itfe {
     /**
      * resample input from buffer provider and output at most *outFrameCount to out buffer.
      * *outFrameCount is updated with the actual number of frames produced.
+     * Input is requested in bounded pieces, so that this does not allocate.
      */
     int (*resample_from_provider)(struct resampler_itfe *resampler,
                     int16_t *out,
@@ -74,7 +88,8 @@ struct resampler_itfe {
     /**
      * resample at most *inFrameCount frames from in buffer and output at most
      * *outFrameCount to out buffer. *inFrameCount and *outFrameCount are updated respectively
-     * with the number of frames remaining in input and written to output.
+     * with the number of frames consumed from input and written to output.
+     * Does not allocate.
      */
     int (*resample_from_input)(struct resampler_itfe *resampler,
                     int16_t *in,
@@ -85,12 +100,58 @@ struct resampler_itfe {
      * \return the latency introduced by the resampler in ns.
      */
     int32_t (*delay_ns)(struct resampler_itfe *resampler);
+    /**
+     * as resample_from_provider(), with float output.
+     */
+    int (*resample_from_provider_float)(struct resampler_itfe *resampler,
+                    float *out,
+                    size_t *outFrameCount);
+    /**
+     * as resample_from_input(), with float input and output.
+     */
+    int (*resample_from_input_float)(struct resampler_itfe *resampler,
+                    float *in,
+                    size_t *inFrameCount,
+                    float *out,
+                    size_t *outFrameCount);
+    /**
+     * adjust the conversion ratio to track drift between the input and output clocks:
+     * input is consumed as if its sample rate were inSampleRate * (1 + ppm / 1000000).
+     * The change applies from the next output frame without resetting the filter state,
+     * so the output stays continuous. ppm 0 restores the nominal ratio.
+     * Does not allocate nor lock, so it may be called from a real-time thread, but not
+     * concurrently with resampling.
+     * \return 0 on success, -EINVAL if |ppm| exceeds RESAMPLER_RATIO_PPM_MAX, or if ppm is
+     *         not 0 and the resampler was created without RESAMPLER_FLAG_VARIABLE_RATIO.
+     */
+    int (*set_ratio_ppm)(struct resampler_itfe *resampler, int32_t ppm);
+    /**
+     * reset resampler state, with the filter history primed by the last of inFrameCount
+     * frames of in rather than by silence, so that the next input is resampled as the
+     * continuation of in without a transient. The frames of in are not output again:
+     * they are those already output by other means, for example while the resampler was
+     * bypassed at equal rates. Only the last frames needed by the filter are used.
+     * Does not allocate.
+     * \return 0 on success, -EINVAL if in is NULL and inFrameCount is not 0.
+     */
+    int (*reset_with_history)(struct resampler_itfe *resampler,
+                    const int16_t *in,
+                    size_t inFrameCount);
+    /**
+     * as reset_with_history(), with float input.
+     */
+    int (*reset_with_history_float)(struct resampler_itfe *resampler,
+                    const float *in,
+                    size_t inFrameCount);
 };
 
 /**
  * create a resampler according to input parameters passed.
  * If resampler_buffer_provider is not NULL only resample_from_provider() can be called.
  * If resampler_buffer_provider is NULL only resample_from_input() can be called.
+ * The provider returns int16 buffers.
+ * The filter tables are shared by all the resamplers of the process with the same
+ * conversion ratio and quality, and freed with the last of them.
  */
 int create_resampler(uint32_t inSampleRate,
           uint32_t outSampleRate,
@@ -99,6 +160,22 @@ int create_resampler(uint32_t inSampleRate,
           struct resampler_buffer_provider *provider,
           struct resampler_itfe **);
 
+/**
+ * as create_resampler(), with the provider returning buffers in format, which is either
+ * AUDIO_FORMAT_PCM_16_BIT or AUDIO_FORMAT_PCM_FLOAT.
+ * Either format may be output, by the int16 or the float methods of the interface.
+ * Resampling is done in float internally, so float input and output avoid int16 quantization.
+ * flags is 0 or RESAMPLER_FLAG_VARIABLE_RATIO.
+ */
+int create_resampler_with_format(uint32_t inSampleRate,
+          uint32_t outSampleRate,
+          uint32_t channelCount,
+          uint32_t quality,
+          audio_format_t format,
+          uint32_t flags,
+          struct resampler_buffer_provider *provider,
+          struct resampler_itfe **);
+
 /**
  * release resampler resources.
  */
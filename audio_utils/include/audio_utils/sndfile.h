@@ -23,6 +23,7 @@
 // The API should be familiar to clients of similar libraries, but there is
 // no guarantee that it will stay exactly source-code compatible with other libraries.
 
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/cdefs.h>
 #include <system/audio-base.h>
@@ -41,12 +42,28 @@ typedef struct {
     int format;
 } SF_INFO;
 
+// As sf_count_t and SF_INFO, for RF64 and BW64 files which may have more than 2^31 frames
+typedef int64_t sf_count64_t;
+
+typedef struct {
+    sf_count64_t frames;
+    int samplerate;
+    int channels;
+    int format;
+} SF_INFO64;
+
 // opaque to clients
 typedef struct SNDFILE_ SNDFILE;
 
 // Access modes
 #define SFM_READ    1
 #define SFM_WRITE   2
+// As SFM_READ, but sf_readf_*() convert directly out of a read-only memory mapping of the
+// file rather than copying through stdio.  Falls back to stdio if the file cannot be mapped.
+#define SFM_READ_MMAP 4
+// As SFM_WRITE, but bypasses the page cache with O_DIRECT where the file system supports it.
+// Suited to long captures, which would otherwise evict more useful pages.
+#define SFM_WRITE_DIRECT 8
 
 // Format
 #define SF_FORMAT_TYPEMASK  1
@@ -58,9 +75,23 @@ typedef struct SNDFILE_ SNDFILE;
 #define SF_FORMAT_PCM_32    8
 #define SF_FORMAT_PCM_24    10
 
-/** Open stream */
+/**
+ * Open stream
+ *
+ * Reading accepts RIFF files of up to 32 channels, and reports at most INT_MAX frames.
+ * Writing produces RIFF, whose sizes sf_close() limits to 4 GiB.  More than 2 channels are
+ * written as WAVE_FORMAT_EXTENSIBLE.
+ */
 SNDFILE *sf_open(const char *path, int mode, SF_INFO *info);
 
+/**
+ * Open stream, as sf_open() but with 64-bit frame counts.
+ *
+ * Reading also accepts RF64 and BW64 files.  Writing reserves space so that sf_close() can
+ * upgrade the file to RF64 once the data exceeds 4 GiB.
+ */
+SNDFILE *sf_open64(const char *path, int mode, SF_INFO64 *info);
+
 /** Close stream */
 void sf_close(SNDFILE *handle);
 
@@ -73,13 +104,37 @@ sf_count_t sf_readf_float(SNDFILE *handle, float *ptr, sf_count_t desired);
 sf_count_t sf_readf_int(SNDFILE *handle, int *ptr, sf_count_t desired);
 
 /**
- * Write interleaved frames
+ * Read interleaved frames, as sf_readf_*() but with 64-bit frame counts
+ * \return actual number of frames read
+ */
+sf_count64_t sf_readf_short64(SNDFILE *handle, int16_t *ptr, sf_count64_t desired);
+sf_count64_t sf_readf_float64(SNDFILE *handle, float *ptr, sf_count64_t desired);
+sf_count64_t sf_readf_int64(SNDFILE *handle, int *ptr, sf_count64_t desired);
+
+/**
+ * Write interleaved frames, converting to any of the formats of the stream.
+ * Frames are buffered, and written out in large blocks and by sf_close().
  * \return actual number of frames written
  */
 sf_count_t sf_writef_short(SNDFILE *handle, const int16_t *ptr, sf_count_t desired);
 sf_count_t sf_writef_float(SNDFILE *handle, const float *ptr, sf_count_t desired);
 sf_count_t sf_writef_int(SNDFILE *handle, const int *ptr, sf_count_t desired);
 
+/**
+ * Get the WAVE_FORMAT_EXTENSIBLE dwChannelMask of speaker positions, which match the
+ * AUDIO_CHANNEL_OUT_* position bits.
+ * \return the channel mask, or 0 if the channels are unassigned or the format is not extensible
+ */
+uint32_t sf_get_channel_mask(SNDFILE *handle);
+
+/**
+ * Set the WAVE_FORMAT_EXTENSIBLE dwChannelMask of a stream open for writing with more than
+ * 2 channels, at any time before sf_close().  The default is the position mask of
+ * audio_channel_out_mask_from_count(), or 0 for unassigned channels.
+ * \return 0 on success, or -EINVAL if the stream is not open for writing or not extensible
+ */
+int sf_set_channel_mask(SNDFILE *handle, uint32_t channelMask);
+
 /**
  * Map SF_FORMAT to PCM format
  */
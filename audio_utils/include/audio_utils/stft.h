@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_STFT_H
+#define ANDROID_AUDIO_STFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+/** \cond */
+__BEGIN_DECLS
+/** \endcond */
+
+/**
+ * Called once per channel for each frame of the analysis.
+ *
+ * \param cookie      as given to create_stft().
+ * \param channel     channel index of the frame, from 0 to the channel count - 1.
+ * \param spectrum    transform of the windowed frame, packed as by fft_real_forward() in
+ *                    frame_size floats. It may be modified in place; the modified spectrum
+ *                    is what is resynthesized.
+ * \param frame_size  number of points of the frame.
+ */
+typedef void (*stft_callback_t)(void *cookie, uint32_t channel, float *spectrum,
+        size_t frame_size);
+
+/**
+ * A streaming short-time Fourier transform with overlap-add resynthesis.
+ *
+ * Input of any number of frames is collected into frames of frame_size samples every
+ * hop_size samples. Each frame is weighted by the analysis window, transformed and passed to
+ * the callback; then the spectrum is transformed back, weighted by the synthesis window and
+ * added to the output. Both windows are the square root of a periodic Hann window, so an
+ * unmodified spectrum gives back the input, delayed by frame_size frames.
+ *
+ * All buffers are allocated by create_stft(): stft_process() does not allocate.
+ */
+struct stft;
+
+/**
+ * Creates a short-time Fourier transform.
+ *
+ * \param frame_size     number of samples per frame, a power of 2 from FFT_SIZE_MIN to
+ *                       FFT_SIZE_MAX.
+ * \param hop_size       number of samples between the starts of two frames, dividing
+ *                       frame_size and at most frame_size / 2.
+ * \param channel_count  number of interleaved channels, each transformed independently.
+ * \param callback       called for each frame and channel.
+ * \param cookie         passed to the callback.
+ * \param stft           set to the new transform on success.
+ * \return 0 on success, -EINVAL for unsupported parameters, -ENOMEM if out of memory.
+ */
+int create_stft(size_t frame_size, size_t hop_size, uint32_t channel_count,
+        stft_callback_t callback, void *cookie, struct stft **stft);
+
+/** Releases a transform created by create_stft(). */
+void release_stft(struct stft *stft);
+
+/**
+ * Processes frame_count interleaved frames of input and writes as many frames of output.
+ * The callback is called from within this function, once per channel for each hop_size
+ * frames of input.
+ *
+ * \param in           frame_count frames of input.
+ * \param out          frame_count frames of output, which is the input delayed by
+ *                     stft_latency() and modified by the callback. May be the same buffer as
+ *                     in. If NULL, only the analysis is done, saving the inverse transforms;
+ *                     out should then be NULL for every call until stft_reset().
+ */
+void stft_process(struct stft *stft, const float *in, float *out, size_t frame_count);
+
+/** Returns the delay in frames of the output relative to the input, which is frame_size. */
+size_t stft_latency(const struct stft *stft);
+
+/** Clears the history of input and output, as for a new stream. */
+void stft_reset(struct stft *stft);
+
+/** \cond */
+__END_DECLS
+/** \endcond */
+
+#endif  // ANDROID_AUDIO_STFT_H
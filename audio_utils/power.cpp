@@ -20,13 +20,19 @@
 
 #include <algorithm>
 #include <math.h>
+#include <string.h>
 
 #include <audio_utils/power.h>
 #include <audio_utils/primitives.h>
+#include "private/private.h"
+#include "private/x86_simd.h"
 
 #if defined(__aarch64__) || defined(__ARM_NEON__)
 #include <arm_neon.h>
 #define USE_NEON
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
 #endif
 
 namespace {
@@ -130,112 +136,378 @@ inline float energyMonoRef(const void *amplitudes, size_t size)
 }
 
 template <audio_format_t FORMAT>
-inline float energyMono(const void *amplitudes, size_t size)
+constexpr inline size_t sampleSize()
 {
-    return energyMonoRef<FORMAT>(amplitudes, size);
+    switch (FORMAT) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        return sizeof(uint8_t);
+
+    case AUDIO_FORMAT_PCM_16_BIT:
+        return sizeof(int16_t);
+
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        return 3;
+
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+    case AUDIO_FORMAT_PCM_32_BIT:
+        return sizeof(int32_t);
+
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return sizeof(float);
+
+    default:
+        static_assert(isFormatSupported(FORMAT), "unsupported format");
+    }
+}
+
+// Sign extended Q8.23 value of a packed 24 bit sample, read without alignment requirements.
+inline int32_t q8_23FromP24(const uint8_t *packed24)
+{
+    return i32_from_p24(packed24) >> 8;
 }
 
-// fast float power computation for ARM processors that support NEON.
+// The vector kernels below share this shape: a lane-wise sum of squares of the raw
+// (not yet normalized) amplitudes over the largest multiple of the vector length,
+// then normalization, then energyMonoRef() on the trailing samples. Loads are unaligned
+// and never read past the last sample.
+
+// fast power computation for ARM processors that support NEON.
 #ifdef USE_NEON
 
-template <typename T>
-float32x4_t convertToFloatVectorAmplitude(T vamplitude) = delete;
+template <audio_format_t FORMAT>
+float32x4_t loadAmplitudesNeon(const uint8_t *samples) = delete;
 
 template <>
-float32x4_t convertToFloatVectorAmplitude<float32x4_t>(float32x4_t vamplitude) {
-    return vamplitude;
+inline float32x4_t loadAmplitudesNeon<AUDIO_FORMAT_PCM_FLOAT>(const uint8_t *samples) {
+    return vld1q_f32(reinterpret_cast<const float *>(samples));
 }
 
 template <>
-float32x4_t convertToFloatVectorAmplitude<int16x4_t>(int16x4_t vamplitude) {
-    const int32x4_t iamplitude = vmovl_s16(vamplitude); // expand s16 to s32 first
-    return vcvtq_f32_s32(iamplitude);
+inline float32x4_t loadAmplitudesNeon<AUDIO_FORMAT_PCM_16_BIT>(const uint8_t *samples) {
+    // expand s16 to s32 first
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(reinterpret_cast<const int16_t *>(samples))));
 }
 
 template <>
-float32x4_t convertToFloatVectorAmplitude<int32x4_t>(int32x4_t vamplitude) {
-    return vcvtq_f32_s32(vamplitude);
+inline float32x4_t loadAmplitudesNeon<AUDIO_FORMAT_PCM_32_BIT>(const uint8_t *samples) {
+    return vcvtq_f32_s32(vld1q_s32(reinterpret_cast<const int32_t *>(samples)));
 }
 
-template <typename Vector, typename Scalar>
-inline float energyMonoVector(const void *amplitudes, size_t size)
-{
-    static_assert(sizeof(Vector) % sizeof(Scalar) == 0,
-             "Vector size must be a multiple of scalar size");
-    const size_t vectorLength = sizeof(Vector) / sizeof(Scalar); // typically 4 (a const)
-
-    // check pointer validity, must be aligned with scalar type.
-    const Scalar *samplitudes = reinterpret_cast<const Scalar *>(amplitudes);
-    LOG_ALWAYS_FATAL_IF((uintptr_t)samplitudes % alignof(Scalar) != 0,
-            "Non-element aligned address: %p %zu", samplitudes, alignof(Scalar));
-
-    float accumulator = 0;
-
-    // handle pointer unaligned to vector type.
-    while ((uintptr_t)samplitudes % alignof(Vector) != 0 /* compiler optimized */ && size > 0) {
-        const float amp = (float)*samplitudes++;
-        accumulator += amp * amp;
-        --size;
-    }
+template <>
+inline float32x4_t loadAmplitudesNeon<AUDIO_FORMAT_PCM_8_24_BIT>(const uint8_t *samples) {
+    return loadAmplitudesNeon<AUDIO_FORMAT_PCM_32_BIT>(samples);
+}
 
-    // samplitudes is now adjusted for proper vector alignment, cast to Vector *
-    const Vector *vamplitudes = reinterpret_cast<const Vector *>(samplitudes);
+template <>
+inline float32x4_t loadAmplitudesNeon<AUDIO_FORMAT_PCM_8_BIT>(const uint8_t *samples) {
+    uint32_t packed;
+    memcpy(&packed, samples, sizeof(packed));
+    const uint16x4_t u16 = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed))));
+    const int32x4_t s32 = vreinterpretq_s32_u32(vmovl_u16(u16));
+    return vcvtq_f32_s32(vsubq_s32(s32, vdupq_n_s32(0x80)));
+}
 
-    // clear vector accumulator
-    float32x4_t accum = vdupq_n_f32(0);
+template <>
+inline float32x4_t loadAmplitudesNeon<AUDIO_FORMAT_PCM_24_BIT_PACKED>(const uint8_t *samples) {
+    const int32_t q8_23[4] = {
+        q8_23FromP24(samples), q8_23FromP24(samples + 3),
+        q8_23FromP24(samples + 6), q8_23FromP24(samples + 9),
+    };
+    return vcvtq_f32_s32(vld1q_s32(q8_23));
+}
 
-    // iterate over array getting sum of squares in vectorLength lanes.
-    size_t i;
-    for (i = 0; i < size - size % vectorLength /* compiler optimized */; i += vectorLength) {
-        const float32x4_t famplitude = convertToFloatVectorAmplitude(*vamplitudes++);
-        accum = vmlaq_f32(accum, famplitude, famplitude);
+template <audio_format_t FORMAT>
+inline float energyMonoNeon(const void *amplitudes, size_t size)
+{
+    constexpr size_t vectorLength = 4;
+    const uint8_t *samples = reinterpret_cast<const uint8_t *>(amplitudes);
+    const size_t vectorSize = size - size % vectorLength;
+
+    float32x4_t accum = vdupq_n_f32(0);
+    for (size_t i = 0; i < vectorSize; i += vectorLength) {
+        const float32x4_t amplitude =
+                loadAmplitudesNeon<FORMAT>(samples + i * sampleSize<FORMAT>());
+        accum = vmlaq_f32(accum, amplitude, amplitude);
     }
 
     // narrow vectorLength lanes of floats
     float32x2_t accum2 = vadd_f32(vget_low_f32(accum), vget_high_f32(accum)); // get stereo volume
     accum2 = vpadd_f32(accum2, accum2); // combine to mono
 
-    // accumulate vector
-    accumulator += vget_lane_f32(accum2, 0);
+    return vget_lane_f32(accum2, 0) * normalizeEnergy<FORMAT>()
+            + energyMonoRef<FORMAT>(samples + vectorSize * sampleSize<FORMAT>(),
+                    size - vectorSize);
+}
 
-    // accumulate any trailing elements too small for vector size
-    for (; i < size; ++i) {
-        const float amp = (float)samplitudes[i];
-        accumulator += amp * amp;
-    }
-    return accumulator;
+#endif // USE_NEON
+
+// fast power computation for x86 processors, SSE2 is the x86-64 baseline,
+// AVX2 is selected at runtime.
+#ifdef USE_SSE
+
+template <audio_format_t FORMAT>
+__m128 loadAmplitudesSse(const uint8_t *samples) = delete;
+
+template <>
+inline __m128 loadAmplitudesSse<AUDIO_FORMAT_PCM_FLOAT>(const uint8_t *samples) {
+    return _mm_loadu_ps(reinterpret_cast<const float *>(samples));
 }
 
 template <>
-inline float energyMono<AUDIO_FORMAT_PCM_FLOAT>(const void *amplitudes, size_t size)
-{
-    return energyMonoVector<float32x4_t, float>(amplitudes, size);
+inline __m128 loadAmplitudesSse<AUDIO_FORMAT_PCM_16_BIT>(const uint8_t *samples) {
+    const __m128i s16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(samples));
+    // sign extend s16 to s32 by duplicating into the high half and shifting down
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16));
 }
 
 template <>
-inline float energyMono<AUDIO_FORMAT_PCM_16_BIT>(const void *amplitudes, size_t size)
-{
-    return energyMonoVector<int16x4_t, int16_t>(amplitudes, size)
-            * normalizeEnergy<AUDIO_FORMAT_PCM_16_BIT>();
+inline __m128 loadAmplitudesSse<AUDIO_FORMAT_PCM_32_BIT>(const uint8_t *samples) {
+    return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples)));
 }
 
-// fast int32_t power computation for PCM_32
 template <>
-inline float energyMono<AUDIO_FORMAT_PCM_32_BIT>(const void *amplitudes, size_t size)
+inline __m128 loadAmplitudesSse<AUDIO_FORMAT_PCM_8_24_BIT>(const uint8_t *samples) {
+    return loadAmplitudesSse<AUDIO_FORMAT_PCM_32_BIT>(samples);
+}
+
+template <>
+inline __m128 loadAmplitudesSse<AUDIO_FORMAT_PCM_8_BIT>(const uint8_t *samples) {
+    int32_t packed;
+    memcpy(&packed, samples, sizeof(packed));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i u32 = _mm_unpacklo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    return _mm_cvtepi32_ps(_mm_sub_epi32(u32, _mm_set1_epi32(0x80)));
+}
+
+template <>
+inline __m128 loadAmplitudesSse<AUDIO_FORMAT_PCM_24_BIT_PACKED>(const uint8_t *samples) {
+    // SSE2 has no byte shuffle, gather the samples as scalars.
+    return _mm_cvtepi32_ps(_mm_setr_epi32(
+            q8_23FromP24(samples), q8_23FromP24(samples + 3),
+            q8_23FromP24(samples + 6), q8_23FromP24(samples + 9)));
+}
+
+inline float horizontalSumSse(__m128 accum)
 {
-    return energyMonoVector<int32x4_t, int32_t>(amplitudes, size)
-            * normalizeEnergy<AUDIO_FORMAT_PCM_32_BIT>();
+    const __m128 sum2 = _mm_add_ps(accum, _mm_movehl_ps(accum, accum));
+    return _mm_cvtss_f32(_mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1)));
+}
+
+template <audio_format_t FORMAT>
+inline float energyMonoSse(const void *amplitudes, size_t size)
+{
+    constexpr size_t vectorLength = 4;
+    const uint8_t *samples = reinterpret_cast<const uint8_t *>(amplitudes);
+    const size_t vectorSize = size - size % vectorLength;
+
+    __m128 accum = _mm_setzero_ps();
+    for (size_t i = 0; i < vectorSize; i += vectorLength) {
+        const __m128 amplitude = loadAmplitudesSse<FORMAT>(samples + i * sampleSize<FORMAT>());
+        accum = _mm_add_ps(accum, _mm_mul_ps(amplitude, amplitude));
+    }
+    return horizontalSumSse(accum) * normalizeEnergy<FORMAT>()
+            + energyMonoRef<FORMAT>(samples + vectorSize * sampleSize<FORMAT>(),
+                    size - vectorSize);
+}
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+template <audio_format_t FORMAT>
+__m256 loadAmplitudesAvx2(const uint8_t *samples) = delete;
+
+template <>
+inline TARGET_AVX2 __m256 loadAmplitudesAvx2<AUDIO_FORMAT_PCM_FLOAT>(const uint8_t *samples) {
+    return _mm256_loadu_ps(reinterpret_cast<const float *>(samples));
+}
+
+template <>
+inline TARGET_AVX2 __m256 loadAmplitudesAvx2<AUDIO_FORMAT_PCM_16_BIT>(const uint8_t *samples) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples))));
+}
+
+template <>
+inline TARGET_AVX2 __m256 loadAmplitudesAvx2<AUDIO_FORMAT_PCM_32_BIT>(const uint8_t *samples) {
+    return _mm256_cvtepi32_ps(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples)));
 }
 
-// fast int32_t power computation for PCM_8_24 (essentially identical to PCM_32 above)
 template <>
-inline float energyMono<AUDIO_FORMAT_PCM_8_24_BIT>(const void *amplitudes, size_t size)
+inline TARGET_AVX2 __m256 loadAmplitudesAvx2<AUDIO_FORMAT_PCM_8_24_BIT>(const uint8_t *samples) {
+    return loadAmplitudesAvx2<AUDIO_FORMAT_PCM_32_BIT>(samples);
+}
+
+template <>
+inline TARGET_AVX2 __m256 loadAmplitudesAvx2<AUDIO_FORMAT_PCM_8_BIT>(const uint8_t *samples) {
+    const __m256i u32 = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(samples)));
+    return _mm256_cvtepi32_ps(_mm256_sub_epi32(u32, _mm256_set1_epi32(0x80)));
+}
+
+template <>
+inline TARGET_AVX2 __m256 loadAmplitudesAvx2<AUDIO_FORMAT_PCM_24_BIT_PACKED>(
+        const uint8_t *samples) {
+    // 24 bytes hold 8 samples, load them as 16 + 8 bytes to avoid reading past the end.
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+    const __m128i hi = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(samples + 16));
+    // samples 4..7 start at byte 12, move them to the start of the upper lane.
+    const __m256i packed = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(lo), _mm_alignr_epi8(hi, lo, 12), 1);
+    // place each sample in the upper 3 bytes of its lane, then sign extend.
+    const __m256i q0_31 = _mm256_shuffle_epi8(packed, _mm256_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+    return _mm256_cvtepi32_ps(_mm256_srai_epi32(q0_31, 8));
+}
+
+template <audio_format_t FORMAT>
+TARGET_AVX2 float energyMonoAvx2(const void *amplitudes, size_t size)
 {
-    return energyMonoVector<int32x4_t, int32_t>(amplitudes, size)
-            * normalizeEnergy<AUDIO_FORMAT_PCM_8_24_BIT>();
+    constexpr size_t vectorLength = 8;
+    const uint8_t *samples = reinterpret_cast<const uint8_t *>(amplitudes);
+    const size_t vectorSize = size - size % vectorLength;
+
+    __m256 accum = _mm256_setzero_ps();
+    for (size_t i = 0; i < vectorSize; i += vectorLength) {
+        const __m256 amplitude = loadAmplitudesAvx2<FORMAT>(samples + i * sampleSize<FORMAT>());
+        accum = _mm256_add_ps(accum, _mm256_mul_ps(amplitude, amplitude));
+    }
+    const __m128 accum4 = _mm_add_ps(
+            _mm256_castps256_ps128(accum), _mm256_extractf128_ps(accum, 1));
+    return horizontalSumSse(accum4) * normalizeEnergy<FORMAT>()
+            + energyMonoRef<FORMAT>(samples + vectorSize * sampleSize<FORMAT>(),
+                    size - vectorSize);
 }
 
-#endif // USE_NEON
+#endif // USE_SSE
+
+// Per channel energy and peak of interleaved samples, one pass over the buffer.
+// The results are accumulated into energy[] and peak[], which the caller initializes.
+template <audio_format_t FORMAT>
+inline void energyMultichannelRef(const void *amplitudes, size_t channelCount, size_t frames,
+        float *energy, float *peak)
+{
+    for (size_t i = 0; i < frames; ++i) {
+        for (size_t ch = 0; ch < channelCount; ++ch) {
+            const float amplitude = convertToFloatAndIncrement<FORMAT>(&amplitudes);
+            energy[ch] += amplitude * amplitude;
+            peak[ch] = std::max(peak[ch], fabsf(amplitude));
+        }
+    }
+}
+
+#if defined(USE_NEON) || defined(USE_SSE)
+
+// 4 lane vector operations for energyMultichannelVector().
+#ifdef USE_NEON
+struct VectorOps {
+    using Vector = float32x4_t;
+    static constexpr size_t kLength = 4;
+    template <audio_format_t FORMAT>
+    static Vector load(const uint8_t *samples) { return loadAmplitudesNeon<FORMAT>(samples); }
+    static Vector zero() { return vdupq_n_f32(0); }
+    static Vector mulAdd(Vector a, Vector b, Vector c) { return vmlaq_f32(a, b, c); }
+    static Vector maxAbs(Vector a, Vector b) { return vmaxq_f32(a, vabsq_f32(b)); }
+    static void store(float *dst, Vector v) { vst1q_f32(dst, v); }
+};
+#else
+struct VectorOps {
+    using Vector = __m128;
+    static constexpr size_t kLength = 4;
+    template <audio_format_t FORMAT>
+    static Vector load(const uint8_t *samples) { return loadAmplitudesSse<FORMAT>(samples); }
+    static Vector zero() { return _mm_setzero_ps(); }
+    static Vector mulAdd(Vector a, Vector b, Vector c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+    static Vector maxAbs(Vector a, Vector b) {
+        return _mm_max_ps(a, _mm_andnot_ps(_mm_set1_ps(-0.f), b));
+    }
+    static void store(float *dst, Vector v) { _mm_storeu_ps(dst, v); }
+};
+#endif
+
+template <audio_format_t FORMAT>
+inline void energyMultichannelVector(const void *amplitudes, size_t channelCount,
+        size_t frames, float *energy, float *peak)
+{
+    using Vector = VectorOps::Vector;
+    constexpr size_t vectorLength = VectorOps::kLength;
+
+    // A block of channelCount vectors holds vectorLength frames, so the m-th vector of
+    // every block carries the same channels: lane j is channel (m * vectorLength + j)
+    // modulo channelCount. Each vector position gets its own accumulators and the lanes
+    // are folded into channels once at the end.
+    Vector accum[AUDIO_CHANNEL_COUNT_MAX];
+    Vector peaks[AUDIO_CHANNEL_COUNT_MAX];
+    for (size_t m = 0; m < channelCount; ++m) {
+        accum[m] = VectorOps::zero();
+        peaks[m] = VectorOps::zero();
+    }
+    const uint8_t *samples = reinterpret_cast<const uint8_t *>(amplitudes);
+    const size_t blocks = frames / vectorLength;
+    for (size_t i = 0; i < blocks; ++i) {
+        for (size_t m = 0; m < channelCount; ++m) {
+            const Vector amplitude = VectorOps::template load<FORMAT>(samples);
+            samples += vectorLength * sampleSize<FORMAT>();
+            accum[m] = VectorOps::mulAdd(accum[m], amplitude, amplitude);
+            peaks[m] = VectorOps::maxAbs(peaks[m], amplitude);
+        }
+    }
+
+    float laneEnergy[vectorLength];
+    float lanePeak[vectorLength];
+    for (size_t m = 0; m < channelCount; ++m) {
+        VectorOps::store(laneEnergy, accum[m]);
+        VectorOps::store(lanePeak, peaks[m]);
+        for (size_t j = 0; j < vectorLength; ++j) {
+            const size_t ch = (m * vectorLength + j) % channelCount;
+            energy[ch] += laneEnergy[j] * normalizeEnergy<FORMAT>();
+            peak[ch] = std::max(peak[ch], lanePeak[j] * normalizeAmplitude<FORMAT>());
+        }
+    }
+
+    energyMultichannelRef<FORMAT>(samples, channelCount, frames - blocks * vectorLength,
+            energy, peak);
+}
+
+#endif // USE_NEON || USE_SSE
+
+template <audio_format_t FORMAT>
+inline void energyMultichannel(const void *amplitudes, size_t channelCount, size_t frames,
+        float *energy, float *peak)
+{
+#if defined(USE_SSE)
+    if (audio_utils_get_x86_simd_level_cap() == AUDIO_UTILS_X86_SIMD_NONE) {
+        energyMultichannelRef<FORMAT>(amplitudes, channelCount, frames, energy, peak);
+        return;
+    }
+#endif
+#if defined(USE_NEON) || defined(USE_SSE)
+    energyMultichannelVector<FORMAT>(amplitudes, channelCount, frames, energy, peak);
+#else
+    energyMultichannelRef<FORMAT>(amplitudes, channelCount, frames, energy, peak);
+#endif
+}
+
+template <audio_format_t FORMAT>
+inline float energyMono(const void *amplitudes, size_t size)
+{
+#if defined(USE_NEON)
+    return energyMonoNeon<FORMAT>(amplitudes, size);
+#elif defined(USE_SSE)
+    // __builtin_cpu_supports() only reads the cpu model initialized at load time.
+    const audio_utils_x86_simd_level_t cap = audio_utils_get_x86_simd_level_cap();
+    if (cap >= AUDIO_UTILS_X86_SIMD_AVX2 && __builtin_cpu_supports("avx2")) {
+        return energyMonoAvx2<FORMAT>(amplitudes, size);
+    }
+    if (cap >= AUDIO_UTILS_X86_SIMD_SSE) {
+        return energyMonoSse<FORMAT>(amplitudes, size);
+    }
+    return energyMonoRef<FORMAT>(amplitudes, size);
+#else
+    return energyMonoRef<FORMAT>(amplitudes, size);
+#endif
+}
 
 } // namespace
 
@@ -265,6 +537,53 @@ float audio_utils_compute_energy_mono(const void *buffer, audio_format_t format,
     }
 }
 
+void audio_utils_compute_energy_multichannel(const void *buffer, audio_format_t format,
+        size_t channelCount, size_t frames, float *energyPerChannel, float *peakPerChannel)
+{
+    LOG_ALWAYS_FATAL_IF(channelCount == 0 || channelCount > AUDIO_CHANNEL_COUNT_MAX,
+            "invalid channelCount: %zu", channelCount);
+    float energy[AUDIO_CHANNEL_COUNT_MAX] = {};
+    float peak[AUDIO_CHANNEL_COUNT_MAX] = {};
+
+    switch (format) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        energyMultichannel<AUDIO_FORMAT_PCM_8_BIT>(buffer, channelCount, frames, energy, peak);
+        break;
+
+    case AUDIO_FORMAT_PCM_16_BIT:
+        energyMultichannel<AUDIO_FORMAT_PCM_16_BIT>(buffer, channelCount, frames, energy, peak);
+        break;
+
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        energyMultichannel<AUDIO_FORMAT_PCM_24_BIT_PACKED>(
+                buffer, channelCount, frames, energy, peak);
+        break;
+
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        energyMultichannel<AUDIO_FORMAT_PCM_8_24_BIT>(
+                buffer, channelCount, frames, energy, peak);
+        break;
+
+    case AUDIO_FORMAT_PCM_32_BIT:
+        energyMultichannel<AUDIO_FORMAT_PCM_32_BIT>(buffer, channelCount, frames, energy, peak);
+        break;
+
+    case AUDIO_FORMAT_PCM_FLOAT:
+        energyMultichannel<AUDIO_FORMAT_PCM_FLOAT>(buffer, channelCount, frames, energy, peak);
+        break;
+
+    default:
+        LOG_ALWAYS_FATAL("invalid format: %#x", format);
+    }
+
+    if (energyPerChannel != nullptr) {
+        std::copy(energy, energy + channelCount, energyPerChannel);
+    }
+    if (peakPerChannel != nullptr) {
+        std::copy(peak, peak + channelCount, peakPerChannel);
+    }
+}
+
 float audio_utils_compute_power_mono(const void *buffer, audio_format_t format, size_t samples)
 {
     return audio_utils_power_from_energy(
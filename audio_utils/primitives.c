@@ -14,9 +14,437 @@
  * limitations under the License.
  */
 
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
 #include <cutils/bitops.h>  /* for popcount() */
 #include <audio_utils/primitives.h>
 #include "private/private.h"
+#include "private/x86_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define USE_X86_SIMD
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define USE_AARCH64_SIMD
+#endif
+
+static audio_utils_x86_simd_level_t x86_simd_level_cap = AUDIO_UTILS_X86_SIMD_AVX2;
+
+audio_utils_x86_simd_level_t audio_utils_get_x86_simd_level_cap(void)
+{
+    return x86_simd_level_cap;
+}
+
+int audio_utils_set_x86_simd_level_for_test(audio_utils_x86_simd_level_t level)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    const audio_utils_x86_simd_level_t previous = x86_simd_level_cap;
+    x86_simd_level_cap = level;
+    return previous;
+#else
+    (void)level;
+    return -ENOSYS;
+#endif
+}
+
+#ifdef USE_X86_SIMD
+
+/*
+ * x86 SSE4.1 / AVX2 conversion kernels.
+ *
+ * The host x86-64 baseline is only SSE2, so the kernels are compiled with per-function
+ * target attributes and selected at runtime by x86_simd_level().  Each kernel handles
+ * a multiple of X86_SIMD_BLOCK samples; the public function finishes the remainder with
+ * the scalar loop.  All kernels are bit-exact with the scalar inline conversions in
+ * primitives.h, including the round half away from zero of roundf().
+ *
+ * Kernels which expand the sample size run from the end of the buffer toward the start,
+ * and kernels which contract the sample size run from the start toward the end, so that
+ * the in-place (dst == src) conversions documented in primitives.h still work.
+ */
+
+#define X86_SIMD_BLOCK 8
+#define X86_TARGET_SSE4_1 __attribute__((target("sse4.1")))
+#define X86_TARGET_AVX2 __attribute__((target("avx2")))
+
+typedef enum {
+    X86_SIMD_NONE,
+    X86_SIMD_SSE4_1,
+    X86_SIMD_AVX2,
+} x86_simd_level_t;
+
+_Static_assert((int)X86_SIMD_SSE4_1 == (int)AUDIO_UTILS_X86_SIMD_SSE
+        && (int)X86_SIMD_AVX2 == (int)AUDIO_UTILS_X86_SIMD_AVX2,
+        "x86_simd_level_t is capped by an audio_utils_x86_simd_level_t");
+
+static inline x86_simd_level_t x86_simd_level(void)
+{
+    /* __builtin_cpu_supports() reads the cpu model which is initialized at load time. */
+    x86_simd_level_t level = X86_SIMD_NONE;
+    if (__builtin_cpu_supports("avx2")) {
+        level = X86_SIMD_AVX2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        level = X86_SIMD_SSE4_1;
+    }
+    const x86_simd_level_t cap = (x86_simd_level_t)x86_simd_level_cap;
+    return level < cap ? level : cap;
+}
+
+/* Returns the number of samples to hand to a vector kernel, zero if there is no kernel. */
+static inline size_t x86_simd_count(x86_simd_level_t level, size_t count)
+{
+    return level == X86_SIMD_NONE ? 0 : count & ~(size_t)(X86_SIMD_BLOCK - 1);
+}
+
+/* roundf() per lane: round to nearest, ties away from zero. */
+static inline X86_TARGET_SSE4_1 __m128 x86_roundf_ps(__m128 x)
+{
+    const __m128 signmask = _mm_set1_ps(-0.f);
+    const __m128 trunc = _mm_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m128 frac = _mm_andnot_ps(signmask, _mm_sub_ps(x, trunc));
+    const __m128 one = _mm_or_ps(_mm_set1_ps(1.f), _mm_and_ps(signmask, x));
+    return _mm_add_ps(trunc, _mm_and_ps(_mm_cmpge_ps(frac, _mm_set1_ps(0.5f)), one));
+}
+
+static inline X86_TARGET_AVX2 __m256 x86_roundf_ps_avx2(__m256 x)
+{
+    const __m256 signmask = _mm256_set1_ps(-0.f);
+    const __m256 trunc = _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256 frac = _mm256_andnot_ps(signmask, _mm256_sub_ps(x, trunc));
+    const __m256 one = _mm256_or_ps(_mm256_set1_ps(1.f), _mm256_and_ps(signmask, x));
+    return _mm256_add_ps(trunc,
+            _mm256_and_ps(_mm256_cmp_ps(frac, _mm256_set1_ps(0.5f), _CMP_GE_OQ), one));
+}
+
+/*
+ * roundf(fmaxf(fminf(f * scale, scale - 1.f), -scale)) per lane, as in clamp16_from_float()
+ * and clamp24_from_float().  MINPS returns the second operand for NaN, matching fminf().
+ */
+static inline X86_TARGET_SSE4_1 __m128i x86_clamp_from_float(__m128 f, float scale)
+{
+    const __m128 x = _mm_max_ps(_mm_min_ps(_mm_mul_ps(f, _mm_set1_ps(scale)),
+            _mm_set1_ps(scale - 1.f)), _mm_set1_ps(-scale));
+    return _mm_cvttps_epi32(x86_roundf_ps(x));
+}
+
+static inline X86_TARGET_AVX2 __m256i x86_clamp_from_float_avx2(__m256 f, float scale)
+{
+    const __m256 x = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(f, _mm256_set1_ps(scale)),
+            _mm256_set1_ps(scale - 1.f)), _mm256_set1_ps(-scale));
+    return _mm256_cvttps_epi32(x86_roundf_ps_avx2(x));
+}
+
+/*
+ * Rounded f * scale per lane, as in clamp32_from_float() and clampq4_27_from_float().
+ * Values at or below -limit convert to the 0x80000000 "integer indefinite" which is also
+ * the clamped negative value; values at or above limit are flipped to 0x7fffffff.
+ */
+static inline X86_TARGET_SSE4_1 __m128i x86_clamp32_from_float(__m128 f, float scale, float limit)
+{
+    const __m128i ival = _mm_cvttps_epi32(x86_roundf_ps(_mm_mul_ps(f, _mm_set1_ps(scale))));
+    return _mm_xor_si128(ival, _mm_castps_si128(_mm_cmpge_ps(f, _mm_set1_ps(limit))));
+}
+
+static inline X86_TARGET_AVX2 __m256i x86_clamp32_from_float_avx2(
+        __m256 f, float scale, float limit)
+{
+    const __m256i ival =
+            _mm256_cvttps_epi32(x86_roundf_ps_avx2(_mm256_mul_ps(f, _mm256_set1_ps(scale))));
+    return _mm256_xor_si256(ival,
+            _mm256_castps_si256(_mm256_cmp_ps(f, _mm256_set1_ps(limit), _CMP_GE_OQ)));
+}
+
+/* Loads 4 packed 24 bit samples (12 bytes) without reading past the end. */
+static inline X86_TARGET_SSE4_1 __m128i x86_load_p24x4(const uint8_t *src)
+{
+    int32_t last;
+    memcpy(&last, src + 8, sizeof(last));
+    return _mm_insert_epi32(_mm_loadl_epi64((const __m128i *)src), last, 2);
+}
+
+/* Stores the low 12 bytes of v as 4 packed 24 bit samples. */
+static inline X86_TARGET_SSE4_1 void x86_store_p24x4(uint8_t *dst, __m128i v)
+{
+    const int32_t last = _mm_extract_epi32(v, 2);
+    _mm_storel_epi64((__m128i *)dst, v);
+    memcpy(dst + 8, &last, sizeof(last));
+}
+
+/* Expands 4 packed 24 bit samples to Q0.31, as in i32_from_p24(). */
+static inline X86_TARGET_SSE4_1 __m128i x86_i32_from_p24x4(__m128i v)
+{
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+}
+
+/* Packs the low 24 bits of 4 int32 samples into the low 12 bytes. */
+static inline X86_TARGET_SSE4_1 __m128i x86_p24x4_from_i32(__m128i v)
+{
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+}
+
+static X86_TARGET_SSE4_1 void x86_i16_from_float_sse4_1(
+        int16_t *dst, const float *src, size_t count)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m128i lo = x86_clamp_from_float(_mm_loadu_ps(src), 1 << 15);
+        const __m128i hi = x86_clamp_from_float(_mm_loadu_ps(src + 4), 1 << 15);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_i16_from_float_avx2(
+        int16_t *dst, const float *src, size_t count)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m256i ival = x86_clamp_from_float_avx2(_mm256_loadu_ps(src), 1 << 15);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(
+                _mm256_castsi256_si128(ival), _mm256_extracti128_si256(ival, 1)));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+/* Expands from the end of the buffer, see above. */
+static X86_TARGET_SSE4_1 void x86_float_from_i16_sse4_1(
+        float *dst, const int16_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.f / (1 << 15));
+    dst += count;
+    src += count;
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        src -= X86_SIMD_BLOCK;
+        dst -= X86_SIMD_BLOCK;
+        const __m128i ival = _mm_loadu_si128((const __m128i *)src);
+        const __m128 lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(ival));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(ival, 8)));
+        _mm_storeu_ps(dst, _mm_mul_ps(lo, scale));
+        _mm_storeu_ps(dst + 4, _mm_mul_ps(hi, scale));
+    }
+}
+
+static X86_TARGET_AVX2 void x86_float_from_i16_avx2(
+        float *dst, const int16_t *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1.f / (1 << 15));
+    dst += count;
+    src += count;
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        src -= X86_SIMD_BLOCK;
+        dst -= X86_SIMD_BLOCK;
+        const __m256i ival = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+        _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(ival), scale));
+    }
+}
+
+/* Shared by float_from_i32, float_from_q8_23 and float_from_q4_27, in place is safe. */
+static X86_TARGET_SSE4_1 void x86_float_from_i32_sse4_1(
+        float *dst, const int32_t *src, size_t count, float scale)
+{
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m128i lo = _mm_loadu_si128((const __m128i *)src);
+        const __m128i hi = _mm_loadu_si128((const __m128i *)(src + 4));
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_float_from_i32_avx2(
+        float *dst, const int32_t *src, size_t count, float scale)
+{
+    const __m256 vscale = _mm256_set1_ps(scale);
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m256i ival = _mm256_loadu_si256((const __m256i *)src);
+        _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(ival), vscale));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+/* Shared by i32_from_float and q4_27_from_float. */
+static X86_TARGET_SSE4_1 void x86_i32_from_float_sse4_1(
+        int32_t *dst, const float *src, size_t count, float scale, float limit)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m128i lo = x86_clamp32_from_float(_mm_loadu_ps(src), scale, limit);
+        const __m128i hi = x86_clamp32_from_float(_mm_loadu_ps(src + 4), scale, limit);
+        _mm_storeu_si128((__m128i *)dst, lo);
+        _mm_storeu_si128((__m128i *)(dst + 4), hi);
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_i32_from_float_avx2(
+        int32_t *dst, const float *src, size_t count, float scale, float limit)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        _mm256_storeu_si256((__m256i *)dst,
+                x86_clamp32_from_float_avx2(_mm256_loadu_ps(src), scale, limit));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+static X86_TARGET_SSE4_1 void x86_q8_23_from_float_sse4_1(
+        int32_t *dst, const float *src, size_t count)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m128i lo = x86_clamp_from_float(_mm_loadu_ps(src), 1 << 23);
+        const __m128i hi = x86_clamp_from_float(_mm_loadu_ps(src + 4), 1 << 23);
+        _mm_storeu_si128((__m128i *)dst, lo);
+        _mm_storeu_si128((__m128i *)(dst + 4), hi);
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_q8_23_from_float_avx2(
+        int32_t *dst, const float *src, size_t count)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        _mm256_storeu_si256((__m256i *)dst,
+                x86_clamp_from_float_avx2(_mm256_loadu_ps(src), 1 << 23));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+/*
+ * Shared by i16_from_i32, i16_from_q8_23 and i16_from_q4_27.
+ * PACKSSDW saturates, which is clamp16() after the shift.
+ */
+static X86_TARGET_SSE4_1 void x86_i16_from_i32_sse4_1(
+        int16_t *dst, const int32_t *src, size_t count, int shift)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)src), shift);
+        const __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(src + 4)), shift);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_i16_from_i32_avx2(
+        int16_t *dst, const int32_t *src, size_t count, int shift)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m256i ival = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)src), shift);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(
+                _mm256_castsi256_si128(ival), _mm256_extracti128_si256(ival, 1)));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
+    }
+}
+
+/* Shared by i32_from_i16 and q8_23_from_i16, expands from the end of the buffer. */
+static X86_TARGET_SSE4_1 void x86_i32_from_i16_sse4_1(
+        int32_t *dst, const int16_t *src, size_t count, int shift)
+{
+    dst += count;
+    src += count;
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        src -= X86_SIMD_BLOCK;
+        dst -= X86_SIMD_BLOCK;
+        const __m128i ival = _mm_loadu_si128((const __m128i *)src);
+        const __m128i lo = _mm_slli_epi32(_mm_cvtepi16_epi32(ival), shift);
+        const __m128i hi = _mm_slli_epi32(_mm_cvtepi16_epi32(_mm_srli_si128(ival, 8)), shift);
+        _mm_storeu_si128((__m128i *)dst, lo);
+        _mm_storeu_si128((__m128i *)(dst + 4), hi);
+    }
+}
+
+static X86_TARGET_AVX2 void x86_i32_from_i16_avx2(
+        int32_t *dst, const int16_t *src, size_t count, int shift)
+{
+    dst += count;
+    src += count;
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        src -= X86_SIMD_BLOCK;
+        dst -= X86_SIMD_BLOCK;
+        const __m256i ival = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+        _mm256_storeu_si256((__m256i *)dst, _mm256_slli_epi32(ival, shift));
+    }
+}
+
+/*
+ * Packed 24 bit kernels are shuffle bound and gain nothing from 256 bit lanes,
+ * so there are only SSE4.1 versions.
+ */
+
+/* Shared by i32_from_p24 (shift 0) and q8_23_from_p24 (shift 8), expands from the end. */
+static X86_TARGET_SSE4_1 void x86_i32_from_p24_sse4_1(
+        int32_t *dst, const uint8_t *src, size_t count, int shift)
+{
+    dst += count;
+    src += count * 3;
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        src -= X86_SIMD_BLOCK * 3;
+        dst -= X86_SIMD_BLOCK;
+        const __m128i lo = _mm_srai_epi32(x86_i32_from_p24x4(x86_load_p24x4(src)), shift);
+        const __m128i hi = _mm_srai_epi32(x86_i32_from_p24x4(x86_load_p24x4(src + 12)), shift);
+        _mm_storeu_si128((__m128i *)dst, lo);
+        _mm_storeu_si128((__m128i *)(dst + 4), hi);
+    }
+}
+
+static X86_TARGET_SSE4_1 void x86_float_from_p24_sse4_1(
+        float *dst, const uint8_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.f / (1UL << 31));
+    dst += count;
+    src += count * 3;
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        src -= X86_SIMD_BLOCK * 3;
+        dst -= X86_SIMD_BLOCK;
+        const __m128i lo = x86_i32_from_p24x4(x86_load_p24x4(src));
+        const __m128i hi = x86_i32_from_p24x4(x86_load_p24x4(src + 12));
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+}
+
+static X86_TARGET_SSE4_1 void x86_p24_from_float_sse4_1(
+        uint8_t *dst, const float *src, size_t count)
+{
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        const __m128i lo = x86_clamp_from_float(_mm_loadu_ps(src), 1 << 23);
+        const __m128i hi = x86_clamp_from_float(_mm_loadu_ps(src + 4), 1 << 23);
+        x86_store_p24x4(dst, x86_p24x4_from_i32(lo));
+        x86_store_p24x4(dst + 12, x86_p24x4_from_i32(hi));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK * 3;
+    }
+}
+
+/* Shared by p24_from_i32 (shift 8) and p24_from_q8_23 (shift 0, clamped). */
+static X86_TARGET_SSE4_1 void x86_p24_from_i32_sse4_1(
+        uint8_t *dst, const int32_t *src, size_t count, int shift)
+{
+    const __m128i limneg = _mm_set1_epi32(-0x800000);
+    const __m128i limpos = _mm_set1_epi32(0x7fffff);
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)src), shift);
+        __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(src + 4)), shift);
+        lo = _mm_max_epi32(_mm_min_epi32(lo, limpos), limneg);
+        hi = _mm_max_epi32(_mm_min_epi32(hi, limpos), limneg);
+        x86_store_p24x4(dst, x86_p24x4_from_i32(lo));
+        x86_store_p24x4(dst + 12, x86_p24x4_from_i32(hi));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK * 3;
+    }
+}
+
+#endif /* USE_X86_SIMD */
 
 void ditherAndClamp(int32_t *out, const int32_t *sums, size_t pairs)
 {
@@ -29,6 +457,18 @@ void ditherAndClamp(int32_t *out, const int32_t *sums, size_t pairs)
 
 void memcpy_to_i16_from_q4_27(int16_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_i16_from_i32_avx2(dst, src, vcount, 12);
+    } else if (vcount > 0) {
+        x86_i16_from_i32_sse4_1(dst, src, vcount, 12);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp16(*src++ >> 12);
     }
@@ -85,6 +525,18 @@ void memcpy_to_u8_from_float(uint8_t *dst, const float *src, size_t count)
 
 void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_i16_from_i32_avx2(dst, src, vcount, 16);
+    } else if (vcount > 0) {
+        x86_i16_from_i32_sse4_1(dst, src, vcount, 16);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
     for (; count > 0; --count) {
         *dst++ = *src++ >> 16;
     }
@@ -92,6 +544,18 @@ void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_i16_from_float_avx2(dst, src, vcount);
+    } else if (vcount > 0) {
+        x86_i16_from_float_sse4_1(dst, src, vcount);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
     for (; count > 0; --count) {
         *dst++ = clamp16_from_float(*src++);
     }
@@ -99,6 +563,18 @@ void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
 
 void memcpy_to_float_from_q4_27(float *dst, const int32_t *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_float_from_i32_avx2(dst, src, vcount, 1.f / (1UL << 27));
+    } else if (vcount > 0) {
+        x86_float_from_i32_sse4_1(dst, src, vcount, 1.f / (1UL << 27));
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
     for (; count > 0; --count) {
         *dst++ = float_from_q4_27(*src++);
     }
@@ -106,11 +582,25 @@ void memcpy_to_float_from_q4_27(float *dst, const int32_t *src, size_t count)
 
 void memcpy_to_float_from_i16(float *dst, const int16_t *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+#else
+    const size_t vcount = 0;
+#endif
     dst += count;
     src += count;
-    for (; count > 0; --count) {
+    for (; count > vcount; --count) {
         *--dst = float_from_i16(*--src);
     }
+#ifdef USE_X86_SIMD
+    /* The remainder at the end is done first, the kernel continues toward the start. */
+    if (level == X86_SIMD_AVX2) {
+        x86_float_from_i16_avx2(dst - vcount, src - vcount, vcount);
+    } else if (vcount > 0) {
+        x86_float_from_i16_sse4_1(dst - vcount, src - vcount, vcount);
+    }
+#endif
 }
 
 void memcpy_to_float_from_u8(float *dst, const uint8_t *src, size_t count)
@@ -124,12 +614,24 @@ void memcpy_to_float_from_u8(float *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+#else
+    const size_t vcount = 0;
+#endif
     dst += count;
     src += count * 3;
-    for (; count > 0; --count) {
+    for (; count > vcount; --count) {
         src -= 3;
         *--dst = float_from_p24(src);
     }
+#ifdef USE_X86_SIMD
+    /* The remainder at the end is done first, the kernel continues toward the start. */
+    if (vcount > 0) {
+        x86_float_from_p24_sse4_1(dst - vcount, src - vcount * 3, vcount);
+    }
+#endif
 }
 
 void memcpy_to_i16_from_p24(int16_t *dst, const uint8_t *src, size_t count)
@@ -146,9 +648,15 @@ void memcpy_to_i16_from_p24(int16_t *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+#else
+    const size_t vcount = 0;
+#endif
     dst += count;
     src += count * 3;
-    for (; count > 0; --count) {
+    for (; count > vcount; --count) {
         src -= 3;
 #if HAVE_BIG_ENDIAN
         *--dst = (src[2] << 8) | (src[1] << 16) | (src[0] << 24);
@@ -156,6 +664,12 @@ void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
         *--dst = (src[0] << 8) | (src[1] << 16) | (src[2] << 24);
 #endif
     }
+#ifdef USE_X86_SIMD
+    /* The remainder at the end is done first, the kernel continues toward the start. */
+    if (vcount > 0) {
+        x86_i32_from_p24_sse4_1(dst - vcount, src - vcount * 3, vcount, 0);
+    }
+#endif
 }
 
 void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
@@ -179,6 +693,16 @@ void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (vcount > 0) {
+        x86_p24_from_float_sse4_1(dst, src, vcount);
+    }
+    dst += vcount * 3;
+    src += vcount;
+    count -= vcount;
+#endif
     for (; count > 0; --count) {
         int32_t ival = clamp24_from_float(*src++);
 
@@ -194,118 +718,578 @@ void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
     }
 }
 
-void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
-{
-    for (; count > 0; --count) {
-        int32_t ival = clamp24_from_q8_23(*src++);
+/*
+ * Dithered conversions.  Each sample takes the next of AUDIO_DITHER_LANES xorshift32
+ * generators in turn, so the vector kernels advance all generators at once from lane 0,
+ * and produce the same samples as the scalar loop.  A stream left at another lane by a
+ * previous call is first brought back to lane 0 one sample at a time.  The two 16 bit
+ * halves of a random word are independent uniform variables, whose difference has the
+ * triangular distribution over (-1, 1) LSB.
+ */
 
-#if HAVE_BIG_ENDIAN
-        *dst++ = ival >> 16;
-        *dst++ = ival >> 8;
-        *dst++ = ival;
-#else
-        *dst++ = ival;
-        *dst++ = ival >> 8;
-        *dst++ = ival >> 16;
-#endif
+int audio_dither_init(audio_dither_t *dither, uint32_t seed, uint32_t channel_count,
+        bool noise_shaping)
+{
+    if (noise_shaping && (channel_count == 0 || channel_count > AUDIO_DITHER_CHANNELS_MAX)) {
+        return -EINVAL;
+    }
+    memset(dither, 0, sizeof(*dither));
+    for (uint32_t i = 0; i < AUDIO_DITHER_LANES; ++i) {
+        /* splitmix32 style hash, so that nearby seeds give unrelated states */
+        uint32_t x = seed + (i + 1) * 0x9e3779b9;
+        x = (x ^ (x >> 16)) * 0x85ebca6b;
+        x = (x ^ (x >> 13)) * 0xc2b2ae35;
+        x ^= x >> 16;
+        dither->state[i] = x != 0 ? x : 1; /* zero is a fixed point of xorshift */
     }
+    dither->channel_count = channel_count;
+    dither->noise_shaping = noise_shaping;
+    return 0;
 }
 
-void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
+static inline float dither_tpdf(audio_dither_t *dither)
 {
-    for (; count > 0; --count) {
-        int32_t ival = *src++ >> 8;
-
-#if HAVE_BIG_ENDIAN
-        *dst++ = ival >> 16;
-        *dst++ = ival >> 8;
-        *dst++ = ival;
-#else
-        *dst++ = ival;
-        *dst++ = ival >> 8;
-        *dst++ = ival >> 16;
-#endif
-    }
+    uint32_t x = dither->state[dither->lane];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    dither->state[dither->lane] = x;
+    dither->lane = (dither->lane + 1) % AUDIO_DITHER_LANES;
+    return ((int32_t)(x >> 16) - (int32_t)(x & 0xffff)) * (1.f / 65536);
 }
 
-void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
+/* fmaxf(fminf(f, max), min) for non-NaN f, as the MINPS and MAXPS vector instructions. */
+static inline float dither_clamp(float f, float min, float max)
 {
-    dst += count;
-    src += count;
-    for (; count > 0; --count) {
-        *--dst = (int32_t)*--src << 8;
-    }
+    f = f < max ? f : max;
+    return f > min ? f : min;
 }
 
-void memcpy_to_q8_23_from_float_with_clamp(int32_t *dst, const float *src, size_t count)
+/*
+ * Returns the dithered sample in output LSBs, clamped to [-scale, scale - 1] and rounded
+ * as in clamp16_from_float().  With noise shaping the error of the previous sample of the
+ * channel is subtracted before requantization.
+ */
+static inline float dither_sample(audio_dither_t *dither, float f, float scale)
 {
-    for (; count > 0; --count) {
-        *dst++ = clamp24_from_float(*src++);
+    const float d = dither_tpdf(dither);
+    const float scaled = f * scale;
+    if (!dither->noise_shaping) {
+        return roundf(dither_clamp(scaled + d, -scale, scale - 1.f));
+    }
+    float *error = &dither->error[dither->channel];
+    if (++dither->channel == dither->channel_count) {
+        dither->channel = 0;
     }
+    const float v = scaled - *error;
+    const float y = roundf(dither_clamp(v + d, -scale, scale - 1.f));
+    /* bounded, so that clipping does not build up the error */
+    *error = dither_clamp(y - v, -1.5f, 1.5f);
+    return y;
 }
 
-void memcpy_to_q8_23_from_p24(int32_t *dst, const uint8_t *src, size_t count)
+#ifdef USE_X86_SIMD
+
+static inline X86_TARGET_SSE4_1 __m128i x86_xorshift32(__m128i x)
 {
-    dst += count;
-    src += count * 3;
-    for (; count > 0; --count) {
-        src -= 3;
-#if HAVE_BIG_ENDIAN
-        *--dst = (int8_t)src[0] << 16 | src[1] << 8 | src[2];
-#else
-        *--dst = (int8_t)src[2] << 16 | src[1] << 8 | src[0];
-#endif
-    }
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
 }
 
-void memcpy_to_q4_27_from_float(int32_t *dst, const float *src, size_t count)
+static inline X86_TARGET_AVX2 __m256i x86_xorshift32_avx2(__m256i x)
 {
-    for (; count > 0; --count) {
-        *dst++ = clampq4_27_from_float(*src++);
-    }
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
 }
 
-void memcpy_to_i16_from_q8_23(int16_t *dst, const int32_t *src, size_t count)
+/* dither_sample() without noise shaping, per lane. */
+static inline X86_TARGET_SSE4_1 __m128i x86_dither(__m128 f, __m128i random, float scale)
 {
-    for (; count > 0; --count) {
-        *dst++ = clamp16(*src++ >> 8);
-    }
+    const __m128i diff = _mm_sub_epi32(_mm_srli_epi32(random, 16),
+            _mm_and_si128(random, _mm_set1_epi32(0xffff)));
+    const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(diff), _mm_set1_ps(1.f / 65536));
+    const __m128 x = _mm_max_ps(_mm_min_ps(_mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(scale)), d),
+            _mm_set1_ps(scale - 1.f)), _mm_set1_ps(-scale));
+    return _mm_cvttps_epi32(x86_roundf_ps(x));
 }
 
-void memcpy_to_float_from_q8_23(float *dst, const int32_t *src, size_t count)
+static inline X86_TARGET_AVX2 __m256i x86_dither_avx2(__m256 f, __m256i random, float scale)
 {
-    for (; count > 0; --count) {
-        *dst++ = float_from_q8_23(*src++);
-    }
+    const __m256i diff = _mm256_sub_epi32(_mm256_srli_epi32(random, 16),
+            _mm256_and_si256(random, _mm256_set1_epi32(0xffff)));
+    const __m256 d = _mm256_mul_ps(_mm256_cvtepi32_ps(diff), _mm256_set1_ps(1.f / 65536));
+    const __m256 x = _mm256_max_ps(_mm256_min_ps(
+            _mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(scale)), d),
+            _mm256_set1_ps(scale - 1.f)), _mm256_set1_ps(-scale));
+    return _mm256_cvttps_epi32(x86_roundf_ps_avx2(x));
 }
 
-void memcpy_to_i32_from_u8(int32_t *dst, const uint8_t *src, size_t count)
+static X86_TARGET_SSE4_1 void x86_i16_from_float_with_dither_sse4_1(
+        int16_t *dst, const float *src, size_t count, uint32_t *state)
 {
-    dst += count;
-    src += count;
-    for (; count > 0; --count) {
-        *--dst = ((int32_t)(*--src) - 0x80) << 24;
+    __m128i lo_state = _mm_loadu_si128((const __m128i *)state);
+    __m128i hi_state = _mm_loadu_si128((const __m128i *)(state + 4));
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        lo_state = x86_xorshift32(lo_state);
+        hi_state = x86_xorshift32(hi_state);
+        const __m128i lo = x86_dither(_mm_loadu_ps(src), lo_state, 1 << 15);
+        const __m128i hi = x86_dither(_mm_loadu_ps(src + 4), hi_state, 1 << 15);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
     }
+    _mm_storeu_si128((__m128i *)state, lo_state);
+    _mm_storeu_si128((__m128i *)(state + 4), hi_state);
 }
 
-void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
+static X86_TARGET_AVX2 void x86_i16_from_float_with_dither_avx2(
+        int16_t *dst, const float *src, size_t count, uint32_t *state)
 {
-    dst += count;
-    src += count;
-    for (; count > 0; --count) {
-        *--dst = (int32_t)*--src << 16;
+    __m256i vstate = _mm256_loadu_si256((const __m256i *)state);
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        vstate = x86_xorshift32_avx2(vstate);
+        const __m256i ival = x86_dither_avx2(_mm256_loadu_ps(src), vstate, 1 << 15);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(
+                _mm256_castsi256_si128(ival), _mm256_extracti128_si256(ival, 1)));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK;
     }
+    _mm256_storeu_si256((__m256i *)state, vstate);
 }
 
-void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
+static X86_TARGET_SSE4_1 void x86_p24_from_float_with_dither_sse4_1(
+        uint8_t *dst, const float *src, size_t count, uint32_t *state)
 {
-    for (; count > 0; --count) {
-        *dst++ = clamp32_from_float(*src++);
+    __m128i lo_state = _mm_loadu_si128((const __m128i *)state);
+    __m128i hi_state = _mm_loadu_si128((const __m128i *)(state + 4));
+    for (; count > 0; count -= X86_SIMD_BLOCK) {
+        lo_state = x86_xorshift32(lo_state);
+        hi_state = x86_xorshift32(hi_state);
+        const __m128i lo = x86_dither(_mm_loadu_ps(src), lo_state, 1 << 23);
+        const __m128i hi = x86_dither(_mm_loadu_ps(src + 4), hi_state, 1 << 23);
+        x86_store_p24x4(dst, x86_p24x4_from_i32(lo));
+        x86_store_p24x4(dst + 12, x86_p24x4_from_i32(hi));
+        src += X86_SIMD_BLOCK;
+        dst += X86_SIMD_BLOCK * 3;
     }
+    _mm_storeu_si128((__m128i *)state, lo_state);
+    _mm_storeu_si128((__m128i *)(state + 4), hi_state);
 }
 
-void memcpy_to_float_from_i32(float *dst, const int32_t *src, size_t count)
+#elif defined(USE_AARCH64_SIMD)
+
+#define NEON_DITHER_BLOCK 8
+
+static inline uint32x4_t neon_xorshift32(uint32x4_t x)
+{
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    return veorq_u32(x, vshlq_n_u32(x, 5));
+}
+
+/* dither_sample() without noise shaping, per lane; FMINNM and FRINTA match fminf() and roundf(). */
+static inline int32x4_t neon_dither(float32x4_t f, uint32x4_t random, float scale)
+{
+    const int32x4_t diff = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(random, 16)),
+            vreinterpretq_s32_u32(vandq_u32(random, vdupq_n_u32(0xffff))));
+    const float32x4_t d = vmulq_f32(vcvtq_f32_s32(diff), vdupq_n_f32(1.f / 65536));
+    const float32x4_t x = vmaxnmq_f32(vminnmq_f32(
+            vaddq_f32(vmulq_f32(f, vdupq_n_f32(scale)), d),
+            vdupq_n_f32(scale - 1.f)), vdupq_n_f32(-scale));
+    return vcvtq_s32_f32(vrndaq_f32(x));
+}
+
+static void neon_i16_from_float_with_dither(
+        int16_t *dst, const float *src, size_t count, uint32_t *state)
+{
+    uint32x4_t lo_state = vld1q_u32(state);
+    uint32x4_t hi_state = vld1q_u32(state + 4);
+    for (; count > 0; count -= NEON_DITHER_BLOCK) {
+        lo_state = neon_xorshift32(lo_state);
+        hi_state = neon_xorshift32(hi_state);
+        const int32x4_t lo = neon_dither(vld1q_f32(src), lo_state, 1 << 15);
+        const int32x4_t hi = neon_dither(vld1q_f32(src + 4), hi_state, 1 << 15);
+        vst1q_s16(dst, vcombine_s16(vmovn_s32(lo), vmovn_s32(hi)));
+        src += NEON_DITHER_BLOCK;
+        dst += NEON_DITHER_BLOCK;
+    }
+    vst1q_u32(state, lo_state);
+    vst1q_u32(state + 4, hi_state);
+}
+
+/* Stores the low 24 bits of 4 int32 samples as 12 bytes. */
+static inline void neon_store_p24x4(uint8_t *dst, int32x4_t v)
+{
+    static const uint8_t pack[16] = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0, 0, 0, 0};
+    const uint8x16_t bytes = vqtbl1q_u8(vreinterpretq_u8_s32(v), vld1q_u8(pack));
+    const uint32_t last = vgetq_lane_u32(vreinterpretq_u32_u8(bytes), 2);
+    vst1_u8(dst, vget_low_u8(bytes));
+    memcpy(dst + 8, &last, sizeof(last));
+}
+
+static void neon_p24_from_float_with_dither(
+        uint8_t *dst, const float *src, size_t count, uint32_t *state)
+{
+    uint32x4_t lo_state = vld1q_u32(state);
+    uint32x4_t hi_state = vld1q_u32(state + 4);
+    for (; count > 0; count -= NEON_DITHER_BLOCK) {
+        lo_state = neon_xorshift32(lo_state);
+        hi_state = neon_xorshift32(hi_state);
+        neon_store_p24x4(dst, neon_dither(vld1q_f32(src), lo_state, 1 << 23));
+        neon_store_p24x4(dst + 12, neon_dither(vld1q_f32(src + 4), hi_state, 1 << 23));
+        src += NEON_DITHER_BLOCK;
+        dst += NEON_DITHER_BLOCK * 3;
+    }
+    vst1q_u32(state, lo_state);
+    vst1q_u32(state + 4, hi_state);
+}
+
+#endif /* USE_X86_SIMD */
+
+static void i16_from_float_with_dither(int16_t *dst, const float *src, size_t count,
+        audio_dither_t *dither)
+{
+    /* a local copy, which the stores to dst cannot alias */
+    audio_dither_t local = *dither;
+    for (; count > 0; --count) {
+        *dst++ = dither_sample(&local, *src++, 1 << 15);
+    }
+    *dither = local;
+}
+
+static void p24_from_float_with_dither(uint8_t *dst, const float *src, size_t count,
+        audio_dither_t *dither)
+{
+    audio_dither_t local = *dither;
+    for (; count > 0; --count) {
+        const int32_t ival = dither_sample(&local, *src++, 1 << 23);
+
+#if HAVE_BIG_ENDIAN
+        *dst++ = ival >> 16;
+        *dst++ = ival >> 8;
+        *dst++ = ival;
+#else
+        *dst++ = ival;
+        *dst++ = ival >> 8;
+        *dst++ = ival >> 16;
+#endif
+    }
+    *dither = local;
+}
+
+/* Number of samples to convert one at a time before the stream is back at lane 0. */
+static inline size_t dither_lane_prologue(const audio_dither_t *dither, size_t count)
+{
+    const size_t head = (AUDIO_DITHER_LANES - dither->lane) % AUDIO_DITHER_LANES;
+    return head < count ? head : count;
+}
+
+void memcpy_to_i16_from_float_with_dither(int16_t *dst, const float *src, size_t count,
+        audio_dither_t *dither)
+{
+    if (!dither->noise_shaping) {
+        const size_t head = dither_lane_prologue(dither, count);
+        i16_from_float_with_dither(dst, src, head, dither);
+        dst += head;
+        src += head;
+        count -= head;
+#if defined(USE_X86_SIMD)
+        const x86_simd_level_t level = x86_simd_level();
+        const size_t vcount = x86_simd_count(level, count);
+        if (level == X86_SIMD_AVX2) {
+            x86_i16_from_float_with_dither_avx2(dst, src, vcount, dither->state);
+        } else if (vcount > 0) {
+            x86_i16_from_float_with_dither_sse4_1(dst, src, vcount, dither->state);
+        }
+        dst += vcount;
+        src += vcount;
+        count -= vcount;
+#elif defined(USE_AARCH64_SIMD)
+        const size_t vcount = count & ~(size_t)(NEON_DITHER_BLOCK - 1);
+        neon_i16_from_float_with_dither(dst, src, vcount, dither->state);
+        dst += vcount;
+        src += vcount;
+        count -= vcount;
+#endif
+    }
+    i16_from_float_with_dither(dst, src, count, dither);
+}
+
+void memcpy_to_p24_from_float_with_dither(uint8_t *dst, const float *src, size_t count,
+        audio_dither_t *dither)
+{
+    if (!dither->noise_shaping) {
+        const size_t head = dither_lane_prologue(dither, count);
+        p24_from_float_with_dither(dst, src, head, dither);
+        dst += head * 3;
+        src += head;
+        count -= head;
+#if defined(USE_X86_SIMD)
+        const x86_simd_level_t level = x86_simd_level();
+        const size_t vcount = x86_simd_count(level, count);
+        if (vcount > 0) {
+            x86_p24_from_float_with_dither_sse4_1(dst, src, vcount, dither->state);
+        }
+        dst += vcount * 3;
+        src += vcount;
+        count -= vcount;
+#elif defined(USE_AARCH64_SIMD)
+        const size_t vcount = count & ~(size_t)(NEON_DITHER_BLOCK - 1);
+        neon_p24_from_float_with_dither(dst, src, vcount, dither->state);
+        dst += vcount * 3;
+        src += vcount;
+        count -= vcount;
+#endif
+    }
+    p24_from_float_with_dither(dst, src, count, dither);
+}
+
+void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (vcount > 0) {
+        x86_p24_from_i32_sse4_1(dst, src, vcount, 0);
+    }
+    dst += vcount * 3;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        int32_t ival = clamp24_from_q8_23(*src++);
+
+#if HAVE_BIG_ENDIAN
+        *dst++ = ival >> 16;
+        *dst++ = ival >> 8;
+        *dst++ = ival;
+#else
+        *dst++ = ival;
+        *dst++ = ival >> 8;
+        *dst++ = ival >> 16;
+#endif
+    }
+}
+
+void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (vcount > 0) {
+        x86_p24_from_i32_sse4_1(dst, src, vcount, 8);
+    }
+    dst += vcount * 3;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        int32_t ival = *src++ >> 8;
+
+#if HAVE_BIG_ENDIAN
+        *dst++ = ival >> 16;
+        *dst++ = ival >> 8;
+        *dst++ = ival;
+#else
+        *dst++ = ival;
+        *dst++ = ival >> 8;
+        *dst++ = ival >> 16;
+#endif
+    }
+}
+
+void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+#else
+    const size_t vcount = 0;
+#endif
+    dst += count;
+    src += count;
+    for (; count > vcount; --count) {
+        *--dst = (int32_t)*--src << 8;
+    }
+#ifdef USE_X86_SIMD
+    /* The remainder at the end is done first, the kernel continues toward the start. */
+    if (level == X86_SIMD_AVX2) {
+        x86_i32_from_i16_avx2(dst - vcount, src - vcount, vcount, 8);
+    } else if (vcount > 0) {
+        x86_i32_from_i16_sse4_1(dst - vcount, src - vcount, vcount, 8);
+    }
+#endif
+}
+
+void memcpy_to_q8_23_from_float_with_clamp(int32_t *dst, const float *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_q8_23_from_float_avx2(dst, src, vcount);
+    } else if (vcount > 0) {
+        x86_q8_23_from_float_sse4_1(dst, src, vcount);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        *dst++ = clamp24_from_float(*src++);
+    }
+}
+
+void memcpy_to_q8_23_from_p24(int32_t *dst, const uint8_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+#else
+    const size_t vcount = 0;
+#endif
+    dst += count;
+    src += count * 3;
+    for (; count > vcount; --count) {
+        src -= 3;
+#if HAVE_BIG_ENDIAN
+        *--dst = (int8_t)src[0] << 16 | src[1] << 8 | src[2];
+#else
+        *--dst = (int8_t)src[2] << 16 | src[1] << 8 | src[0];
+#endif
+    }
+#ifdef USE_X86_SIMD
+    /* The remainder at the end is done first, the kernel continues toward the start. */
+    if (vcount > 0) {
+        x86_i32_from_p24_sse4_1(dst - vcount, src - vcount * 3, vcount, 8);
+    }
+#endif
+}
+
+void memcpy_to_q4_27_from_float(int32_t *dst, const float *src, size_t count)
 {
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_i32_from_float_avx2(dst, src, vcount, 1UL << 27, 16.f);
+    } else if (vcount > 0) {
+        x86_i32_from_float_sse4_1(dst, src, vcount, 1UL << 27, 16.f);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        *dst++ = clampq4_27_from_float(*src++);
+    }
+}
+
+void memcpy_to_i16_from_q8_23(int16_t *dst, const int32_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_i16_from_i32_avx2(dst, src, vcount, 8);
+    } else if (vcount > 0) {
+        x86_i16_from_i32_sse4_1(dst, src, vcount, 8);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        *dst++ = clamp16(*src++ >> 8);
+    }
+}
+
+void memcpy_to_float_from_q8_23(float *dst, const int32_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_float_from_i32_avx2(dst, src, vcount, 1.f / (1UL << 23));
+    } else if (vcount > 0) {
+        x86_float_from_i32_sse4_1(dst, src, vcount, 1.f / (1UL << 23));
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        *dst++ = float_from_q8_23(*src++);
+    }
+}
+
+void memcpy_to_i32_from_u8(int32_t *dst, const uint8_t *src, size_t count)
+{
+    dst += count;
+    src += count;
+    for (; count > 0; --count) {
+        *--dst = ((int32_t)(*--src) - 0x80) << 24;
+    }
+}
+
+void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+#else
+    const size_t vcount = 0;
+#endif
+    dst += count;
+    src += count;
+    for (; count > vcount; --count) {
+        *--dst = (int32_t)*--src << 16;
+    }
+#ifdef USE_X86_SIMD
+    /* The remainder at the end is done first, the kernel continues toward the start. */
+    if (level == X86_SIMD_AVX2) {
+        x86_i32_from_i16_avx2(dst - vcount, src - vcount, vcount, 16);
+    } else if (vcount > 0) {
+        x86_i32_from_i16_sse4_1(dst - vcount, src - vcount, vcount, 16);
+    }
+#endif
+}
+
+void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_i32_from_float_avx2(dst, src, vcount, 1UL << 31, 1.f);
+    } else if (vcount > 0) {
+        x86_i32_from_float_sse4_1(dst, src, vcount, 1UL << 31, 1.f);
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
+    for (; count > 0; --count) {
+        *dst++ = clamp32_from_float(*src++);
+    }
+}
+
+void memcpy_to_float_from_i32(float *dst, const int32_t *src, size_t count)
+{
+#ifdef USE_X86_SIMD
+    const x86_simd_level_t level = x86_simd_level();
+    const size_t vcount = x86_simd_count(level, count);
+    if (level == X86_SIMD_AVX2) {
+        x86_float_from_i32_avx2(dst, src, vcount, 1.f / (1UL << 31));
+    } else if (vcount > 0) {
+        x86_float_from_i32_sse4_1(dst, src, vcount, 1.f / (1UL << 31));
+    }
+    dst += vcount;
+    src += vcount;
+    count -= vcount;
+#endif
     for (; count > 0; --count) {
         *dst++ = float_from_i32(*src++);
     }
@@ -489,10 +1473,250 @@ void memcpy_by_channel_mask(void *dst, uint32_t dst_mask,
     } \
 }
 
+/*
+ * C macros to apply the precomputed remix plans, independent of dst/src sample type.
+ * Don't pass in any expressions for the macro arguments here.
+ */
+#define copy_frame_by_prefix(dst, dst_channels, src, src_channels, copy_channels, count, zero) \
+{ \
+    unsigned i; \
+    for (; (count) > 0; --(count)) { \
+        for (i = 0; i < (copy_channels); ++i) { \
+            *(dst)++ = (src)[i]; \
+        } \
+        for (; i < (dst_channels); ++i) { \
+            *(dst)++ = (zero); \
+        } \
+        (src) += (src_channels); \
+    } \
+}
+
+#define copy_frame_by_permutation(dst, dst_channels, src, src_channels, idxary, count) \
+{ \
+    unsigned i; \
+    for (; (count) > 0; --(count)) { \
+        for (i = 0; i < (dst_channels); ++i) { \
+            *(dst)++ = (src)[(idxary)[i]]; \
+        } \
+        (src) += (src_channels); \
+    } \
+}
+
+#define copy_frame_by_plan(dst, src, plan, count, zero) \
+{ \
+    switch ((plan)->type) { \
+    case MEMCPY_BY_INDEX_ARRAY_PREFIX: \
+    case MEMCPY_BY_INDEX_ARRAY_ZERO_FILL: \
+        copy_frame_by_prefix(dst, (plan)->dst_channels, src, (plan)->src_channels, \
+                (plan)->copy_channels, count, zero); \
+        break; \
+    case MEMCPY_BY_INDEX_ARRAY_PERMUTATION: \
+        copy_frame_by_permutation(dst, (plan)->dst_channels, src, (plan)->src_channels, \
+                (plan)->idxary, count); \
+        break; \
+    default: \
+        copy_frame_by_idx(dst, (plan)->dst_channels, src, (plan)->src_channels, \
+                (plan)->idxary, count, zero); \
+        break; \
+    } \
+}
+
+#if defined(USE_X86_SIMD) || defined(USE_AARCH64_SIMD)
+
+/*
+ * Remix by byte shuffle: each destination frame vector is assembled from the loaded source
+ * frame vectors by a table lookup (PSHUFB or TBL), with out of range table indices giving
+ * the zero fill.  Loads and stores cover whole vectors, which may extend into the next frame;
+ * frames are processed in order so that the next frame overwrites those bytes, and the last
+ * frames, whose vectors would extend past the end of the buffers, are left to the scalar copy.
+ */
+
+/* Returns the number of leading frames whose vector loads and stores stay within the buffers. */
+static size_t shuffle_frame_count(const memcpy_by_index_array_plan_t *plan, size_t count)
+{
+    const size_t src_bytes = plan->src_channels * plan->sample_size;
+    const size_t dst_bytes = plan->dst_channels * plan->sample_size;
+    const size_t load_bytes = plan->shuffle_src_vectors * 16;
+    const size_t store_bytes = plan->shuffle_dst_vectors * 16;
+    if (count * src_bytes < load_bytes || count * dst_bytes < store_bytes) {
+        return 0;
+    }
+    const size_t src_frames = (count * src_bytes - load_bytes) / src_bytes + 1;
+    const size_t dst_frames = (count * dst_bytes - store_bytes) / dst_bytes + 1;
+    return src_frames < dst_frames ? src_frames : dst_frames;
+}
+
+#ifdef USE_X86_SIMD
+
+/*
+ * Returns destination vector d of a frame.  The helpers are called with constant vector counts
+ * and written without loops, so that no compiler keeps the vectors in arrays on the stack.
+ */
+static inline X86_TARGET_SSE4_1 __attribute__((always_inline)) __m128i x86_shuffle_vector(
+        const uint8_t *src, const __m128i masks[4], const unsigned d,
+        const unsigned nsrc, const bool local)
+{
+    const __m128i *in = (const __m128i *)src;
+    if (local) {
+        return d < nsrc ? _mm_shuffle_epi8(_mm_loadu_si128(in + d), masks[d])
+                : _mm_setzero_si128();
+    }
+    __m128i out = _mm_shuffle_epi8(_mm_loadu_si128(in), masks[0]);
+    if (nsrc > 1) out = _mm_or_si128(out, _mm_shuffle_epi8(_mm_loadu_si128(in + 1), masks[1]));
+    if (nsrc > 2) out = _mm_or_si128(out, _mm_shuffle_epi8(_mm_loadu_si128(in + 2), masks[2]));
+    if (nsrc > 3) out = _mm_or_si128(out, _mm_shuffle_epi8(_mm_loadu_si128(in + 3), masks[3]));
+    return out;
+}
+
+static inline X86_TARGET_SSE4_1 __attribute__((always_inline)) void x86_shuffle_frames_n(
+        uint8_t *dst, size_t dst_bytes, const uint8_t *src, size_t src_bytes,
+        const __m128i masks[4][4], size_t count, const unsigned nsrc, const unsigned ndst,
+        const bool local)
+{
+    for (; count > 0; --count) {
+        __m128i *out = (__m128i *)dst;
+        _mm_storeu_si128(out, x86_shuffle_vector(src, masks[0], 0, nsrc, local));
+        if (ndst > 1) _mm_storeu_si128(out + 1, x86_shuffle_vector(src, masks[1], 1, nsrc, local));
+        if (ndst > 2) _mm_storeu_si128(out + 2, x86_shuffle_vector(src, masks[2], 2, nsrc, local));
+        if (ndst > 3) _mm_storeu_si128(out + 3, x86_shuffle_vector(src, masks[3], 3, nsrc, local));
+        src += src_bytes;
+        dst += dst_bytes;
+    }
+}
+
+static X86_TARGET_SSE4_1 void x86_shuffle_frames(void *dst, const void *src,
+        const memcpy_by_index_array_plan_t *plan, size_t count)
+{
+    const unsigned nsrc = plan->shuffle_src_vectors;
+    const unsigned ndst = plan->shuffle_dst_vectors;
+    /* PSHUFB takes 16 byte tables, so split the shuffle into one mask per source vector;
+     * a mask byte with the high bit set gives zero. */
+    __m128i masks[4][4];
+    for (unsigned d = 0; d < ndst; ++d) {
+        const __m128i offsets = _mm_loadu_si128((const __m128i *)plan->shuffle + d);
+        for (unsigned k = 0; k < nsrc; ++k) {
+            const __m128i index = _mm_sub_epi8(offsets, _mm_set1_epi8(k * 16));
+            const __m128i in_range = _mm_cmpeq_epi8(
+                    _mm_and_si128(index, _mm_set1_epi8(0xf0)), _mm_setzero_si128());
+            masks[d][k] = _mm_or_si128(index, _mm_andnot_si128(in_range, _mm_set1_epi8(0x80)));
+        }
+    }
+    const size_t dst_bytes = plan->dst_channels * plan->sample_size;
+    const size_t src_bytes = plan->src_channels * plan->sample_size;
+    const bool local = plan->shuffle_local;
+#define X86_SHUFFLE_CASE(n, d) \
+    case (n) * 8 + (d): \
+        if (local) { \
+            x86_shuffle_frames_n((uint8_t *)dst, dst_bytes, (const uint8_t *)src, src_bytes, \
+                    masks, count, (n), (d), true); \
+        } else { \
+            x86_shuffle_frames_n((uint8_t *)dst, dst_bytes, (const uint8_t *)src, src_bytes, \
+                    masks, count, (n), (d), false); \
+        } \
+        break
+    switch (nsrc * 8 + ndst) {
+    X86_SHUFFLE_CASE(1, 1); X86_SHUFFLE_CASE(1, 2); X86_SHUFFLE_CASE(1, 3); X86_SHUFFLE_CASE(1, 4);
+    X86_SHUFFLE_CASE(2, 1); X86_SHUFFLE_CASE(2, 2); X86_SHUFFLE_CASE(2, 3); X86_SHUFFLE_CASE(2, 4);
+    X86_SHUFFLE_CASE(3, 1); X86_SHUFFLE_CASE(3, 2); X86_SHUFFLE_CASE(3, 3); X86_SHUFFLE_CASE(3, 4);
+    X86_SHUFFLE_CASE(4, 1); X86_SHUFFLE_CASE(4, 2); X86_SHUFFLE_CASE(4, 3); X86_SHUFFLE_CASE(4, 4);
+    default:
+        abort(); /* plan not initialized by memcpy_by_index_array_plan_init() */
+    }
+#undef X86_SHUFFLE_CASE
+}
+
+#else /* USE_AARCH64_SIMD */
+
+/* Returns destination vector d of a frame, see x86_shuffle_vector(). */
+static inline __attribute__((always_inline)) uint8x16_t neon_shuffle_vector(
+        const uint8_t *src, const uint8x16_t index, const unsigned d,
+        const unsigned nsrc, const bool local)
+{
+    /* TBL gives zero for indices past the end of the table */
+    if (local) {
+        return d < nsrc ? vqtbl1q_u8(vld1q_u8(src + d * 16), index) : vdupq_n_u8(0);
+    }
+    switch (nsrc) {
+    case 1:
+        return vqtbl1q_u8(vld1q_u8(src), index);
+    case 2:
+        return vqtbl2q_u8(vld1q_u8_x2(src), index);
+    case 3:
+        return vqtbl3q_u8(vld1q_u8_x3(src), index);
+    default:
+        return vqtbl4q_u8(vld1q_u8_x4(src), index);
+    }
+}
+
+static inline __attribute__((always_inline)) void neon_shuffle_frames_n(
+        uint8_t *dst, size_t dst_bytes, const uint8_t *src, size_t src_bytes,
+        const uint8x16_t index[4], size_t count, const unsigned nsrc, const unsigned ndst,
+        const bool local)
+{
+    for (; count > 0; --count) {
+        vst1q_u8(dst, neon_shuffle_vector(src, index[0], 0, nsrc, local));
+        if (ndst > 1) vst1q_u8(dst + 16, neon_shuffle_vector(src, index[1], 1, nsrc, local));
+        if (ndst > 2) vst1q_u8(dst + 32, neon_shuffle_vector(src, index[2], 2, nsrc, local));
+        if (ndst > 3) vst1q_u8(dst + 48, neon_shuffle_vector(src, index[3], 3, nsrc, local));
+        src += src_bytes;
+        dst += dst_bytes;
+    }
+}
+
+static void neon_shuffle_frames(void *dst, const void *src,
+        const memcpy_by_index_array_plan_t *plan, size_t count)
+{
+    const unsigned nsrc = plan->shuffle_src_vectors;
+    const unsigned ndst = plan->shuffle_dst_vectors;
+    const bool local = plan->shuffle_local;
+    uint8x16_t index[4];
+    for (unsigned d = 0; d < ndst; ++d) {
+        index[d] = vld1q_u8(plan->shuffle + d * 16);
+        if (local) {
+            /* index within the source vector d, keeping 0xff for zero fill */
+            index[d] = vsubq_u8(index[d], vandq_u8(vdupq_n_u8(d * 16),
+                    vmvnq_u8(vceqq_u8(index[d], vdupq_n_u8(0xff)))));
+        }
+    }
+    const size_t dst_bytes = plan->dst_channels * plan->sample_size;
+    const size_t src_bytes = plan->src_channels * plan->sample_size;
+#define NEON_SHUFFLE_CASE(n, d) \
+    case (n) * 8 + (d): \
+        if (local) { \
+            neon_shuffle_frames_n((uint8_t *)dst, dst_bytes, (const uint8_t *)src, src_bytes, \
+                    index, count, (n), (d), true); \
+        } else { \
+            neon_shuffle_frames_n((uint8_t *)dst, dst_bytes, (const uint8_t *)src, src_bytes, \
+                    index, count, (n), (d), false); \
+        } \
+        break
+    switch (nsrc * 8 + ndst) {
+    NEON_SHUFFLE_CASE(1, 1); NEON_SHUFFLE_CASE(1, 2); NEON_SHUFFLE_CASE(1, 3); NEON_SHUFFLE_CASE(1, 4);
+    NEON_SHUFFLE_CASE(2, 1); NEON_SHUFFLE_CASE(2, 2); NEON_SHUFFLE_CASE(2, 3); NEON_SHUFFLE_CASE(2, 4);
+    NEON_SHUFFLE_CASE(3, 1); NEON_SHUFFLE_CASE(3, 2); NEON_SHUFFLE_CASE(3, 3); NEON_SHUFFLE_CASE(3, 4);
+    NEON_SHUFFLE_CASE(4, 1); NEON_SHUFFLE_CASE(4, 2); NEON_SHUFFLE_CASE(4, 3); NEON_SHUFFLE_CASE(4, 4);
+    default:
+        abort(); /* plan not initialized by memcpy_by_index_array_plan_init() */
+    }
+#undef NEON_SHUFFLE_CASE
+}
+
+#endif /* USE_X86_SIMD */
+
+#endif /* USE_X86_SIMD || USE_AARCH64_SIMD */
+
 void memcpy_by_index_array(void *dst, uint32_t dst_channels,
         const void *src, uint32_t src_channels,
         const int8_t *idxary, size_t sample_size, size_t count)
 {
+    memcpy_by_index_array_plan_t plan;
+    if (memcpy_by_index_array_plan_init(
+            &plan, dst_channels, src_channels, idxary, sample_size) == 0) {
+        memcpy_by_index_array_with_plan(dst, src, &plan, count);
+        return;
+    }
+
+    /* too many channels for a plan, or indices out of range */
     switch (sample_size) {
     case 1: {
         uint8_t *udst = (uint8_t*)dst;
@@ -525,6 +1749,140 @@ void memcpy_by_index_array(void *dst, uint32_t dst_channels,
     }
 }
 
+int memcpy_by_index_array_plan_init(memcpy_by_index_array_plan_t *plan,
+        uint32_t dst_channels, uint32_t src_channels, const int8_t *idxary, size_t sample_size)
+{
+    if (dst_channels > MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX
+            || sample_size < 1 || sample_size > 4) {
+        return -EINVAL;
+    }
+    uint32_t copy_channels = 0;   /* length of the idxary[i] == i prefix */
+    bool zero_tail = true;        /* all entries after the prefix are -1 */
+    bool zero_fill = false;       /* some entry is -1 */
+    for (uint32_t i = 0; i < dst_channels; ++i) {
+        const int index = idxary[i];
+        if (index >= (int)src_channels) {
+            return -EINVAL;
+        }
+        if (index < 0) {
+            zero_fill = true;
+        } else {
+            zero_tail = false;
+        }
+        if (index == (int)i && copy_channels == i) {
+            ++copy_channels;
+            zero_tail = true;
+        }
+        plan->idxary[i] = index < 0 ? -1 : index;
+    }
+    plan->dst_channels = dst_channels;
+    plan->src_channels = src_channels;
+    plan->copy_channels = copy_channels;
+    plan->sample_size = sample_size;
+    if (copy_channels == dst_channels) {
+        plan->type = dst_channels == src_channels
+                ? MEMCPY_BY_INDEX_ARRAY_IDENTITY : MEMCPY_BY_INDEX_ARRAY_PREFIX;
+    } else if (zero_tail) {
+        plan->type = MEMCPY_BY_INDEX_ARRAY_ZERO_FILL;
+    } else if (!zero_fill) {
+        plan->type = MEMCPY_BY_INDEX_ARRAY_PERMUTATION;
+    } else {
+        plan->type = MEMCPY_BY_INDEX_ARRAY_GENERIC;
+    }
+
+    /* byte shuffle, if the frames fit in the vectors */
+    plan->shuffle_src_vectors = 0;
+    plan->shuffle_dst_vectors = 0;
+    plan->shuffle_local = false;
+    const size_t dst_bytes = dst_channels * sample_size;
+    size_t src_bytes = 0; /* end of the source bytes used */
+    if (plan->type == MEMCPY_BY_INDEX_ARRAY_IDENTITY
+            || dst_bytes > MEMCPY_BY_INDEX_ARRAY_PLAN_SHUFFLE_BYTES) {
+        return 0;
+    }
+    memset(plan->shuffle, 0xff, sizeof(plan->shuffle));
+    for (uint32_t i = 0; i < dst_channels; ++i) {
+        const int index = plan->idxary[i];
+        if (index >= 0) {
+            for (size_t j = 0; j < sample_size; ++j) {
+                plan->shuffle[i * sample_size + j] = index * sample_size + j;
+            }
+            if (src_bytes < (index + 1) * sample_size) {
+                src_bytes = (index + 1) * sample_size;
+            }
+        }
+    }
+    if (src_bytes > 0 && src_bytes <= MEMCPY_BY_INDEX_ARRAY_PLAN_SHUFFLE_BYTES) {
+        plan->shuffle_src_vectors = (src_bytes + 15) / 16;
+        plan->shuffle_dst_vectors = (dst_bytes + 15) / 16;
+        /* prefix copies, zero fill and reordering within 16 bytes need a single table
+         * lookup per destination vector */
+        plan->shuffle_local = true;
+        for (size_t i = 0; i < plan->shuffle_dst_vectors * 16; ++i) {
+            if (plan->shuffle[i] != 0xff && plan->shuffle[i] / 16 != i / 16) {
+                plan->shuffle_local = false;
+            }
+        }
+    }
+    return 0;
+}
+
+void memcpy_by_index_array_with_plan(void *dst, const void *src,
+        const memcpy_by_index_array_plan_t *plan, size_t count)
+{
+    if (plan->type == MEMCPY_BY_INDEX_ARRAY_IDENTITY) {
+        memcpy(dst, src, count * plan->dst_channels * plan->sample_size);
+        return;
+    }
+#if defined(USE_X86_SIMD) || defined(USE_AARCH64_SIMD)
+    if (plan->shuffle_dst_vectors > 0) {
+        const size_t frames = shuffle_frame_count(plan, count);
+#ifdef USE_X86_SIMD
+        /* PSHUFB is SSSE3, which is implied by SSE4.1 */
+        if (frames > 0 && x86_simd_level() != X86_SIMD_NONE) {
+            x86_shuffle_frames(dst, src, plan, frames);
+#else
+        if (frames > 0) {
+            neon_shuffle_frames(dst, src, plan, frames);
+#endif
+            dst = (uint8_t *)dst + frames * plan->dst_channels * plan->sample_size;
+            src = (const uint8_t *)src + frames * plan->src_channels * plan->sample_size;
+            count -= frames;
+        }
+    }
+#endif
+    switch (plan->sample_size) {
+    case 1: {
+        uint8_t *udst = (uint8_t*)dst;
+        const uint8_t *usrc = (const uint8_t*)src;
+
+        copy_frame_by_plan(udst, usrc, plan, count, 0);
+    } break;
+    case 2: {
+        uint16_t *udst = (uint16_t*)dst;
+        const uint16_t *usrc = (const uint16_t*)src;
+
+        copy_frame_by_plan(udst, usrc, plan, count, 0);
+    } break;
+    case 3: {
+        uint8x3_t *udst = (uint8x3_t*)dst;
+        const uint8x3_t *usrc = (const uint8x3_t*)src;
+        static const uint8x3_t zero;
+
+        copy_frame_by_plan(udst, usrc, plan, count, zero);
+    } break;
+    case 4: {
+        uint32_t *udst = (uint32_t*)dst;
+        const uint32_t *usrc = (const uint32_t*)src;
+
+        copy_frame_by_plan(udst, usrc, plan, count, 0);
+    } break;
+    default:
+        abort(); /* illegal value */
+        break;
+    }
+}
+
 size_t memcpy_by_index_array_initialization(int8_t *idxary, size_t idxcount,
         uint32_t dst_mask, uint32_t src_mask)
 {
@@ -642,3 +2000,536 @@ void accumulate_float(float *dst, const float *src, size_t count) {
         *dst++ += *src++;
     }
 }
+
+/*
+ * Accumulate with gain.  The scalar helpers below define the results: integer samples are
+ * scaled and summed in float (16-bit) or double (32-bit) precision, then clamped and rounded
+ * half away from zero as in clamp16_from_float().  Products and sums are separate statements
+ * so that clang, which Android builds with, does not contract them into a fused multiply-add,
+ * which the vector kernels would not match: its default -ffp-contract=on only fuses within an
+ * expression.  GCC's -ffp-contract=fast fuses across statements, so a GCC build needs
+ * -ffp-contract=off for these results.
+ */
+
+static inline float channel_gain(const float *gains, const float *increments,
+        uint32_t channel, size_t frame)
+{
+    if (increments == NULL) {
+        return gains[channel];
+    }
+    const float step = (float)frame * increments[channel];
+    return gains[channel] + step;
+}
+
+static inline int16_t accumulate_with_gain_sample_i16(int16_t dst, int16_t src, float gain)
+{
+    const float product = src * gain;
+    const float sum = product + dst;
+    return roundf(fmaxf(fminf(sum, 32767.f), -32768.f));
+}
+
+static inline int32_t accumulate_with_gain_sample_i32(int32_t dst, int32_t src, float gain,
+        double min, double max)
+{
+    const double product = src * (double)gain;
+    const double sum = product + dst;
+    return round(fmax(fmin(sum, max), min));
+}
+
+static inline float accumulate_with_gain_sample_float(float dst, float src, float gain)
+{
+    const float product = src * gain;
+    return dst + product;
+}
+
+/* Limits of accumulate_q8_23(), see clamp24_from_q8_23(). */
+#define Q8_23_MIN (-(double)(1 << 23))
+#define Q8_23_MAX ((double)((1 << 23) - 1))
+
+#if defined(USE_X86_SIMD) || defined(USE_AARCH64_SIMD)
+
+#define ACCUMULATE_BLOCK 8
+#define ACCUMULATE_CHANNELS_MAX 32
+
+/*
+ * Per sample gains for the vector kernels.  The channel gains repeat every channel_count
+ * samples, so a table of lcm(channel_count, ACCUMULATE_BLOCK) samples covers whole blocks.
+ * With a ramp, the gain of a sample is gain + (frames + frame) * increment, where frames
+ * counts the frames of the table periods already processed: the same float operations as
+ * channel_gain(), as the integer frame counts are exact in float.
+ */
+typedef struct {
+    size_t period;          /* samples, a multiple of ACCUMULATE_BLOCK */
+    size_t period_frames;
+    bool ramp;
+    float gain[ACCUMULATE_BLOCK * ACCUMULATE_CHANNELS_MAX];
+    float increment[ACCUMULATE_BLOCK * ACCUMULATE_CHANNELS_MAX];
+    float frame[ACCUMULATE_BLOCK * ACCUMULATE_CHANNELS_MAX];
+} accumulate_gain_table_t;
+
+/* Returns false if there are too many channels for the table. */
+static bool accumulate_gain_table_init(accumulate_gain_table_t *table,
+        const float *gains, const float *increments, uint32_t channel_count)
+{
+    if (channel_count > ACCUMULATE_CHANNELS_MAX) {
+        return false;
+    }
+    uint32_t gcd = channel_count;
+    for (uint32_t b = ACCUMULATE_BLOCK; b != 0; ) {
+        const uint32_t r = gcd % b;
+        gcd = b;
+        b = r;
+    }
+    table->period = channel_count / gcd * ACCUMULATE_BLOCK;
+    table->period_frames = table->period / channel_count;
+    table->ramp = increments != NULL;
+    for (size_t i = 0; i < table->period; ++i) {
+        const uint32_t channel = i % channel_count;
+        table->gain[i] = gains[channel];
+        table->increment[i] = increments != NULL ? increments[channel] : 0.f;
+        table->frame[i] = i / channel_count;
+    }
+    return true;
+}
+
+#endif /* USE_X86_SIMD || USE_AARCH64_SIMD */
+
+#ifdef USE_X86_SIMD
+
+static inline X86_TARGET_SSE4_1 __m128 x86_table_gain(
+        const accumulate_gain_table_t *table, size_t phase, __m128 frames)
+{
+    const __m128 gain = _mm_loadu_ps(table->gain + phase);
+    if (!table->ramp) {
+        return gain;
+    }
+    const __m128 frame = _mm_add_ps(frames, _mm_loadu_ps(table->frame + phase));
+    return _mm_add_ps(gain, _mm_mul_ps(frame, _mm_loadu_ps(table->increment + phase)));
+}
+
+static inline X86_TARGET_AVX2 __m256 x86_table_gain_avx2(
+        const accumulate_gain_table_t *table, size_t phase, __m256 frames)
+{
+    const __m256 gain = _mm256_loadu_ps(table->gain + phase);
+    if (!table->ramp) {
+        return gain;
+    }
+    const __m256 frame = _mm256_add_ps(frames, _mm256_loadu_ps(table->frame + phase));
+    return _mm256_add_ps(gain, _mm256_mul_ps(frame, _mm256_loadu_ps(table->increment + phase)));
+}
+
+/* round() per lane: round to nearest, ties away from zero, as x86_roundf_ps(). */
+static inline X86_TARGET_SSE4_1 __m128d x86_round_pd(__m128d x)
+{
+    const __m128d signmask = _mm_set1_pd(-0.);
+    const __m128d trunc = _mm_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m128d frac = _mm_andnot_pd(signmask, _mm_sub_pd(x, trunc));
+    const __m128d one = _mm_or_pd(_mm_set1_pd(1.), _mm_and_pd(signmask, x));
+    return _mm_add_pd(trunc, _mm_and_pd(_mm_cmpge_pd(frac, _mm_set1_pd(0.5)), one));
+}
+
+static inline X86_TARGET_AVX2 __m256d x86_round_pd_avx2(__m256d x)
+{
+    const __m256d signmask = _mm256_set1_pd(-0.);
+    const __m256d trunc = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256d frac = _mm256_andnot_pd(signmask, _mm256_sub_pd(x, trunc));
+    const __m256d one = _mm256_or_pd(_mm256_set1_pd(1.), _mm256_and_pd(signmask, x));
+    return _mm256_add_pd(trunc,
+            _mm256_and_pd(_mm256_cmp_pd(frac, _mm256_set1_pd(0.5), _CMP_GE_OQ), one));
+}
+
+/* accumulate_with_gain_sample_i16() per lane, in float. */
+static inline X86_TARGET_SSE4_1 __m128i x86_accumulate_i16x4(__m128i dst, __m128i src, __m128 gain)
+{
+    const __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(src), gain), _mm_cvtepi32_ps(dst));
+    const __m128 x = _mm_max_ps(_mm_min_ps(sum, _mm_set1_ps(32767.f)), _mm_set1_ps(-32768.f));
+    return _mm_cvttps_epi32(x86_roundf_ps(x));
+}
+
+/* accumulate_with_gain_sample_i32() on the two low lanes, in double. */
+static inline X86_TARGET_SSE4_1 __m128i x86_accumulate_i32x2(__m128i dst, __m128i src,
+        __m128 gain, __m128d min, __m128d max)
+{
+    const __m128d sum = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(src), _mm_cvtps_pd(gain)),
+            _mm_cvtepi32_pd(dst));
+    return _mm_cvttpd_epi32(x86_round_pd(_mm_max_pd(_mm_min_pd(sum, max), min)));
+}
+
+static inline X86_TARGET_AVX2 __m128i x86_accumulate_i32x4_avx2(__m128i dst, __m128i src,
+        __m128 gain, __m256d min, __m256d max)
+{
+    const __m256d sum = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_cvtepi32_pd(src), _mm256_cvtps_pd(gain)),
+            _mm256_cvtepi32_pd(dst));
+    return _mm256_cvttpd_epi32(x86_round_pd_avx2(
+            _mm256_max_pd(_mm256_min_pd(sum, max), min)));
+}
+
+/*
+ * The kernels process a multiple of ACCUMULATE_BLOCK samples, with the table phase and
+ * frame count advanced once per block.
+ */
+#define X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, addfn, setfn) \
+    do { \
+        (phase) += ACCUMULATE_BLOCK; \
+        if ((phase) == (table)->period) { \
+            (phase) = 0; \
+            (frames) = addfn((frames), setfn((float)(table)->period_frames)); \
+        } \
+    } while (0)
+
+static X86_TARGET_SSE4_1 void x86_accumulate_i16_sse4_1(int16_t *dst, const int16_t *src,
+        const accumulate_gain_table_t *table, size_t count)
+{
+    size_t phase = 0;
+    __m128 frames = _mm_setzero_ps();
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)src);
+        const __m128i d = _mm_loadu_si128((const __m128i *)dst);
+        const __m128i lo = x86_accumulate_i16x4(_mm_cvtepi16_epi32(d), _mm_cvtepi16_epi32(s),
+                x86_table_gain(table, phase, frames));
+        const __m128i hi = x86_accumulate_i16x4(_mm_cvtepi16_epi32(_mm_srli_si128(d, 8)),
+                _mm_cvtepi16_epi32(_mm_srli_si128(s, 8)),
+                x86_table_gain(table, phase + 4, frames));
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
+        X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, _mm_add_ps, _mm_set1_ps);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_accumulate_i16_avx2(int16_t *dst, const int16_t *src,
+        const accumulate_gain_table_t *table, size_t count)
+{
+    size_t phase = 0;
+    __m256 frames = _mm256_setzero_ps();
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const __m256 s = _mm256_cvtepi32_ps(
+                _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src)));
+        const __m256 d = _mm256_cvtepi32_ps(
+                _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)dst)));
+        const __m256 sum = _mm256_add_ps(
+                _mm256_mul_ps(s, x86_table_gain_avx2(table, phase, frames)), d);
+        const __m256 x = _mm256_max_ps(_mm256_min_ps(sum, _mm256_set1_ps(32767.f)),
+                _mm256_set1_ps(-32768.f));
+        const __m256i ival = _mm256_cvttps_epi32(x86_roundf_ps_avx2(x));
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(
+                _mm256_castsi256_si128(ival), _mm256_extracti128_si256(ival, 1)));
+        X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, _mm256_add_ps, _mm256_set1_ps);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+/* Shared by i32 and q8_23, which differ in the clamping limits. */
+static X86_TARGET_SSE4_1 void x86_accumulate_i32_sse4_1(int32_t *dst, const int32_t *src,
+        const accumulate_gain_table_t *table, size_t count, double min, double max)
+{
+    const __m128d vmin = _mm_set1_pd(min);
+    const __m128d vmax = _mm_set1_pd(max);
+    size_t phase = 0;
+    __m128 frames = _mm_setzero_ps();
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        for (size_t i = 0; i < ACCUMULATE_BLOCK; i += 4) {
+            const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            const __m128 gain = x86_table_gain(table, phase + i, frames);
+            const __m128i lo = x86_accumulate_i32x2(d, s, gain, vmin, vmax);
+            const __m128i hi = x86_accumulate_i32x2(_mm_srli_si128(d, 8),
+                    _mm_srli_si128(s, 8), _mm_movehl_ps(gain, gain), vmin, vmax);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi64(lo, hi));
+        }
+        X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, _mm_add_ps, _mm_set1_ps);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_accumulate_i32_avx2(int32_t *dst, const int32_t *src,
+        const accumulate_gain_table_t *table, size_t count, double min, double max)
+{
+    const __m256d vmin = _mm256_set1_pd(min);
+    const __m256d vmax = _mm256_set1_pd(max);
+    size_t phase = 0;
+    __m256 frames = _mm256_setzero_ps();
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const __m256i s = _mm256_loadu_si256((const __m256i *)src);
+        const __m256i d = _mm256_loadu_si256((const __m256i *)dst);
+        const __m256 gain = x86_table_gain_avx2(table, phase, frames);
+        const __m128i lo = x86_accumulate_i32x4_avx2(_mm256_castsi256_si128(d),
+                _mm256_castsi256_si128(s), _mm256_castps256_ps128(gain), vmin, vmax);
+        const __m128i hi = x86_accumulate_i32x4_avx2(_mm256_extracti128_si256(d, 1),
+                _mm256_extracti128_si256(s, 1), _mm256_extractf128_ps(gain, 1), vmin, vmax);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_set_m128i(hi, lo));
+        X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, _mm256_add_ps, _mm256_set1_ps);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+static X86_TARGET_SSE4_1 void x86_accumulate_float_sse4_1(float *dst, const float *src,
+        const accumulate_gain_table_t *table, size_t count)
+{
+    size_t phase = 0;
+    __m128 frames = _mm_setzero_ps();
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const __m128 lo = _mm_mul_ps(_mm_loadu_ps(src), x86_table_gain(table, phase, frames));
+        const __m128 hi = _mm_mul_ps(_mm_loadu_ps(src + 4),
+                x86_table_gain(table, phase + 4, frames));
+        _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), lo));
+        _mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4), hi));
+        X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, _mm_add_ps, _mm_set1_ps);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+static X86_TARGET_AVX2 void x86_accumulate_float_avx2(float *dst, const float *src,
+        const accumulate_gain_table_t *table, size_t count)
+{
+    size_t phase = 0;
+    __m256 frames = _mm256_setzero_ps();
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const __m256 product = _mm256_mul_ps(_mm256_loadu_ps(src),
+                x86_table_gain_avx2(table, phase, frames));
+        _mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), product));
+        X86_ACCUMULATE_NEXT_BLOCK(table, phase, frames, _mm256_add_ps, _mm256_set1_ps);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+#elif defined(USE_AARCH64_SIMD)
+
+static inline float32x4_t neon_table_gain(
+        const accumulate_gain_table_t *table, size_t phase, float32x4_t frames)
+{
+    const float32x4_t gain = vld1q_f32(table->gain + phase);
+    if (!table->ramp) {
+        return gain;
+    }
+    const float32x4_t frame = vaddq_f32(frames, vld1q_f32(table->frame + phase));
+    return vaddq_f32(gain, vmulq_f32(frame, vld1q_f32(table->increment + phase)));
+}
+
+/* accumulate_with_gain_sample_i16() per lane; FMINNM and FRINTA match fminf() and roundf(). */
+static inline int16x4_t neon_accumulate_i16x4(int16x4_t dst, int16x4_t src, float32x4_t gain)
+{
+    const float32x4_t sum = vaddq_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(src)), gain),
+            vcvtq_f32_s32(vmovl_s16(dst)));
+    const float32x4_t x = vmaxnmq_f32(vminnmq_f32(sum, vdupq_n_f32(32767.f)),
+            vdupq_n_f32(-32768.f));
+    return vmovn_s32(vcvtq_s32_f32(vrndaq_f32(x)));
+}
+
+/* accumulate_with_gain_sample_i32() on two lanes, in double. */
+static inline int32x2_t neon_accumulate_i32x2(int32x2_t dst, int32x2_t src, float32x2_t gain,
+        float64x2_t min, float64x2_t max)
+{
+    const float64x2_t sum = vaddq_f64(
+            vmulq_f64(vcvtq_f64_s64(vmovl_s32(src)), vcvt_f64_f32(gain)),
+            vcvtq_f64_s64(vmovl_s32(dst)));
+    return vmovn_s64(vcvtq_s64_f64(vrndaq_f64(vmaxnmq_f64(vminnmq_f64(sum, max), min))));
+}
+
+#define NEON_ACCUMULATE_NEXT_BLOCK(table, phase, frames) \
+    do { \
+        (phase) += ACCUMULATE_BLOCK; \
+        if ((phase) == (table)->period) { \
+            (phase) = 0; \
+            (frames) = vaddq_f32((frames), vdupq_n_f32((float)(table)->period_frames)); \
+        } \
+    } while (0)
+
+static void neon_accumulate_i16(int16_t *dst, const int16_t *src,
+        const accumulate_gain_table_t *table, size_t count)
+{
+    size_t phase = 0;
+    float32x4_t frames = vdupq_n_f32(0.f);
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const int16x8_t s = vld1q_s16(src);
+        const int16x8_t d = vld1q_s16(dst);
+        const int16x4_t lo = neon_accumulate_i16x4(vget_low_s16(d), vget_low_s16(s),
+                neon_table_gain(table, phase, frames));
+        const int16x4_t hi = neon_accumulate_i16x4(vget_high_s16(d), vget_high_s16(s),
+                neon_table_gain(table, phase + 4, frames));
+        vst1q_s16(dst, vcombine_s16(lo, hi));
+        NEON_ACCUMULATE_NEXT_BLOCK(table, phase, frames);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+static void neon_accumulate_i32(int32_t *dst, const int32_t *src,
+        const accumulate_gain_table_t *table, size_t count, double min, double max)
+{
+    const float64x2_t vmin = vdupq_n_f64(min);
+    const float64x2_t vmax = vdupq_n_f64(max);
+    size_t phase = 0;
+    float32x4_t frames = vdupq_n_f32(0.f);
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        for (size_t i = 0; i < ACCUMULATE_BLOCK; i += 4) {
+            const int32x4_t s = vld1q_s32(src + i);
+            const int32x4_t d = vld1q_s32(dst + i);
+            const float32x4_t gain = neon_table_gain(table, phase + i, frames);
+            const int32x2_t lo = neon_accumulate_i32x2(vget_low_s32(d), vget_low_s32(s),
+                    vget_low_f32(gain), vmin, vmax);
+            const int32x2_t hi = neon_accumulate_i32x2(vget_high_s32(d), vget_high_s32(s),
+                    vget_high_f32(gain), vmin, vmax);
+            vst1q_s32(dst + i, vcombine_s32(lo, hi));
+        }
+        NEON_ACCUMULATE_NEXT_BLOCK(table, phase, frames);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+static void neon_accumulate_float(float *dst, const float *src,
+        const accumulate_gain_table_t *table, size_t count)
+{
+    size_t phase = 0;
+    float32x4_t frames = vdupq_n_f32(0.f);
+    for (; count > 0; count -= ACCUMULATE_BLOCK) {
+        const float32x4_t lo = vmulq_f32(vld1q_f32(src), neon_table_gain(table, phase, frames));
+        const float32x4_t hi = vmulq_f32(vld1q_f32(src + 4),
+                neon_table_gain(table, phase + 4, frames));
+        vst1q_f32(dst, vaddq_f32(vld1q_f32(dst), lo));
+        vst1q_f32(dst + 4, vaddq_f32(vld1q_f32(dst + 4), hi));
+        NEON_ACCUMULATE_NEXT_BLOCK(table, phase, frames);
+        src += ACCUMULATE_BLOCK;
+        dst += ACCUMULATE_BLOCK;
+    }
+}
+
+#endif /* USE_X86_SIMD */
+
+/*
+ * Runs the vector kernel KERNEL_<isa> on the leading whole blocks of samples, and sets
+ * i to the number of samples processed.  Trailing arguments are passed to the kernel.
+ */
+#if defined(USE_X86_SIMD)
+#define ACCUMULATE_WITH_GAIN_SIMD(kernel, dst, src, gains, increments, channel_count, count, \
+        i, ...) \
+    do { \
+        const x86_simd_level_t level = x86_simd_level(); \
+        const size_t vcount = level == X86_SIMD_NONE \
+                ? 0 : (count) & ~(size_t)(ACCUMULATE_BLOCK - 1); \
+        accumulate_gain_table_t table; \
+        if (vcount > 0 \
+                && accumulate_gain_table_init(&table, gains, increments, channel_count)) { \
+            if (level == X86_SIMD_AVX2) { \
+                x86_##kernel##_avx2(dst, src, &table, vcount, ##__VA_ARGS__); \
+            } else { \
+                x86_##kernel##_sse4_1(dst, src, &table, vcount, ##__VA_ARGS__); \
+            } \
+            (i) = vcount; \
+        } \
+    } while (0)
+#elif defined(USE_AARCH64_SIMD)
+#define ACCUMULATE_WITH_GAIN_SIMD(kernel, dst, src, gains, increments, channel_count, count, \
+        i, ...) \
+    do { \
+        const size_t vcount = (count) & ~(size_t)(ACCUMULATE_BLOCK - 1); \
+        accumulate_gain_table_t table; \
+        if (vcount > 0 \
+                && accumulate_gain_table_init(&table, gains, increments, channel_count)) { \
+            neon_##kernel(dst, src, &table, vcount, ##__VA_ARGS__); \
+            (i) = vcount; \
+        } \
+    } while (0)
+#else
+#define ACCUMULATE_WITH_GAIN_SIMD(kernel, dst, src, gains, increments, channel_count, count, \
+        i, ...)
+#endif
+
+void accumulate_with_channel_gains_i16(int16_t *dst, const int16_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count)
+{
+    const size_t count = frame_count * channel_count;
+    size_t i = 0;
+    ACCUMULATE_WITH_GAIN_SIMD(accumulate_i16, dst, src, gains, increments, channel_count,
+            count, i);
+    size_t frame = channel_count == 0 ? 0 : i / channel_count;
+    uint32_t channel = i - frame * channel_count;
+    for (; i < count; ++i) {
+        dst[i] = accumulate_with_gain_sample_i16(dst[i], src[i],
+                channel_gain(gains, increments, channel, frame));
+        if (++channel == channel_count) {
+            channel = 0;
+            ++frame;
+        }
+    }
+}
+
+static void accumulate_with_channel_gains_i32_clamp(int32_t *dst, const int32_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count,
+        double min, double max)
+{
+    const size_t count = frame_count * channel_count;
+    size_t i = 0;
+    ACCUMULATE_WITH_GAIN_SIMD(accumulate_i32, dst, src, gains, increments, channel_count,
+            count, i, min, max);
+    size_t frame = channel_count == 0 ? 0 : i / channel_count;
+    uint32_t channel = i - frame * channel_count;
+    for (; i < count; ++i) {
+        dst[i] = accumulate_with_gain_sample_i32(dst[i], src[i],
+                channel_gain(gains, increments, channel, frame), min, max);
+        if (++channel == channel_count) {
+            channel = 0;
+            ++frame;
+        }
+    }
+}
+
+void accumulate_with_channel_gains_q8_23(int32_t *dst, const int32_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count)
+{
+    accumulate_with_channel_gains_i32_clamp(dst, src, gains, increments, channel_count,
+            frame_count, Q8_23_MIN, Q8_23_MAX);
+}
+
+void accumulate_with_channel_gains_i32(int32_t *dst, const int32_t *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count)
+{
+    accumulate_with_channel_gains_i32_clamp(dst, src, gains, increments, channel_count,
+            frame_count, INT32_MIN, INT32_MAX);
+}
+
+void accumulate_with_channel_gains_float(float *dst, const float *src,
+        const float *gains, const float *increments, uint32_t channel_count, size_t frame_count)
+{
+    const size_t count = frame_count * channel_count;
+    size_t i = 0;
+    ACCUMULATE_WITH_GAIN_SIMD(accumulate_float, dst, src, gains, increments, channel_count,
+            count, i);
+    size_t frame = channel_count == 0 ? 0 : i / channel_count;
+    uint32_t channel = i - frame * channel_count;
+    for (; i < count; ++i) {
+        dst[i] = accumulate_with_gain_sample_float(dst[i], src[i],
+                channel_gain(gains, increments, channel, frame));
+        if (++channel == channel_count) {
+            channel = 0;
+            ++frame;
+        }
+    }
+}
+
+void accumulate_with_gain_i16(int16_t *dst, const int16_t *src, float gain, size_t count)
+{
+    accumulate_with_channel_gains_i16(dst, src, &gain, NULL /* increments */, 1, count);
+}
+
+void accumulate_with_gain_q8_23(int32_t *dst, const int32_t *src, float gain, size_t count)
+{
+    accumulate_with_channel_gains_q8_23(dst, src, &gain, NULL /* increments */, 1, count);
+}
+
+void accumulate_with_gain_i32(int32_t *dst, const int32_t *src, float gain, size_t count)
+{
+    accumulate_with_channel_gains_i32(dst, src, &gain, NULL /* increments */, 1, count);
+}
+
+void accumulate_with_gain_float(float *dst, const float *src, float gain, size_t count)
+{
+    accumulate_with_channel_gains_float(dst, src, &gain, NULL /* increments */, 1, count);
+}
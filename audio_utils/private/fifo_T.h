@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FIFO_T_PRIVATE_H
+#define ANDROID_AUDIO_FIFO_T_PRIVATE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Shared by audio_utils_fifo_writer_T and audio_utils_fifo_reader_T.
+
+template <typename T>
+static inline void memcpyWords(T *dst, const T *src, uint32_t count)
+{
+    switch (count) {
+    case 0: break;
+// TODO templatize here also, but first confirm no performance regression compared to current
+#define _(n) \
+    case n: { \
+        struct s##n { T a[n]; }; \
+        *(struct s##n *)dst = *(const struct s##n *)src; \
+        break; \
+    }
+    _(1) _(2) _(3) _(4) _(5) _(6) _(7) _(8) _(9) _(10) _(11) _(12) _(13) _(14) _(15) _(16)
+#undef _
+    default:
+        memcpy(dst, src, count * sizeof(T));
+        break;
+    }
+}
+
+#endif // ANDROID_AUDIO_FIFO_T_PRIVATE_H
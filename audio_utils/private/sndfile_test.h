@@ -0,0 +1,35 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SNDFILE_TEST_H
+#define ANDROID_AUDIO_SNDFILE_TEST_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <audio_utils/sndfile.h>
+
+__BEGIN_DECLS
+
+/* For the sndfile tests only: as sf_open64(), but a stream open for writing is upgraded to
+ * RF64 by sf_close() from a RIFF size of rf64Threshold rather than 4 GiB, so that the upgrade
+ * can be tested without writing 4 GiB of data.
+ */
+SNDFILE *sf_open64_for_test(const char *path, int mode, SF_INFO64 *info,
+        uint64_t rf64Threshold);
+
+__END_DECLS
+
+#endif /*ANDROID_AUDIO_SNDFILE_TEST_H*/
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_X86_SIMD_H
+#define ANDROID_AUDIO_X86_SIMD_H
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/* Levels of the x86 vector kernels selected at runtime. */
+typedef enum {
+    AUDIO_UTILS_X86_SIMD_NONE,      /* scalar code only */
+    AUDIO_UTILS_X86_SIMD_SSE,       /* SSE4.1 conversion and SSE2 energy kernels */
+    AUDIO_UTILS_X86_SIMD_AVX2,      /* AVX2 kernels when the cpu supports them, the default */
+} audio_utils_x86_simd_level_t;
+
+/* Returns the highest x86 vector kernel level to use. */
+audio_utils_x86_simd_level_t audio_utils_get_x86_simd_level_cap(void);
+
+/* For tests only: caps the x86 vector kernels used by the conversion, dither, accumulate
+ * and energy functions, so that the fallbacks used on less capable cpus are tested on any
+ * host.  Must not be called while those functions run in other threads.
+ * Returns the previous level, or -ENOSYS if not on x86.
+ */
+int audio_utils_set_x86_simd_level_for_test(audio_utils_x86_simd_level_t level);
+
+__END_DECLS
+
+#endif /*ANDROID_AUDIO_X86_SIMD_H*/
@@ -18,65 +18,602 @@
 #define LOG_TAG "resampler"
 
 #include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <log/log.h>
 
 #include <system/audio.h>
+#include <audio_utils/primitives.h>
 #include <audio_utils/resampler.h>
-#include <speex/speex_resampler.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define USE_X86_SIMD
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON_SIMD
+#endif
+
+/* Filter lengths are a multiple of this, so the dot products need no scalar tail. */
+#define RESAMPLER_TAPS_ALIGN 8
+/* Longest filter, reached when downsampling by a large ratio at high quality. */
+#define RESAMPLER_TAPS_MAX 2048
+/* Rational ratios with up to this many phases use one exact filter per phase. */
+#define RESAMPLER_PHASES_MAX 1024
+/* Otherwise the filter is tabulated at this many phases and linearly interpolated. */
+#define RESAMPLER_PHASES_INTERPOLATED 256
+/* Up to this many channels, interpolated filters interpolate outputs rather than rows. */
+#define RESAMPLER_INTERPOLATE_OUTPUTS_MAX_CHANNELS 4
+/* Input frames taken from the caller at a time, and output frames converted at a time. */
+#define RESAMPLER_CHUNK_FRAMES 256
+
+/*
+ * Kaiser windowed sinc filters, with lengths and bandwidths following the speex quality
+ * levels so that RESAMPLER_QUALITY_* keep their meaning.  The bandwidth is relative to the
+ * lower of the two Nyquist frequencies.
+ */
+static const struct {
+    uint32_t taps;
+    float downsample_bandwidth;
+    float upsample_bandwidth;
+    float beta;
+} resampler_quality[RESAMPLER_QUALITY_MAX + 1] = {
+    {8, 0.830f, 0.860f, 6.f},
+    {16, 0.850f, 0.880f, 6.f},
+    {32, 0.882f, 0.910f, 6.f},
+    {48, 0.895f, 0.917f, 8.f},
+    {64, 0.921f, 0.940f, 8.f},
+    {80, 0.922f, 0.940f, 10.f},
+    {96, 0.940f, 0.945f, 10.f},
+    {128, 0.950f, 0.950f, 10.f},
+    {160, 0.960f, 0.960f, 10.f},
+    {192, 0.968f, 0.968f, 12.f},
+    {256, 0.975f, 0.975f, 12.f},
+};
+
+/*
+ * Polyphase filter for one conversion ratio and quality.  Filters are immutable once
+ * designed, and shared by all the resamplers with the same ratio and quality through
+ * a process wide reference counted cache.
+ */
+struct resampler_filter {
+    struct resampler_filter *next;              // in the cache list
+    uint32_t refcount;                          // protected by the cache lock
+    uint32_t in_ratio;                          // key: in_sample_rate / gcd
+    uint32_t out_ratio;                         //      out_sample_rate / gcd
+    uint32_t quality;                           //      RESAMPLER_QUALITY_*
+    bool interpolate;                           //      rows are interpolated, phases + 1 of them
+
+    // row p holds the taps for an output at phase p / phases after an input frame
+    uint32_t taps;                              // filter length, multiple of TAPS_ALIGN
+    uint32_t phases;                            // number of phases
+    float *coefs;                               // rows of taps coefficients
+};
+
+/* Dot product kernel, chosen for the CPU by resampler_select_dot() at creation. */
+typedef float (*resampler_dot_t)(const float *coefs, const float *x, size_t taps);
 
 struct resampler {
     struct resampler_itfe itfe;
-    SpeexResamplerState *speex_resampler;       // handle on speex resampler
     struct resampler_buffer_provider *provider; // buffer provider installed by client
+    audio_format_t format;                      // of the provider buffers
     uint32_t in_sample_rate;                    // input sampling rate in Hz
     uint32_t out_sample_rate;                   // output sampling rate in Hz
     uint32_t channel_count;                     // number of channels (interleaved)
-    int16_t *in_buf;                            // input buffer
-    size_t in_buf_size;                         // input buffer size
-    size_t frames_in;                           // number of frames in input buffer
-    size_t frames_rq;                           // cached number of output frames
-    size_t frames_needed;                       // minimum number of input frames to produce
-                                                // frames_rq output frames
-    int32_t speex_delay_ns;                     // delay introduced by speex resampler in ns
+    uint32_t flags;                             // RESAMPLER_FLAG_*
+
+    const struct resampler_filter *filter;      // shared, from the cache
+    resampler_dot_t dot;                        // best dot product for the CPU
+    float *row;                                 // interpolated row, when filter->interpolate
+
+    // position of the next output: window start within the history, and phase
+    size_t pos;
+    uint32_t phase;                             // numerator over phases, or 32-bit fraction
+    uint32_t step_int;                          // input frames per output frame, integer part
+    uint32_t step_frac;                         // and fractional part, as phase
+    int32_t ratio_ppm;                          // set by set_ratio_ppm()
+
+    // history of input frames, deinterleaved into one plane per channel
+    float *hist;
+    size_t hist_capacity;                       // frames per plane
+    size_t hist_frames;                         // valid frames per plane
+
+    float *out_buf;                             // RESAMPLER_CHUNK_FRAMES interleaved float
 };
 
+//------------------------------------------------------------------------------
+// filter design
+//------------------------------------------------------------------------------
+
+/* zeroth order modified Bessel function of the first kind */
+static double resampler_bessel_i0(double x)
+{
+    double sum = 1.;
+    double term = 1.;
+    const double x2 = x * x / 4.;
+    for (int k = 1; k < 50 && term > sum * 1e-12; ++k) {
+        term *= x2 / ((double) k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+/*
+ * Fills phases rows of taps coefficients.  Row p weights the taps input frames of a window
+ * for an output at time p / phases after frame taps / 2 - 1 of the window.  Each row is
+ * normalized to unity DC gain.
+ */
+static void resampler_design(float *coefs, uint32_t taps, uint32_t rows, uint32_t phases,
+        double cutoff, double beta)
+{
+    const double half = taps / 2.;
+    const double i0_beta = resampler_bessel_i0(beta);
+    for (uint32_t p = 0; p < rows; ++p) {
+        float *row = &coefs[(size_t) p * taps];
+        double sum = 0.;
+        for (uint32_t k = 0; k < taps; ++k) {
+            const double t = (double) p / phases + half - 1. - k;
+            double h = 0.;
+            if (fabs(t) < half) {
+                const double x = t / half;
+                const double w = resampler_bessel_i0(beta * sqrt(1. - x * x)) / i0_beta;
+                const double s = t == 0. ? 1. : sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+                h = cutoff * s * w;
+            }
+            row[k] = (float) h;
+            sum += h;
+        }
+        if (sum != 0.) {
+            for (uint32_t k = 0; k < taps; ++k) {
+                row[k] = (float) (row[k] / sum);
+            }
+        }
+    }
+}
+
+static uint32_t resampler_gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        const uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void *resampler_alloc(size_t bytes)
+{
+    void *ptr = NULL;
+    // 32 byte alignment for the AVX loads of the coefficients
+    return posix_memalign(&ptr, 32, bytes) == 0 ? ptr : NULL;
+}
+
+/*
+ * Designs the filter for the ratio in / out, both reduced.  Filters with more than
+ * RESAMPLER_PHASES_MAX phases are always interpolated; otherwise an interpolated filter
+ * may be requested, as needed when the ratio varies.
+ */
+static struct resampler_filter *resampler_filter_create(uint32_t in, uint32_t out,
+        uint32_t quality, bool interpolate)
+{
+    struct resampler_filter *filter =
+            (struct resampler_filter *) calloc(1, sizeof(struct resampler_filter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->in_ratio = in;
+    filter->out_ratio = out;
+    filter->quality = quality;
+
+    double cutoff;
+    uint64_t taps = resampler_quality[quality].taps;
+    if (in > out) {
+        // downsampling: widen the filter in proportion, to keep the transition band
+        cutoff = resampler_quality[quality].downsample_bandwidth * out / in;
+        taps = (taps * in + out - 1) / out;
+        taps = (taps + RESAMPLER_TAPS_ALIGN - 1) & ~(uint64_t) (RESAMPLER_TAPS_ALIGN - 1);
+        if (taps > RESAMPLER_TAPS_MAX) {
+            taps = RESAMPLER_TAPS_MAX;
+        }
+    } else {
+        cutoff = resampler_quality[quality].upsample_bandwidth;
+    }
+    filter->taps = (uint32_t) taps;
+
+    filter->interpolate = interpolate || out > RESAMPLER_PHASES_MAX;
+    uint32_t rows;
+    if (!filter->interpolate) {
+        filter->phases = out;
+        rows = out;
+    } else {
+        filter->phases = RESAMPLER_PHASES_INTERPOLATED;
+        rows = RESAMPLER_PHASES_INTERPOLATED + 1;
+    }
+    filter->coefs = (float *) resampler_alloc((size_t) rows * filter->taps * sizeof(float));
+    if (filter->coefs == NULL) {
+        free(filter);
+        return NULL;
+    }
+    resampler_design(filter->coefs, filter->taps, rows, filter->phases, cutoff,
+            resampler_quality[quality].beta);
+    return filter;
+}
+
+static pthread_mutex_t resampler_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct resampler_filter *resampler_cache;   // list of filters in use
+
+/*
+ * Returns the filter for the conversion, designing it if no resampler currently uses it,
+ * or NULL if out of memory.  Sample rates with the same ratio share a filter.
+ */
+static const struct resampler_filter *resampler_filter_acquire(uint32_t in_sample_rate,
+        uint32_t out_sample_rate, uint32_t quality, bool interpolate)
+{
+    const uint32_t gcd = resampler_gcd(in_sample_rate, out_sample_rate);
+    const uint32_t in = in_sample_rate / gcd;
+    const uint32_t out = out_sample_rate / gcd;
+    interpolate = interpolate || out > RESAMPLER_PHASES_MAX;
+
+    pthread_mutex_lock(&resampler_cache_lock);
+    struct resampler_filter *filter;
+    for (filter = resampler_cache; filter != NULL; filter = filter->next) {
+        if (filter->in_ratio == in && filter->out_ratio == out && filter->quality == quality &&
+                filter->interpolate == interpolate) {
+            break;
+        }
+    }
+    if (filter == NULL) {
+        // designed under the lock, so that concurrent creations do not duplicate the work
+        filter = resampler_filter_create(in, out, quality, interpolate);
+        if (filter != NULL) {
+            filter->next = resampler_cache;
+            resampler_cache = filter;
+        }
+    }
+    if (filter != NULL) {
+        ++filter->refcount;
+    }
+    pthread_mutex_unlock(&resampler_cache_lock);
+    return filter;
+}
+
+/* Releases a filter returned by resampler_filter_acquire(), freeing it with its last user. */
+static void resampler_filter_release(const struct resampler_filter *filter)
+{
+    pthread_mutex_lock(&resampler_cache_lock);
+    struct resampler_filter **link = &resampler_cache;
+    while (*link != filter) {
+        link = &(*link)->next;
+    }
+    struct resampler_filter *found = *link;
+    if (--found->refcount == 0) {
+        *link = found->next;
+        free(found->coefs);
+        free(found);
+    }
+    pthread_mutex_unlock(&resampler_cache_lock);
+}
 
 //------------------------------------------------------------------------------
-// speex based resampler
+// inner loops
 //------------------------------------------------------------------------------
 
+#ifdef USE_X86_SIMD
+
+static __attribute__((target("avx2,fma"))) float x86_dot_avx2(
+        const float *coefs, const float *x, size_t taps)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 16 <= taps; k += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(&coefs[k]), _mm256_loadu_ps(&x[k]), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(&coefs[k + 8]), _mm256_loadu_ps(&x[k + 8]), acc1);
+    }
+    if (k < taps) {
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(&coefs[k]), _mm256_loadu_ps(&x[k]), acc0);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+/* SSE is in the x86-64 baseline, and in that of the Android x86 ABI. */
+static float x86_dot_sse(const float *coefs, const float *x, size_t taps)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (size_t k = 0; k < taps; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(&coefs[k]), _mm_loadu_ps(&x[k])));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(&coefs[k + 4]), _mm_loadu_ps(&x[k + 4])));
+    }
+    __m128 sum = _mm_add_ps(acc0, acc1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#endif /* USE_X86_SIMD */
+
+#ifndef USE_X86_SIMD
+
+/* Returns the dot product of taps coefficients and input frames, taps a multiple of 8. */
+static float resampler_dot(const float *coefs, const float *x, size_t taps)
+{
+#if defined(USE_NEON_SIMD)
+    float32x4_t acc0 = vdupq_n_f32(0.f);
+    float32x4_t acc1 = vdupq_n_f32(0.f);
+    for (size_t k = 0; k < taps; k += 8) {
+#if defined(__aarch64__)
+        acc0 = vfmaq_f32(acc0, vld1q_f32(&coefs[k]), vld1q_f32(&x[k]));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(&coefs[k + 4]), vld1q_f32(&x[k + 4]));
+#else
+        acc0 = vmlaq_f32(acc0, vld1q_f32(&coefs[k]), vld1q_f32(&x[k]));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(&coefs[k + 4]), vld1q_f32(&x[k + 4]));
+#endif
+    }
+    const float32x4_t sum = vaddq_f32(acc0, acc1);
+    const float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+#else
+    float sum = 0.f;
+    for (size_t k = 0; k < taps; ++k) {
+        sum += coefs[k] * x[k];
+    }
+    return sum;
+#endif
+}
+
+#endif /* !USE_X86_SIMD */
+
+static resampler_dot_t resampler_select_dot(void)
+{
+#ifdef USE_X86_SIMD
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return x86_dot_avx2;
+    }
+    return x86_dot_sse;
+#else
+    return resampler_dot;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// native polyphase resampler
+//------------------------------------------------------------------------------
+
+/*
+ * Makes room for frames more frames of history, dropping those already consumed.  The history
+ * is sized at creation for the filter window and RESAMPLER_CHUNK_FRAMES, and every append is
+ * at most RESAMPLER_CHUNK_FRAMES once the window can no longer produce output, so this never
+ * allocates on the audio path.
+ */
+static void resampler_reserve(struct resampler *rsmp, size_t frames)
+{
+    const size_t cc = rsmp->channel_count;
+    const size_t keep = rsmp->hist_frames - rsmp->pos;
+    if (rsmp->pos > 0) {
+        for (size_t c = 0; c < cc; ++c) {
+            float *plane = &rsmp->hist[c * rsmp->hist_capacity];
+            memmove(plane, &plane[rsmp->pos], keep * sizeof(float));
+        }
+        rsmp->hist_frames = keep;
+        rsmp->pos = 0;
+    }
+    LOG_ALWAYS_FATAL_IF(keep + frames > rsmp->hist_capacity,
+            "history of %zu frames overflows with %zu more", keep, frames);
+}
+
+/*
+ * Appends at most RESAMPLER_CHUNK_FRAMES interleaved frames in format to the history,
+ * deinterleaving into float planes.
+ */
+static void resampler_append(struct resampler *rsmp, const void *in, audio_format_t format,
+        size_t frames)
+{
+    resampler_reserve(rsmp, frames);
+    const size_t cc = rsmp->channel_count;
+    for (size_t c = 0; c < cc; ++c) {
+        float *dst = &rsmp->hist[c * rsmp->hist_capacity + rsmp->hist_frames];
+        if (format == AUDIO_FORMAT_PCM_FLOAT) {
+            const float *src = (const float *) in + c;
+            if (cc == 1) {
+                memcpy(dst, src, frames * sizeof(float));
+            } else {
+                for (size_t i = 0; i < frames; ++i) {
+                    dst[i] = src[i * cc];
+                }
+            }
+        } else {
+            const int16_t *src = (const int16_t *) in + c;
+            if (cc == 1) {
+                memcpy_to_float_from_i16(dst, src, frames);
+            } else {
+                for (size_t i = 0; i < frames; ++i) {
+                    dst[i] = float_from_i16(src[i * cc]);
+                }
+            }
+        }
+    }
+    rsmp->hist_frames += frames;
+}
+
+/* Produces at most frames interleaved float frames from the history, returns the number. */
+static size_t resampler_process(struct resampler *rsmp, float *out, size_t frames)
+{
+    const resampler_dot_t dot = rsmp->dot;
+    const size_t cc = rsmp->channel_count;
+    const struct resampler_filter *filter = rsmp->filter;
+    const size_t taps = filter->taps;
+    const float *hist = rsmp->hist;
+    const size_t capacity = rsmp->hist_capacity;
+    size_t pos = rsmp->pos;
+    uint32_t phase = rsmp->phase;
+    size_t produced = 0;
+    for (; produced < frames && pos + taps <= rsmp->hist_frames; ++produced) {
+        if (!filter->interpolate) {
+            const float *row = &filter->coefs[(size_t) phase * taps];
+            for (size_t c = 0; c < cc; ++c) {
+                out[produced * cc + c] = dot(row, &hist[c * capacity + pos], taps);
+            }
+        } else {
+            // linear interpolation between the two nearest tabulated phases
+            const uint64_t scaled = (uint64_t) phase * filter->phases;
+            const float *a = &filter->coefs[(size_t) (scaled >> 32) * taps];
+            const float *b = a + taps;
+            const float frac = (float) (uint32_t) scaled * (1.f / 4294967296.f);
+            if (cc <= RESAMPLER_INTERPOLATE_OUTPUTS_MAX_CHANNELS) {
+                // few channels: interpolating the outputs of both rows is cheaper
+                for (size_t c = 0; c < cc; ++c) {
+                    const float *h = &hist[c * capacity + pos];
+                    const float outA = dot(a, h, taps);
+                    out[produced * cc + c] = outA + frac * (dot(b, h, taps) - outA);
+                }
+            } else {
+                float *row = rsmp->row;
+                for (size_t k = 0; k < taps; ++k) {
+                    row[k] = a[k] + frac * (b[k] - a[k]);
+                }
+                for (size_t c = 0; c < cc; ++c) {
+                    out[produced * cc + c] = dot(row, &hist[c * capacity + pos], taps);
+                }
+            }
+        }
+        pos += rsmp->step_int;
+        if (!filter->interpolate) {
+            phase += rsmp->step_frac;
+            if (phase >= filter->phases) {
+                phase -= filter->phases;
+                ++pos;
+            }
+        } else {
+            const uint32_t next = phase + rsmp->step_frac;
+            pos += next < phase; // carry
+            phase = next;
+        }
+    }
+    rsmp->pos = pos;
+    rsmp->phase = phase;
+    return produced;
+}
+
+/* Stores float frames to out in format, returns the advanced out pointer. */
+static void *resampler_store(void *out, audio_format_t format, const float *src, size_t count)
+{
+    if (format == AUDIO_FORMAT_PCM_FLOAT) {
+        if (out != src) {
+            memcpy(out, src, count * sizeof(float));
+        }
+        return (float *) out + count;
+    }
+    memcpy_to_i16_from_float((int16_t *) out, src, count);
+    return (int16_t *) out + count;
+}
+
+/* Produces at most frames frames to out in format, returns the number. */
+static size_t resampler_output(struct resampler *rsmp, void *out, audio_format_t format,
+        size_t frames)
+{
+    const size_t cc = rsmp->channel_count;
+    size_t produced = 0;
+    while (produced < frames) {
+        size_t chunk = frames - produced;
+        float *dst;
+        if (format == AUDIO_FORMAT_PCM_FLOAT) {
+            dst = (float *) out;
+        } else {
+            if (chunk > RESAMPLER_CHUNK_FRAMES) {
+                chunk = RESAMPLER_CHUNK_FRAMES;
+            }
+            dst = rsmp->out_buf;
+        }
+        const size_t actual = resampler_process(rsmp, dst, chunk);
+        out = resampler_store(out, format, dst, actual * cc);
+        produced += actual;
+        if (actual < chunk) {
+            break;
+        }
+    }
+    return produced;
+}
+
 static void resampler_reset(struct resampler_itfe *resampler)
 {
     struct resampler *rsmp = (struct resampler *)resampler;
 
-    rsmp->frames_in = 0;
-    rsmp->frames_rq = 0;
+    if (rsmp == NULL) {
+        return;
+    }
+    // prime the history so that the first output is centered on the first input frame
+    const size_t prime = rsmp->filter->taps / 2 - 1;
+    for (size_t c = 0; c < rsmp->channel_count; ++c) {
+        memset(&rsmp->hist[c * rsmp->hist_capacity], 0, prime * sizeof(float));
+    }
+    rsmp->hist_frames = prime;
+    rsmp->pos = 0;
+    rsmp->phase = 0;
+}
 
-    if (rsmp != NULL && rsmp->speex_resampler != NULL) {
-        speex_resampler_reset_mem(rsmp->speex_resampler);
+static int resampler_reset_with_history_l(struct resampler *rsmp, const void *in,
+        audio_format_t format, size_t inFrameCount)
+{
+    if (rsmp == NULL || (in == NULL && inFrameCount > 0)) {
+        return -EINVAL;
+    }
+    resampler_reset(&rsmp->itfe);
+    // the last frames of in replace the end of the silence primed by reset
+    const size_t prime = rsmp->hist_frames;
+    if (inFrameCount > prime) {
+        in = (const uint8_t *)in + (inFrameCount - prime)
+                * audio_bytes_per_sample(format) * rsmp->channel_count;
+        inFrameCount = prime;
+    }
+    rsmp->hist_frames = prime - inFrameCount;
+    if (inFrameCount > 0) {
+        resampler_append(rsmp, in, format, inFrameCount);
     }
+    return 0;
+}
+
+static int resampler_reset_with_history(struct resampler_itfe *resampler,
+        const int16_t *in, size_t inFrameCount)
+{
+    return resampler_reset_with_history_l((struct resampler *)resampler,
+            in, AUDIO_FORMAT_PCM_16_BIT, inFrameCount);
+}
+
+static int resampler_reset_with_history_float(struct resampler_itfe *resampler,
+        const float *in, size_t inFrameCount)
+{
+    return resampler_reset_with_history_l((struct resampler *)resampler,
+            in, AUDIO_FORMAT_PCM_FLOAT, inFrameCount);
 }
 
 static int32_t resampler_delay_ns(struct resampler_itfe *resampler)
 {
     struct resampler *rsmp = (struct resampler *)resampler;
 
-    int32_t delay = (int32_t)((1000000000 * (int64_t)rsmp->frames_in) / rsmp->in_sample_rate);
-    delay += rsmp->speex_delay_ns;
-
-    return delay;
+    // input frames buffered from the center of the next output's window on: the history is
+    // primed so that outputs are centered on their input, with no further delay
+    const double phase = rsmp->filter->interpolate ? rsmp->phase * (1. / 4294967296.)
+            : (double) rsmp->phase / rsmp->filter->phases;
+    const double frames = (double) rsmp->hist_frames
+            - (rsmp->pos + rsmp->filter->taps / 2 - 1) - phase;
+    return frames > 0. ? (int32_t) (1e9 * frames / rsmp->in_sample_rate) : 0;
 }
 
 // outputs a number of frames less or equal to *outFrameCount and updates *outFrameCount
 // with the actual number of frames produced.
-int resampler_resample_from_provider(struct resampler_itfe *resampler,
-                       int16_t *out,
+static int resampler_resample_from_provider_l(struct resampler *rsmp,
+                       void *out, audio_format_t outFormat,
                        size_t *outFrameCount)
 {
-    struct resampler *rsmp = (struct resampler *)resampler;
-
     if (rsmp == NULL || out == NULL || outFrameCount == NULL) {
         return -EINVAL;
     }
@@ -85,79 +622,46 @@ int resampler_resample_from_provider(struct resampler_itfe *resampler,
         return -ENOSYS;
     }
 
-    size_t framesRq = *outFrameCount;
-    // update and cache the number of frames needed at the input sampling rate to produce
-    // the number of frames requested at the output sampling rate
-    if (framesRq != rsmp->frames_rq) {
-        rsmp->frames_needed = (framesRq * rsmp->in_sample_rate) / rsmp->out_sample_rate + 1;
-        rsmp->frames_rq = framesRq;
-    }
-
+    const size_t framesRq = *outFrameCount;
+    const size_t frameSize = audio_bytes_per_sample(outFormat) * rsmp->channel_count;
     size_t framesWr = 0;
-    spx_uint32_t inFrames = 0;
     while (framesWr < framesRq) {
-        if (rsmp->frames_in < rsmp->frames_needed) {
-            // make sure that the number of frames present in rsmp->in_buf (rsmp->frames_in) is at
-            // least the number of frames needed to produce the number of frames requested at
-            // the output sampling rate
-            if (rsmp->in_buf_size < rsmp->frames_needed) {
-                rsmp->in_buf_size = rsmp->frames_needed;
-                rsmp->in_buf = (int16_t *)realloc(rsmp->in_buf,
-                                        rsmp->in_buf_size * rsmp->channel_count * sizeof(int16_t));
-            }
-            struct resampler_buffer buf;
-            buf.frame_count = rsmp->frames_needed - rsmp->frames_in;
-            rsmp->provider->get_next_buffer(rsmp->provider, &buf);
-            if (buf.raw == NULL) {
-                break;
-            }
-            memcpy(rsmp->in_buf + rsmp->frames_in * rsmp->channel_count,
-                    buf.raw,
-                    buf.frame_count * rsmp->channel_count * sizeof(int16_t));
-            rsmp->frames_in += buf.frame_count;
-            rsmp->provider->release_buffer(rsmp->provider, &buf);
+        framesWr += resampler_output(rsmp, (uint8_t *)out + framesWr * frameSize, outFormat,
+                framesRq - framesWr);
+        if (framesWr == framesRq) {
+            break;
         }
-
-        spx_uint32_t outFrames = framesRq - framesWr;
-        inFrames = rsmp->frames_in;
-        if (rsmp->channel_count == 1) {
-            speex_resampler_process_int(rsmp->speex_resampler,
-                                        0,
-                                        rsmp->in_buf,
-                                        &inFrames,
-                                        out + framesWr,
-                                        &outFrames);
-        } else {
-            speex_resampler_process_interleaved_int(rsmp->speex_resampler,
-                                        rsmp->in_buf,
-                                        &inFrames,
-                                        out + framesWr * rsmp->channel_count,
-                                        &outFrames);
+        // request enough input frames for the remaining output, beyond the filter window,
+        // up to what the history has room for
+        struct resampler_buffer buf;
+        uint64_t frames = ((framesRq - framesWr) * (uint64_t)rsmp->in_sample_rate) /
+                rsmp->out_sample_rate + 1;
+        if (frames > RESAMPLER_CHUNK_FRAMES) {
+            frames = RESAMPLER_CHUNK_FRAMES;
         }
-        framesWr += outFrames;
-        rsmp->frames_in -= inFrames;
-        ALOGW_IF((framesWr != framesRq) && (rsmp->frames_in != 0),
-                "ReSampler::resample() remaining %zu frames in and %zu frames out",
-                rsmp->frames_in, (framesRq - framesWr));
-    }
-    if (rsmp->frames_in) {
-        memmove(rsmp->in_buf,
-                rsmp->in_buf + inFrames * rsmp->channel_count,
-                rsmp->frames_in * rsmp->channel_count * sizeof(int16_t));
+        buf.frame_count = frames;
+        rsmp->provider->get_next_buffer(rsmp->provider, &buf);
+        if (buf.raw == NULL || buf.frame_count == 0) {
+            break;
+        }
+        // only the frames requested are consumed
+        if (buf.frame_count > frames) {
+            buf.frame_count = frames;
+        }
+        resampler_append(rsmp, buf.raw, rsmp->format, buf.frame_count);
+        rsmp->provider->release_buffer(rsmp->provider, &buf);
     }
     *outFrameCount = framesWr;
-
     return 0;
 }
 
-int resampler_resample_from_input(struct resampler_itfe *resampler,
-                                  int16_t *in,
+static int resampler_resample_from_input_l(struct resampler *rsmp,
+                                  const void *in,
                                   size_t *inFrameCount,
-                                  int16_t *out,
+                                  void *out,
+                                  audio_format_t format,
                                   size_t *outFrameCount)
 {
-    struct resampler *rsmp = (struct resampler *)resampler;
-
     if (rsmp == NULL || in == NULL || inFrameCount == NULL ||
             out == NULL || outFrameCount == NULL) {
         return -EINVAL;
@@ -167,38 +671,113 @@ int resampler_resample_from_input(struct resampler_itfe *resampler,
         return -ENOSYS;
     }
 
-    if (rsmp->channel_count == 1) {
-        speex_resampler_process_int(rsmp->speex_resampler,
-                                    0,
-                                    in,
-                                    (spx_uint32_t *)inFrameCount,
-                                    out,
-                                    (spx_uint32_t *)outFrameCount);
-    } else {
-        speex_resampler_process_interleaved_int(rsmp->speex_resampler,
-                                                in,
-                                                (spx_uint32_t *)inFrameCount,
-                                                out,
-                                                (spx_uint32_t *)outFrameCount);
+    const size_t frameSize = audio_bytes_per_sample(format) * rsmp->channel_count;
+    const size_t inFrames = *inFrameCount;
+    const size_t outFrames = *outFrameCount;
+    size_t framesRd = 0;
+    size_t framesWr = 0;
+    for (;;) {
+        framesWr += resampler_output(rsmp, (uint8_t *)out + framesWr * frameSize, format,
+                outFrames - framesWr);
+        if (framesWr == outFrames || framesRd == inFrames) {
+            break;
+        }
+        size_t frames = inFrames - framesRd;
+        if (frames > RESAMPLER_CHUNK_FRAMES) {
+            frames = RESAMPLER_CHUNK_FRAMES;
+        }
+        resampler_append(rsmp, (const uint8_t *)in + framesRd * frameSize, format, frames);
+        framesRd += frames;
     }
+    *inFrameCount = framesRd;
+    *outFrameCount = framesWr;
 
     ALOGV("resampler_resample_from_input() DONE in %zu out %zu", *inFrameCount, *outFrameCount);
 
     return 0;
 }
 
-int create_resampler(uint32_t inSampleRate,
+static int resampler_resample_from_provider(struct resampler_itfe *resampler,
+                       int16_t *out,
+                       size_t *outFrameCount)
+{
+    return resampler_resample_from_provider_l((struct resampler *)resampler,
+            out, AUDIO_FORMAT_PCM_16_BIT, outFrameCount);
+}
+
+static int resampler_resample_from_provider_float(struct resampler_itfe *resampler,
+                       float *out,
+                       size_t *outFrameCount)
+{
+    return resampler_resample_from_provider_l((struct resampler *)resampler,
+            out, AUDIO_FORMAT_PCM_FLOAT, outFrameCount);
+}
+
+static int resampler_resample_from_input(struct resampler_itfe *resampler,
+                                  int16_t *in,
+                                  size_t *inFrameCount,
+                                  int16_t *out,
+                                  size_t *outFrameCount)
+{
+    return resampler_resample_from_input_l((struct resampler *)resampler,
+            in, inFrameCount, out, AUDIO_FORMAT_PCM_16_BIT, outFrameCount);
+}
+
+static int resampler_resample_from_input_float(struct resampler_itfe *resampler,
+                                  float *in,
+                                  size_t *inFrameCount,
+                                  float *out,
+                                  size_t *outFrameCount)
+{
+    return resampler_resample_from_input_l((struct resampler *)resampler,
+            in, inFrameCount, out, AUDIO_FORMAT_PCM_FLOAT, outFrameCount);
+}
+
+/* Sets the step for the filter phases and the ratio, adjusted by ratio_ppm. */
+static void resampler_set_step(struct resampler *rsmp)
+{
+    const struct resampler_filter *filter = rsmp->filter;
+    if (!filter->interpolate) {
+        rsmp->step_int = filter->in_ratio / filter->out_ratio;
+        rsmp->step_frac = filter->in_ratio % filter->out_ratio;
+    } else {
+        const uint64_t step = (uint64_t) llround((double) filter->in_ratio / filter->out_ratio
+                * (1. + rsmp->ratio_ppm * 1e-6) * 4294967296.);
+        rsmp->step_int = (uint32_t) (step >> 32);
+        rsmp->step_frac = (uint32_t) step;
+    }
+}
+
+static int resampler_set_ratio_ppm(struct resampler_itfe *resampler, int32_t ppm)
+{
+    struct resampler *rsmp = (struct resampler *)resampler;
+
+    if (rsmp == NULL || ppm > RESAMPLER_RATIO_PPM_MAX || ppm < -RESAMPLER_RATIO_PPM_MAX) {
+        return -EINVAL;
+    }
+    // the exact phases cannot represent an arbitrary ratio, and designing the interpolated
+    // filter here would allocate: it must be chosen at creation
+    if (ppm != 0 && (rsmp->flags & RESAMPLER_FLAG_VARIABLE_RATIO) == 0) {
+        return -EINVAL;
+    }
+    rsmp->ratio_ppm = ppm;
+    resampler_set_step(rsmp);
+    return 0;
+}
+
+int create_resampler_with_format(uint32_t inSampleRate,
                     uint32_t outSampleRate,
                     uint32_t channelCount,
                     uint32_t quality,
+                    audio_format_t format,
+                    uint32_t flags,
                     struct resampler_buffer_provider* provider,
                     struct resampler_itfe **resampler)
 {
-    int error;
     struct resampler *rsmp;
 
-    ALOGV("create_resampler() In SR %d Out SR %d channels %d",
-         inSampleRate, outSampleRate, channelCount);
+    ALOGV("create_resampler() In SR %d Out SR %d channels %d format %#x flags %#x",
+         inSampleRate, outSampleRate, channelCount, format, flags);
 
     if (resampler == NULL) {
         return -EINVAL;
@@ -206,48 +785,80 @@ int create_resampler(uint32_t inSampleRate,
 
     *resampler = NULL;
 
-    if (quality <= RESAMPLER_QUALITY_MIN || quality >= RESAMPLER_QUALITY_MAX) {
+    if (quality <= RESAMPLER_QUALITY_MIN || quality >= RESAMPLER_QUALITY_MAX ||
+            inSampleRate == 0 || outSampleRate == 0 || channelCount == 0 ||
+            (format != AUDIO_FORMAT_PCM_16_BIT && format != AUDIO_FORMAT_PCM_FLOAT) ||
+            (flags & ~RESAMPLER_FLAG_VARIABLE_RATIO) != 0) {
         return -EINVAL;
     }
 
     rsmp = (struct resampler *)calloc(1, sizeof(struct resampler));
-
-    rsmp->speex_resampler = speex_resampler_init(channelCount,
-                                      inSampleRate,
-                                      outSampleRate,
-                                      quality,
-                                      &error);
-    if (rsmp->speex_resampler == NULL) {
-        ALOGW("ReSampler: Cannot create speex resampler: %s", speex_resampler_strerror(error));
-        free(rsmp);
-        return -ENODEV;
+    if (rsmp == NULL) {
+        return -ENOMEM;
     }
 
     rsmp->itfe.reset = resampler_reset;
     rsmp->itfe.resample_from_provider = resampler_resample_from_provider;
     rsmp->itfe.resample_from_input = resampler_resample_from_input;
     rsmp->itfe.delay_ns = resampler_delay_ns;
+    rsmp->itfe.resample_from_provider_float = resampler_resample_from_provider_float;
+    rsmp->itfe.resample_from_input_float = resampler_resample_from_input_float;
+    rsmp->itfe.set_ratio_ppm = resampler_set_ratio_ppm;
+    rsmp->itfe.reset_with_history = resampler_reset_with_history;
+    rsmp->itfe.reset_with_history_float = resampler_reset_with_history_float;
 
     rsmp->provider = provider;
+    rsmp->format = format;
     rsmp->in_sample_rate = inSampleRate;
     rsmp->out_sample_rate = outSampleRate;
     rsmp->channel_count = channelCount;
-    rsmp->in_buf = NULL;
-    rsmp->in_buf_size = 0;
+    rsmp->flags = flags;
+    rsmp->dot = resampler_select_dot();
+
+    int status = 0;
+    rsmp->filter = resampler_filter_acquire(inSampleRate, outSampleRate, quality,
+            (flags & RESAMPLER_FLAG_VARIABLE_RATIO) != 0 /* interpolate */);
+    if (rsmp->filter == NULL) {
+        status = -ENOMEM;
+    } else {
+        if (rsmp->filter->interpolate) {
+            rsmp->row = (float *)resampler_alloc(rsmp->filter->taps * sizeof(float));
+        }
+        rsmp->hist_capacity = rsmp->filter->taps + RESAMPLER_CHUNK_FRAMES;
+        rsmp->hist = (float *)malloc(rsmp->hist_capacity * channelCount * sizeof(float));
+        rsmp->out_buf = (float *)malloc(RESAMPLER_CHUNK_FRAMES * channelCount * sizeof(float));
+        if (rsmp->hist == NULL || rsmp->out_buf == NULL ||
+                (rsmp->filter->interpolate && rsmp->row == NULL)) {
+            status = -ENOMEM;
+        }
+    }
+    if (status != 0) {
+        ALOGW("ReSampler: Cannot create resampler: %d", status);
+        release_resampler(&rsmp->itfe);
+        return status;
+    }
 
+    resampler_set_step(rsmp);
     resampler_reset(&rsmp->itfe);
 
-    int frames = speex_resampler_get_input_latency(rsmp->speex_resampler);
-    rsmp->speex_delay_ns = (int32_t)((1000000000 * (int64_t)frames) / rsmp->in_sample_rate);
-    frames = speex_resampler_get_output_latency(rsmp->speex_resampler);
-    rsmp->speex_delay_ns += (int32_t)((1000000000 * (int64_t)frames) / rsmp->out_sample_rate);
-
     *resampler = &rsmp->itfe;
-    ALOGV("create_resampler() DONE rsmp %p &rsmp->itfe %p speex %p",
-         rsmp, &rsmp->itfe, rsmp->speex_resampler);
+    ALOGV("create_resampler() DONE rsmp %p &rsmp->itfe %p taps %u phases %u%s",
+         rsmp, &rsmp->itfe, rsmp->filter->taps, rsmp->filter->phases,
+         rsmp->filter->interpolate ? " interpolated" : "");
     return 0;
 }
 
+int create_resampler(uint32_t inSampleRate,
+                    uint32_t outSampleRate,
+                    uint32_t channelCount,
+                    uint32_t quality,
+                    struct resampler_buffer_provider* provider,
+                    struct resampler_itfe **resampler)
+{
+    return create_resampler_with_format(inSampleRate, outSampleRate, channelCount, quality,
+            AUDIO_FORMAT_PCM_16_BIT, 0 /* flags */, provider, resampler);
+}
+
 void release_resampler(struct resampler_itfe *resampler)
 {
     struct resampler *rsmp = (struct resampler *)resampler;
@@ -256,10 +867,11 @@ void release_resampler(struct resampler_itfe *resampler)
         return;
     }
 
-    free(rsmp->in_buf);
-
-    if (rsmp->speex_resampler != NULL) {
-        speex_resampler_destroy(rsmp->speex_resampler);
+    free(rsmp->hist);
+    free(rsmp->out_buf);
+    if (rsmp->filter != NULL) {
+        resampler_filter_release(rsmp->filter);
     }
+    free(rsmp->row);
     free(rsmp);
 }
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Streaming short-time Fourier transform on top of fft.cpp.
+ *
+ * The input history starts with frame_size - hop_size zeros, so the first frame is
+ * transformed after hop_size samples of input. The frame transformed at input time t covers
+ * [t - frame_size, t), and once added to the overlap it completes the output samples
+ * [t - frame_size, t - frame_size + hop_size), which are returned during the next hop:
+ * the latency is frame_size.
+ *
+ * The analysis and synthesis windows are sin(pi n / frame_size), whose product is the
+ * periodic Hann window. Hann windows spaced by a hop dividing frame_size sum to
+ * frame_size / (2 hop_size), so the synthesis window is scaled by its inverse and by the
+ * 1 / frame_size of the unnormalized inverse transform.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <new>
+
+#include <audio_utils/fft.h>
+#include <audio_utils/stft.h>
+
+struct stft {
+    ~stft() {
+        release_fft_plan(plan);
+    }
+
+    size_t frame_size;
+    size_t hop_size;
+    uint32_t channel_count;
+    stft_callback_t callback;
+    void *cookie;
+    struct fft_plan *plan = NULL;
+    // the arrays below, in one allocation which does not throw
+    std::unique_ptr<float[]> arrays;
+    float *analysis_window;
+    float *synthesis_window;
+    // the last frame_size samples of input of each channel
+    float *input;
+    // the output of each channel not yet completed by the overlap of later frames
+    float *overlap;
+    // the completed output of each channel, returned during the current hop
+    float *ready;
+    // the frame being transformed
+    float *work;
+    // samples of the current hop received so far
+    size_t filled;
+};
+
+int create_stft(size_t frame_size, size_t hop_size, uint32_t channel_count,
+        stft_callback_t callback, void *cookie, struct stft **stft)
+{
+    if (stft == NULL || callback == NULL || channel_count == 0 || hop_size == 0
+            || hop_size > frame_size / 2 || frame_size % hop_size != 0) {
+        return -EINVAL;
+    }
+    struct stft *s = new (std::nothrow) struct stft;
+    if (s == NULL) {
+        return -ENOMEM;
+    }
+    int ret = create_fft_plan(frame_size, &s->plan);
+    if (ret != 0) {
+        delete s;
+        return ret;
+    }
+    s->frame_size = frame_size;
+    s->hop_size = hop_size;
+    s->channel_count = channel_count;
+    s->callback = callback;
+    s->cookie = cookie;
+
+    const size_t samples = channel_count * frame_size;
+    s->arrays.reset(new (std::nothrow) float[3 * frame_size + 2 * samples
+            + channel_count * hop_size]);
+    if (s->arrays == nullptr) {
+        delete s;
+        return -ENOMEM;
+    }
+    s->analysis_window = s->arrays.get();
+    s->synthesis_window = s->analysis_window + frame_size;
+    s->work = s->synthesis_window + frame_size;
+    s->input = s->work + frame_size;
+    s->overlap = s->input + samples;
+    s->ready = s->overlap + samples;
+    const double scale = 2. * hop_size / frame_size / frame_size;
+    for (size_t i = 0; i < frame_size; ++i) {
+        const double w = sin(M_PI * i / frame_size);
+        s->analysis_window[i] = w;
+        s->synthesis_window[i] = w * scale;
+    }
+    stft_reset(s);
+
+    *stft = s;
+    return 0;
+}
+
+void release_stft(struct stft *stft)
+{
+    delete stft;
+}
+
+size_t stft_latency(const struct stft *stft)
+{
+    return stft->frame_size;
+}
+
+void stft_reset(struct stft *stft)
+{
+    const size_t samples = stft->channel_count * stft->frame_size;
+    std::fill(stft->input, stft->input + samples, 0.f);
+    std::fill(stft->overlap, stft->overlap + samples, 0.f);
+    std::fill(stft->ready, stft->ready + stft->channel_count * stft->hop_size, 0.f);
+    stft->filled = 0;
+}
+
+/* Transforms the last frame of each channel and, if synthesize, adds it to the output. */
+static void stft_frame(struct stft *stft, bool synthesize)
+{
+    const size_t n = stft->frame_size;
+    const size_t hop = stft->hop_size;
+    const float *analysis = stft->analysis_window;
+    const float *synthesis = stft->synthesis_window;
+    float *work = stft->work;
+    for (uint32_t c = 0; c < stft->channel_count; ++c) {
+        float *input = &stft->input[c * n];
+        for (size_t i = 0; i < n; ++i) {
+            work[i] = input[i] * analysis[i];
+        }
+        fft_real_forward(stft->plan, work, work);
+        stft->callback(stft->cookie, c, work, n);
+        memmove(input, input + hop, (n - hop) * sizeof(*input));
+
+        if (synthesize) {
+            fft_real_inverse(stft->plan, work, work);
+            float *overlap = &stft->overlap[c * n];
+            float *ready = &stft->ready[c * hop];
+            for (size_t i = 0; i < hop; ++i) {
+                ready[i] = overlap[i] + work[i] * synthesis[i];
+            }
+            for (size_t i = hop; i < n; ++i) {
+                overlap[i - hop] = overlap[i] + work[i] * synthesis[i];
+            }
+            memset(overlap + n - hop, 0, hop * sizeof(*overlap));
+        }
+    }
+}
+
+void stft_process(struct stft *stft, const float *in, float *out, size_t frame_count)
+{
+    const size_t n = stft->frame_size;
+    const size_t hop = stft->hop_size;
+    const uint32_t channels = stft->channel_count;
+    while (frame_count > 0) {
+        const size_t count = std::min(frame_count, hop - stft->filled);
+        // the input is stored before the output is written, in case in == out
+        for (uint32_t c = 0; c < channels; ++c) {
+            float *input = &stft->input[c * n + n - hop + stft->filled];
+            for (size_t i = 0; i < count; ++i) {
+                input[i] = in[i * channels + c];
+            }
+        }
+        if (out != NULL) {
+            for (uint32_t c = 0; c < channels; ++c) {
+                const float *ready = &stft->ready[c * hop + stft->filled];
+                for (size_t i = 0; i < count; ++i) {
+                    out[i * channels + c] = ready[i];
+                }
+            }
+            out += count * channels;
+        }
+        in += count * channels;
+        frame_count -= count;
+        stft->filled += count;
+        if (stft->filled == hop) {
+            stft_frame(stft, out != NULL);
+            stft->filled = 0;
+        }
+    }
+}
@@ -36,6 +36,10 @@ echo "testing channels"
 adb push $OUT/data/nativetest/channels_tests/channels_tests /system/bin
 adb shell /system/bin/channels_tests
 
+echo "benchmarking channels"
+adb push $OUT/system/bin/channels_benchmark /system/bin
+adb shell /system/bin/channels_benchmark
+
 echo "string test"
 adb push $OUT/data/nativetest/string_tests/string_tests /system/bin
 adb shell /system/bin/string_tests
@@ -44,6 +48,10 @@ echo "format tests"
 adb push $OUT/data/nativetest/format_tests/format_tests /system/bin
 adb shell /system/bin/format_tests
 
+echo "benchmarking format"
+adb push $OUT/system/bin/format_benchmark /system/bin
+adb shell /system/bin/format_benchmark
+
 echo "simplelog tests"
 adb push $OUT/data/nativetest/simplelog_tests/simplelog_tests /system/bin
 adb shell /system/bin/simplelog_tests
@@ -71,3 +79,79 @@ adb shell /system/bin/statistics_benchmark
 echo "benchmarking primitives"
 adb push $OUT/system/bin/primitives_benchmark /system/bin
 adb shell /system/bin/primitives_benchmark
+
+echo "powerlog tests"
+adb push $OUT/data/nativetest/powerlog_tests/powerlog_tests /system/bin
+adb shell /system/bin/powerlog_tests
+
+echo "benchmarking powerlog"
+adb push $OUT/system/bin/powerlog_benchmark /system/bin
+adb shell /system/bin/powerlog_benchmark
+
+echo "benchmarking power"
+adb push $OUT/system/bin/power_benchmark /system/bin
+adb shell /system/bin/power_benchmark
+
+echo "errorlog tests"
+adb push $OUT/data/nativetest/errorlog_tests/errorlog_tests /system/bin
+adb shell /system/bin/errorlog_tests
+
+echo "benchmarking errorlog"
+adb push $OUT/system/bin/errorlog_benchmark /system/bin
+adb shell /system/bin/errorlog_benchmark
+
+echo "fifo reader group tests"
+adb push $OUT/data/nativetest/fifo_reader_group_tests/fifo_reader_group_tests /system/bin
+adb shell /system/bin/fifo_reader_group_tests
+
+echo "fifo T tests"
+adb push $OUT/data/nativetest/fifo_T_tests/fifo_T_tests /system/bin
+adb shell /system/bin/fifo_T_tests
+
+echo "fifo shared tests"
+adb push $OUT/data/nativetest/fifo_shared_tests/fifo_shared_tests /system/bin
+adb shell /system/bin/fifo_shared_tests
+
+echo "benchmarking fifo"
+adb push $OUT/system/bin/fifo_benchmark /system/bin
+adb shell /system/bin/fifo_benchmark
+
+echo "sndfile tests"
+adb push $OUT/data/nativetest/sndfile_tests/sndfile_tests /system/bin
+adb shell /system/bin/sndfile_tests
+
+echo "benchmarking sndfile"
+adb push $OUT/system/bin/sndfile_benchmark /system/bin
+adb shell /system/bin/sndfile_benchmark
+
+echo "echo_reference tests"
+adb push $OUT/data/nativetest/echo_reference_tests/echo_reference_tests /system/bin
+adb shell /system/bin/echo_reference_tests
+
+echo "benchmarking echo_reference"
+adb push $OUT/system/bin/echo_reference_benchmark /system/bin
+adb shell /system/bin/echo_reference_benchmark
+
+echo "resampler tests"
+adb push $OUT/data/nativetest/resampler_tests/resampler_tests /system/bin
+adb shell /system/bin/resampler_tests
+
+echo "benchmarking resampler"
+adb push $OUT/system/bin/resampler_benchmark /system/bin
+adb shell /system/bin/resampler_benchmark
+
+echo "fft tests"
+adb push $OUT/data/nativetest/fft_tests/fft_tests /system/bin
+adb shell /system/bin/fft_tests
+
+echo "benchmarking fft"
+adb push $OUT/system/bin/fft_benchmark /system/bin
+adb shell /system/bin/fft_benchmark
+
+echo "stft tests"
+adb push $OUT/data/nativetest/stft_tests/stft_tests /system/bin
+adb shell /system/bin/stft_tests
+
+echo "benchmarking stft"
+adb push $OUT/system/bin/stft_benchmark /system/bin
+adb shell /system/bin/stft_benchmark
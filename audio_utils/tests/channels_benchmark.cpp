@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/channels.h>
+
+static constexpr size_t kFrameCount = 960; // 20 ms at 48 kHz
+
+typedef size_t (*adjust_channels_t)(const void*, size_t, void*, size_t, unsigned, size_t);
+
+/*
+ * Args: in channels, out channels.
+ * 1 -> 2, 2 -> 1, 2 -> 8 and 6 -> 2 have vectorized kernels; 2 -> 4 and 8 -> 2 are
+ * included for comparison with the generic path.
+ */
+template <typename T, adjust_channels_t ADJUST>
+static void BM_AdjustChannels(benchmark::State& state) {
+    const size_t inChannels = state.range(0);
+    const size_t outChannels = state.range(1);
+    // non-destructive conversions require equally sized buffers.
+    const size_t size = kFrameCount * std::max(inChannels, outChannels);
+
+    std::vector<T> src(size);
+    std::vector<T> dst(size);
+    std::minstd_rand gen(inChannels * 10 + outChannels);
+    std::uniform_int_distribution<int32_t> dis(
+            std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+    for (auto &sample : src) {
+        sample = dis(gen);
+    }
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        ADJUST(src.data(), inChannels, dst.data(), outChannels, sizeof(T),
+                kFrameCount * inChannels * sizeof(T));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kFrameCount);
+}
+
+static void ChannelPairs(benchmark::internal::Benchmark* b) {
+    b->Args({1, 2})->Args({2, 1})->Args({2, 8})->Args({6, 2})->Args({2, 4})->Args({8, 2});
+}
+
+BENCHMARK_TEMPLATE(BM_AdjustChannels, int16_t, adjust_channels)->Apply(ChannelPairs);
+BENCHMARK_TEMPLATE(BM_AdjustChannels, int32_t, adjust_channels)->Apply(ChannelPairs);
+BENCHMARK_TEMPLATE(BM_AdjustChannels, int16_t, adjust_selected_channels)->Apply(ChannelPairs);
+BENCHMARK_TEMPLATE(BM_AdjustChannels, int32_t, adjust_selected_channels)->Apply(ChannelPairs);
+BENCHMARK_TEMPLATE(BM_AdjustChannels, int16_t, adjust_channels_non_destructive)
+        ->Apply(ChannelPairs);
+BENCHMARK_TEMPLATE(BM_AdjustChannels, int32_t, adjust_channels_non_destructive)
+        ->Apply(ChannelPairs);
+
+BENCHMARK_MAIN();
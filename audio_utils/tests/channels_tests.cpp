@@ -17,7 +17,10 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_channels_tests"
 
+#include <algorithm>
+#include <limits>
 #include <math.h>
+#include <random>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -201,3 +204,99 @@ TEST(audio_utils_channels, adjust_channels_non_destructive) {
     // Comparison array must be identical to reference.
     expectEq(u16inout, u16ref);
 }
+
+// Scalar reference of the documented conversions, used to check the vectorized kernels
+// for the common channel count pairs (and the remainder frames which they handle in C).
+enum class Adjust { CHANNELS, SELECTED, NON_DESTRUCTIVE };
+
+template<typename T>
+std::vector<T> referenceAdjust(Adjust adjust, const std::vector<T> &in, size_t inChannels,
+        const std::vector<T> &out, size_t outChannels, size_t frames) {
+    std::vector<T> result(out);
+    const T *extra = in.data() + frames * inChannels; // non-destructive expansion source
+    std::vector<T> removed;                           // non-destructive contraction output
+    for (size_t i = 0; i < frames; ++i) {
+        const T *src = &in[i * inChannels];
+        T *dst = &result[i * outChannels];
+        if (outChannels > inChannels) {
+            for (size_t c = 0; c < outChannels; ++c) {
+                if (c < inChannels) {
+                    dst[c] = src[c];
+                } else if (adjust == Adjust::NON_DESTRUCTIVE) {
+                    dst[c] = *extra++;
+                } else if (adjust == Adjust::CHANNELS) {
+                    // mono is duplicated to the first two channels.
+                    dst[c] = inChannels == 1 && c == 1 ? src[0] : 0;
+                }
+            }
+        } else if (adjust != Adjust::NON_DESTRUCTIVE && outChannels == 1) {
+            dst[0] = ((int64_t)src[0] + src[1]) >> 1;
+        } else {
+            for (size_t c = 0; c < inChannels; ++c) {
+                if (c < outChannels) {
+                    dst[c] = src[c];
+                } else if (adjust == Adjust::NON_DESTRUCTIVE) {
+                    removed.push_back(src[c]);
+                }
+            }
+        }
+    }
+    std::copy(removed.begin(), removed.end(), result.begin() + frames * outChannels);
+    return result;
+}
+
+template<typename T>
+void testAdjust(Adjust adjust, size_t inChannels, size_t outChannels, size_t frames,
+        bool inPlace) {
+    const size_t maxChannels = std::max(inChannels, outChannels);
+    const size_t size = frames * maxChannels;
+    std::minstd_rand gen(frames * 100 + inChannels * 10 + outChannels);
+    std::uniform_int_distribution<int32_t> dis(
+            std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+    std::vector<T> in(size);
+    std::vector<T> out(size);
+    for (size_t i = 0; i < size; ++i) {
+        in[i] = dis(gen);
+        out[i] = dis(gen);
+    }
+    // extreme values exercise the averaging of stereo to mono.
+    if (size >= 4) {
+        in[0] = in[1] = std::numeric_limits<T>::max();
+        in[2] = in[3] = std::numeric_limits<T>::min();
+    }
+    const std::vector<T> expected = referenceAdjust(adjust, in, inChannels,
+            inPlace ? in : out, outChannels, frames);
+
+    T *outBuff = out.data();
+    if (inPlace) {
+        out = in;
+        outBuff = out.data();
+    }
+    const size_t numInBytes = frames * inChannels * sizeof(T);
+    size_t (*const fn)(const void*, size_t, void*, size_t, unsigned, size_t) =
+            adjust == Adjust::CHANNELS ? adjust_channels
+            : adjust == Adjust::SELECTED ? adjust_selected_channels
+            : adjust_channels_non_destructive;
+    const size_t outBytes = fn(inPlace ? outBuff : in.data(), inChannels,
+            outBuff, outChannels, sizeof(T), numInBytes);
+
+    EXPECT_EQ(frames * outChannels * sizeof(T), outBytes);
+    EXPECT_EQ(expected, out) << "adjust " << (int)adjust << " " << inChannels << " -> "
+            << outChannels << " frames " << frames << " sample size " << sizeof(T)
+            << (inPlace ? " in-place" : "");
+}
+
+TEST(audio_utils_channels, common_channel_pairs) {
+    static constexpr size_t pairs[][2] = { {1, 2}, {2, 1}, {2, 8}, {6, 2}, {2, 4}, {8, 2} };
+    for (Adjust adjust : { Adjust::CHANNELS, Adjust::SELECTED, Adjust::NON_DESTRUCTIVE }) {
+        for (const auto &pair : pairs) {
+            // all block remainders, and a buffer size.
+            for (size_t frames : { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 960 }) {
+                for (bool inPlace : { false, true }) {
+                    testAdjust<int16_t>(adjust, pair[0], pair[1], frames, inPlace);
+                    testAdjust<int32_t>(adjust, pair[0], pair[1], frames, inPlace);
+                }
+            }
+        }
+    }
+}
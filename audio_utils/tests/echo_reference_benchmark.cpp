@@ -0,0 +1,130 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/echo_reference.h>
+#include <audio_utils/primitives.h>
+
+static constexpr uint32_t kWriteRate = 48000;
+
+struct Config {
+    const char *name;
+    audio_format_t format;          // of both the write and the read side
+    uint32_t wrChannelCount;
+    uint32_t rdChannelCount;
+    uint32_t rdRate;
+    bool floatThroughI16;           // float converted to int16 around an int16 reference
+};
+
+static const Config kConfigs[] = {
+    {"i16 2->1 48k->48k", AUDIO_FORMAT_PCM_16_BIT, 2, 1, 48000, false},
+    {"i16 2->1 48k->16k", AUDIO_FORMAT_PCM_16_BIT, 2, 1, 16000, false},
+    {"float 2->1 48k->48k", AUDIO_FORMAT_PCM_FLOAT, 2, 1, 48000, false},
+    {"float 2->1 48k->16k", AUDIO_FORMAT_PCM_FLOAT, 2, 1, 16000, false},
+    {"float via i16 2->1 48k->16k", AUDIO_FORMAT_PCM_FLOAT, 2, 1, 16000, true},
+    {"float 4->4 48k->48k", AUDIO_FORMAT_PCM_FLOAT, 4, 4, 48000, false},
+    {"float 4->4 48k->16k", AUDIO_FORMAT_PCM_FLOAT, 4, 4, 16000, false},
+    {"float 8->4 48k->16k", AUDIO_FORMAT_PCM_FLOAT, 8, 4, 16000, false},
+};
+
+static struct timespec now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts;
+}
+
+/*
+On a host x86-64, medians of 15 interleaved repetitions; an iteration is one 10 ms frame.
+Converting float through int16 costs about the same as float throughout, but quantizes
+the reference to 16 bits and clips it to [-1, 1]. Resampling uses the interpolated
+filter, which follows the ratio adjusted for drift.
+----------------------------------------------------------------------------------------
+Benchmark                          Time             CPU   Iterations
+----------------------------------------------------------------------------------------
+BM_EchoReference/0_median       1081 ns         1075 ns           15 i16 2->1 48k->48k
+BM_EchoReference/1_median       6301 ns         6092 ns           15 i16 2->1 48k->16k
+BM_EchoReference/2_median       1528 ns         1509 ns           15 float 2->1 48k->48k
+BM_EchoReference/3_median       6715 ns         6602 ns           15 float 2->1 48k->16k
+BM_EchoReference/4_median       6415 ns         6311 ns           15 float via i16 2->1 48k->16k
+BM_EchoReference/5_median       1227 ns         1218 ns           15 float 4->4 48k->48k
+BM_EchoReference/6_median      19144 ns        18831 ns           15 float 4->4 48k->16k
+BM_EchoReference/7_median      19503 ns        19069 ns           15 float 8->4 48k->16k
+*/
+
+// Writes and reads 10 ms of a sine per iteration, as playback and capture would.
+static void BM_EchoReference(benchmark::State& state) {
+    const Config &config = kConfigs[state.range(0)];
+    const audio_format_t format = config.floatThroughI16 ? AUDIO_FORMAT_PCM_16_BIT : config.format;
+    const bool isFloat = format == AUDIO_FORMAT_PCM_FLOAT;
+    struct echo_reference_itfe *er;
+    if (create_echo_reference(format, config.rdChannelCount, config.rdRate,
+            format, config.wrChannelCount, kWriteRate, &er) != 0) {
+        state.SkipWithError("create_echo_reference failed");
+        return;
+    }
+
+    const size_t wrFrames = kWriteRate / 100;
+    const size_t rdFrames = config.rdRate / 100;
+    const size_t wrSamples = wrFrames * config.wrChannelCount;
+    const size_t rdSamples = rdFrames * config.rdChannelCount;
+    std::vector<float> wrFloat(wrSamples);
+    for (size_t i = 0; i < wrSamples; ++i) {
+        wrFloat[i] = 0.5f * sinf(2.f * M_PI * 1000.f * (i / config.wrChannelCount) / kWriteRate);
+    }
+    std::vector<int16_t> wrI16(wrSamples);
+    memcpy_to_i16_from_float(wrI16.data(), wrFloat.data(), wrSamples);
+    std::vector<float> rdFloat(rdSamples);
+    std::vector<int16_t> rdI16(rdSamples);
+
+    struct echo_reference_buffer buffer{};
+    buffer.frame_count = rdFrames;
+    buffer.time_stamp = now();
+    buffer.raw = isFloat ? (void *)rdFloat.data() : rdI16.data();
+    er->read(er, &buffer);  // start reading
+
+    for (auto _ : state) {
+        buffer.raw = isFloat ? (void *)wrFloat.data() : wrI16.data();
+        if (config.floatThroughI16) {
+            memcpy_to_i16_from_float(wrI16.data(), wrFloat.data(), wrSamples);
+        }
+        buffer.frame_count = wrFrames;
+        buffer.delay_ns = 0;
+        buffer.time_stamp = now();
+        er->write(er, &buffer);
+
+        buffer.raw = isFloat ? (void *)rdFloat.data() : rdI16.data();
+        buffer.frame_count = rdFrames;
+        buffer.delay_ns = 0;
+        buffer.time_stamp = now();
+        er->read(er, &buffer);
+        if (config.floatThroughI16) {
+            memcpy_to_float_from_i16(rdFloat.data(), rdI16.data(), rdSamples);
+        }
+        benchmark::DoNotOptimize(buffer.raw);
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(config.name);
+    release_echo_reference(er);
+}
+
+BENCHMARK(BM_EchoReference)->DenseRange(0, sizeof(kConfigs) / sizeof(kConfigs[0]) - 1);
+
+BENCHMARK_MAIN();
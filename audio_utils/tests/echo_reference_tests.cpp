@@ -0,0 +1,431 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_echo_reference_tests"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <math.h>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+
+#include <audio_utils/echo_reference.h>
+
+static struct timespec now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts;
+}
+
+// Writes frames of stereo, with a time stamp and no playback delay so that read() keeps
+// the reference as written.
+static int writeStereo(struct echo_reference_itfe *er, std::vector<int16_t> &stereo) {
+    struct echo_reference_buffer buffer{};
+    buffer.raw = stereo.data();
+    buffer.frame_count = stereo.size() / 2;
+    buffer.time_stamp = now();
+    return er->write(er, &buffer);
+}
+
+static int readFrames(struct echo_reference_itfe *er, std::vector<int16_t> &frames,
+        size_t frameCount) {
+    struct echo_reference_buffer buffer{};
+    buffer.raw = frames.data();
+    buffer.frame_count = frameCount;
+    buffer.time_stamp = now();
+    return er->read(er, &buffer);
+}
+
+TEST(echo_reference, invalid) {
+    struct echo_reference_itfe *er;
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_32_BIT, 1, 48000,
+            AUDIO_FORMAT_PCM_FLOAT, 2, 48000, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, 48000,
+            AUDIO_FORMAT_PCM_8_BIT, 2, 48000, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 0, 48000,
+            AUDIO_FORMAT_PCM_16_BIT, 1, 48000, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, 4, 48000,
+            AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_COUNT_MAX + 1, 48000, &er));
+    EXPECT_EQ(-EINVAL, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, 0,
+            AUDIO_FORMAT_PCM_16_BIT, 2, 48000, &er));
+}
+
+// Written stereo is read back downmixed to mono, in order, and silence follows it.
+TEST(echo_reference, downmix) {
+    constexpr size_t kFrames = 480;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, 48000,
+            AUDIO_FORMAT_PCM_16_BIT, 2, 48000, &er));
+
+    std::vector<int16_t> mono(kFrames, 1);
+    // reads before any write return silence, and start reading
+    ASSERT_EQ(0, readFrames(er, mono, kFrames));
+    EXPECT_EQ(std::vector<int16_t>(kFrames, 0), mono);
+
+    std::vector<int16_t> stereo(kFrames * 2);
+    for (size_t i = 0; i < kFrames; ++i) {
+        stereo[2 * i] = i;
+        stereo[2 * i + 1] = i + 2;
+    }
+    for (int block = 0; block < 2; ++block) {
+        ASSERT_EQ(0, writeStereo(er, stereo));
+    }
+    for (int block = 0; block < 2; ++block) {
+        ASSERT_EQ(0, readFrames(er, mono, kFrames));
+        for (size_t i = 0; i < kFrames; ++i) {
+            ASSERT_EQ((int16_t)(i + 1), mono[i]) << "block " << block << " frame " << i;
+        }
+    }
+    ASSERT_EQ(0, readFrames(er, mono, kFrames));
+    EXPECT_EQ(std::vector<int16_t>(kFrames, 0), mono);
+
+    // after the writer stops, reads return silence
+    ASSERT_EQ(0, writeStereo(er, stereo));
+    ASSERT_EQ(0, er->write(er, nullptr));
+    ASSERT_EQ(0, readFrames(er, mono, kFrames));
+    EXPECT_EQ(std::vector<int16_t>(kFrames, 0), mono);
+    release_echo_reference(er);
+}
+
+// Writes at 48 kHz are read at 16 kHz, with the frame count scaled.
+TEST(echo_reference, resample) {
+    constexpr size_t kWriteFrames = 480;
+    constexpr size_t kReadFrames = 160;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, 16000,
+            AUDIO_FORMAT_PCM_16_BIT, 2, 48000, &er));
+
+    std::vector<int16_t> mono(kReadFrames);
+    ASSERT_EQ(0, readFrames(er, mono, kReadFrames));
+    std::vector<int16_t> stereo(kWriteFrames * 2, 8192);
+    double sum = 0.;
+    for (int block = 0; block < 10; ++block) {
+        ASSERT_EQ(0, writeStereo(er, stereo));
+        ASSERT_EQ(0, readFrames(er, mono, kReadFrames));
+        if (block > 0) {
+            for (int16_t sample : mono) sum += sample;
+        }
+    }
+    // all but the resampler delay of the DC input came through
+    EXPECT_NEAR(8192., sum / (9 * kReadFrames), 8192. / 50);
+    release_echo_reference(er);
+}
+
+// Writes and reads frames of any format and channel count, as raw bytes.
+static int writeRaw(struct echo_reference_itfe *er, void *frames, size_t frameCount) {
+    struct echo_reference_buffer buffer{};
+    buffer.raw = frames;
+    buffer.frame_count = frameCount;
+    buffer.time_stamp = now();
+    return er->write(er, &buffer);
+}
+
+static int readRaw(struct echo_reference_itfe *er, void *frames, size_t frameCount) {
+    struct echo_reference_buffer buffer{};
+    buffer.raw = frames;
+    buffer.frame_count = frameCount;
+    buffer.time_stamp = now();
+    return er->read(er, &buffer);
+}
+
+// 4 channel float goes through unchanged, bit exact.
+TEST(echo_reference, float_multichannel) {
+    constexpr size_t kChannels = 4;
+    constexpr size_t kFrames = 480;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, kChannels, 48000,
+            AUDIO_FORMAT_PCM_FLOAT, kChannels, 48000, &er));
+
+    std::vector<float> in(kFrames * kChannels);
+    std::vector<float> out(kFrames * kChannels);
+    ASSERT_EQ(0, readRaw(er, out.data(), kFrames));
+    for (int block = 0; block < 3; ++block) {
+        for (size_t i = 0; i < in.size(); ++i) {
+            in[i] = sinf(0.001f * (block * in.size() + i)) * 1.5f; // beyond int16 range
+        }
+        ASSERT_EQ(0, writeRaw(er, in.data(), kFrames));
+        ASSERT_EQ(0, readRaw(er, out.data(), kFrames));
+        ASSERT_EQ(in, out) << "block " << block;
+    }
+    release_echo_reference(er);
+}
+
+// Channels and formats are converted as by adjust_channels() and memcpy_by_audio_format().
+TEST(echo_reference, convert) {
+    constexpr size_t kFrames = 480;
+    struct echo_reference_itfe *er;
+
+    // float stereo averaged to float mono
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, 1, 48000,
+            AUDIO_FORMAT_PCM_FLOAT, 2, 48000, &er));
+    std::vector<float> stereo(kFrames * 2);
+    for (size_t i = 0; i < kFrames; ++i) {
+        stereo[2 * i] = i * 0.001f;
+        stereo[2 * i + 1] = -0.25f;
+    }
+    std::vector<float> mono(kFrames);
+    ASSERT_EQ(0, readRaw(er, mono.data(), kFrames));
+    ASSERT_EQ(0, writeRaw(er, stereo.data(), kFrames));
+    ASSERT_EQ(0, readRaw(er, mono.data(), kFrames));
+    for (size_t i = 0; i < kFrames; ++i) {
+        ASSERT_EQ((i * 0.001f - 0.25f) * 0.5f, mono[i]) << "frame " << i;
+    }
+    release_echo_reference(er);
+
+    // int16 6 channels to float 4 channels, dropping the last two
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, 4, 48000,
+            AUDIO_FORMAT_PCM_16_BIT, 6, 48000, &er));
+    std::vector<int16_t> six(kFrames * 6);
+    for (size_t i = 0; i < six.size(); ++i) {
+        six[i] = (i % 6 + 1) * 4096;
+    }
+    std::vector<float> four(kFrames * 4);
+    ASSERT_EQ(0, readRaw(er, four.data(), kFrames));
+    ASSERT_EQ(0, writeRaw(er, six.data(), kFrames));
+    ASSERT_EQ(0, readRaw(er, four.data(), kFrames));
+    for (size_t i = 0; i < four.size(); ++i) {
+        ASSERT_EQ((i % 4 + 1) / 8.f, four[i]) << "sample " << i;
+    }
+    release_echo_reference(er);
+
+    // float mono to int16 stereo
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 2, 48000,
+            AUDIO_FORMAT_PCM_FLOAT, 1, 48000, &er));
+    std::vector<float> floatMono(kFrames, 0.5f);
+    std::vector<int16_t> i16Stereo(kFrames * 2);
+    ASSERT_EQ(0, readRaw(er, i16Stereo.data(), kFrames));
+    ASSERT_EQ(0, writeRaw(er, floatMono.data(), kFrames));
+    ASSERT_EQ(0, readRaw(er, i16Stereo.data(), kFrames));
+    EXPECT_EQ(std::vector<int16_t>(kFrames * 2, 16384), i16Stereo);
+    release_echo_reference(er);
+}
+
+// 4 channel float at 48 kHz read at 16 kHz keeps the channels apart, and float levels
+// beyond int16 range.
+TEST(echo_reference, float_multichannel_resample) {
+    constexpr size_t kChannels = 4;
+    constexpr size_t kWriteFrames = 480;
+    constexpr size_t kReadFrames = 160;
+    constexpr size_t kBlocks = 10;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, kChannels, 16000,
+            AUDIO_FORMAT_PCM_FLOAT, kChannels, 48000, &er));
+
+    std::vector<float> in(kWriteFrames * kChannels);
+    for (size_t i = 0; i < in.size(); ++i) {
+        in[i] = (i % kChannels) - 1.f;  // -1, 0, 1, 2
+    }
+    std::vector<float> out(kReadFrames * kChannels);
+    ASSERT_EQ(0, readRaw(er, out.data(), kReadFrames));
+    double sum[kChannels] = {};
+    for (size_t block = 0; block < kBlocks; ++block) {
+        ASSERT_EQ(0, writeRaw(er, in.data(), kWriteFrames));
+        ASSERT_EQ(0, readRaw(er, out.data(), kReadFrames));
+        if (block > 0) {
+            for (size_t i = 0; i < out.size(); ++i) sum[i % kChannels] += out[i];
+        }
+    }
+    // all but the resampler delay of the DC input came through
+    for (size_t c = 0; c < kChannels; ++c) {
+        EXPECT_NEAR(c - 1., sum[c] / ((kBlocks - 1) * kReadFrames), 0.02) << "channel " << c;
+    }
+    release_echo_reference(er);
+}
+
+// A playback thread writes 10 ms every 10 ms while a capture thread reads as it pleases,
+// including waiting for data.  The writer never waits for the reader, so its write()
+// latency stays in the microseconds whatever the reader is doing.
+TEST(echo_reference, two_thread_latency) {
+    constexpr uint32_t kRate = 48000;
+    constexpr size_t kWriteFrames = kRate / 100;
+    constexpr size_t kBlocks = 200;
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_16_BIT, 1, kRate,
+            AUDIO_FORMAT_PCM_16_BIT, 2, kRate, &er));
+    std::vector<int16_t> first(kWriteFrames);
+    ASSERT_EQ(0, readFrames(er, first, kWriteFrames)); // start reading
+
+    std::atomic<bool> done{false};
+    std::vector<int64_t> readNs;
+    std::thread reader([&] {
+        std::vector<int16_t> mono(kWriteFrames);
+        size_t count = 1;
+        while (!done) {
+            // odd sizes, so that the reader is often short of frames and waits
+            count = count % (kWriteFrames - 97) + 97;
+            const auto start = std::chrono::steady_clock::now();
+            EXPECT_EQ(0, readFrames(er, mono, count));
+            readNs.push_back(std::chrono::nanoseconds(
+                    std::chrono::steady_clock::now() - start).count());
+        }
+    });
+
+    std::vector<int16_t> stereo(kWriteFrames * 2, 100);
+    std::vector<int64_t> writeNs;
+    auto next = std::chrono::steady_clock::now();
+    for (size_t block = 0; block < kBlocks; ++block) {
+        const auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(0, writeStereo(er, stereo));
+        writeNs.push_back(std::chrono::nanoseconds(
+                std::chrono::steady_clock::now() - start).count());
+        next += std::chrono::milliseconds(10);
+        std::this_thread::sleep_until(next);
+    }
+    done = true;
+    reader.join();
+    release_echo_reference(er);
+
+    std::sort(writeNs.begin(), writeNs.end());
+    std::sort(readNs.begin(), readNs.end());
+    const int64_t writeMedian = writeNs[writeNs.size() / 2];
+    const int64_t writeP99 = writeNs[writeNs.size() * 99 / 100];
+    ALOGD("write() median %lld ns, 99%% %lld ns, max %lld ns; read() median %lld ns, max %lld ns",
+            (long long)writeMedian, (long long)writeP99, (long long)writeNs.back(),
+            (long long)readNs[readNs.size() / 2], (long long)readNs.back());
+    EXPECT_LT(writeMedian, 100000);   // 100 us
+    EXPECT_LT(writeP99, 1000000);     // 1 ms, a tenth of the period
+}
+
+// Sine of frequency sampled at times start + i / rate, i = 0 .. count - 1, by rotation.
+static void sine(double frequency, double start, double rate, size_t count,
+        std::complex<double> *phasors) {
+    const std::complex<double> step = std::polar(1., 2. * M_PI * frequency / rate);
+    std::complex<double> phasor = std::polar(1., 2. * M_PI * fmod(frequency * start, 1.));
+    for (size_t i = 0; i < count; ++i) {
+        phasors[i] = phasor;
+        phasor *= step;
+    }
+}
+
+static struct timespec toTimespec(double seconds) {
+    const int64_t ns = (int64_t)(seconds * 1e9);
+    return {(time_t)(ns / 1000000000), (long)(ns % 1000000000)};
+}
+
+// An hour of playback and capture with the sample rates of both devices off nominal, as
+// measured against CLOCK_MONOTONIC, is simulated with time stamps: the playback device
+// renders a 50 Hz sine and the microphone hears it without echo path delay. The reference
+// read is compared with what the microphone heard, and their residual misalignment is
+// estimated every 10 s by fitting the reference with the sine and cosine of the capture times.
+// The reference must also stay continuous, including when the resampler takes over from
+// the bypass at equal nominal rates: no sample to sample step may exceed that of the sine.
+class EchoReferenceDriftTest
+        : public ::testing::TestWithParam<std::tuple<uint32_t, uint32_t>> {};
+
+TEST_P(EchoReferenceDriftTest, drift_simulation) {
+    constexpr double kFrequency = 50.;      // a period of 20 ms, longer than any misalignment
+    const uint32_t kWriteRate = std::get<0>(GetParam());
+    const uint32_t kReadRate = std::get<1>(GetParam());
+    constexpr double kPlaybackPpm = 60.;
+    constexpr double kCapturePpm = -45.;
+    const size_t kWriteFrames = kWriteRate / 100;
+    const size_t kReadFrames = kReadRate / 100;
+    constexpr double kPlaybackDelay = 0.020; // the last frame written is rendered after this
+    constexpr double kCaptureDelay = 0.010;  // the first frame read was captured before this
+    constexpr double kDuration = 3600.;
+    constexpr double kWindow = 10.;
+    constexpr double kSettle = 120.;         // the drift estimation takes this to converge
+    constexpr double kEpoch = 1000.;         // CLOCK_MONOTONIC of the simulation start
+    constexpr double kStart = 1.;            // the reference is silent until writes arrive
+    const double playbackRate = kWriteRate * (1. + kPlaybackPpm * 1e-6);
+    const double captureRate = kReadRate * (1. + kCapturePpm * 1e-6);
+
+    struct echo_reference_itfe *er;
+    ASSERT_EQ(0, create_echo_reference(AUDIO_FORMAT_PCM_FLOAT, 1, kReadRate,
+            AUDIO_FORMAT_PCM_FLOAT, 2, kWriteRate, &er));
+    std::vector<float> stereo(kWriteFrames * 2);
+    std::vector<float> mono(kReadFrames);
+    std::vector<std::complex<double>> phasors(kWriteFrames);
+    struct echo_reference_buffer buffer{};
+
+    double writeTime = 0.;
+    double readTime = 0.;
+    double windowEnd = kWindow;
+    double ss = 0., sc = 0., cc = 0., ys = 0., yc = 0.;
+    double minError = INFINITY, maxError = -INFINITY;
+    double maxStep = 0.;
+    float previous = 0.f;
+    while (readTime < kDuration) {
+        if (writeTime <= readTime) {
+            sine(kFrequency, writeTime + kPlaybackDelay - kWriteFrames / playbackRate,
+                    playbackRate, kWriteFrames, phasors.data());
+            for (size_t i = 0; i < kWriteFrames; ++i) {
+                stereo[2 * i] = stereo[2 * i + 1] = 0.5 * phasors[i].imag();
+            }
+            buffer.raw = stereo.data();
+            buffer.frame_count = kWriteFrames;
+            buffer.delay_ns = kPlaybackDelay * 1e9;
+            buffer.time_stamp = toTimespec(kEpoch + writeTime);
+            ASSERT_EQ(0, er->write(er, &buffer));
+            writeTime += kWriteFrames / playbackRate;
+            continue;
+        }
+        buffer.raw = mono.data();
+        buffer.frame_count = kReadFrames;
+        buffer.delay_ns = kCaptureDelay * 1e9;
+        buffer.time_stamp = toTimespec(kEpoch + readTime);
+        ASSERT_EQ(0, er->read(er, &buffer));
+        // the reference is 0.5 * sin(2 pi f (t - error)) for the capture times t
+        sine(kFrequency, readTime - kCaptureDelay, captureRate, kReadFrames, phasors.data());
+        for (size_t i = 0; i < kReadFrames; ++i) {
+            const double s = phasors[i].imag(), c = phasors[i].real();
+            ss += s * s; sc += s * c; cc += c * c; ys += mono[i] * s; yc += mono[i] * c;
+            if (readTime >= kStart) {
+                maxStep = std::max(maxStep, (double)fabsf(mono[i] - previous));
+            }
+            previous = mono[i];
+        }
+        readTime += kReadFrames / captureRate;
+        if (readTime >= windowEnd) {
+            const double det = ss * cc - sc * sc;
+            const double a = (ys * cc - yc * sc) / det;
+            const double b = (yc * ss - ys * sc) / det;
+            const double errorUs = atan2(-b, a) / (2. * M_PI * kFrequency) * 1e6;
+            if (fmod(windowEnd, 300.) < kWindow / 2 || windowEnd <= 60.) {
+                ALOGD("%4.0f s: misalignment %7.1f us, amplitude %.3f",
+                        windowEnd, errorUs, hypot(a, b));
+            }
+            if (windowEnd > kSettle) {
+                minError = std::min(minError, errorUs);
+                maxError = std::max(maxError, errorUs);
+            }
+            ss = sc = cc = ys = yc = 0.;
+            windowEnd += kWindow;
+        }
+    }
+    release_echo_reference(er);
+
+    ALOGD("after %.0f s, misalignment between %.1f and %.1f us, largest step %.5f",
+            kSettle, minError, maxError, maxStep);
+    // a playback to capture drift of 105 ppm is 378 ms an hour
+    EXPECT_LT(std::max(fabs(minError), fabs(maxError)), 50.);
+    EXPECT_LT(maxError - minError, 5.);
+    // 0.5 amplitude sine, with some margin for the resampler passband ripple
+    EXPECT_LT(maxStep, 0.5 * 2. * M_PI * kFrequency / kReadRate * 1.01);
+}
+
+INSTANTIATE_TEST_CASE_P(
+        EchoReferenceDriftTestAll, EchoReferenceDriftTest,
+        ::testing::Values(
+                std::make_tuple(48000, 16000),
+                std::make_tuple(48000, 48000)));
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/ErrorLog.h>
+
+#include "log_benchmark.h"
+
+using namespace android;
+
+// One error per ms, in runs of 8 identical codes so that both aggregation into the current
+// entry and new entries are timed.  A concurrent dumper runs if state.range(0) is not 0.
+template <typename Log>
+static void BM_ErrorLogLog(benchmark::State& state) {
+    constexpr int64_t kPeriodNs = 1000000;
+
+    Log elog(100 /* entries */, 1000000000 /* aggregateNs */);
+
+    int64_t nowNs = 0;
+    int32_t code = 0;
+    benchmarkLogWithDumper(state, elog, [&] {
+        elog.log(code >> 3, nowNs);
+        code = (code + 1) & 63;
+        nowNs += kPeriodNs;
+    });
+}
+
+BENCHMARK_TEMPLATE(BM_ErrorLogLog, ErrorLog<int32_t>)
+        ->ArgName("dumper")->Arg(0)->Arg(1)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ErrorLogLog, SingleWriterErrorLog<int32_t>)
+        ->ArgName("dumper")->Arg(0)->Arg(1)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -17,6 +17,10 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_errorlog_tests"
 
+#include <atomic>
+#include <sstream>
+#include <thread>
+
 #include <audio_utils/ErrorLog.h>
 #include <gtest/gtest.h>
 #include <iostream>
@@ -102,3 +106,62 @@ TEST(audio_utils_errorlog, c) {
       2     1  12-31 16:00:00.000  12-31 16:00:00.000
      */
 }
+
+TEST(audio_utils_errorlog, concurrent_dump) {
+    constexpr size_t kEntries = 10;
+    constexpr uint32_t kRun = 4;        // identical error codes aggregated per entry
+    constexpr int64_t kLogs = 1000000;
+    auto elog = std::make_unique<SingleWriterErrorLog<int32_t>>(
+            kEntries, 1000000000 /* aggregateNs */);
+
+    // Runs of kRun identical codes, alternating between codes 1 and 2.
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int64_t i = 0; i < kLogs; ++i) {
+            elog->log((i / kRun) % 2 + 1 /* code */, i /* nowNs */);
+        }
+        done = true;
+    });
+
+    // Every dump not counted as inconsistent must be a consistent snapshot: all entries are
+    // complete runs, except the newest (last) entry, which has as many errors as logged so far.
+    int64_t lastErrors = 0;
+    auto checkDump = [&] {
+        const int64_t inconsistentDumps = elog->inconsistentDumps();
+        std::istringstream ss(elog->dumpToString());
+        if (elog->inconsistentDumps() != inconsistentDumps) return;
+        std::string line;
+        ASSERT_TRUE(std::getline(ss, line));
+        ASSERT_EQ(0u, line.find("Errors: "));
+        const int64_t errors = std::stoll(line.substr(line.find(':') + 1));
+        ASSERT_LE(lastErrors, errors);
+        lastErrors = errors;
+        if (errors == 0) return;
+
+        ASSERT_TRUE(std::getline(ss, line)); // column header
+        std::vector<std::pair<int32_t, uint32_t>> entries;
+        while (std::getline(ss, line)) {
+            int32_t code;
+            uint32_t count;
+            std::istringstream(line) >> code >> count;
+            entries.emplace_back(code, count);
+        }
+        const size_t expectedEntries = std::min((errors + kRun - 1) / kRun, (int64_t)kEntries);
+        ASSERT_EQ(expectedEntries, entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const int64_t run = (errors - 1) / kRun - (entries.size() - 1 - i);
+            EXPECT_EQ(run % 2 + 1, entries[i].first);
+            EXPECT_EQ(i + 1 == entries.size() ? (errors - 1) % kRun + 1 : kRun,
+                    entries[i].second);
+        }
+    };
+    while (!done) {
+        checkDump();
+    }
+    writer.join();
+    const int64_t inconsistentDumps = elog->inconsistentDumps();
+    checkDump(); // without a writer, the dump is always consistent
+    EXPECT_EQ(inconsistentDumps, elog->inconsistentDumps());
+    EXPECT_EQ(kLogs, lastErrors);
+    std::cout << "inconsistent dumps: " << inconsistentDumps << std::endl;
+}
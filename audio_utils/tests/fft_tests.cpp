@@ -0,0 +1,214 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <audio_utils/fft.h>
+
+// Uniform noise in [-1, 1), reproducible.
+static std::vector<float> makeNoise(size_t count, unsigned seed = 42) {
+    std::minstd_rand gen(seed);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    std::vector<float> noise(count);
+    for (auto &sample : noise) {
+        sample = dis(gen);
+    }
+    return noise;
+}
+
+// Transform of n interleaved complex points by the definition, in double.
+static std::vector<double> dft(const std::vector<float> &x, size_t n) {
+    std::vector<double> cosine(n), sine(n);
+    for (size_t i = 0; i < n; ++i) {
+        cosine[i] = cos(2. * M_PI * i / n);
+        sine[i] = -sin(2. * M_PI * i / n);
+    }
+    std::vector<double> out(2 * n);
+    for (size_t k = 0; k < n; ++k) {
+        double re = 0., im = 0.;
+        for (size_t j = 0; j < n; ++j) {
+            const size_t i = j * k % n;
+            re += x[2 * j] * cosine[i] - x[2 * j + 1] * sine[i];
+            im += x[2 * j] * sine[i] + x[2 * j + 1] * cosine[i];
+        }
+        out[2 * k] = re;
+        out[2 * k + 1] = im;
+    }
+    return out;
+}
+
+// Largest difference relative to the largest magnitude of the expected values.
+template <typename T>
+static double relativeError(const std::vector<float> &actual, const std::vector<T> &expected) {
+    double error = 0., norm = 0.;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        error = std::max(error, fabs(actual[i] - (double)expected[i]));
+        norm = std::max(norm, fabs((double)expected[i]));
+    }
+    return error / norm;
+}
+
+static std::vector<size_t> allSizes() {
+    std::vector<size_t> sizes;
+    for (size_t n = FFT_SIZE_MIN; n <= FFT_SIZE_MAX; n <<= 1) {
+        sizes.push_back(n);
+    }
+    return sizes;
+}
+
+TEST(audio_utils_fft, create) {
+    struct fft_plan *plan;
+    for (size_t n : {0, 1, 3, 6, 1000, FFT_SIZE_MAX * 2}) {
+        EXPECT_EQ(-EINVAL, create_fft_plan(n, &plan)) << n;
+    }
+    for (size_t n : allSizes()) {
+        ASSERT_EQ(0, create_fft_plan(n, &plan)) << n;
+        EXPECT_EQ(n, fft_plan_size(plan));
+        release_fft_plan(plan);
+    }
+}
+
+TEST(audio_utils_fft, complex_forward) {
+    for (size_t n : allSizes()) {
+        if (n > 4096) break;  // the reference is quadratic
+        struct fft_plan *plan;
+        ASSERT_EQ(0, create_fft_plan(n, &plan));
+        const std::vector<float> x = makeNoise(2 * n);
+        std::vector<float> out(2 * n);
+        fft_complex_forward(plan, x.data(), out.data());
+        EXPECT_LT(relativeError(out, dft(x, n)), 1e-6) << n;
+        release_fft_plan(plan);
+    }
+}
+
+TEST(audio_utils_fft, complex_inverse) {
+    for (size_t n : allSizes()) {
+        struct fft_plan *plan;
+        ASSERT_EQ(0, create_fft_plan(n, &plan));
+        const std::vector<float> x = makeNoise(2 * n);
+        std::vector<float> spectrum(2 * n), out(2 * n);
+        fft_complex_forward(plan, x.data(), spectrum.data());
+        fft_complex_inverse(plan, spectrum.data(), out.data());
+        for (auto &sample : out) {
+            sample /= n;
+        }
+        EXPECT_LT(relativeError(out, x), 1e-6) << n;
+
+        // the inverse conjugates the twiddle factors
+        if (n <= 4096) {
+            std::vector<float> conjugate = x;
+            for (size_t i = 1; i < 2 * n; i += 2) {
+                conjugate[i] = -conjugate[i];
+            }
+            fft_complex_inverse(plan, conjugate.data(), out.data());
+            std::vector<double> expected = dft(x, n);
+            for (size_t i = 1; i < 2 * n; i += 2) {
+                expected[i] = -expected[i];
+            }
+            EXPECT_LT(relativeError(out, expected), 1e-6) << n;
+        }
+        release_fft_plan(plan);
+    }
+}
+
+TEST(audio_utils_fft, real) {
+    for (size_t n : allSizes()) {
+        struct fft_plan *plan;
+        ASSERT_EQ(0, create_fft_plan(n, &plan));
+        const std::vector<float> x = makeNoise(n);
+
+        // the same as the complex transform with a zero imaginary part
+        std::vector<float> complex(2 * n);
+        for (size_t i = 0; i < n; ++i) {
+            complex[2 * i] = x[i];
+        }
+        fft_complex_forward(plan, complex.data(), complex.data());
+        std::vector<float> expected(complex.begin(), complex.begin() + n);
+        expected[1] = complex[n];  // the real X[n / 2] is packed in place of the zero im X[0]
+        EXPECT_EQ(0.f, complex[1]);
+        EXPECT_EQ(0.f, complex[n + 1]);
+
+        std::vector<float> spectrum(n), out(n);
+        fft_real_forward(plan, x.data(), spectrum.data());
+        EXPECT_LT(relativeError(spectrum, expected), 1e-6) << n;
+
+        fft_real_inverse(plan, spectrum.data(), out.data());
+        for (auto &sample : out) {
+            sample /= n;
+        }
+        EXPECT_LT(relativeError(out, x), 1e-6) << n;
+        release_fft_plan(plan);
+    }
+}
+
+TEST(audio_utils_fft, in_place) {
+    for (size_t n : allSizes()) {
+        struct fft_plan *plan;
+        ASSERT_EQ(0, create_fft_plan(n, &plan));
+        const std::vector<float> x = makeNoise(2 * n);
+        std::vector<float> expected(2 * n), buffer = x;
+
+        fft_complex_forward(plan, x.data(), expected.data());
+        fft_complex_forward(plan, buffer.data(), buffer.data());
+        EXPECT_EQ(expected, buffer) << n;
+        fft_complex_inverse(plan, x.data(), expected.data());
+        buffer = x;
+        fft_complex_inverse(plan, buffer.data(), buffer.data());
+        EXPECT_EQ(expected, buffer) << n;
+
+        expected.resize(n);
+        buffer.assign(x.begin(), x.begin() + n);
+        fft_real_forward(plan, x.data(), expected.data());
+        fft_real_forward(plan, buffer.data(), buffer.data());
+        EXPECT_EQ(expected, buffer) << n;
+        buffer.assign(x.begin(), x.begin() + n);
+        fft_real_inverse(plan, x.data(), expected.data());
+        fft_real_inverse(plan, buffer.data(), buffer.data());
+        EXPECT_EQ(expected, buffer) << n;
+        release_fft_plan(plan);
+    }
+}
+
+TEST(audio_utils_fft, sine) {
+    // a sine of an integer number of periods is a single pair of bins
+    constexpr size_t n = FFT_SIZE_MAX;
+    constexpr size_t bin = 1000;
+    struct fft_plan *plan;
+    ASSERT_EQ(0, create_fft_plan(n, &plan));
+    std::vector<float> x(n);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = sin(2. * M_PI * bin * i / n);
+    }
+    fft_real_forward(plan, x.data(), x.data());
+    for (size_t k = 0; k < n / 2; ++k) {
+        const float re = k == 0 ? x[0] : x[2 * k];
+        const float im = k == 0 ? 0.f : x[2 * k + 1];
+        if (k == bin) {
+            EXPECT_NEAR(0.f, re, 1e-4 * n);
+            EXPECT_NEAR(-0.5f * n, im, 1e-4 * n);
+        } else {
+            EXPECT_NEAR(0.f, hypot(re, im), 1e-4 * n) << k;
+        }
+    }
+    EXPECT_NEAR(0.f, x[1], 1e-4 * n);
+    release_fft_plan(plan);
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_T_tests"
+
+#include <atomic>
+#include <thread>
+
+#include <audio_utils/fifo_reader_T.h>
+#include <audio_utils/fifo_writer_T.h>
+#include <gtest/gtest.h>
+
+template <typename T>
+class FifoTTest : public ::testing::Test {};
+
+using FifoTTypes = ::testing::Types<int32_t, int64_t, float>;
+TYPED_TEST_CASE(FifoTTest, FifoTTypes);
+
+TYPED_TEST(FifoTTest, basic) {
+    using T = TypeParam;
+    T buffer[16];
+    audio_utils_fifo fifo(16 /*frameCount*/, sizeof(T), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo_writer_T<T> writer(fifo);
+    audio_utils_fifo_reader_T<T> reader(fifo);
+
+    // Nothing is observable before storeRelease and loadAcquire.
+    writer.write1(T(1));
+    EXPECT_EQ(0u, reader.loadAcquire());
+    writer.storeRelease();
+    EXPECT_EQ(0u, reader.available());
+    ASSERT_EQ(1u, reader.loadAcquire());
+    EXPECT_EQ(T(1), reader.read1());
+    EXPECT_EQ(0u, reader.available());
+
+    // Bulk write and read across the wrap point.
+    T data[12];
+    for (int i = 0; i < 12; ++i) data[i] = T(i + 2);
+    writer.write(data, 12);
+    writer.storeRelease();
+    ASSERT_EQ(12u, reader.loadAcquire());
+    T out[12];
+    EXPECT_EQ(5u, reader.read(out, 5));
+    EXPECT_EQ(7u, reader.available());
+    writer.write(data, 4);
+    writer.storeRelease();
+    // Still as of the previous loadAcquire.
+    EXPECT_EQ(7u, reader.read(out + 5, 12));
+    for (int i = 0; i < 12; ++i) {
+        EXPECT_EQ(data[i], out[i]);
+    }
+    ASSERT_EQ(4u, reader.loadAcquire());
+    EXPECT_EQ(4u, reader.read(out, 12));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(data[i], out[i]);
+    }
+    EXPECT_EQ(0u, reader.totalLost());
+}
+
+TYPED_TEST(FifoTTest, overrun) {
+    using T = TypeParam;
+    T buffer[8];
+    audio_utils_fifo fifo(8 /*frameCount*/, sizeof(T), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo_writer_T<T> writer(fifo);
+    audio_utils_fifo_reader_T<T> reader(fifo);
+
+    for (int i = 0; i < 20; ++i) {
+        writer.write1(T(i));
+    }
+    writer.storeRelease();
+    // The reader skips to the oldest frame still in the buffer.
+    ASSERT_EQ(8u, reader.loadAcquire());
+    EXPECT_EQ(12u, reader.totalLost());
+    T out[8];
+    ASSERT_EQ(8u, reader.read(out, 8));
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(T(i + 12), out[i]);
+    }
+}
+
+TEST(audio_utils_fifo_T, threads) {
+    constexpr int64_t kFrames = 1000000;
+    int64_t buffer[1024];
+    audio_utils_fifo fifo(1024 /*frameCount*/, sizeof(int64_t), buffer,
+            false /*throttlesWriter*/);
+    audio_utils_fifo_writer64 writer(fifo);
+    audio_utils_fifo_reader64 reader(fifo);
+
+    // The writer is not throttled, so it waits for the reader to keep the test lossless.
+    std::atomic<int64_t> consumed{0};
+    std::thread writerThread([&] {
+        for (int64_t i = 0; i < kFrames; ++i) {
+            while (i - consumed.load(std::memory_order_acquire) >= 512) {
+                std::this_thread::yield();
+            }
+            writer.write1(i);
+            if ((i & 15) == 15) {
+                writer.storeRelease();
+            }
+        }
+        writer.storeRelease();
+    });
+
+    int64_t expected = 0;
+    while (expected < kFrames) {
+        if (reader.loadAcquire() == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        while (reader.available() > 0) {
+            ASSERT_EQ(expected++, reader.read1());
+        }
+        consumed.store(expected, std::memory_order_release);
+    }
+    writerThread.join();
+    EXPECT_EQ(0u, reader.totalLost());
+}
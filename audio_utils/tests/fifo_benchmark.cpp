@@ -0,0 +1,346 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <atomic>
+#include <limits.h>
+#include <memory>
+#include <sched.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <type_traits>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/fifo.h>
+#include <audio_utils/fifo_reader_T.h>
+#include <audio_utils/fifo_writer_T.h>
+
+static constexpr size_t kPeriod = 256;              // frames per write and per read
+static constexpr size_t kFifoFrames = kPeriod * 4;
+static constexpr size_t kFrameSize = 2 * sizeof(int16_t); // stereo 16-bit
+
+// Writes periods to the FIFO until done, blocking while the FIFO is full.
+static void writerLoop(audio_utils_fifo_writer *writer, const std::atomic<bool> *done) {
+    std::vector<int16_t> data(kPeriod * 2);
+    const struct timespec timeout = {0, 10000000}; // allows to exit when the readers stop
+    while (!*done) {
+        (void) writer->write(data.data(), kPeriod, &timeout);
+    }
+}
+
+// Copies a slice out of the FIFO, as a reader would.
+static void copySlice(const audio_utils_fifo& fifo, const audio_utils_iovec iovec[2], void *dst) {
+    const char *buffer = (const char *) const_cast<audio_utils_fifo&>(fifo).buffer();
+    memcpy(dst, buffer + iovec[0].mOffset * kFrameSize, iovec[0].mLength * kFrameSize);
+    memcpy((char *) dst + iovec[0].mLength * kFrameSize, buffer + iovec[1].mOffset * kFrameSize,
+            iovec[1].mLength * kFrameSize);
+}
+
+// One writer thread, N readers served by the benchmark thread, each reader reading
+// up to one period per iteration with its own obtain() and release().
+// The first reader throttles the writer, the others keep up with it.
+// state.range(0) is the number of readers.
+static void BM_FifoReaders(benchmark::State& state) {
+    const size_t readerCount = state.range(0);
+    std::vector<char> buffer(kFifoFrames * kFrameSize);
+    audio_utils_fifo fifo(kFifoFrames, kFrameSize, buffer.data(), true /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    std::vector<std::unique_ptr<audio_utils_fifo_reader>> readers;
+    for (size_t i = 0; i < readerCount; ++i) {
+        readers.emplace_back(new audio_utils_fifo_reader(fifo, i == 0 /*throttlesWriter*/));
+    }
+    std::vector<char> dst(kPeriod * kFrameSize);
+
+    std::atomic<bool> done{false};
+    std::thread writerThread(writerLoop, &writer, &done);
+    const struct timespec forever = {LONG_MAX, 0};
+    int64_t frames = 0;
+    for (auto _ : state) {
+        // Throttling reader last, so the others do not fall behind.
+        for (size_t i = readerCount; i-- > 0; ) {
+            audio_utils_iovec iovec[2];
+            ssize_t obtained = readers[i]->obtain(iovec, kPeriod, &forever);
+            if (obtained > 0) {
+                copySlice(fifo, iovec, dst.data());
+                readers[i]->release(obtained);
+                frames += obtained;
+            }
+        }
+    }
+    done = true;
+    writerThread.join();
+    state.SetItemsProcessed(frames);
+}
+
+BENCHMARK(BM_FifoReaders)->Arg(1)->Arg(2)->Arg(4)->Arg(6)->UseRealTime();
+
+// Same as BM_FifoReaders, but the N readers are an audio_utils_fifo_reader_group
+// which throttles the writer with its slowest reader.
+// state.range(0) is the number of readers.
+static void BM_FifoReaderGroup(benchmark::State& state) {
+    const size_t readerCount = state.range(0);
+    std::vector<char> buffer(kFifoFrames * kFrameSize);
+    audio_utils_fifo fifo(kFifoFrames, kFrameSize, buffer.data(), true /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader_group group(fifo, readerCount);
+    // group.obtain() takes the pairs as a C array, which std::array lays out the same
+    std::vector<std::array<audio_utils_iovec, 2>> iovecs(readerCount);
+    static_assert(sizeof(iovecs[0]) == sizeof(audio_utils_iovec[2]));
+    std::vector<ssize_t> obtained(readerCount);
+    std::vector<size_t> counts(readerCount);
+    std::vector<char> dst(kPeriod * kFrameSize);
+
+    std::atomic<bool> done{false};
+    std::thread writerThread(writerLoop, &writer, &done);
+    const struct timespec forever = {LONG_MAX, 0};
+    int64_t frames = 0;
+    for (auto _ : state) {
+        (void) group.obtain(reinterpret_cast<audio_utils_iovec (*)[2]>(iovecs.data()),
+                obtained.data(), kPeriod, &forever);
+        for (size_t i = 0; i < readerCount; ++i) {
+            counts[i] = obtained[i] > 0 ? obtained[i] : 0;
+            if (counts[i] > 0) {
+                copySlice(fifo, iovecs[i].data(), dst.data());
+                frames += counts[i];
+            }
+        }
+        group.release(counts.data());
+    }
+    done = true;
+    writerThread.join();
+    state.SetItemsProcessed(frames);
+}
+
+BENCHMARK(BM_FifoReaderGroup)->Arg(1)->Arg(2)->Arg(4)->Arg(6)->UseRealTime();
+
+// Telemetry stream through writer_T and reader_T, one element at a time with write1 and read1,
+// committing and observing once per state.range(0) elements.
+template <typename T>
+static void BM_FifoT_1(benchmark::State& state) {
+    const uint32_t count = state.range(0);
+    std::vector<T> buffer(1024);
+    audio_utils_fifo fifo(buffer.size(), sizeof(T), buffer.data(), false /*throttlesWriter*/);
+    audio_utils_fifo_writer_T<T> writer(fifo);
+    audio_utils_fifo_reader_T<T> reader(fifo);
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < count; ++i) {
+            writer.write1(T(i));
+        }
+        writer.storeRelease();
+        (void) reader.loadAcquire();
+        for (uint32_t i = 0; i < count; ++i) {
+            benchmark::DoNotOptimize(reader.read1());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+// Same as BM_FifoT_1, but with bulk write and read of state.range(0) elements.
+template <typename T>
+static void BM_FifoT(benchmark::State& state) {
+    const uint32_t count = state.range(0);
+    std::vector<T> buffer(1024);
+    audio_utils_fifo fifo(buffer.size(), sizeof(T), buffer.data(), false /*throttlesWriter*/);
+    audio_utils_fifo_writer_T<T> writer(fifo);
+    audio_utils_fifo_reader_T<T> reader(fifo);
+    std::vector<T> src(count), dst(count);
+    for (auto _ : state) {
+        writer.write(src.data(), count);
+        writer.storeRelease();
+        (void) reader.loadAcquire();
+        benchmark::DoNotOptimize(reader.read(dst.data(), count));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+// Same as BM_FifoT, but with the ordinary writer and reader, for comparison.
+template <typename T>
+static void BM_Fifo(benchmark::State& state) {
+    const uint32_t count = state.range(0);
+    std::vector<T> buffer(1024);
+    audio_utils_fifo fifo(buffer.size(), sizeof(T), buffer.data(), false /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader reader(fifo, false /*throttlesWriter*/);
+    std::vector<T> src(count), dst(count);
+    for (auto _ : state) {
+        (void) writer.write(src.data(), count);
+        benchmark::DoNotOptimize(reader.read(dst.data(), count));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK_TEMPLATE(BM_FifoT_1, int32_t)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_FifoT_1, float)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_FifoT_1, int64_t)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_FifoT, int32_t)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_FifoT, float)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_FifoT, int64_t)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_Fifo, int32_t)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_Fifo, float)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_Fifo, int64_t)->Arg(1)->Arg(16)->Arg(256);
+
+// Returns the first two CPUs the calling thread may run on, or false if there are fewer.
+static bool twoCpus(int cpus[2]) {
+    cpu_set_t set;
+    if (sched_getaffinity(0 /*pid*/, sizeof(set), &set) != 0) {
+        return false;
+    }
+    int found = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && found < 2; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus[found++] = cpu;
+        }
+    }
+    return found == 2;
+}
+
+// Pins the calling thread to the given CPU.
+static bool pinToCpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0 /*pid*/, sizeof(set), &set) == 0;
+}
+
+// Two-core streaming between a writer and a reader which poll without blocking, each pinned to
+// its own CPU. An iteration is kFramesPerIteration frames received by the reader, in transfers
+// of at most kCount frames, so that polls of an empty FIFO are not counted as iterations.
+// FifoT is either audio_utils_fifo, whose indices are adjacent to each other and to the
+// FIFO fields read by both sides, or audio_utils_fifo_padded.
+// The writer and reader objects are adjacent in memory unless Padded is true.
+// The benchmark is skipped where the thread may run on fewer than two CPUs.
+template <typename FifoT, bool Padded>
+static void BM_FifoFalseSharing(benchmark::State& state) {
+    using Writer = typename std::conditional<Padded,
+            audio_utils_cache_line_aligned<audio_utils_fifo_writer>,
+            audio_utils_fifo_writer>::type;
+    using Reader = typename std::conditional<Padded,
+            audio_utils_cache_line_aligned<audio_utils_fifo_reader>,
+            audio_utils_fifo_reader>::type;
+    constexpr uint32_t kCount = 4;  // small transfers, so index traffic dominates
+    constexpr int64_t kFramesPerIteration = 1024;
+    int cpus[2];
+    cpu_set_t saved;
+    if (!twoCpus(cpus) || sched_getaffinity(0 /*pid*/, sizeof(saved), &saved) != 0) {
+        state.SkipWithError("needs two CPUs");
+        return;
+    }
+    std::vector<int32_t> buffer(256);
+    FifoT fifo(buffer.size(), sizeof(int32_t), buffer.data(), true /*throttlesWriter*/);
+    struct Endpoints {
+        Endpoints(audio_utils_fifo& fifo) : mWriter(fifo), mReader(fifo) { }
+        Writer mWriter;
+        Reader mReader;
+    } endpoints(fifo);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> writerPinned{0};  // 1 when pinned, -1 on failure
+    std::thread writerThread([&] {
+        writerPinned = pinToCpu(cpus[1]) ? 1 : -1;
+        const int32_t data[kCount] = {};
+        while (!done.load(std::memory_order_relaxed)) {
+            (void) endpoints.mWriter.write(data, kCount);
+        }
+    });
+    while (writerPinned == 0) {
+        std::this_thread::yield();
+    }
+    if (writerPinned < 0 || !pinToCpu(cpus[0])) {
+        state.SkipWithError("sched_setaffinity failed");
+    }
+
+    for (auto _ : state) {
+        for (int64_t frames = 0; frames < kFramesPerIteration; ) {
+            int32_t data[kCount];
+            const ssize_t actual = endpoints.mReader.read(data, kCount);
+            if (actual > 0) {
+                frames += actual;
+            }
+        }
+    }
+    done = true;
+    writerThread.join();
+    (void) sched_setaffinity(0 /*pid*/, sizeof(saved), &saved);
+    state.SetItemsProcessed(state.iterations() * kFramesPerIteration);
+}
+
+BENCHMARK_TEMPLATE(BM_FifoFalseSharing, audio_utils_fifo, false)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FifoFalseSharing, audio_utils_fifo, true)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FifoFalseSharing, audio_utils_fifo_padded, false)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FifoFalseSharing, audio_utils_fifo_padded, true)->UseRealTime();
+
+static int64_t monotonicNs() {
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Wakeup latency of a blocking reader, for a writer which writes one frame every period,
+// with and without polling the index before the futex wait, see audio_utils_fifo_spinning_reader.
+// The frame is the write time, so the reader measures the latency from write to read return.
+// The CPU time reported by the benchmark is that of the reader thread.
+// state.range(0) is the write period in microseconds, state.range(1) the spin budget.
+static void BM_FifoWakeup(benchmark::State& state) {
+    const int64_t periodNs = state.range(0) * 1000;
+    int64_t buffer[16];
+    audio_utils_fifo fifo(16 /*frameCount*/, sizeof(int64_t), buffer, true /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_spinning_reader reader(fifo, state.range(1) * 1000 /*spinNs*/);
+
+    std::atomic<bool> done{false};
+    std::thread writerThread([&] {
+        struct timespec next;
+        (void) clock_gettime(CLOCK_MONOTONIC, &next);
+        while (!done) {
+            next.tv_nsec += periodNs;
+            if (next.tv_nsec >= 1000000000) {
+                next.tv_nsec -= 1000000000;
+                next.tv_sec++;
+            }
+            (void) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL /*remain*/);
+            const int64_t nowNs = monotonicNs();
+            (void) writer.write(&nowNs, 1);
+        }
+    });
+
+    const struct timespec timeout = {1, 0};
+    int64_t totalNs = 0;
+    int64_t maxNs = 0;
+    int64_t frames = 0;
+    for (auto _ : state) {
+        int64_t writeNs;
+        if (reader.read(&writeNs, 1, &timeout) == 1) {
+            const int64_t latencyNs = monotonicNs() - writeNs;
+            totalNs += latencyNs;
+            maxNs = std::max(maxNs, latencyNs);
+            ++frames;
+        }
+    }
+    done = true;
+    writerThread.join();
+    state.counters["latency_ns"] = frames > 0 ? totalNs / frames : 0;
+    state.counters["max_latency_ns"] = maxNs;
+}
+
+BENCHMARK(BM_FifoWakeup)->ArgNames({"period_us", "spin_us"})
+        ->Args({1000, 0})->Args({1000, 200})->Args({1000, 1100})
+        ->Args({250, 0})->Args({250, 50})->Args({250, 300})
+        ->Iterations(2000)->UseRealTime();
+
+BENCHMARK_MAIN();
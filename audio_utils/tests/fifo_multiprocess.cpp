@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -31,8 +32,12 @@
 #define FRAME_SIZE sizeof(int16_t)
 #define BUFFER_SIZE (FRAME_COUNT * FRAME_SIZE)
 
-int main(int argc __unused, char **argv __unused)
+int main(int argc, char **argv)
 {
+    // optional argument is the spin budget in microseconds, see audio_utils_fifo_spinning_reader
+    const int64_t spinNs = argc > 1 ? atoll(argv[1]) * 1000 : 0;
+    printf("spinNs=%lld\n", (long long) spinNs);
+
     // TODO Add error checking for ashmem_create_region and mmap
 
     const int frontFd = ashmem_create_region("front", sizeof(audio_utils_fifo_index));
@@ -86,7 +91,7 @@ int main(int argc __unused, char **argv __unused)
 
         // Retain our read/write mapping of rear index and data
         audio_utils_fifo fifo(FRAME_COUNT, FRAME_SIZE, data, *rearIndex, frontIndex);
-        audio_utils_fifo_writer writer(fifo);
+        audio_utils_fifo_spinning_writer writer(fifo, spinNs);
 
         sleep(2);
 
@@ -159,7 +164,7 @@ int main(int argc __unused, char **argv __unused)
 
         // Retain our read/write mapping of front index
         audio_utils_fifo fifo(FRAME_COUNT, FRAME_SIZE, data, *rearIndex, frontIndex);
-        audio_utils_fifo_reader reader(fifo);
+        audio_utils_fifo_spinning_reader reader(fifo, spinNs);
 
         for (;;) {
             int16_t value;
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_reader_group_tests"
+
+#include <errno.h>
+#include <limits.h>
+#include <thread>
+#include <vector>
+
+#include <audio_utils/fifo.h>
+#include <gtest/gtest.h>
+
+// Reads the frames of one reader's slice into a vector.
+static std::vector<int32_t> slice(const audio_utils_fifo& fifo, const audio_utils_iovec iovec[2]) {
+    const int32_t *buffer = (const int32_t *) const_cast<audio_utils_fifo&>(fifo).buffer();
+    std::vector<int32_t> frames(buffer + iovec[0].mOffset,
+            buffer + iovec[0].mOffset + iovec[0].mLength);
+    frames.insert(frames.end(), buffer + iovec[1].mOffset,
+            buffer + iovec[1].mOffset + iovec[1].mLength);
+    return frames;
+}
+
+TEST(audio_utils_fifo_reader_group, throttle) {
+    constexpr size_t kReaders = 3;
+    int32_t buffer[12]; // not a power of 2, to exercise the fudge factor
+    audio_utils_fifo fifo(12 /*frameCount*/, sizeof(int32_t), buffer, true /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader_group group(fifo, kReaders);
+    ASSERT_EQ(kReaders, group.size());
+
+    audio_utils_iovec iovecs[kReaders][2];
+    ssize_t obtained[kReaders];
+    EXPECT_EQ(0, group.obtain(iovecs, obtained));
+
+    int32_t next = 0;
+    int32_t data[12];
+    for (auto& d : data) d = next++;
+    ASSERT_EQ(10, writer.write(data, 10));
+
+    ASSERT_EQ(10, group.obtain(iovecs, obtained));
+    for (size_t i = 0; i < kReaders; ++i) {
+        ASSERT_EQ(10, obtained[i]);
+        EXPECT_EQ(std::vector<int32_t>(data, data + 10), slice(fifo, iovecs[i]));
+    }
+
+    // The writer is throttled by the slowest reader only.
+    const size_t counts1[kReaders] = {10, 4, 0};
+    group.release(counts1);
+    EXPECT_EQ(2, writer.available());
+    const size_t counts2[kReaders] = {0, 6, 7};
+    group.release(counts2);
+    EXPECT_EQ(9, writer.available());
+
+    // Wrap around.
+    for (auto& d : data) d = next++;
+    ASSERT_EQ(9, writer.write(data, 12));
+    ASSERT_EQ(12, group.obtain(iovecs, obtained, 12));
+    EXPECT_EQ(9, obtained[0]);
+    EXPECT_EQ(9, obtained[1]);
+    EXPECT_EQ(12, obtained[2]);
+    EXPECT_EQ(std::vector<int32_t>(data, data + 9), slice(fifo, iovecs[0]));
+    std::vector<int32_t> expected = {7, 8, 9};
+    expected.insert(expected.end(), data, data + 9);
+    EXPECT_EQ(expected, slice(fifo, iovecs[2]));
+
+    const size_t counts3[kReaders] = {9, 9, 12};
+    group.release(counts3);
+    EXPECT_EQ(12, writer.available());
+    for (size_t i = 0; i < kReaders; ++i) {
+        EXPECT_EQ(19u, group.reader(i).totalReleased());
+    }
+
+    // Non-blocking obtain of an empty group.
+    const struct timespec zero = {0, 0};
+    EXPECT_EQ(0, group.obtain(iovecs, obtained, SIZE_MAX, &zero));
+    const struct timespec shortTimeout = {0, 1000000};
+    EXPECT_EQ(-ETIMEDOUT, group.obtain(iovecs, obtained, SIZE_MAX, &shortTimeout));
+}
+
+TEST(audio_utils_fifo_reader_group, overflow) {
+    constexpr size_t kReaders = 2;
+    int32_t buffer[8];
+    audio_utils_fifo fifo(8 /*frameCount*/, sizeof(int32_t), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader_group group(fifo, kReaders, false /*throttlesWriter*/);
+
+    int32_t data[8] = {};
+    audio_utils_iovec iovecs[kReaders][2];
+    ssize_t obtained[kReaders];
+    size_t lost[kReaders];
+    ASSERT_EQ(6, writer.write(data, 6));
+    ASSERT_EQ(6, group.obtain(iovecs, obtained, SIZE_MAX, NULL, lost));
+    const size_t counts[kReaders] = {6, 0};
+    group.release(counts);
+
+    // Reader 1 falls more than a buffer behind, reader 0 does not.
+    ASSERT_EQ(8, writer.write(data, 8));
+    ASSERT_EQ(8, group.obtain(iovecs, obtained, SIZE_MAX, NULL, lost));
+    EXPECT_EQ(8, obtained[0]);
+    EXPECT_EQ(0u, lost[0]);
+    EXPECT_EQ(-EOVERFLOW, obtained[1]);
+    EXPECT_EQ(6u, lost[1]);
+    EXPECT_EQ(6u, group.reader(1).totalLost());
+
+    // After re-synchronization reader 1 sees the still valid frames.
+    ASSERT_EQ(8, group.obtain(iovecs, obtained, SIZE_MAX, NULL, lost));
+    EXPECT_EQ(8, obtained[1]);
+}
+
+TEST(audio_utils_fifo_reader_group, threads) {
+    constexpr size_t kReaders = 4;
+    constexpr int32_t kFrames = 100000;
+    constexpr size_t kPeriod = 48;
+    std::vector<int32_t> buffer(kPeriod * 4);
+    audio_utils_fifo fifo(buffer.size(), sizeof(int32_t), buffer.data(),
+            true /*throttlesWriter*/);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader_group group(fifo, kReaders);
+
+    std::thread writerThread([&] {
+        const struct timespec forever = {LONG_MAX, 0};
+        int32_t next = 0;
+        while (next < kFrames) {
+            int32_t data[kPeriod];
+            for (auto& d : data) d = next++;
+            for (size_t written = 0; written < kPeriod; ) {
+                ssize_t actual = writer.write(data + written, kPeriod - written, &forever);
+                ASSERT_LT(0, actual);
+                written += actual;
+            }
+        }
+    });
+
+    // Readers consume at different rates, but all see every frame in order.
+    const struct timespec forever = {LONG_MAX, 0};
+    int32_t expected[kReaders] = {};
+    while (expected[kReaders - 1] < kFrames) {
+        audio_utils_iovec iovecs[kReaders][2];
+        ssize_t obtained[kReaders];
+        ASSERT_LT(0, group.obtain(iovecs, obtained, SIZE_MAX, &forever));
+        size_t counts[kReaders];
+        for (size_t i = 0; i < kReaders; ++i) {
+            ASSERT_LE(0, obtained[i]);
+            counts[i] = std::min((size_t) obtained[i], kPeriod / (i + 1));
+            const std::vector<int32_t> frames = slice(fifo, iovecs[i]);
+            for (size_t j = 0; j < counts[i]; ++j) {
+                ASSERT_EQ(expected[i]++, frames[j]);
+            }
+        }
+        group.release(counts);
+    }
+    writerThread.join();
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_shared_tests"
+
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <audio_utils/fifo_shared.h>
+#include <gtest/gtest.h>
+
+TEST(audio_utils_fifo_shared, attach) {
+    auto creator = audio_utils_fifo_shared::create(100 /*frameCount*/, sizeof(int32_t));
+    ASSERT_NE(nullptr, creator);
+    auto attached = audio_utils_fifo_shared::attach(creator->fd());
+    ASSERT_NE(nullptr, attached);
+    EXPECT_EQ(100u, attached->fifo().capacity());
+    EXPECT_EQ(sizeof(int32_t), attached->fifo().frameSize());
+
+    // Each part of the region is on its own cache line.
+    const uintptr_t buffer = (uintptr_t) attached->fifo().buffer();
+    EXPECT_EQ(0u, buffer % AUDIO_UTILS_FIFO_SHARED_ALIGNMENT);
+
+    auto writer = creator->createWriter();
+    auto reader = attached->createReader();
+    int32_t data[60];
+    for (int32_t i = 0; i < 60; ++i) data[i] = i;
+    ASSERT_EQ(60, writer->write(data, 60));
+    EXPECT_EQ(40, writer->available());
+
+    // The reader sees the writer's frames in place, in its own mapping.
+    audio_utils_iovec iovec[2];
+    ASSERT_EQ(60, reader->obtain(iovec, SIZE_MAX));
+    const int32_t *frames = (const int32_t *) attached->fifo().buffer();
+    for (int32_t i = 0; i < 60; ++i) {
+        ASSERT_EQ(i, frames[iovec[0].mOffset + i]);
+    }
+    reader->release(60);
+    EXPECT_EQ(100, writer->available());
+}
+
+TEST(audio_utils_fifo_shared, process) {
+    constexpr int32_t kFrames = 100000;
+    auto creator = audio_utils_fifo_shared::create(256 /*frameCount*/, sizeof(int32_t));
+    ASSERT_NE(nullptr, creator);
+
+    const pid_t pid = fork();
+    ASSERT_LE(0, pid);
+    if (pid == 0) {
+        // The child inherits the descriptor, as if received over binder.
+        auto attached = audio_utils_fifo_shared::attach(creator->fd());
+        if (attached == nullptr) _exit(1);
+        auto reader = attached->createReader();
+        const struct timespec timeout = {5, 0};
+        for (int32_t expected = 0; expected < kFrames; ) {
+            int32_t buffer[64];
+            ssize_t actual = reader->read(buffer, 64, &timeout);
+            if (actual <= 0) _exit(2);
+            for (ssize_t i = 0; i < actual; ++i) {
+                if (buffer[i] != expected++) _exit(3);
+            }
+        }
+        _exit(0);
+    }
+
+    auto writer = creator->createWriter();
+    const struct timespec timeout = {5, 0};
+    for (int32_t next = 0; next < kFrames; ) {
+        int32_t buffer[64];
+        const int32_t count = std::min(64, kFrames - next);
+        for (int32_t i = 0; i < count; ++i) buffer[i] = next + i;
+        ssize_t actual = writer->write(buffer, count, &timeout);
+        ASSERT_LT(0, actual);
+        next += actual;
+    }
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST(audio_utils_fifo_shared, invalid) {
+    // Not a shared memory FIFO.
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    EXPECT_EQ(nullptr, audio_utils_fifo_shared::attach(fds[0]));
+    close(fds[0]);
+    close(fds[1]);
+
+    // Corrupted header.
+    auto creator = audio_utils_fifo_shared::create(16 /*frameCount*/, sizeof(int16_t));
+    ASSERT_NE(nullptr, creator);
+    auto header = (audio_utils_fifo_shared_header *) mmap(NULL, getpagesize(),
+            PROT_READ | PROT_WRITE, MAP_SHARED, creator->fd(), 0);
+    ASSERT_NE(MAP_FAILED, (void *) header);
+    header->mFrameCount = INT32_MAX;
+    EXPECT_EQ(nullptr, audio_utils_fifo_shared::attach(creator->fd()));
+    header->mFrameCount = 16;
+    header->mVersion = AUDIO_UTILS_FIFO_SHARED_VERSION + 1;
+    EXPECT_EQ(nullptr, audio_utils_fifo_shared::attach(creator->fd()));
+    header->mVersion = AUDIO_UTILS_FIFO_SHARED_VERSION;
+    EXPECT_NE(nullptr, audio_utils_fifo_shared::attach(creator->fd()));
+    munmap(header, getpagesize());
+}
@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <audio_utils/fifo.h>
 extern "C" {
@@ -24,10 +25,10 @@ extern "C" {
 }
 
 struct Context {
-    audio_utils_fifo_writer *mInputWriter;
-    audio_utils_fifo_reader *mInputReader;
-    audio_utils_fifo_writer *mTransferWriter;
-    audio_utils_fifo_reader *mTransferReader;
+    audio_utils_fifo_spinning_writer *mInputWriter;
+    audio_utils_fifo_spinning_reader *mInputReader;
+    audio_utils_fifo_spinning_writer *mTransferWriter;
+    audio_utils_fifo_spinning_reader *mTransferReader;
     audio_utils_fifo_writer *mOutputWriter;
     audio_utils_fifo_reader *mOutputReader;
 };
@@ -96,22 +97,23 @@ void *output_routine(void *arg)
 
 int main(int argc, char **argv)
 {
+    // optional argument is the spin budget in microseconds, see audio_utils_fifo_spinning_reader
+    const int64_t spinNs = argc > 1 ? atoll(argv[1]) * 1000 : 0;
     set_conio_terminal_mode();
-    argc = argc + 0;
-    argv = &argv[0];
 
     char inputBuffer[16];
     audio_utils_fifo inputFifo(sizeof(inputBuffer) /*frameCount*/, 1 /*frameSize*/, inputBuffer,
             true /*throttlesWriter*/);
-    audio_utils_fifo_writer inputWriter(inputFifo);
-    audio_utils_fifo_reader inputReader(inputFifo, true /*throttlesWriter*/);
+    audio_utils_fifo_spinning_writer inputWriter(inputFifo, spinNs);
+    audio_utils_fifo_spinning_reader inputReader(inputFifo, spinNs, true /*throttlesWriter*/);
     //inputWriter.setHysteresis(sizeof(inputBuffer) * 1/4, sizeof(inputBuffer) * 3/4);
 
     char transferBuffer[64];
     audio_utils_fifo transferFifo(sizeof(transferBuffer) /*frameCount*/, 1 /*frameSize*/,
             transferBuffer, true /*throttlesWriter*/);
-    audio_utils_fifo_writer transferWriter(transferFifo);
-    audio_utils_fifo_reader transferReader(transferFifo, true /*throttlesWriter*/);
+    audio_utils_fifo_spinning_writer transferWriter(transferFifo, spinNs);
+    audio_utils_fifo_spinning_reader transferReader(transferFifo, spinNs,
+            true /*throttlesWriter*/);
     transferReader.setHysteresis(sizeof(transferBuffer) * 3/4, sizeof(transferBuffer) * 1/4);
     //transferWriter.setEffective(8);
 
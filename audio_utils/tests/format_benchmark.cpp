@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/format.h>
+
+struct Conversion {
+    audio_format_t srcFormat;
+    audio_channel_mask_t srcMask;
+    audio_format_t dstFormat;
+    audio_channel_mask_t dstMask;
+};
+
+// typical HAL output and input conversions
+static const Conversion kConversions[] = {
+    {AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_7POINT1,
+            AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO},
+    {AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_5POINT1},
+    {AUDIO_FORMAT_PCM_24_BIT_PACKED, AUDIO_CHANNEL_OUT_5POINT1,
+            AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO},
+    {AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_FORMAT_PCM_32_BIT, AUDIO_CHANNEL_INDEX_MASK_4},
+};
+
+/*
+ * Args: conversion index, frame count, fused.
+ * The two step conversion is memcpy_by_audio_format() into an intermediate buffer
+ * followed by memcpy_by_index_array(), as done by callers before
+ * memcpy_by_audio_format_and_channel_mask().  Bytes processed counts the
+ * source and destination buffers only.
+ */
+static void BM_MemcpyByAudioFormatAndChannelMask(benchmark::State& state) {
+    const Conversion &c = kConversions[state.range(0)];
+    const size_t frames = state.range(1);
+    const bool fused = state.range(2);
+    const size_t srcChannels = audio_channel_count_from_out_mask(c.srcMask);
+    const size_t dstChannels = audio_channel_count_from_out_mask(c.dstMask);
+    const size_t srcBytes = frames * srcChannels * audio_bytes_per_sample(c.srcFormat);
+    const size_t dstBytes = frames * dstChannels * audio_bytes_per_sample(c.dstFormat);
+
+    std::vector<uint8_t> src(srcBytes);
+    for (size_t i = 0; i < srcBytes; ++i) {
+        src[i] = i * 7;
+    }
+    std::vector<uint8_t> dst(dstBytes);
+    std::vector<uint8_t> intermediate(frames * srcChannels * audio_bytes_per_sample(c.dstFormat));
+    int8_t idxary[32];
+    memcpy_by_index_array_initialization_from_channel_mask(idxary, 32, c.dstMask, c.srcMask);
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        if (fused) {
+            memcpy_by_audio_format_and_channel_mask(dst.data(), c.dstFormat, c.dstMask,
+                    src.data(), c.srcFormat, c.srcMask, frames);
+        } else {
+            memcpy_by_audio_format(intermediate.data(), c.dstFormat,
+                    src.data(), c.srcFormat, frames * srcChannels);
+            memcpy_by_index_array(dst.data(), dstChannels, intermediate.data(), srcChannels,
+                    idxary, audio_bytes_per_sample(c.dstFormat), frames);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * (srcBytes + dstBytes));
+}
+
+static void ConversionArgs(benchmark::internal::Benchmark* b) {
+    for (size_t i = 0; i < sizeof(kConversions) / sizeof(kConversions[0]); ++i) {
+        // 20 ms, and 1 s which exceeds the caches
+        for (int frames : {960, 48000}) {
+            b->Args({(int)i, frames, false})->Args({(int)i, frames, true});
+        }
+    }
+}
+
+BENCHMARK(BM_MemcpyByAudioFormatAndChannelMask)->Apply(ConversionArgs);
+
+BENCHMARK_MAIN();
@@ -131,3 +131,90 @@ INSTANTIATE_TEST_CASE_P(FormatVariations, FormatTest, ::testing::Combine(
         AUDIO_FORMAT_PCM_32_BIT,
         AUDIO_FORMAT_PCM_8_24_BIT
     )));
+
+class FormatChannelMaskTest : public FormatTest
+{
+};
+
+TEST_P(FormatChannelMaskTest, memcpy_by_audio_format_and_channel_mask)
+{
+    const auto param = GetParam();
+    const audio_format_t src_encoding = std::get<0>(param);
+    const audio_format_t dst_encoding = std::get<1>(param);
+    if (!is_common_src_format(src_encoding) && !is_common_dst_format(dst_encoding)) {
+        return;
+    }
+
+    // mask pairs covering identity, contraction, expansion, reordering and index masks.
+    const std::pair<audio_channel_mask_t, audio_channel_mask_t> masks[] = {
+        {AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_STEREO},
+        {AUDIO_CHANNEL_OUT_MONO, AUDIO_CHANNEL_OUT_STEREO},
+        {AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_MONO},
+        {AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_5POINT1},
+        {AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_7POINT1},
+        {AUDIO_CHANNEL_OUT_7POINT1, AUDIO_CHANNEL_OUT_STEREO},
+        {AUDIO_CHANNEL_OUT_7POINT1, AUDIO_CHANNEL_OUT_5POINT1},
+        {audio_channel_mask_for_index_assignment_from_count(4), AUDIO_CHANNEL_OUT_7POINT1},
+        {AUDIO_CHANNEL_OUT_QUAD, audio_channel_mask_for_index_assignment_from_count(8)},
+        {audio_channel_mask_for_index_assignment_from_count(2),
+                audio_channel_mask_for_index_assignment_from_count(2)},
+        {AUDIO_CHANNEL_OUT_STEREO, audio_channel_mask_for_index_assignment_from_count(2)},
+    };
+    // more frames than a conversion block, with a tail.
+    constexpr size_t FRAMES = 1001;
+    constexpr size_t CHANNELS_MAX = 8;
+    int16_t orig_data[FRAMES * CHANNELS_MAX];
+    for (size_t i = 0; i < FRAMES * CHANNELS_MAX; ++i) {
+        orig_data[i] = (int16_t)(i * 0x0101);
+    }
+    uint32_t src[FRAMES * CHANNELS_MAX];
+    memcpy_by_audio_format(src, src_encoding,
+            orig_data, AUDIO_FORMAT_PCM_16_BIT, FRAMES * CHANNELS_MAX);
+
+    for (const auto &mask : masks) {
+        const audio_channel_mask_t dst_mask = mask.first;
+        const audio_channel_mask_t src_mask = mask.second;
+        const size_t src_channels = audio_channel_count_from_out_mask(src_mask);
+        const size_t dst_channels = audio_channel_count_from_out_mask(dst_mask);
+        const size_t dst_bytes = FRAMES * dst_channels * audio_bytes_per_sample(dst_encoding);
+
+        // two step reference: format conversion then channel remix.
+        uint32_t converted[FRAMES * CHANNELS_MAX];
+        memcpy_by_audio_format(converted, dst_encoding,
+                src, src_encoding, FRAMES * src_channels);
+        int8_t idxary[32];
+        ASSERT_EQ(dst_channels, memcpy_by_index_array_initialization_from_channel_mask(
+                idxary, 32, dst_mask, src_mask));
+        uint32_t check[FRAMES * CHANNELS_MAX];
+        memcpy_by_index_array(check, dst_channels, converted, src_channels,
+                idxary, audio_bytes_per_sample(dst_encoding), FRAMES);
+
+        uint32_t data[FRAMES * CHANNELS_MAX + 1];
+        memset(data, 0x55, sizeof(data));
+        memcpy_by_audio_format_and_channel_mask(data, dst_encoding, dst_mask,
+                src, src_encoding, src_mask, FRAMES);
+        EXPECT_EQ(0, memcmp(check, data, dst_bytes))
+                << "src:" << std::hex << src_encoding << " dst:" << dst_encoding
+                << " src_mask:" << src_mask << " dst_mask:" << dst_mask;
+        // nothing written past the end of the destination.
+        EXPECT_EQ(0x55, ((uint8_t *)data)[dst_bytes]);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(FormatChannelMaskVariations, FormatChannelMaskTest, ::testing::Combine(
+    ::testing::Values(
+        AUDIO_FORMAT_PCM_8_BIT,
+        AUDIO_FORMAT_PCM_16_BIT,
+        AUDIO_FORMAT_PCM_FLOAT,
+        AUDIO_FORMAT_PCM_24_BIT_PACKED,
+        AUDIO_FORMAT_PCM_32_BIT,
+        AUDIO_FORMAT_PCM_8_24_BIT
+    ),
+    ::testing::Values(
+        AUDIO_FORMAT_PCM_8_BIT,
+        AUDIO_FORMAT_PCM_16_BIT,
+        AUDIO_FORMAT_PCM_FLOAT,
+        AUDIO_FORMAT_PCM_24_BIT_PACKED,
+        AUDIO_FORMAT_PCM_32_BIT,
+        AUDIO_FORMAT_PCM_8_24_BIT
+    )));
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_UTILS_TESTS_LOG_BENCHMARK_H
+#define ANDROID_AUDIO_UTILS_TESTS_LOG_BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+// Times logOnce() for each iteration of state, while another thread calls
+// log.dumpToString() continuously if state.range(0) is not 0.  The worst case time of a
+// single logOnce() is reported in the max_ns counter.
+template <typename Log, typename LogOnce>
+void benchmarkLogWithDumper(benchmark::State& state, Log &log, LogOnce logOnce) {
+    std::atomic<bool> done{false};
+    std::thread dumpThread;
+    if (state.range(0)) {
+        dumpThread = std::thread([&] {
+            while (!done) {
+                benchmark::DoNotOptimize(log.dumpToString());
+            }
+        });
+    }
+
+    int64_t maxNs = 0;
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        logOnce();
+        const int64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        maxNs = std::max(maxNs, elapsedNs);
+    }
+
+    done = true;
+    if (dumpThread.joinable()) {
+        dumpThread.join();
+    }
+    state.counters["max_ns"] = maxNs;
+}
+
+#endif // ANDROID_AUDIO_UTILS_TESTS_LOG_BENCHMARK_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/power.h>
+#include <audio_utils/primitives.h>
+
+// Same scalar loop as energyMonoRef() in power.cpp, the baseline for the vector kernels.
+template <audio_format_t FORMAT>
+static float energyMonoRef(const void *amplitudes, size_t size)
+{
+    const uint8_t *samples = reinterpret_cast<const uint8_t *>(amplitudes);
+    float accum(0.f);
+    for (size_t i = 0; i < size; ++i) {
+        float amplitude;
+        switch (FORMAT) {
+        case AUDIO_FORMAT_PCM_8_BIT:
+            amplitude = float_from_u8(samples[i]);
+            break;
+        case AUDIO_FORMAT_PCM_16_BIT:
+            amplitude = float_from_i16(reinterpret_cast<const int16_t *>(samples)[i]);
+            break;
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            amplitude = float_from_p24(samples + i * 3);
+            break;
+        case AUDIO_FORMAT_PCM_8_24_BIT:
+            amplitude = float_from_q8_23(reinterpret_cast<const int32_t *>(samples)[i]);
+            break;
+        case AUDIO_FORMAT_PCM_32_BIT:
+            amplitude = float_from_i32(reinterpret_cast<const int32_t *>(samples)[i]);
+            break;
+        case AUDIO_FORMAT_PCM_FLOAT:
+            amplitude = reinterpret_cast<const float *>(samples)[i];
+            break;
+        default:
+            amplitude = 0.f;
+            break;
+        }
+        accum += amplitude * amplitude;
+    }
+    return accum;
+}
+
+template <audio_format_t FORMAT, bool REFERENCE>
+static void BM_EnergyMono(benchmark::State& state) {
+    const size_t count = state.range(0);
+    const size_t sampleSize = audio_bytes_per_sample(FORMAT);
+
+    // Initialize buffer with deterministic pseudo-random values
+    std::vector<uint8_t> buffer(count * sampleSize);
+    std::minstd_rand gen(count);
+    std::uniform_int_distribution<> dis(0, UINT8_MAX);
+    for (auto &b : buffer) {
+        b = dis(gen);
+    }
+    if (FORMAT == AUDIO_FORMAT_PCM_FLOAT) {
+        std::uniform_real_distribution<float> fdis(-1.f, 1.f);
+        for (size_t i = 0; i < count; ++i) {
+            reinterpret_cast<float *>(buffer.data())[i] = fdis(gen);
+        }
+    }
+
+    // Run the test
+    float energy = 0.f;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(buffer.data());
+        energy += REFERENCE ? energyMonoRef<FORMAT>(buffer.data(), count)
+                : audio_utils_compute_energy_mono(buffer.data(), FORMAT, count);
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(energy);
+
+    state.SetComplexityN(state.range(0));
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define BENCHMARK_ENERGY_MONO(format) \
+    BENCHMARK_TEMPLATE(BM_EnergyMono, format, true)->RangeMultiplier(4)->Range(16, 1 << 14); \
+    BENCHMARK_TEMPLATE(BM_EnergyMono, format, false)->RangeMultiplier(4)->Range(16, 1 << 14)
+
+BENCHMARK_ENERGY_MONO(AUDIO_FORMAT_PCM_8_BIT);
+BENCHMARK_ENERGY_MONO(AUDIO_FORMAT_PCM_16_BIT);
+BENCHMARK_ENERGY_MONO(AUDIO_FORMAT_PCM_24_BIT_PACKED);
+BENCHMARK_ENERGY_MONO(AUDIO_FORMAT_PCM_8_24_BIT);
+BENCHMARK_ENERGY_MONO(AUDIO_FORMAT_PCM_32_BIT);
+BENCHMARK_ENERGY_MONO(AUDIO_FORMAT_PCM_FLOAT);
+
+static void BM_EnergyMultichannel(benchmark::State& state) {
+    const size_t channelCount = state.range(0);
+    constexpr size_t kFrames = 960; // 20 ms at 48 kHz
+
+    // Initialize buffer with deterministic pseudo-random values
+    std::vector<float> buffer(kFrames * channelCount);
+    std::minstd_rand gen(channelCount);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    for (auto &f : buffer) {
+        f = dis(gen);
+    }
+    std::vector<float> energy(channelCount);
+    std::vector<float> peak(channelCount);
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(buffer.data());
+        audio_utils_compute_energy_multichannel(buffer.data(), AUDIO_FORMAT_PCM_FLOAT,
+                channelCount, kFrames, energy.data(), peak.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kFrames);
+}
+
+BENCHMARK(BM_EnergyMultichannel)->Arg(1)->Arg(2)->Arg(6)->Arg(8)->Arg(12)->Arg(16);
+
+BENCHMARK_MAIN();
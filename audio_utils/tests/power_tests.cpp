@@ -17,15 +17,25 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_power_tests"
 
+#include <algorithm>
 #include <cmath>
 #include <math.h>
+#include <random>
+#include <vector>
 
+#include <audio_utils/format.h>
 #include <audio_utils/power.h>
+#include <audio_utils/primitives.h>
 #include <gtest/gtest.h>
 #include <log/log.h>
 
+#include "x86_simd_level_test.h"
+
 typedef struct { uint8_t c[3]; } __attribute__((__packed__)) uint8x3_t;
 
+// the tests of the energy functions, which have x86 vector kernels
+using audio_utils_power_simd = X86SimdLevelTest;
+
 void testFloatValue(float f_value, size_t length) {
     const float power = audio_utils_power_from_amplitude(f_value);
     float f_ary[length];
@@ -143,7 +153,7 @@ void testFloatRamp(size_t length) {
 }
 
 // power_mono implicitly tests energy_mono
-TEST(audio_utils_power, power_mono) {
+TEST_P(audio_utils_power_simd, power_mono) {
     // f_values should have limited mantissa
     for (float f_value : { 0.f, 0.25f, 0.5f, 0.75f, 1.f }) {
         const float power = audio_utils_power_from_amplitude(f_value);
@@ -156,12 +166,117 @@ TEST(audio_utils_power, power_mono) {
 }
 
 // power_mono implicitly tests energy_mono
-TEST(audio_utils_power, power_mono_ramp) {
+TEST_P(audio_utils_power_simd, power_mono_ramp) {
     for (size_t length : { 1, 3, 5, 7, 16, 21, 32, 37, 297 }) {
         testFloatRamp(length);
     }
 }
 
+// compare against a double precision reference on random data, for every format,
+// with lengths and offsets covering the vector body and the scalar remainder.
+TEST_P(audio_utils_power_simd, energy_mono_random) {
+    constexpr size_t kSamples = 1031;
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    std::vector<float> f_ary(kSamples);
+    std::vector<uint8_t> u8_ary(kSamples);
+    std::vector<int16_t> i16_ary(kSamples);
+    std::vector<int32_t> i32_ary(kSamples);
+    std::vector<int32_t> q8_23_ary(kSamples);
+    std::vector<uint8x3_t> p24_ary(kSamples);
+    for (size_t i = 0; i < kSamples; ++i) {
+        f_ary[i] = dis(gen);
+        u8_ary[i] = clamp8_from_float(f_ary[i]);
+        i16_ary[i] = clamp16_from_float(f_ary[i]);
+        i32_ary[i] = clamp32_from_float(f_ary[i]);
+        q8_23_ary[i] = clamp24_from_float(f_ary[i]);
+        memcpy_to_p24_from_q8_23(p24_ary[i].c, &q8_23_ary[i], 1);
+    }
+
+    for (size_t offset = 0; offset < 3; ++offset) {
+        for (size_t length : { 0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 480, 1024 }) {
+            double f_energy = 0, u8_energy = 0, i16_energy = 0;
+            double i32_energy = 0, q8_23_energy = 0;
+            for (size_t i = offset; i < offset + length; ++i) {
+                f_energy += (double)f_ary[i] * f_ary[i];
+                u8_energy += pow((u8_ary[i] - 128) / 128., 2);
+                i16_energy += pow(i16_ary[i] / 32768., 2);
+                i32_energy += pow(i32_ary[i] / 2147483648., 2);
+                q8_23_energy += pow(q8_23_ary[i] / 8388608., 2);
+            }
+            const auto expectNear = [&](double expected, const void *buffer,
+                    audio_format_t format) {
+                EXPECT_NEAR(expected,
+                        audio_utils_compute_energy_mono(buffer, format, length),
+                        expected * 1e-5)
+                        << "format:" << format << " offset:" << offset << " length:" << length;
+            };
+            expectNear(f_energy, &f_ary[offset], AUDIO_FORMAT_PCM_FLOAT);
+            expectNear(u8_energy, &u8_ary[offset], AUDIO_FORMAT_PCM_8_BIT);
+            expectNear(i16_energy, &i16_ary[offset], AUDIO_FORMAT_PCM_16_BIT);
+            expectNear(i32_energy, &i32_ary[offset], AUDIO_FORMAT_PCM_32_BIT);
+            expectNear(q8_23_energy, &q8_23_ary[offset], AUDIO_FORMAT_PCM_8_24_BIT);
+            expectNear(q8_23_energy, &p24_ary[offset], AUDIO_FORMAT_PCM_24_BIT_PACKED);
+        }
+    }
+}
+
+// per channel results must match deinterleaving and computing each channel as mono.
+TEST_P(audio_utils_power_simd, energy_multichannel) {
+    constexpr size_t kFrames = 67;
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    for (size_t channelCount : { 1, 2, 3, 4, 6, 8, 12, 16, 30 }) {
+        std::vector<float> f_ary(kFrames * channelCount);
+        std::vector<int16_t> i16_ary(f_ary.size());
+        std::vector<uint8x3_t> p24_ary(f_ary.size());
+        for (size_t i = 0; i < f_ary.size(); ++i) {
+            f_ary[i] = dis(gen) * (i % channelCount + 1) / channelCount; // per channel level
+            i16_ary[i] = clamp16_from_float(f_ary[i]);
+            const int32_t q8_23 = clamp24_from_float(f_ary[i]);
+            memcpy_to_p24_from_q8_23(p24_ary[i].c, &q8_23, 1);
+        }
+        const auto check = [&](const void *buffer, audio_format_t format) {
+            for (size_t frames : { (size_t)0, (size_t)1, (size_t)5, kFrames }) {
+                std::vector<float> energy(channelCount);
+                std::vector<float> peak(channelCount);
+                audio_utils_compute_energy_multichannel(buffer, format, channelCount, frames,
+                        energy.data(), peak.data());
+                std::vector<float> mono(frames);
+                std::vector<float> converted(frames * channelCount);
+                memcpy_by_audio_format(converted.data(), AUDIO_FORMAT_PCM_FLOAT,
+                        buffer, format, converted.size());
+                for (size_t ch = 0; ch < channelCount; ++ch) {
+                    float expectedPeak = 0.f;
+                    for (size_t i = 0; i < frames; ++i) {
+                        mono[i] = converted[i * channelCount + ch];
+                        expectedPeak = std::max(expectedPeak, fabsf(mono[i]));
+                    }
+                    const float expectedEnergy = audio_utils_compute_energy_mono(
+                            mono.data(), AUDIO_FORMAT_PCM_FLOAT, frames);
+                    EXPECT_NEAR(expectedEnergy, energy[ch], expectedEnergy * 1e-5)
+                            << "format:" << format << " channels:" << channelCount
+                            << " frames:" << frames << " channel:" << ch;
+                    EXPECT_EQ(expectedPeak, peak[ch])
+                            << "format:" << format << " channels:" << channelCount
+                            << " frames:" << frames << " channel:" << ch;
+                }
+            }
+        };
+        check(f_ary.data(), AUDIO_FORMAT_PCM_FLOAT);
+        check(i16_ary.data(), AUDIO_FORMAT_PCM_16_BIT);
+        check(p24_ary.data(), AUDIO_FORMAT_PCM_24_BIT_PACKED);
+    }
+
+    // either output may be omitted.
+    const float stereo[] = { 0.5f, -0.25f, -0.5f, 0.125f };
+    float peak[2];
+    audio_utils_compute_energy_multichannel(stereo, AUDIO_FORMAT_PCM_FLOAT, 2, 2,
+            nullptr /* energyPerChannel */, peak);
+    EXPECT_EQ(0.5f, peak[0]);
+    EXPECT_EQ(0.25f, peak[1]);
+}
+
 TEST(audio_utils_power, power_from) {
     EXPECT_EQ(0.f, audio_utils_power_from_amplitude(1.f));
     EXPECT_EQ(-INFINITY, audio_utils_power_from_amplitude(0.f));
@@ -171,3 +286,5 @@ TEST(audio_utils_power, power_from) {
     EXPECT_EQ(-INFINITY, audio_utils_power_from_energy(0.f));
     EXPECT_TRUE(std::isnan(audio_utils_power_from_energy(-1.f)));
 }
+
+INSTANTIATE_TEST_SUITE_P(X86SimdLevels, audio_utils_power_simd, X86_SIMD_LEVELS);
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/PowerLog.h>
+
+#include "log_benchmark.h"
+
+using namespace android;
+
+// 1 ms of stereo float per log(), with a concurrent dumper if state.range(0) is not 0.
+template <typename PowerLogT>
+static void BM_PowerLogLog(benchmark::State& state) {
+    constexpr size_t kFrames = 48; // 1 ms at 48 kHz
+    constexpr size_t kChannels = 2;
+
+    PowerLogT plog(48000 /* sampleRate */, kChannels, AUDIO_FORMAT_PCM_FLOAT,
+            300 /* entries */, kFrames * 4 /* framesPerEntry */);
+
+    // Initialize buffer with deterministic pseudo-random values
+    std::vector<float> buffer(kFrames * kChannels);
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    for (auto &f : buffer) {
+        f = dis(gen);
+    }
+
+    int64_t nowNs = 0;
+    benchmarkLogWithDumper(state, plog, [&] {
+        plog.log(buffer.data(), kFrames, nowNs);
+        nowNs += 1000000;
+    });
+}
+
+BENCHMARK_TEMPLATE(BM_PowerLogLog, PowerLog)->ArgName("dumper")->Arg(0)->Arg(1)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PowerLogLog, SingleWriterPowerLog)->ArgName("dumper")->Arg(0)->Arg(1)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
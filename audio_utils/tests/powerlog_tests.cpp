@@ -17,6 +17,11 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_powerlog_tests"
 
+#include <atomic>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
 #include <audio_utils/PowerLog.h>
 #include <gtest/gtest.h>
 #include <iostream>
@@ -101,3 +106,43 @@ TEST(audio_utils_powerlog, c) {
    12-31 16:00:00.000: [  -12.0 ] sum(-12.0)
      */
 }
+
+TEST(audio_utils_powerlog, concurrent_dump) {
+    constexpr size_t kEntries = 64;
+    auto plog = std::make_unique<SingleWriterPowerLog>(
+            48000 /* sampleRate */,
+            1 /* channelCount */,
+            AUDIO_FORMAT_PCM_16_BIT,
+            kEntries,
+            1 /* framesPerEntry */);
+
+    // The writer laps the ring many times while the reader dumps.
+    const int16_t levels[] = { 0x4000 /* -6 dB */, 0x2000 /* -12 dB */, 0 };
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int64_t i = 0; i < 1000000; ++i) {
+            plog->log(&levels[i % 7 % std::size(levels)], 1 /* frame */, i + 1 /* nowNs */);
+        }
+        done = true;
+    });
+
+    size_t dumps = 0;
+    do {
+        // Every value on an entry line must be one of the logged powers,
+        // a torn or stale entry would show up as something else.
+        std::istringstream lines(plog->dumpToString("#" /* prefix */));
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.rfind("# ", 0) != 0) continue; // not an entry line
+            std::istringstream values(line.substr(line.find(": ") + 2));
+            std::string value;
+            while (values >> value && value[0] != ']') {
+                if (value == "[") continue;
+                EXPECT_TRUE(value == "-6.0" || value == "-12.0") << line;
+            }
+        }
+        ++dumps;
+    } while (!done);
+    writer.join();
+    EXPECT_GT(dumps, (size_t)0);
+}
@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstddef>
+#include <limits>
 #include <random>
+#include <type_traits>
 #include <vector>
 
 #include <benchmark/benchmark.h>
@@ -84,57 +87,262 @@ static void BM_MemcpyFloat(benchmark::State& state) {
 
 BENCHMARK(BM_MemcpyFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
 
-static void BM_MemcpyToFloatFromI16(benchmark::State& state) {
+// Fills a source buffer with deterministic pseudo-random samples.
+// Floats slightly exceed [-1.0, 1.0) so the clamping paths are exercised.
+template <typename T>
+static void fillRandom(std::vector<T> &src, size_t seed) {
+    std::minstd_rand gen(seed);
+    if constexpr (std::is_floating_point_v<T>) {
+        std::uniform_real_distribution<T> dis(-1.1, 1.1);
+        for (auto &v : src) v = dis(gen);
+    } else {
+        std::uniform_int_distribution<int64_t> dis(
+                std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+        for (auto &v : src) v = dis(gen);
+    }
+}
+
+// Benchmarks a memcpy_to_*_from_* converter. Packed 24 bit samples are uint8_t with
+// a sample size of 3, so DST_SIZE and SRC_SIZE give the number of elements per sample.
+template <typename D, typename S, void (*CONVERT)(D *, const S *, size_t),
+        size_t DST_SIZE = 1, size_t SRC_SIZE = 1>
+static void BM_MemcpyTo(benchmark::State& state) {
     const size_t count = state.range(0);
 
-    std::vector<int16_t> src(count);
-    std::vector<float> dst(count);
-
-    // Initialize src buffer with deterministic pseudo-random values
-    std::minstd_rand gen(count);
-    std::uniform_int_distribution<> dis(INT16_MIN, INT16_MAX);
-    for (size_t i = 0; i < count; i++) {
-        src[i] = dis(gen);
-    }
+    std::vector<S> src(count * SRC_SIZE);
+    std::vector<D> dst(count * DST_SIZE);
+    fillRandom(src, count);
 
     // Run the test
     while (state.KeepRunning()) {
         benchmark::DoNotOptimize(src.data());
         benchmark::DoNotOptimize(dst.data());
-        memcpy_to_float_from_i16(dst.data(), src.data(), count);
+        CONVERT(dst.data(), src.data(), count);
         benchmark::ClobberMemory();
     }
 
     state.SetComplexityN(state.range(0));
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetBytesProcessed(state.iterations() * count * (sizeof(D) * DST_SIZE
+            + sizeof(S) * SRC_SIZE));
 }
 
-BENCHMARK(BM_MemcpyToFloatFromI16)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+#define BENCHMARK_MEMCPY_TO(...) \
+    BENCHMARK_TEMPLATE(BM_MemcpyTo, __VA_ARGS__)->RangeMultiplier(2)->Ranges({{10, 8<<12}})
 
+BENCHMARK_MEMCPY_TO(float, int16_t, memcpy_to_float_from_i16);
+BENCHMARK_MEMCPY_TO(int16_t, float, memcpy_to_i16_from_float);
+BENCHMARK_MEMCPY_TO(float, int32_t, memcpy_to_float_from_i32);
+BENCHMARK_MEMCPY_TO(int32_t, float, memcpy_to_i32_from_float);
+BENCHMARK_MEMCPY_TO(float, int32_t, memcpy_to_float_from_q8_23);
+BENCHMARK_MEMCPY_TO(int32_t, float, memcpy_to_q8_23_from_float_with_clamp);
+BENCHMARK_MEMCPY_TO(float, int32_t, memcpy_to_float_from_q4_27);
+BENCHMARK_MEMCPY_TO(int32_t, float, memcpy_to_q4_27_from_float);
+BENCHMARK_MEMCPY_TO(float, uint8_t, memcpy_to_float_from_p24, 1, 3);
+BENCHMARK_MEMCPY_TO(uint8_t, float, memcpy_to_p24_from_float, 3, 1);
+BENCHMARK_MEMCPY_TO(float, uint8_t, memcpy_to_float_from_u8);
+BENCHMARK_MEMCPY_TO(uint8_t, float, memcpy_to_u8_from_float);
+BENCHMARK_MEMCPY_TO(int16_t, int32_t, memcpy_to_i16_from_i32);
+BENCHMARK_MEMCPY_TO(int32_t, int16_t, memcpy_to_i32_from_i16);
+BENCHMARK_MEMCPY_TO(int16_t, int32_t, memcpy_to_i16_from_q8_23);
+BENCHMARK_MEMCPY_TO(int32_t, int16_t, memcpy_to_q8_23_from_i16);
+BENCHMARK_MEMCPY_TO(int16_t, int32_t, memcpy_to_i16_from_q4_27);
+BENCHMARK_MEMCPY_TO(int16_t, uint8_t, memcpy_to_i16_from_p24, 1, 3);
+BENCHMARK_MEMCPY_TO(uint8_t, int16_t, memcpy_to_p24_from_i16, 3, 1);
+BENCHMARK_MEMCPY_TO(int16_t, uint8_t, memcpy_to_i16_from_u8);
+BENCHMARK_MEMCPY_TO(uint8_t, int16_t, memcpy_to_u8_from_i16);
+BENCHMARK_MEMCPY_TO(int32_t, uint8_t, memcpy_to_i32_from_p24, 1, 3);
+BENCHMARK_MEMCPY_TO(uint8_t, int32_t, memcpy_to_p24_from_i32, 3, 1);
+BENCHMARK_MEMCPY_TO(int32_t, uint8_t, memcpy_to_q8_23_from_p24, 1, 3);
+BENCHMARK_MEMCPY_TO(uint8_t, int32_t, memcpy_to_p24_from_q8_23, 3, 1);
+BENCHMARK_MEMCPY_TO(int32_t, uint8_t, memcpy_to_i32_from_u8);
+BENCHMARK_MEMCPY_TO(uint8_t, int32_t, memcpy_to_u8_from_i32);
+BENCHMARK_MEMCPY_TO(uint8_t, int32_t, memcpy_to_u8_from_q8_23);
+BENCHMARK_MEMCPY_TO(uint8_t, uint8_t, memcpy_to_u8_from_p24, 1, 3);
 
-static void BM_MemcpyToI16FromFloat(benchmark::State& state) {
+// Benchmarks a dithered converter, to compare with the plain converter above.
+// Args: sample count, noise shaping.
+template <typename D, void (*CONVERT)(D *, const float *, size_t, audio_dither_t *),
+        size_t DST_SIZE = 1>
+static void BM_MemcpyWithDither(benchmark::State& state) {
     const size_t count = state.range(0);
+    const bool noiseShaping = state.range(1);
 
     std::vector<float> src(count);
-    std::vector<int16_t> dst(count);
+    std::vector<D> dst(count * DST_SIZE);
+    fillRandom(src, count);
+    audio_dither_t dither;
+    audio_dither_init(&dither, count, 2 /* channel_count */, noiseShaping);
 
-    // Initialize src buffer with deterministic pseudo-random values
-    std::minstd_rand gen(count);
-    std::uniform_real_distribution<> dis;
-    for (size_t i = 0; i < count; i++) {
-        src[i] = dis(gen);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        CONVERT(dst.data(), src.data(), count, &dither);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetBytesProcessed(state.iterations() * count * (sizeof(D) * DST_SIZE
+            + sizeof(float)));
+}
+
+BENCHMARK_TEMPLATE(BM_MemcpyWithDither, int16_t, memcpy_to_i16_from_float_with_dither)
+        ->RangeMultiplier(2)->Ranges({{10, 8<<12}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_MemcpyWithDither, uint8_t, memcpy_to_p24_from_float_with_dither, 3)
+        ->RangeMultiplier(2)->Ranges({{10, 8<<12}, {0, 1}});
+
+enum RemixKind { REMIX_IDENTITY, REMIX_PREFIX, REMIX_ZERO_FILL, REMIX_PERMUTATION,
+        REMIX_GENERIC };
+
+// Builds an index array of the given kind for a stream with the given number of channels,
+// returning the number of source channels.
+static uint32_t remixIndexArray(RemixKind kind, uint32_t channels, int8_t *idxary) {
+    switch (kind) {
+    case REMIX_IDENTITY:
+        for (uint32_t i = 0; i < channels; ++i) idxary[i] = i;
+        return channels;
+    case REMIX_PREFIX: // drop the last 4 source channels
+        for (uint32_t i = 0; i < channels; ++i) idxary[i] = i;
+        return channels + 4;
+    case REMIX_ZERO_FILL: // the last 4 destination channels are silent
+        for (uint32_t i = 0; i < channels; ++i) idxary[i] = i < channels - 4 ? i : -1;
+        return channels - 4;
+    case REMIX_PERMUTATION: // swap channel pairs
+        for (uint32_t i = 0; i < channels; ++i) idxary[i] = i ^ 1;
+        return channels;
+    case REMIX_GENERIC: // swap channel pairs, silencing every fourth channel
+        for (uint32_t i = 0; i < channels; ++i) idxary[i] = i % 4 == 3 ? -1 : i ^ 1;
+        return channels;
+    }
+    return 0;
+}
+
+// Args: destination channels, RemixKind.
+template <typename T, bool USE_PLAN>
+static void BM_MemcpyByIndexArray(benchmark::State& state) {
+    const size_t count = 960;
+    const uint32_t dstChannels = state.range(0);
+    int8_t idxary[MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX];
+    const uint32_t srcChannels = remixIndexArray((RemixKind)state.range(1), dstChannels, idxary);
+
+    std::vector<T> src(count * srcChannels);
+    std::vector<T> dst(count * dstChannels);
+    fillRandom(src, count);
+    memcpy_by_index_array_plan_t plan;
+    if (memcpy_by_index_array_plan_init(
+            &plan, dstChannels, srcChannels, idxary, sizeof(T)) != 0) {
+        state.SkipWithError("Invalid plan");
+        return;
     }
 
-    // Run the test
     while (state.KeepRunning()) {
         benchmark::DoNotOptimize(src.data());
         benchmark::DoNotOptimize(dst.data());
-        memcpy_to_i16_from_float(dst.data(), src.data(), count);
+        if (USE_PLAN) {
+            memcpy_by_index_array_with_plan(dst.data(), src.data(), &plan, count);
+        } else {
+            memcpy_by_index_array(dst.data(), dstChannels, src.data(), srcChannels,
+                    idxary, sizeof(T), count);
+        }
         benchmark::ClobberMemory();
     }
+    state.SetBytesProcessed(state.iterations() * count * dstChannels * sizeof(T));
+}
 
-    state.SetComplexityN(state.range(0));
+static void RemixArgs(benchmark::internal::Benchmark* b) {
+    for (int channels : {12, 16}) {
+        for (int kind = REMIX_IDENTITY; kind <= REMIX_GENERIC; ++kind) {
+            b->Args({channels, kind});
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_MemcpyByIndexArray, int16_t, false)->Apply(RemixArgs);
+BENCHMARK_TEMPLATE(BM_MemcpyByIndexArray, int16_t, true)->Apply(RemixArgs);
+BENCHMARK_TEMPLATE(BM_MemcpyByIndexArray, int32_t, false)->Apply(RemixArgs);
+BENCHMARK_TEMPLATE(BM_MemcpyByIndexArray, int32_t, true)->Apply(RemixArgs);
+
+// Scales samples into a separate buffer, the pass that accumulate_with_channel_gains_*()
+// fuses with accumulate_*().
+template <typename T>
+static void scaleByChannelGains(T *dst, const T *src, const float *gains,
+        uint32_t channelCount, size_t frameCount) {
+    for (size_t i = 0; i < frameCount; ++i) {
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            const double scaled = *src++ * (double)gains[c];
+            if constexpr (std::is_floating_point_v<T>) {
+                *dst++ = scaled;
+            } else {
+                *dst++ = std::clamp(scaled, (double)std::numeric_limits<T>::min(),
+                        (double)std::numeric_limits<T>::max());
+            }
+        }
+    }
+}
+
+enum AccumulateMode { ACCUMULATE_NO_GAIN, ACCUMULATE_TWO_PASS, ACCUMULATE_GAINS,
+        ACCUMULATE_RAMP };
+
+// Args: channels, AccumulateMode.
+template <typename T, void (*ACCUMULATE)(T *, const T *, size_t),
+        void (*ACCUMULATE_WITH_GAINS)(T *, const T *, const float *, const float *,
+                uint32_t, size_t)>
+static void BM_AccumulateWithGain(benchmark::State& state) {
+    const size_t frameCount = 960;
+    const uint32_t channelCount = state.range(0);
+    const AccumulateMode mode = (AccumulateMode)state.range(1);
+    const size_t count = frameCount * channelCount;
+
+    std::vector<T> src(count);
+    std::vector<T> dst(count);
+    std::vector<T> scaled(count);
+    fillRandom(src, count);
+    fillRandom(dst, count + 1);
+    std::vector<float> gains(channelCount, 0.5f);
+    std::vector<float> increments(channelCount, 1e-4f);
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        switch (mode) {
+        case ACCUMULATE_NO_GAIN:
+            ACCUMULATE(dst.data(), src.data(), count);
+            break;
+        case ACCUMULATE_TWO_PASS:
+            scaleByChannelGains(scaled.data(), src.data(), gains.data(), channelCount,
+                    frameCount);
+            ACCUMULATE(dst.data(), scaled.data(), count);
+            break;
+        case ACCUMULATE_GAINS:
+            ACCUMULATE_WITH_GAINS(dst.data(), src.data(), gains.data(), nullptr,
+                    channelCount, frameCount);
+            break;
+        case ACCUMULATE_RAMP:
+            ACCUMULATE_WITH_GAINS(dst.data(), src.data(), gains.data(), increments.data(),
+                    channelCount, frameCount);
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+static void AccumulateArgs(benchmark::internal::Benchmark* b) {
+    for (int channels : {1, 2, 6, 8}) {
+        for (int mode = ACCUMULATE_NO_GAIN; mode <= ACCUMULATE_RAMP; ++mode) {
+            b->Args({channels, mode});
+        }
+    }
 }
 
-BENCHMARK(BM_MemcpyToI16FromFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+BENCHMARK_TEMPLATE(BM_AccumulateWithGain, int16_t, accumulate_i16,
+        accumulate_with_channel_gains_i16)->Apply(AccumulateArgs);
+BENCHMARK_TEMPLATE(BM_AccumulateWithGain, int32_t, accumulate_q8_23,
+        accumulate_with_channel_gains_q8_23)->Apply(AccumulateArgs);
+BENCHMARK_TEMPLATE(BM_AccumulateWithGain, int32_t, accumulate_i32,
+        accumulate_with_channel_gains_i32)->Apply(AccumulateArgs);
+BENCHMARK_TEMPLATE(BM_AccumulateWithGain, float, accumulate_float,
+        accumulate_with_channel_gains_float)->Apply(AccumulateArgs);
 
 BENCHMARK_MAIN();
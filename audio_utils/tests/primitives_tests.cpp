@@ -17,7 +17,12 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_primitives_tests"
 
+#include <errno.h>
 #include <math.h>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <random>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -27,8 +32,13 @@
 #include <audio_utils/format.h>
 #include <audio_utils/channels.h>
 
+#include "x86_simd_level_test.h"
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
+// the tests of functions with x86 vector kernels
+using audio_utils_primitives_simd = X86SimdLevelTest;
+
 static const int32_t lim8pos = 255;
 static const int32_t lim8neg = 0;
 static const int32_t lim16pos = (1 << 15) - 1;
@@ -194,7 +204,7 @@ TEST(audio_utils_primitives, clamp_to_int) {
     EXPECT_EQ(255, clamp8_from_float(INFINITY));
 }
 
-TEST(audio_utils_primitives, memcpy) {
+TEST_P(audio_utils_primitives_simd, memcpy) {
     // test round-trip.
     constexpr size_t size = 65536;
     std::vector<int16_t> i16ref(size);
@@ -353,6 +363,148 @@ TEST(audio_utils_primitives, memcpy) {
     checkMonotone(i32ary.data(), testsize);
 }
 
+// Compares a buffer conversion against the per-sample inline reference conversion
+// over lengths and offsets which exercise both the vector body and the scalar remainder.
+template <typename D, typename S, typename C, typename R>
+static void checkConversion(const char *name, C convert, R reference, const std::vector<S> &src)
+{
+    constexpr size_t maxCount = 67;
+    std::vector<D> dst(maxCount + 1);
+    for (size_t offset = 0; offset < 2; ++offset) {
+        for (size_t count = 0; count <= maxCount; ++count) {
+            for (size_t start = 0; start + offset + count <= src.size(); start += maxCount) {
+                const S *in = src.data() + start + offset;
+                convert(dst.data() + offset, in, count);
+                for (size_t i = 0; i < count; ++i) {
+                    const D expected = reference(in[i]);
+                    ASSERT_EQ(0, memcmp(&expected, &dst[offset + i], sizeof(D)))
+                            << name << " count:" << count << " offset:" << offset
+                            << " index:" << i;
+                }
+            }
+        }
+    }
+}
+
+// Same as checkConversion for packed 24 bit source or destination, a sample is 3 bytes.
+static void checkP24(const char *name, const std::vector<uint8_t> &p24, const uint8_t *ref24)
+{
+    for (size_t i = 0; i < p24.size(); ++i) {
+        ASSERT_EQ(ref24[i], p24[i]) << name << " byte:" << i;
+    }
+}
+
+TEST_P(audio_utils_primitives_simd, memcpy_reference) {
+    // floats: ties and near ties for each integer scale, limits, infinities and random values.
+    std::vector<float> fsrc = {
+            0.f, -0.f, 1.f, -1.f, 2.f, -2.f, 16.f, -16.f, 1.e20f, -1.e20f,
+            INFINITY, -INFINITY, 0x7fff / 32768.f, 0x7fffff / 8388608.f,
+            nextafterf(1.f, 0.f), nextafterf(-1.f, 0.f), nextafterf(16.f, 0.f), 1.e-30f };
+    for (const float scale : { 1.f / 32768, 1.f / 8388608, 1.f / 2147483648.f, 1.f / 134217728 }) {
+        for (const float lsb : { 0.5f, 1.5f, 2.5f, -0.5f, -1.5f, -2.5f, 1000.5f, -32767.5f }) {
+            fsrc.push_back(lsb * scale);
+            fsrc.push_back(nextafterf(lsb * scale, 0.f));
+            fsrc.push_back(nextafterf(lsb * scale, lsb * 2 * scale));
+        }
+    }
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> fdis(-1.25f, 1.25f);
+    while (fsrc.size() < 1024) {
+        fsrc.push_back(fdis(gen));
+    }
+    std::vector<int32_t> isrc = { 0, -1, 1, INT32_MAX, INT32_MIN, 0x7fffff, -0x800000,
+            0x800000, -0x800001, 0x7fff, -0x8000, 0x8000, -0x8001 };
+    std::uniform_int_distribution<int32_t> idis(INT32_MIN, INT32_MAX);
+    while (isrc.size() < 1024) {
+        isrc.push_back(idis(gen));
+        isrc.push_back(idis(gen) >> 7); // around the Q8.23 clamp limits
+    }
+    std::vector<int16_t> i16src(isrc.size());
+    for (size_t i = 0; i < isrc.size(); ++i) {
+        i16src[i] = isrc[i] >> 16;
+    }
+
+    checkConversion<int16_t>("i16_from_float", memcpy_to_i16_from_float,
+            clamp16_from_float, fsrc);
+    checkConversion<int32_t>("q8_23_from_float", memcpy_to_q8_23_from_float_with_clamp,
+            clamp24_from_float, fsrc);
+    checkConversion<int32_t>("q4_27_from_float", memcpy_to_q4_27_from_float,
+            clampq4_27_from_float, fsrc);
+    checkConversion<int32_t>("i32_from_float", memcpy_to_i32_from_float,
+            clamp32_from_float, fsrc);
+    checkConversion<float>("float_from_i16", memcpy_to_float_from_i16,
+            float_from_i16, i16src);
+    checkConversion<int32_t>("i32_from_i16", memcpy_to_i32_from_i16,
+            [](int16_t i) { return (int32_t)i << 16; }, i16src);
+    checkConversion<int32_t>("q8_23_from_i16", memcpy_to_q8_23_from_i16,
+            [](int16_t i) { return (int32_t)i << 8; }, i16src);
+    checkConversion<float>("float_from_i32", memcpy_to_float_from_i32,
+            float_from_i32, isrc);
+    checkConversion<float>("float_from_q8_23", memcpy_to_float_from_q8_23,
+            float_from_q8_23, isrc);
+    checkConversion<float>("float_from_q4_27", memcpy_to_float_from_q4_27,
+            float_from_q4_27, isrc);
+    checkConversion<int16_t>("i16_from_i32", memcpy_to_i16_from_i32,
+            [](int32_t i) { return (int16_t)(i >> 16); }, isrc);
+    checkConversion<int16_t>("i16_from_q8_23", memcpy_to_i16_from_q8_23,
+            [](int32_t i) { return clamp16(i >> 8); }, isrc);
+    checkConversion<int16_t>("i16_from_q4_27", memcpy_to_i16_from_q4_27,
+            [](int32_t i) { return clamp16(i >> 12); }, isrc);
+
+    // packed 24 bit, checked against a sample at a time conversion.
+    const size_t count = isrc.size();
+    std::vector<uint8_t> p24(count * 3);
+    std::vector<uint8_t> ref24(count * 3);
+    std::vector<int32_t> i32(count);
+    std::vector<float> f(count);
+    for (size_t i = 0; i < count; ++i) {
+        memcpy_to_p24_from_float(&ref24[i * 3], &fsrc[i], 1);
+    }
+    for (const size_t n : { count, count - 1, count - 7, (size_t)13 }) { // decreasing
+        std::fill(p24.begin(), p24.end(), 0);
+        std::fill(ref24.begin() + n * 3, ref24.end(), 0);
+        memcpy_to_p24_from_float(p24.data(), fsrc.data(), n);
+        checkP24("p24_from_float", p24, ref24.data());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        memcpy_to_p24_from_i32(&ref24[i * 3], &isrc[i], 1);
+    }
+    memcpy_to_p24_from_i32(p24.data(), isrc.data(), count);
+    checkP24("p24_from_i32", p24, ref24.data());
+    for (size_t i = 0; i < count; ++i) {
+        memcpy_to_p24_from_q8_23(&ref24[i * 3], &isrc[i], 1);
+    }
+    memcpy_to_p24_from_q8_23(p24.data(), isrc.data(), count);
+    checkP24("p24_from_q8_23", p24, ref24.data());
+
+    // p24 now holds clamped Q8.23 values
+    memcpy_to_float_from_p24(f.data(), p24.data(), count - 3);
+    memcpy_to_i32_from_p24(i32.data(), p24.data(), count - 5);
+    for (size_t i = 0; i < count - 3; ++i) {
+        ASSERT_EQ(float_from_p24(&p24[i * 3]), f[i]) << "float_from_p24 index:" << i;
+    }
+    for (size_t i = 0; i < count - 5; ++i) {
+        ASSERT_EQ(i32_from_p24(&p24[i * 3]), i32[i]) << "i32_from_p24 index:" << i;
+    }
+    memcpy_to_q8_23_from_p24(i32.data(), p24.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(i32_from_p24(&p24[i * 3]) >> 8, i32[i]) << "q8_23_from_p24 index:" << i;
+    }
+
+    // expanding conversions in place.
+    std::vector<float> inplace(count);
+    memcpy(inplace.data(), i16src.data(), count * sizeof(int16_t));
+    memcpy_to_float_from_i16(inplace.data(), (const int16_t *)inplace.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(float_from_i16(i16src[i]), inplace[i]) << "in place index:" << i;
+    }
+    memcpy(inplace.data(), p24.data(), (count - 1) * 3);
+    memcpy_to_float_from_p24(inplace.data(), (const uint8_t *)inplace.data(), count - 1);
+    for (size_t i = 0; i < count - 1; ++i) {
+        ASSERT_EQ(float_from_p24(&p24[i * 3]), inplace[i]) << "in place p24 index:" << i;
+    }
+}
+
 template<typename T>
 void checkMonotoneOrZero(const T *ary, size_t size)
 {
@@ -366,6 +518,125 @@ void checkMonotoneOrZero(const T *ary, size_t size)
     }
 }
 
+// Returns the variance of the means over windows of the requantization error,
+// which measures the low frequency noise power.
+static double windowedErrorVariance(const std::vector<int16_t> &out, float value) {
+    constexpr size_t window = 64;
+    double sum = 0;
+    double sum2 = 0;
+    const size_t windows = out.size() / window;
+    for (size_t w = 0; w < windows; ++w) {
+        double mean = 0;
+        for (size_t i = 0; i < window; ++i) {
+            mean += out[w * window + i] - value * 32768;
+        }
+        mean /= window;
+        sum += mean;
+        sum2 += mean * mean;
+    }
+    return sum2 / windows - (sum / windows) * (sum / windows);
+}
+
+TEST_P(audio_utils_primitives_simd, memcpy_with_dither) {
+    audio_dither_t dither;
+    EXPECT_EQ(-EINVAL, audio_dither_init(&dither, 1, 0, true /* noise_shaping */));
+    EXPECT_EQ(-EINVAL, audio_dither_init(&dither, 1, AUDIO_DITHER_CHANNELS_MAX + 1, true));
+    EXPECT_EQ(0, audio_dither_init(&dither, 1, 0, false));
+
+    constexpr size_t size = 65536;
+    std::vector<float> fary(size);
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.1f, 1.1f);
+    for (auto &f : fary) f = dis(gen);
+
+    for (bool noiseShaping : {false, true}) {
+        // one call gives the same samples as calls of any size.
+        audio_dither_t whole, pieces;
+        ASSERT_EQ(0, audio_dither_init(&whole, 1234, 2, noiseShaping));
+        ASSERT_EQ(0, audio_dither_init(&pieces, 1234, 2, noiseShaping));
+        std::vector<int16_t> i16ref(size), i16ary(size);
+        memcpy_to_i16_from_float_with_dither(i16ref.data(), fary.data(), size, &whole);
+        std::vector<uint8_t> p24ref(size * 3), p24ary(size * 3);
+        memcpy_to_p24_from_float_with_dither(p24ref.data(), fary.data(), size, &whole);
+        for (size_t i = 0, n = 1; i < size; i += n, n = n * 3 % 37 + 1) {
+            n = std::min(n, size - i);
+            memcpy_to_i16_from_float_with_dither(&i16ary[i], &fary[i], n, &pieces);
+        }
+        for (size_t i = 0, n = 5; i < size; i += n, n = n * 7 % 29 + 1) {
+            n = std::min(n, size - i);
+            memcpy_to_p24_from_float_with_dither(&p24ary[i * 3], &fary[i], n, &pieces);
+        }
+        EXPECT_EQ(i16ref, i16ary);
+        EXPECT_EQ(p24ref, p24ary);
+
+        // the dither is within 1 LSB of the undithered conversion, away from clamping.
+        std::vector<int16_t> i16plain(size);
+        memcpy_to_i16_from_float(i16plain.data(), fary.data(), size);
+        std::vector<int32_t> i32ref(size), i32plain(size);
+        std::vector<uint8_t> p24plain(size * 3);
+        memcpy_to_p24_from_float(p24plain.data(), fary.data(), size);
+        memcpy_to_i32_from_p24(i32ref.data(), p24ref.data(), size);
+        memcpy_to_i32_from_p24(i32plain.data(), p24plain.data(), size);
+        const int maxError = noiseShaping ? 3 : 1;
+        for (size_t i = 0; i < size; ++i) {
+            if (fabsf(fary[i]) < 0.99f) {
+                ASSERT_LE(abs(i16ref[i] - i16plain[i]), maxError) << i;
+                ASSERT_LE(abs((i32ref[i] >> 8) - (i32plain[i] >> 8)), maxError) << i;
+            }
+        }
+    }
+
+    // TPDF dither makes requantization unbiased: a constant of a fraction of an LSB
+    // is reproduced on average, and the noise shaped error is mostly high frequency.
+    const float value = 0.3f / 32768;
+    std::vector<float> constant(size, value);
+    std::vector<int16_t> flat(size), shaped(size);
+    ASSERT_EQ(0, audio_dither_init(&dither, 5, 1, false));
+    memcpy_to_i16_from_float_with_dither(flat.data(), constant.data(), size, &dither);
+    ASSERT_EQ(0, audio_dither_init(&dither, 5, 1, true));
+    memcpy_to_i16_from_float_with_dither(shaped.data(), constant.data(), size, &dither);
+    EXPECT_NEAR(0.3, std::accumulate(flat.begin(), flat.end(), 0.) / size, 0.02);
+    EXPECT_NEAR(0.3, std::accumulate(shaped.begin(), shaped.end(), 0.) / size, 0.02);
+    for (int16_t sample : flat) {
+        ASSERT_TRUE(sample >= -1 && sample <= 1);
+    }
+    EXPECT_LT(windowedErrorVariance(shaped, value) * 10, windowedErrorVariance(flat, value));
+}
+
+// Odd sized calls leave the stream at another lane, from which the vector kernels
+// must still give the samples of a single call.
+TEST_P(audio_utils_primitives_simd, memcpy_with_dither_odd_counts) {
+    constexpr size_t size = 48000;
+    std::vector<float> fary(size);
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.1f, 1.1f);
+    for (auto &f : fary) f = dis(gen);
+
+    audio_dither_t whole, pieces;
+    ASSERT_EQ(0, audio_dither_init(&whole, 99, 0, false));
+    ASSERT_EQ(0, audio_dither_init(&pieces, 99, 0, false));
+    std::vector<int16_t> i16ref(size), i16ary(size);
+    memcpy_to_i16_from_float_with_dither(i16ref.data(), fary.data(), size, &whole);
+    std::vector<uint8_t> p24ref(size * 3), p24ary(size * 3);
+    memcpy_to_p24_from_float_with_dither(p24ref.data(), fary.data(), size, &whole);
+
+    constexpr size_t counts[] = {441, 7, 1023, 13, 3};
+    for (size_t i = 0, j = 0; i < size; ++j) {
+        const size_t n = std::min(counts[j % std::size(counts)], size - i);
+        memcpy_to_i16_from_float_with_dither(&i16ary[i], &fary[i], n, &pieces);
+        i += n;
+    }
+    for (size_t i = 0, j = 0; i < size; ++j) {
+        const size_t n = std::min(counts[j % std::size(counts)], size - i);
+        memcpy_to_p24_from_float_with_dither(&p24ary[i * 3], &fary[i], n, &pieces);
+        i += n;
+    }
+    EXPECT_EQ(i16ref, i16ary);
+    EXPECT_EQ(p24ref, p24ary);
+    EXPECT_EQ(0, memcmp(whole.state, pieces.state, sizeof(whole.state)));
+    EXPECT_EQ(whole.lane, pieces.lane);
+}
+
 TEST(audio_utils_primitives, memcpy_by_channel_mask) {
     uint32_t dst_mask;
     uint32_t src_mask;
@@ -682,6 +953,149 @@ TEST(audio_utils_primitives, memcpy_by_index_array_src_index) {
     delete[] u24ary;
 }
 
+// scalar reference for memcpy_by_index_array()
+static void memcpy_by_index_array_reference(uint8_t *dst, uint32_t dst_channels,
+        const uint8_t *src, uint32_t src_channels, const int8_t *idxary,
+        size_t sample_size, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        for (uint32_t j = 0; j < dst_channels; ++j) {
+            uint8_t *out = dst + (i * dst_channels + j) * sample_size;
+            if (idxary[j] < 0) {
+                memset(out, 0, sample_size);
+            } else {
+                memcpy(out, src + (i * src_channels + idxary[j]) * sample_size, sample_size);
+            }
+        }
+    }
+}
+
+TEST_P(audio_utils_primitives_simd, memcpy_by_index_array_plan) {
+    memcpy_by_index_array_plan_t plan;
+
+    // classification
+    const int8_t identity[] = {0, 1, 2, 3};
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init(&plan, 4, 4, identity, 2));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_IDENTITY, plan.type);
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init(&plan, 2, 4, identity, 2));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_PREFIX, plan.type);
+    EXPECT_EQ(2u, plan.copy_channels);
+    const int8_t zeroFill[] = {0, 1, -1, -1};
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init(&plan, 4, 2, zeroFill, 4));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_ZERO_FILL, plan.type);
+    EXPECT_EQ(2u, plan.copy_channels);
+    const int8_t swap[] = {1, 0, 3, 2};
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init(&plan, 4, 4, swap, 3));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_PERMUTATION, plan.type);
+    const int8_t gap[] = {0, -1, 1};
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init(&plan, 3, 2, gap, 1));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_GENERIC, plan.type);
+
+    // invalid arguments
+    EXPECT_EQ(-EINVAL, memcpy_by_index_array_plan_init(&plan, 4, 3, identity, 2));
+    EXPECT_EQ(-EINVAL, memcpy_by_index_array_plan_init(&plan, 4, 4, identity, 5));
+    EXPECT_EQ(-EINVAL, memcpy_by_index_array_plan_init(&plan, 4, 4, identity, 0));
+    EXPECT_EQ(-EINVAL, memcpy_by_index_array_plan_init(
+            &plan, MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX + 1, 4, identity, 2));
+
+    // compare random index arrays, including the frame sizes handled by the byte shuffle,
+    // against the reference, for frame counts exercising the scalar tail.
+    std::minstd_rand gen(42);
+    const size_t counts[] = {0, 1, 3, 4, 7, 16, 33, 96};
+    const size_t maxCount = 96;
+    for (size_t sampleSize = 1; sampleSize <= 4; ++sampleSize) {
+        for (uint32_t srcChannels = 1; srcChannels <= 24; ++srcChannels) {
+            for (uint32_t dstChannels = 1; dstChannels <= 24; ++dstChannels) {
+                int8_t idxary[MEMCPY_BY_INDEX_ARRAY_PLAN_CHANNELS_MAX];
+                for (uint32_t j = 0; j < dstChannels; ++j) {
+                    // mostly identity with occasional zero fill and reordering
+                    switch (gen() % 4) {
+                    case 0:
+                        idxary[j] = -1;
+                        break;
+                    case 1:
+                        idxary[j] = gen() % srcChannels;
+                        break;
+                    default:
+                        idxary[j] = j < srcChannels ? j : -1;
+                        break;
+                    }
+                }
+                ASSERT_EQ(0, memcpy_by_index_array_plan_init(
+                        &plan, dstChannels, srcChannels, idxary, sampleSize));
+
+                std::vector<uint8_t> src(maxCount * srcChannels * sampleSize);
+                for (auto &v : src) v = gen();
+                std::vector<uint8_t> dst(maxCount * dstChannels * sampleSize + 1);
+                std::vector<uint8_t> ref(dst.size());
+                for (size_t count : counts) {
+                    // the byte past the end must not be written
+                    std::fill(dst.begin(), dst.end(), 0x55);
+                    std::fill(ref.begin(), ref.end(), 0x55);
+                    memcpy_by_index_array_reference(ref.data(), dstChannels, src.data(),
+                            srcChannels, idxary, sampleSize, count);
+                    memcpy_by_index_array_with_plan(dst.data(), src.data(), &plan, count);
+                    ASSERT_EQ(ref, dst) << "sampleSize " << sampleSize
+                            << " srcChannels " << srcChannels << " dstChannels " << dstChannels
+                            << " count " << count;
+
+                    std::fill(dst.begin(), dst.end(), 0x55);
+                    memcpy_by_index_array(dst.data(), dstChannels, src.data(), srcChannels,
+                            idxary, sampleSize, count);
+                    ASSERT_EQ(ref, dst);
+                }
+            }
+        }
+    }
+}
+
+TEST_P(audio_utils_primitives_simd, memcpy_by_index_array_plan_from_channel_mask) {
+    memcpy_by_index_array_plan_t plan;
+
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init_from_channel_mask(&plan,
+            AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_STEREO, sizeof(int16_t)));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_IDENTITY, plan.type);
+
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init_from_channel_mask(&plan,
+            AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_5POINT1, sizeof(int16_t)));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_PREFIX, plan.type);
+    EXPECT_EQ(2u, plan.dst_channels);
+    EXPECT_EQ(6u, plan.src_channels);
+
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init_from_channel_mask(&plan,
+            AUDIO_CHANNEL_OUT_7POINT1, AUDIO_CHANNEL_OUT_STEREO, sizeof(float)));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_ZERO_FILL, plan.type);
+    EXPECT_EQ(8u, plan.dst_channels);
+
+    // index masks are filled in order
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init_from_channel_mask(&plan,
+            audio_channel_mask_for_index_assignment_from_count(4),
+            AUDIO_CHANNEL_OUT_5POINT1, 3));
+    EXPECT_EQ(MEMCPY_BY_INDEX_ARRAY_PREFIX, plan.type);
+
+    // compare against the index array initialization used by memcpy_by_index_array()
+    const audio_channel_mask_t dstMask = AUDIO_CHANNEL_OUT_5POINT1;
+    const audio_channel_mask_t srcMask = AUDIO_CHANNEL_OUT_7POINT1;
+    ASSERT_EQ(0, memcpy_by_index_array_plan_init_from_channel_mask(&plan,
+            dstMask, srcMask, sizeof(int32_t)));
+    int8_t idxary[32];
+    const size_t dstChannels = memcpy_by_index_array_initialization_from_channel_mask(
+            idxary, 32, dstMask, srcMask);
+    const size_t srcChannels = audio_channel_count_from_out_mask(srcMask);
+    const size_t count = 97;
+    std::vector<int32_t> src(count * srcChannels);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = i;
+    std::vector<int32_t> dst(count * dstChannels);
+    std::vector<int32_t> ref(count * dstChannels);
+    memcpy_by_index_array(ref.data(), dstChannels, src.data(), srcChannels,
+            idxary, sizeof(int32_t), count);
+    memcpy_by_index_array_with_plan(dst.data(), src.data(), &plan, count);
+    EXPECT_EQ(ref, dst);
+
+    EXPECT_EQ(-EINVAL, memcpy_by_index_array_plan_init_from_channel_mask(&plan,
+            AUDIO_CHANNEL_NONE, AUDIO_CHANNEL_OUT_STEREO, sizeof(int16_t)));
+}
+
 TEST(audio_utils_primitives, updown_mix) {
     const size_t size = 32767;
     std::vector<int16_t> i16ref(size * 2);
@@ -746,7 +1160,7 @@ void checkAddedClampedu8(uint8_t *out, const uint8_t *in1,
     delete[] outi16ary;
 }
 
-TEST(audio_utils_primitives, accumulate) {
+TEST_P(audio_utils_primitives_simd, accumulate) {
     int16_t *i16ref = new int16_t[65536];
     int16_t *i16add = new int16_t[65536];
     int16_t *i16ary = new int16_t[65536];
@@ -855,6 +1269,124 @@ TEST(audio_utils_primitives, accumulate) {
 }
 
 
+// The definition of accumulate_with_gain_*(): scale and sum in float for 16-bit samples
+// and in double for 32-bit samples, then clamp and round half away from zero.
+static int16_t accumulateWithGain(int16_t dst, int16_t src, float gain) {
+    const float product = src * gain;
+    const float sum = product + dst;
+    return roundf(fmaxf(fminf(sum, 32767.f), -32768.f));
+}
+
+static int32_t accumulateWithGain(int32_t dst, int32_t src, float gain, double min, double max) {
+    const double product = src * (double)gain;
+    const double sum = product + dst;
+    return round(fmax(fmin(sum, max), min));
+}
+
+static float accumulateWithGain(float dst, float src, float gain) {
+    const float product = src * gain;
+    return dst + product;
+}
+
+template <typename T, typename F>
+static void checkAccumulateWithChannelGains(
+        void (*accumulate)(T *, const T *, const float *, const float *, uint32_t, size_t),
+        F reference, const std::vector<T> &src, const std::vector<T> &dst) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> gainDis(-2.f, 2.f);
+    for (uint32_t channelCount : {1, 2, 3, 4, 5, 6, 7, 8, 12, 24, 33}) {
+        std::vector<float> gains(channelCount);
+        std::vector<float> increments(channelCount);
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            gains[c] = gainDis(gen);
+            increments[c] = gainDis(gen) / 256;
+        }
+        for (size_t frameCount : {0, 1, 3, 8, 17, 100, 333}) {
+            ASSERT_LE(frameCount * channelCount, src.size());
+            for (bool ramp : {false, true}) {
+                std::vector<T> ref(dst.begin(), dst.begin() + frameCount * channelCount);
+                for (size_t i = 0; i < frameCount; ++i) {
+                    for (uint32_t c = 0; c < channelCount; ++c) {
+                        const float step = ramp ? (float)i * increments[c] : 0.f;
+                        const float gain = ramp ? gains[c] + step : gains[c];
+                        T &sample = ref[i * channelCount + c];
+                        sample = reference(sample, src[i * channelCount + c], gain);
+                    }
+                }
+                std::vector<T> out(dst.begin(), dst.begin() + frameCount * channelCount);
+                accumulate(out.data(), src.data(), gains.data(),
+                        ramp ? increments.data() : nullptr, channelCount, frameCount);
+                ASSERT_EQ(ref, out) << "channelCount " << channelCount
+                        << " frameCount " << frameCount << " ramp " << ramp;
+            }
+        }
+    }
+}
+
+TEST_P(audio_utils_primitives_simd, accumulate_with_gain) {
+    constexpr size_t size = 65536;
+    std::minstd_rand gen(42);
+    std::vector<int16_t> i16src(size), i16dst(size);
+    std::vector<int32_t> i32src(size), i32dst(size), q8_23src(size), q8_23dst(size);
+    std::vector<float> fsrc(size), fdst(size);
+    std::uniform_int_distribution<int32_t> i32dis(INT32_MIN, INT32_MAX);
+    for (size_t i = 0; i < size; ++i) {
+        i16src[i] = i - 32768;
+        i16dst[i] = i32dis(gen) >> 16;
+        i32src[i] = i32dis(gen);
+        i32dst[i] = i32dis(gen);
+        q8_23src[i] = i32src[i] >> 8;
+        q8_23dst[i] = i32dst[i] >> 8;
+        fsrc[i] = i32src[i] / 2147483648.f;
+        fdst[i] = i32dst[i] / 2147483648.f;
+    }
+
+    // unity gain is accumulate_*().
+    std::vector<int16_t> i16ref(i16dst), i16ary(i16dst);
+    accumulate_i16(i16ref.data(), i16src.data(), size);
+    accumulate_with_gain_i16(i16ary.data(), i16src.data(), 1.f, size);
+    EXPECT_EQ(i16ref, i16ary);
+    std::vector<int32_t> i32ref(i32dst), i32ary(i32dst);
+    accumulate_i32(i32ref.data(), i32src.data(), size);
+    accumulate_with_gain_i32(i32ary.data(), i32src.data(), 1.f, size);
+    EXPECT_EQ(i32ref, i32ary);
+    std::vector<int32_t> q8_23ref(q8_23dst), q8_23ary(q8_23dst);
+    accumulate_q8_23(q8_23ref.data(), q8_23src.data(), size);
+    accumulate_with_gain_q8_23(q8_23ary.data(), q8_23src.data(), 1.f, size);
+    EXPECT_EQ(q8_23ref, q8_23ary);
+    std::vector<float> fref(fdst), fary(fdst);
+    accumulate_float(fref.data(), fsrc.data(), size);
+    accumulate_with_gain_float(fary.data(), fsrc.data(), 1.f, size);
+    EXPECT_EQ(fref, fary);
+
+    // saturation.
+    i16ary.assign(size, 32767);
+    accumulate_with_gain_i16(i16ary.data(), i16ary.data(), 2.f, size);
+    EXPECT_EQ(std::vector<int16_t>(size, 32767), i16ary);
+    i32ary.assign(size, INT32_MIN);
+    accumulate_with_gain_i32(i32ary.data(), i32ary.data(), 0.5f, size);
+    EXPECT_EQ(std::vector<int32_t>(size, INT32_MIN), i32ary);
+    q8_23ary.assign(size, 0x7fffff);
+    accumulate_with_gain_q8_23(q8_23ary.data(), q8_23ary.data(), 0.25f, size);
+    EXPECT_EQ(std::vector<int32_t>(size, 0x7fffff), q8_23ary);
+
+    // constant and ramped channel gains against the definition.
+    checkAccumulateWithChannelGains(accumulate_with_channel_gains_i16,
+            [](int16_t d, int16_t s, float g) { return accumulateWithGain(d, s, g); },
+            i16src, i16dst);
+    checkAccumulateWithChannelGains(accumulate_with_channel_gains_i32,
+            [](int32_t d, int32_t s, float g) {
+                return accumulateWithGain(d, s, g, INT32_MIN, INT32_MAX); },
+            i32src, i32dst);
+    checkAccumulateWithChannelGains(accumulate_with_channel_gains_q8_23,
+            [](int32_t d, int32_t s, float g) {
+                return accumulateWithGain(d, s, g, -(1 << 23), (1 << 23) - 1); },
+            q8_23src, q8_23dst);
+    checkAccumulateWithChannelGains(accumulate_with_channel_gains_float,
+            [](float d, float s, float g) { return accumulateWithGain(d, s, g); },
+            fsrc, fdst);
+}
+
 TEST(audio_utils_primitives, MemcpyToFloatFromFloatWithClamping) {
     std::vector<float> src = {-INFINITY, -2, -1, -0, 0, 0.009, 1.000001, 9999999, INFINITY, NAN};
     std::vector<float> dst(src.size());
@@ -866,3 +1398,5 @@ TEST(audio_utils_primitives, MemcpyToFloatFromFloatWithClamping) {
 
     ASSERT_EQ(dst, expected) << "src=" << testing::PrintToString(src);
 }
+
+INSTANTIATE_TEST_SUITE_P(X86SimdLevels, audio_utils_primitives_simd, X86_SIMD_LEVELS);
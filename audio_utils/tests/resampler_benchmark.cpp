@@ -0,0 +1,285 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <malloc.h>
+#include <math.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/primitives.h>
+#include <audio_utils/resampler.h>
+#ifdef __ANDROID__
+#include <speex/speex_resampler.h>
+#endif
+
+static constexpr uint32_t kInRate = 44100;
+static constexpr uint32_t kOutRate = 48000;
+static constexpr uint32_t kChannels = 2;
+static constexpr size_t kInFrames = kInRate;       // 1 second
+static constexpr size_t kInChunk = kInRate / 100;  // 10 ms
+static constexpr size_t kOutChunk = kOutRate / 50; // room for any 10 ms of output
+
+enum Engine {
+    NATIVE_I16,
+    NATIVE_FLOAT,
+    SPEEX_I16,
+};
+
+// Interleaved stereo sine of frequency at kInRate, amplitude 0.5.
+static std::vector<float> makeSine(double frequency) {
+    std::vector<float> sine(kInFrames * kChannels);
+    for (size_t i = 0; i < kInFrames; ++i) {
+        sine[i * kChannels] = sine[i * kChannels + 1] =
+                0.5 * sin(2. * M_PI * frequency * i / kInRate);
+    }
+    return sine;
+}
+
+// Signal to noise ratio in dB of channel 0 of out, a sine of frequency at kOutRate with
+// unknown delay: the signal is the least squares fit of a sine and cosine, the noise the
+// residual.  The first and last 20 ms are skipped, covering the filter transients.
+static double sineSnr(const std::vector<float> &out, double frequency) {
+    const size_t frames = out.size() / kChannels;
+    const size_t skip = kOutRate / 50;
+    double ss = 0., sc = 0., cc = 0., ys = 0., yc = 0.;
+    for (size_t i = skip; i + skip < frames; ++i) {
+        const double s = sin(2. * M_PI * frequency * i / kOutRate);
+        const double c = cos(2. * M_PI * frequency * i / kOutRate);
+        const double y = out[i * kChannels];
+        ss += s * s; sc += s * c; cc += c * c; ys += y * s; yc += y * c;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (yc * ss - ys * sc) / det;
+    double signal = 0., noise = 0.;
+    for (size_t i = skip; i + skip < frames; ++i) {
+        const double fit = a * sin(2. * M_PI * frequency * i / kOutRate)
+                + b * cos(2. * M_PI * frequency * i / kOutRate);
+        const double error = out[i * kChannels] - fit;
+        signal += fit * fit;
+        noise += error * error;
+    }
+    return 10. * log10(signal / noise);
+}
+
+// Resamples 1 second of input in 10 ms chunks, returns the output as float.
+static std::vector<float> resample(Engine engine, uint32_t quality,
+        const std::vector<float> &in, const std::vector<int16_t> &in16) {
+    std::vector<float> out;
+    out.reserve((kOutRate + kOutChunk) * kChannels);
+    std::vector<float> chunk(kOutChunk * kChannels);
+    std::vector<int16_t> chunk16(kOutChunk * kChannels);
+
+    struct resampler_itfe *resampler = nullptr;
+#ifdef __ANDROID__
+    SpeexResamplerState *speex = nullptr;
+#endif
+    switch (engine) {
+    case NATIVE_I16:
+    case NATIVE_FLOAT:
+        create_resampler_with_format(kInRate, kOutRate, kChannels, quality,
+                engine == NATIVE_FLOAT ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT,
+                0 /* flags */, nullptr /* provider */, &resampler);
+        break;
+    case SPEEX_I16:
+#ifdef __ANDROID__
+        int error;
+        speex = speex_resampler_init(kChannels, kInRate, kOutRate, quality, &error);
+        speex_resampler_skip_zeros(speex);
+#endif
+        break;
+    }
+
+    for (size_t pos = 0; pos < kInFrames; pos += kInChunk) {
+        size_t inCount = kInChunk;
+        size_t outCount = kOutChunk;
+        switch (engine) {
+        case NATIVE_I16:
+            resampler->resample_from_input(resampler,
+                    const_cast<int16_t *>(&in16[pos * kChannels]), &inCount,
+                    chunk16.data(), &outCount);
+            break;
+        case NATIVE_FLOAT:
+            resampler->resample_from_input_float(resampler,
+                    const_cast<float *>(&in[pos * kChannels]), &inCount,
+                    chunk.data(), &outCount);
+            break;
+        case SPEEX_I16:
+#ifdef __ANDROID__
+        {
+            spx_uint32_t inLen = inCount;
+            spx_uint32_t outLen = outCount;
+            speex_resampler_process_interleaved_int(speex, &in16[pos * kChannels], &inLen,
+                    chunk16.data(), &outLen);
+            outCount = outLen;
+        }
+#else
+            outCount = 0;
+#endif
+            break;
+        }
+        if (engine == NATIVE_FLOAT) {
+            out.insert(out.end(), chunk.begin(), chunk.begin() + outCount * kChannels);
+        } else {
+            for (size_t i = 0; i < outCount * kChannels; ++i) {
+                out.push_back(float_from_i16(chunk16[i]));
+            }
+        }
+    }
+
+    release_resampler(resampler);
+#ifdef __ANDROID__
+    if (speex != nullptr) speex_resampler_destroy(speex);
+#endif
+    return out;
+}
+
+/*
+On an x86-64 host. The speex engine is only built for Android, so these numbers have no
+side by side speex comparison: run BM_Resample<SPEEX_I16> on a device for it.
+
+Benchmark                            Time             CPU   Iterations UserCounters...
+--------------------------------------------------------------------------------------
+BM_Resample<NATIVE_I16>/1       768125 ns       761723 ns          856 snr_15k=68.2772 snr_997=75.8351
+BM_Resample<NATIVE_I16>/2      1063014 ns      1055475 ns          711 snr_15k=73.5007 snr_997=74.9018
+BM_Resample<NATIVE_I16>/3      1287270 ns      1272566 ns          566 snr_15k=88.2618 snr_997=88.6682
+BM_Resample<NATIVE_I16>/4      1709852 ns      1697691 ns          515 snr_15k=89.801 snr_997=88.9987
+BM_Resample<NATIVE_I16>/5      1807758 ns      1790311 ns          447 snr_15k=93.7423 snr_997=89.2662
+BM_Resample<NATIVE_I16>/6      1859485 ns      1847798 ns          342 snr_15k=93.0082 snr_997=89.2543
+BM_Resample<NATIVE_I16>/7      2429340 ns      2412339 ns          287 snr_15k=92.1842 snr_997=89.2403
+BM_Resample<NATIVE_I16>/8      2998510 ns      2930219 ns          259 snr_15k=93.0084 snr_997=89.2219
+BM_Resample<NATIVE_I16>/9      3220034 ns      3206134 ns          206 snr_15k=92.1864 snr_997=89.1902
+BM_Resample<NATIVE_FLOAT>/1     560870 ns       553990 ns         1251 snr_15k=68.3025 snr_997=76.0293
+BM_Resample<NATIVE_FLOAT>/2     910008 ns       869005 ns          897 snr_15k=73.7534 snr_997=75.0874
+BM_Resample<NATIVE_FLOAT>/3    1065023 ns      1043100 ns          716 snr_15k=93.8813 snr_997=97.0269
+BM_Resample<NATIVE_FLOAT>/4    1290887 ns      1282143 ns          441 snr_15k=97.7287 snr_997=101.771
+BM_Resample<NATIVE_FLOAT>/5    1535006 ns      1520545 ns          457 snr_15k=110.689 snr_997=120.717
+BM_Resample<NATIVE_FLOAT>/6    1687978 ns      1671558 ns          425 snr_15k=116.003 snr_997=122.043
+BM_Resample<NATIVE_FLOAT>/7    2616549 ns      2586543 ns          288 snr_15k=125.942 snr_997=119.667
+BM_Resample<NATIVE_FLOAT>/8    3303085 ns      3257567 ns          265 snr_15k=125.064 snr_997=125.39
+BM_Resample<NATIVE_FLOAT>/9    3373701 ns      3344016 ns          228 snr_15k=139.293 snr_997=140.867
+*/
+
+// Resamples 1 second of stereo 44.1 kHz to 48 kHz in 10 ms chunks at quality state.range(0).
+// The snr counters are for a sine at 997 Hz and at 15 kHz, the latter near the passband edge.
+template <Engine ENGINE>
+static void BM_Resample(benchmark::State& state) {
+    const uint32_t quality = state.range(0);
+    const std::vector<float> in = makeSine(997.);
+    std::vector<int16_t> in16(in.size());
+    memcpy_to_i16_from_float(in16.data(), in.data(), in.size());
+
+    std::vector<float> out;
+    for (auto _ : state) {
+        out = resample(ENGINE, quality, in, in16);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.counters["snr_997"] = sineSnr(out, 997.);
+
+    const std::vector<float> in15k = makeSine(15000.);
+    std::vector<int16_t> in15k16(in15k.size());
+    memcpy_to_i16_from_float(in15k16.data(), in15k.data(), in15k.size());
+    state.counters["snr_15k"] = sineSnr(resample(ENGINE, quality, in15k, in15k16), 15000.);
+    state.SetItemsProcessed(state.iterations() * kInFrames);
+}
+
+static void ResamplerQualities(benchmark::internal::Benchmark* b) {
+    for (int quality = RESAMPLER_QUALITY_MIN + 1; quality < RESAMPLER_QUALITY_MAX; ++quality) {
+        b->Arg(quality);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Resample, NATIVE_I16)->Apply(ResamplerQualities);
+BENCHMARK_TEMPLATE(BM_Resample, NATIVE_FLOAT)->Apply(ResamplerQualities);
+#ifdef __ANDROID__
+BENCHMARK_TEMPLATE(BM_Resample, SPEEX_I16)->Apply(ResamplerQualities);
+#endif
+
+static size_t heapBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return mallinfo().uordblks;
+#endif
+}
+
+static constexpr size_t kResamplers = 1000;
+
+/*
+On an x86-64 host:
+
+Benchmark                                  Time             CPU   Iterations UserCounters...
+--------------------------------------------------------------------------------------------
+BM_Create1000Resamplers/3               2124 us         2080 us          350 bytes_per_resampler=4.656k bytes_saved=30.7692M filter_bytes=30.8k
+BM_Create1000Resamplers/4               2179 us         2126 us          326 bytes_per_resampler=4.784k bytes_saved=40.999M filter_bytes=41.04k
+BM_Create1000Resamplers/9               3859 us         3834 us          185 bytes_per_resampler=5.808k bytes_saved=122.837M filter_bytes=122.96k
+BM_Create1000ResamplersUncached/3     402502 us       398748 us            2
+BM_Create1000ResamplersUncached/4     556139 us       554588 us            1
+BM_Create1000ResamplersUncached/9    1844419 us      1827479 us            1
+*/
+
+// Creates kResamplers stereo 44.1 kHz to 48 kHz resamplers at quality state.range(0) and
+// releases them.  With the filter cache only the first designs its filter, the others share
+// it: filter_bytes is the size of the shared tables, bytes_saved what kResamplers private
+// copies would have added, bytes_per_resampler the heap actually used by each.
+static void BM_Create1000Resamplers(benchmark::State& state) {
+    const uint32_t quality = state.range(0);
+    std::vector<struct resampler_itfe *> resamplers(kResamplers);
+    size_t heapFirst = 0;
+    size_t heapEach = 0;
+
+    for (auto _ : state) {
+        const size_t heapStart = heapBytes();
+        for (size_t i = 0; i < kResamplers; ++i) {
+            create_resampler(kInRate, kOutRate, kChannels, quality, nullptr, &resamplers[i]);
+            if (i == 0) heapFirst = heapBytes() - heapStart;
+        }
+        heapEach = (heapBytes() - heapStart - heapFirst) / (kResamplers - 1);
+        for (auto resampler : resamplers) {
+            release_resampler(resampler);
+        }
+    }
+    state.counters["filter_bytes"] = heapFirst - heapEach;
+    state.counters["bytes_saved"] = (double)(heapFirst - heapEach) * (kResamplers - 1);
+    state.counters["bytes_per_resampler"] = heapEach;
+    state.SetItemsProcessed(state.iterations() * kResamplers);
+}
+
+// As above, but each resampler is released before the next is created, so that each
+// designs its own filter, as all did before the cache.
+static void BM_Create1000ResamplersUncached(benchmark::State& state) {
+    const uint32_t quality = state.range(0);
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < kResamplers; ++i) {
+            struct resampler_itfe *resampler;
+            create_resampler(kInRate, kOutRate, kChannels, quality, nullptr, &resampler);
+            release_resampler(resampler);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kResamplers);
+}
+
+static void CreateQualities(benchmark::internal::Benchmark* b) {
+    b->Arg(RESAMPLER_QUALITY_VOIP)->Arg(RESAMPLER_QUALITY_DEFAULT)
+            ->Arg(RESAMPLER_QUALITY_MAX - 1)->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK(BM_Create1000Resamplers)->Apply(CreateQualities);
+BENCHMARK(BM_Create1000ResamplersUncached)->Apply(CreateQualities);
+
+BENCHMARK_MAIN();
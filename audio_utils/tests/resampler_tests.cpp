@@ -0,0 +1,445 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_resampler_tests"
+
+#include <math.h>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+
+#include <audio_utils/primitives.h>
+#include <audio_utils/resampler.h>
+
+static constexpr double kFrequency = 1000.;
+
+// Interleaved sine of kFrequency, the same on every channel.
+static std::vector<float> makeSine(uint32_t sampleRate, size_t frames, uint32_t channels) {
+    std::vector<float> sine(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        const float value = 0.5 * sin(2. * M_PI * kFrequency * i / sampleRate);
+        for (size_t c = 0; c < channels; ++c) {
+            sine[i * channels + c] = value;
+        }
+    }
+    return sine;
+}
+
+// Signal to noise ratio in dB of channel 0 of a resampled sine, against the ideal sine.
+// The resampler output is aligned on its input, skip the filter transient at either end.
+static double sineSnr(const std::vector<float> &out, uint32_t sampleRate, uint32_t channels,
+        size_t skip) {
+    double signal = 0.;
+    double noise = 0.;
+    const size_t frames = out.size() / channels;
+    for (size_t i = skip; i + skip < frames; ++i) {
+        const double ideal = 0.5 * sin(2. * M_PI * kFrequency * i / sampleRate);
+        const double error = out[i * channels] - ideal;
+        signal += ideal * ideal;
+        noise += error * error;
+    }
+    return 10. * log10(signal / noise);
+}
+
+// Resamples all of in, feeding it in chunks of inChunk frames.
+static std::vector<float> resampleFloat(struct resampler_itfe *resampler,
+        const std::vector<float> &in, uint32_t channels, size_t outFrames, size_t inChunk) {
+    std::vector<float> out(outFrames * channels);
+    size_t inPos = 0;
+    size_t outPos = 0;
+    while (outPos < outFrames && inPos < in.size() / channels) {
+        size_t inCount = std::min(inChunk, in.size() / channels - inPos);
+        size_t outCount = outFrames - outPos;
+        EXPECT_EQ(0, resampler->resample_from_input_float(resampler,
+                const_cast<float *>(&in[inPos * channels]), &inCount,
+                &out[outPos * channels], &outCount));
+        inPos += inCount;
+        outPos += outCount;
+    }
+    out.resize(outPos * channels);
+    return out;
+}
+
+class ResamplerTest
+        : public ::testing::TestWithParam<std::tuple<uint32_t /* in */, uint32_t /* out */>> {
+};
+
+TEST_P(ResamplerTest, sine_snr) {
+    const uint32_t inRate = std::get<0>(GetParam());
+    const uint32_t outRate = std::get<1>(GetParam());
+    constexpr uint32_t kChannels = 2;
+    const std::vector<float> in = makeSine(inRate, inRate / 4, kChannels);
+
+    for (uint32_t quality : {RESAMPLER_QUALITY_VOIP, RESAMPLER_QUALITY_DEFAULT,
+            RESAMPLER_QUALITY_DESKTOP, RESAMPLER_QUALITY_MAX - 1}) {
+        struct resampler_itfe *resampler;
+        ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, kChannels, quality,
+                AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */, nullptr /* provider */, &resampler));
+        const std::vector<float> out =
+                resampleFloat(resampler, in, kChannels, outRate / 4, 480 /* inChunk */);
+        release_resampler(resampler);
+
+        // all the input but the half filter left in the history is resampled
+        EXPECT_GT(out.size() / kChannels, outRate / 4 * 9 / 10);
+        const double snr = sineSnr(out, outRate, kChannels, outRate / 100 /* skip */);
+        ALOGV("%u -> %u quality %u snr %f", inRate, outRate, quality, snr);
+        EXPECT_GT(snr, quality < RESAMPLER_QUALITY_DESKTOP ? 60. : 80.)
+                << inRate << " -> " << outRate << " quality " << quality;
+    }
+}
+
+// The output does not depend on how the input is chunked.
+TEST_P(ResamplerTest, chunking) {
+    const uint32_t inRate = std::get<0>(GetParam());
+    const uint32_t outRate = std::get<1>(GetParam());
+    constexpr uint32_t kChannels = 3;
+    const std::vector<float> in = makeSine(inRate, inRate / 10, kChannels);
+
+    std::vector<float> reference;
+    for (size_t inChunk : {1, 7, 160, 4096}) {
+        struct resampler_itfe *resampler;
+        ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, kChannels,
+                RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */,
+                nullptr, &resampler));
+        const std::vector<float> out = resampleFloat(resampler, in, kChannels, outRate, inChunk);
+        release_resampler(resampler);
+        if (reference.empty()) {
+            reference = out;
+        } else {
+            EXPECT_EQ(reference, out) << "inChunk " << inChunk;
+        }
+    }
+}
+
+// The int16 path matches the float path, up to the int16 quantization.
+TEST_P(ResamplerTest, i16_matches_float) {
+    const uint32_t inRate = std::get<0>(GetParam());
+    const uint32_t outRate = std::get<1>(GetParam());
+    constexpr uint32_t kChannels = 2;
+    const std::vector<float> in = makeSine(inRate, inRate / 10, kChannels);
+    std::vector<int16_t> in16(in.size());
+    memcpy_to_i16_from_float(in16.data(), in.data(), in.size());
+
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, kChannels,
+            RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */,
+            nullptr, &resampler));
+    const std::vector<float> out = resampleFloat(resampler, in, kChannels, outRate, in.size());
+    release_resampler(resampler);
+
+    ASSERT_EQ(0, create_resampler(inRate, outRate, kChannels, RESAMPLER_QUALITY_DEFAULT,
+            nullptr, &resampler));
+    size_t inCount = in16.size() / kChannels;
+    size_t outCount = out.size() / kChannels;
+    std::vector<int16_t> out16(outCount * kChannels);
+    EXPECT_EQ(0, resampler->resample_from_input(resampler, in16.data(), &inCount,
+            out16.data(), &outCount));
+    EXPECT_EQ(out.size() / kChannels, outCount);
+    EXPECT_EQ(in16.size() / kChannels, inCount);
+    release_resampler(resampler);
+
+    for (size_t i = 0; i < outCount * kChannels; ++i) {
+        ASSERT_NEAR(out[i], float_from_i16(out16[i]), 3. / 32768.) << "sample " << i;
+    }
+}
+
+struct SineProvider {
+    struct resampler_buffer_provider provider; // must be first
+    std::vector<float> data;
+    size_t frames;
+    size_t pos;
+    size_t chunk;
+};
+
+static int getNextBuffer(struct resampler_buffer_provider *provider,
+        struct resampler_buffer *buffer) {
+    SineProvider *sine = reinterpret_cast<SineProvider *>(provider);
+    const size_t frames = std::min({buffer->frame_count, sine->chunk, sine->frames - sine->pos});
+    buffer->frame_count = frames;
+    buffer->f32 = frames == 0 ? nullptr : &sine->data[sine->pos * sine->data.size() / sine->frames];
+    return frames == 0 ? -ENODATA : 0;
+}
+
+static void releaseBuffer(struct resampler_buffer_provider *provider,
+        struct resampler_buffer *buffer) {
+    SineProvider *sine = reinterpret_cast<SineProvider *>(provider);
+    sine->pos += buffer->frame_count;
+}
+
+// Pulling from a provider gives the same output as pushing the input.
+TEST_P(ResamplerTest, provider_matches_input) {
+    const uint32_t inRate = std::get<0>(GetParam());
+    const uint32_t outRate = std::get<1>(GetParam());
+    constexpr uint32_t kChannels = 1;
+
+    SineProvider sine{};
+    sine.provider.get_next_buffer = getNextBuffer;
+    sine.provider.release_buffer = releaseBuffer;
+    sine.frames = inRate / 10;
+    sine.data = makeSine(inRate, sine.frames, kChannels);
+    sine.chunk = 333;
+
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, kChannels,
+            RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */,
+            nullptr, &resampler));
+    const std::vector<float> expected =
+            resampleFloat(resampler, sine.data, kChannels, outRate, 256);
+    release_resampler(resampler);
+
+    ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, kChannels,
+            RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */,
+            &sine.provider, &resampler));
+    std::vector<float> out(expected.size());
+    size_t outPos = 0;
+    while (outPos < out.size()) {
+        size_t outCount = std::min<size_t>(441, out.size() - outPos);
+        EXPECT_EQ(0, resampler->resample_from_provider_float(resampler,
+                &out[outPos], &outCount));
+        if (outCount == 0) break;
+        outPos += outCount;
+    }
+    release_resampler(resampler);
+
+    EXPECT_EQ(expected.size(), outPos);
+    EXPECT_EQ(expected, out);
+}
+
+INSTANTIATE_TEST_CASE_P(
+        ResamplerTestAll, ResamplerTest,
+        ::testing::Values(
+                std::make_tuple(44100, 48000),
+                std::make_tuple(48000, 44100),
+                std::make_tuple(48000, 16000),
+                std::make_tuple(8000, 48000),
+                std::make_tuple(44100, 47999) // interpolated phases
+                ));
+
+TEST(resampler, invalid) {
+    struct resampler_itfe *resampler;
+    EXPECT_EQ(-EINVAL, create_resampler(44100, 48000, 2, RESAMPLER_QUALITY_MAX,
+            nullptr, &resampler));
+    EXPECT_EQ(-EINVAL, create_resampler(0, 48000, 2, RESAMPLER_QUALITY_DEFAULT,
+            nullptr, &resampler));
+    EXPECT_EQ(-EINVAL, create_resampler_with_format(44100, 48000, 2, RESAMPLER_QUALITY_DEFAULT,
+            AUDIO_FORMAT_PCM_8_BIT, 0 /* flags */, nullptr, &resampler));
+    EXPECT_EQ(-EINVAL, create_resampler_with_format(44100, 48000, 2, RESAMPLER_QUALITY_DEFAULT,
+            AUDIO_FORMAT_PCM_FLOAT, ~0u /* flags */, nullptr, &resampler));
+}
+
+// The delay is the input not yet output: outputs are centered on their input.
+TEST(resampler, delay) {
+    for (const auto &rates : std::vector<std::pair<uint32_t, uint32_t>>{
+            {48000, 48000}, {48000, 16000}, {44100, 48000}}) {
+        const uint32_t inRate = rates.first, outRate = rates.second;
+        struct resampler_itfe *resampler;
+        ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, 1, RESAMPLER_QUALITY_DEFAULT,
+                AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */, nullptr, &resampler));
+        EXPECT_EQ(0, resampler->delay_ns(resampler));
+
+        std::vector<float> in(inRate / 10, 0.5f);
+        std::vector<float> out(outRate / 5);
+        size_t inFrames = in.size();
+        size_t outFrames = out.size();
+        ASSERT_EQ(0, resampler->resample_from_input_float(resampler, in.data(), &inFrames,
+                out.data(), &outFrames));
+        ASSERT_EQ(in.size(), inFrames);
+        const double pendingNs = 1e9 * ((double)inFrames / inRate - (double)outFrames / outRate);
+        EXPECT_GT(pendingNs, 0.);
+        EXPECT_NEAR(pendingNs, resampler->delay_ns(resampler), 1e9 / outRate)
+                << inRate << " to " << outRate;
+
+        resampler->reset(resampler);
+        EXPECT_EQ(0, resampler->delay_ns(resampler));
+        release_resampler(resampler);
+    }
+}
+
+// Resamplers sharing a filter, created and released concurrently and in any order,
+// give the same output as one alone.
+TEST(resampler, shared_filter) {
+    constexpr uint32_t kChannels = 2;
+    const std::vector<float> in = makeSine(44100, 4410, kChannels);
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_with_format(44100, 48000, kChannels,
+            RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */,
+            nullptr, &resampler));
+    const std::vector<float> expected = resampleFloat(resampler, in, kChannels, 4800, 441);
+    release_resampler(resampler);
+
+    constexpr size_t kThreads = 4;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&in, &expected, t] {
+            std::vector<struct resampler_itfe *> resamplers(8);
+            for (size_t i = 0; i < resamplers.size(); ++i) {
+                // same ratio and quality: 88.2 kHz to 96 kHz shares the 44.1 kHz to 48 kHz filter
+                const uint32_t scale = (i + t) % 2 + 1;
+                ASSERT_EQ(0, create_resampler_with_format(44100 * scale, 48000 * scale,
+                        kChannels, RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT,
+                        0 /* flags */, nullptr, &resamplers[i]));
+            }
+            for (size_t i = t % 2; i < resamplers.size(); i += 2) {
+                EXPECT_EQ(expected, resampleFloat(resamplers[i], in, kChannels, 4800, 441));
+            }
+            for (size_t i = 0; i < resamplers.size(); ++i) {
+                release_resampler(resamplers[(i * 3 + t) % resamplers.size()]);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+TEST(resampler, set_ratio_ppm_invalid) {
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler(48000, 48000, 1, RESAMPLER_QUALITY_DEFAULT,
+            nullptr, &resampler));
+    // without RESAMPLER_FLAG_VARIABLE_RATIO, only the nominal ratio is accepted
+    EXPECT_EQ(-EINVAL, resampler->set_ratio_ppm(resampler, 1));
+    EXPECT_EQ(0, resampler->set_ratio_ppm(resampler, 0));
+    release_resampler(resampler);
+
+    ASSERT_EQ(0, create_resampler_with_format(48000, 48000, 1, RESAMPLER_QUALITY_DEFAULT,
+            AUDIO_FORMAT_PCM_16_BIT, RESAMPLER_FLAG_VARIABLE_RATIO, nullptr, &resampler));
+    EXPECT_EQ(-EINVAL, resampler->set_ratio_ppm(resampler, RESAMPLER_RATIO_PPM_MAX + 1));
+    EXPECT_EQ(-EINVAL, resampler->set_ratio_ppm(resampler, -RESAMPLER_RATIO_PPM_MAX - 1));
+    EXPECT_EQ(0, resampler->set_ratio_ppm(resampler, RESAMPLER_RATIO_PPM_MAX));
+    EXPECT_EQ(0, resampler->set_ratio_ppm(resampler, 0));
+    release_resampler(resampler);
+}
+
+// Changing the ratio while resampling a sine does not make clicks: the output stays a sine,
+// its sample to sample difference never exceeds that of the fastest sine in the sweep.
+TEST(resampler, set_ratio_ppm_continuous) {
+    constexpr uint32_t kRate = 48000;
+    const std::vector<float> in = makeSine(kRate, kRate, 1 /* channels */);
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_with_format(kRate, kRate, 1, RESAMPLER_QUALITY_DEFAULT,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_FLAG_VARIABLE_RATIO, nullptr, &resampler));
+
+    std::vector<float> out;
+    std::vector<float> block(kRate / 100);
+    size_t inPos = 0;
+    for (int i = 0; inPos < in.size(); ++i) {
+        // step between +-1000 ppm every 10 ms block
+        EXPECT_EQ(0, resampler->set_ratio_ppm(resampler, (i % 3 - 1) * 1000));
+        size_t inCount = in.size() - inPos;
+        size_t outCount = block.size();
+        EXPECT_EQ(0, resampler->resample_from_input_float(resampler,
+                const_cast<float *>(&in[inPos]), &inCount, block.data(), &outCount));
+        inPos += inCount;
+        out.insert(out.end(), block.begin(), block.begin() + outCount);
+    }
+    release_resampler(resampler);
+
+    // 0.5 amplitude sine at kFrequency, at most 0.1% faster
+    const double maxDelta = 0.5 * 2. * M_PI * kFrequency * 1.001 / kRate;
+    for (size_t i = kRate / 100; i + 1 < out.size() - kRate / 100; ++i) {
+        ASSERT_LE(fabs(out[i + 1] - out[i]), maxDelta * 1.01) << "frame " << i;
+    }
+}
+
+// A source whose clock runs faster than nominal feeds a buffer drained through the
+// resampler at the nominal output rate.  A controller steering set_ratio_ppm() from the
+// buffer occupancy keeps it bounded, where without it the buffer would grow without limit.
+TEST(resampler, set_ratio_ppm_tracks_drift) {
+    constexpr uint32_t kInRate = 44100;
+    constexpr uint32_t kOutRate = 48000;
+    constexpr double kDriftPpm = 300.;
+    constexpr size_t kBlock = kOutRate / 100;          // consumer period, 10 ms
+    constexpr size_t kBlocks = 100 * 60;                // 1 minute
+    constexpr double kTarget = kInRate / 50;            // 20 ms of buffered input
+
+    struct resampler_itfe *resampler;
+    ASSERT_EQ(0, create_resampler_with_format(kInRate, kOutRate, 1, RESAMPLER_QUALITY_DEFAULT,
+            AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_FLAG_VARIABLE_RATIO, nullptr, &resampler));
+
+    std::vector<float> fifo(kTarget, 0.25f);            // primed to the target
+    std::vector<float> out(kBlock);
+    double produced = 0.;
+    double integral = 0.;
+    double maxError = 0.;
+    size_t underruns = 0;
+    int32_t ppm = 0;
+    for (size_t b = 0; b < kBlocks; ++b) {
+        // the source produces 10 ms of its own clock, which is kDriftPpm fast
+        produced += kInRate / 100. * (1. + kDriftPpm * 1e-6);
+        const size_t newFrames = (size_t)produced;
+        produced -= newFrames;
+        fifo.insert(fifo.end(), newFrames, 0.25f);
+
+        size_t inCount = fifo.size();
+        size_t outCount = kBlock;
+        EXPECT_EQ(0, resampler->resample_from_input_float(resampler, fifo.data(), &inCount,
+                out.data(), &outCount));
+        fifo.erase(fifo.begin(), fifo.begin() + inCount);
+        if (outCount < kBlock) ++underruns;
+
+        // occupancy counts the input held in the resampler history as well
+        const double occupancy = fifo.size()
+                + (double)resampler->delay_ns(resampler) * kInRate / 1e9;
+        const double error = occupancy - kTarget;
+        if (b >= kBlocks / 2) maxError = std::max(maxError, fabs(error));
+        integral += error;
+        // proportional integral, about critically damped with a 2 second time constant
+        ppm = (int32_t)lround(20. * error + 0.04 * integral);
+        ppm = std::max(-RESAMPLER_RATIO_PPM_MAX, std::min(RESAMPLER_RATIO_PPM_MAX, ppm));
+        ASSERT_EQ(0, resampler->set_ratio_ppm(resampler, ppm));
+    }
+    release_resampler(resampler);
+
+    EXPECT_EQ(0u, underruns);
+    EXPECT_LT(maxError, kInRate / 1000.); // within 1 ms of the target over the last 30 s
+    EXPECT_NEAR(kDriftPpm, ppm, 50.);
+}
+
+// A resampler primed with input already output continues that input seamlessly: its outputs
+// are those of a resampler fed all the input, from the first output of the new input on.
+TEST(resampler, reset_with_history) {
+    constexpr uint32_t kChannels = 2;
+    // rates and a common point of the input and output, where the phase is 0
+    for (const auto &rates : std::vector<std::tuple<uint32_t, uint32_t, size_t, size_t>>{
+            {48000, 48000, 480, 480}, {44100, 48000, 1470, 1600}}) {
+        const uint32_t inRate = std::get<0>(rates), outRate = std::get<1>(rates);
+        const size_t skipIn = std::get<2>(rates), skipOut = std::get<3>(rates);
+        const std::vector<float> in = makeSine(inRate, inRate / 10, kChannels);
+        struct resampler_itfe *resampler;
+        ASSERT_EQ(0, create_resampler_with_format(inRate, outRate, kChannels,
+                RESAMPLER_QUALITY_DEFAULT, AUDIO_FORMAT_PCM_FLOAT, 0 /* flags */,
+                nullptr, &resampler));
+        const std::vector<float> expected =
+                resampleFloat(resampler, in, kChannels, outRate / 5, 441 /* inChunk */);
+
+        EXPECT_EQ(-EINVAL, resampler->reset_with_history_float(resampler, nullptr, 1));
+        ASSERT_EQ(0, resampler->reset_with_history_float(resampler, in.data(), skipIn));
+        EXPECT_EQ(0, resampler->delay_ns(resampler));
+        const std::vector<float> rest(in.begin() + skipIn * kChannels, in.end());
+        const std::vector<float> out =
+                resampleFloat(resampler, rest, kChannels, outRate / 5, 441 /* inChunk */);
+        release_resampler(resampler);
+
+        ASSERT_EQ(expected.size() - skipOut * kChannels, out.size()) << inRate;
+        for (size_t i = 0; i < out.size(); ++i) {
+            ASSERT_NEAR(expected[i + skipOut * kChannels], out[i], 1e-6f) << inRate << " " << i;
+        }
+    }
+}
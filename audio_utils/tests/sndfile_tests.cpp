@@ -0,0 +1,378 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_sndfile_tests"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <audio_utils/sndfile.h>
+#include <gtest/gtest.h>
+
+#include "../private/sndfile_test.h"
+
+static std::string tempPath(const char *name) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == nullptr) {
+#ifdef __ANDROID__
+        dir = "/data/local/tmp";
+#else
+        dir = "/tmp";
+#endif
+    }
+    return std::string(dir) + "/" + name + "_" + std::to_string(getpid()) + ".wav";
+}
+
+static std::vector<uint8_t> readBytes(const std::string &path) {
+    std::vector<uint8_t> bytes;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f != nullptr) {
+        uint8_t buffer[4096];
+        size_t actual;
+        while ((actual = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + actual);
+        }
+        fclose(f);
+    }
+    return bytes;
+}
+
+static void writeBytes(const std::string &path, const std::vector<uint8_t> &bytes) {
+    FILE *f = fopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(1u, fwrite(bytes.data(), bytes.size(), 1, f));
+    fclose(f);
+}
+
+static void write4u(uint8_t *ptr, uint32_t u) {
+    for (int i = 0; i < 4; ++i) ptr[i] = u >> (i * 8);
+}
+
+static void write8u(uint8_t *ptr, uint64_t u) {
+    write4u(ptr, (uint32_t) u);
+    write4u(ptr + 4, (uint32_t) (u >> 32));
+}
+
+// Returns the offset of the first chunk with the given id, or 0 if none.
+static size_t findChunk(const std::vector<uint8_t> &bytes, const char *id) {
+    for (size_t offset = 12; offset + 8 <= bytes.size(); ) {
+        if (!memcmp(&bytes[offset], id, 4)) return offset;
+        offset += 8 + (bytes[offset + 4] | bytes[offset + 5] << 8 |
+                bytes[offset + 6] << 16 | (uint32_t) bytes[offset + 7] << 24);
+    }
+    return 0;
+}
+
+static constexpr int kChannels = 2;
+static constexpr sf_count_t kFrames = 1001;
+
+// Writes a test signal in the given format, and returns the float written.  The stream is
+// opened by sf_open(), or if rf64Threshold is not 0 by sf_open64_for_test().
+static std::vector<float> writeFile(const std::string &path, int format,
+        uint64_t rf64Threshold = 0) {
+    std::vector<float> data(kFrames * kChannels);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = ((int) (i * 7919 % 2001) - 1000) / 1024.f;
+    }
+    SNDFILE *sf;
+    if (rf64Threshold == 0) {
+        SF_INFO info{};
+        info.samplerate = 48000;
+        info.channels = kChannels;
+        info.format = SF_FORMAT_WAV | format;
+        sf = sf_open(path.c_str(), SFM_WRITE, &info);
+    } else {
+        SF_INFO64 info{};
+        info.samplerate = 48000;
+        info.channels = kChannels;
+        info.format = SF_FORMAT_WAV | format;
+        sf = sf_open64_for_test(path.c_str(), SFM_WRITE, &info, rf64Threshold);
+    }
+    EXPECT_NE(nullptr, sf);
+    if (sf == nullptr) return data;
+    if (format == SF_FORMAT_PCM_32) {
+        std::vector<int> ints(data.size());
+        for (size_t i = 0; i < data.size(); ++i) ints[i] = (int) (data[i] * (1 << 30));
+        EXPECT_EQ(kFrames, sf_writef_int(sf, ints.data(), kFrames));
+    } else if (format == SF_FORMAT_PCM_U8) {
+        std::vector<short> shorts(data.size());
+        for (size_t i = 0; i < data.size(); ++i) shorts[i] = (short) (data[i] * (1 << 14));
+        EXPECT_EQ(kFrames, sf_writef_short(sf, shorts.data(), kFrames));
+    } else {
+        EXPECT_EQ(kFrames, sf_writef_float(sf, data.data(), kFrames));
+    }
+    sf_close(sf);
+    return data;
+}
+
+// Reads the whole file in the given mode, in odd sized pieces.
+template <typename T, typename Info, typename Count>
+static std::vector<T> readFile(const std::string &path, int mode,
+        SNDFILE *(*open)(const char *, int, Info *), Count (*readf)(SNDFILE *, T *, Count)) {
+    Info info{};
+    SNDFILE *sf = open(path.c_str(), mode, &info);
+    EXPECT_NE(nullptr, sf);
+    if (sf == nullptr) return {};
+    EXPECT_EQ(kChannels, info.channels);
+    EXPECT_EQ(48000, info.samplerate);
+    std::vector<T> data(info.frames * info.channels);
+    Count read = 0;
+    for (Count actual; (actual = readf(sf, &data[read * info.channels], 97)) > 0; ) {
+        read += actual;
+    }
+    EXPECT_EQ(info.frames, read);
+    sf_close(sf);
+    return data;
+}
+
+template <typename T>
+static std::vector<T> readFile(const std::string &path, int mode,
+        sf_count_t (*readf)(SNDFILE *, T *, sf_count_t)) {
+    return readFile(path, mode, sf_open, readf);
+}
+
+template <typename T>
+static std::vector<T> readFile64(const std::string &path, int mode,
+        sf_count64_t (*readf)(SNDFILE *, T *, sf_count64_t)) {
+    return readFile(path, mode, sf_open64, readf);
+}
+
+template <typename T>
+static void expectSameRead(const std::string &path,
+        sf_count_t (*readf)(SNDFILE *, T *, sf_count_t)) {
+    const std::vector<T> stdio = readFile(path, SFM_READ, readf);
+    const std::vector<T> mapped = readFile(path, SFM_READ_MMAP, readf);
+    EXPECT_EQ(stdio, mapped);
+}
+
+class SndfileTest : public ::testing::TestWithParam<int> {
+protected:
+    void TearDown() override {
+        unlink(mPath.c_str());
+    }
+    const std::string mPath = tempPath("sndfile_tests");
+};
+
+TEST_P(SndfileTest, mmap_matches_stdio) {
+    const int format = GetParam();
+    const std::vector<float> written = writeFile(mPath, format);
+
+    const std::vector<float> read = readFile(mPath, SFM_READ_MMAP, sf_readf_float);
+    ASSERT_EQ(written.size(), read.size());
+    if (format == SF_FORMAT_FLOAT) {
+        EXPECT_EQ(written, read);
+    }
+    expectSameRead(mPath, sf_readf_short);
+    expectSameRead(mPath, sf_readf_float);
+    expectSameRead(mPath, sf_readf_int);
+}
+
+TEST_P(SndfileTest, rf64) {
+    const int format = GetParam();
+    writeFile(mPath, format, 0xFFFFFFFF /* rf64Threshold */);
+    const std::vector<float> riff = readFile64(mPath, SFM_READ, sf_readf_float64);
+    EXPECT_EQ(riff, readFile(mPath, SFM_READ, sf_readf_float));
+
+    // rewrite the header as RF64 and then BW64, using the reserved JUNK for the ds64
+    std::vector<uint8_t> bytes = readBytes(mPath);
+    ASSERT_EQ(0, memcmp(&bytes[12], "JUNK", 4));
+    const uint32_t riffSize = bytes.size() - 8;
+    size_t data = bytes.size() - riff.size() / kChannels * (bytes[48 + 20] /* blockAlign */) - 8;
+    ASSERT_EQ(0, memcmp(&bytes[data], "data", 4));
+    const uint32_t dataSize = bytes[data + 4] | bytes[data + 5] << 8 |
+            bytes[data + 6] << 16 | bytes[data + 7] << 24;
+    memcpy(&bytes[0], "RF64", 4);
+    write4u(&bytes[4], 0xFFFFFFFF);
+    memcpy(&bytes[12], "ds64", 4);
+    write8u(&bytes[20], riffSize);
+    write8u(&bytes[28], dataSize);
+    write8u(&bytes[36], kFrames);
+    write4u(&bytes[data + 4], 0xFFFFFFFF);
+    for (const char *magic : {"RF64", "BW64"}) {
+        memcpy(&bytes[0], magic, 4);
+        writeBytes(mPath, bytes);
+        EXPECT_EQ(riff, readFile64(mPath, SFM_READ, sf_readf_float64)) << magic;
+        EXPECT_EQ(riff, readFile64(mPath, SFM_READ_MMAP, sf_readf_float64)) << magic;
+        // only sf_open64() reads RF64 and BW64
+        SF_INFO info{};
+        EXPECT_EQ(nullptr, sf_open(mPath.c_str(), SFM_READ, &info)) << magic;
+    }
+
+    // RF64 requires the ds64 to be first
+    memcpy(&bytes[12], "JUNK", 4);
+    writeBytes(mPath, bytes);
+    SF_INFO64 info{};
+    EXPECT_EQ(nullptr, sf_open64(mPath.c_str(), SFM_READ, &info));
+}
+
+static uint32_t little4u(const uint8_t *ptr) {
+    return ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (uint32_t) ptr[3] << 24;
+}
+
+static uint64_t little8u(const uint8_t *ptr) {
+    return little4u(ptr) | (uint64_t) little4u(ptr + 4) << 32;
+}
+
+// sf_close() upgrades the header to RF64 from a threshold lowered for the test, rather than
+// after 4 GiB of data.
+TEST_P(SndfileTest, rf64_write) {
+    const int format = GetParam();
+    writeFile(mPath, format);
+    const std::vector<float> riff = readFile(mPath, SFM_READ, sf_readf_float);
+    // sf_open() reserves no space for a ds64
+    EXPECT_EQ(0u, findChunk(readBytes(mPath), "JUNK"));
+
+    writeFile(mPath, format, 1 /* rf64Threshold */);
+    const std::vector<uint8_t> bytes = readBytes(mPath);
+    ASSERT_LT(48u, bytes.size());
+    EXPECT_EQ(0, memcmp(&bytes[0], "RF64", 4));
+    EXPECT_EQ(0xFFFFFFFFu, little4u(&bytes[4]));
+    ASSERT_EQ(0, memcmp(&bytes[12], "ds64", 4));
+    EXPECT_EQ(28u, little4u(&bytes[16]));
+    const size_t fmt = findChunk(bytes, "fmt ");
+    ASSERT_NE(0u, fmt);
+    const uint32_t blockAlign = bytes[fmt + 20] | bytes[fmt + 21] << 8;
+    const size_t data = findChunk(bytes, "data");
+    ASSERT_NE(0u, data);
+    EXPECT_EQ(0xFFFFFFFFu, little4u(&bytes[data + 4]));
+    // the ds64 riff, data and sample sizes
+    EXPECT_EQ(bytes.size() - 8, little8u(&bytes[20]));
+    EXPECT_EQ((uint64_t) kFrames * blockAlign, little8u(&bytes[28]));
+    EXPECT_EQ(bytes.size() - data - 8, little8u(&bytes[28]));
+    EXPECT_EQ((uint64_t) kFrames, little8u(&bytes[36]));
+
+    EXPECT_EQ(riff, readFile64(mPath, SFM_READ, sf_readf_float64));
+    EXPECT_EQ(riff, readFile64(mPath, SFM_READ_MMAP, sf_readf_float64));
+}
+
+TEST_P(SndfileTest, write_conversions) {
+    const int format = GetParam();
+    std::vector<float> data(kFrames * kChannels);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = ((int) (i * 7919 % 2001) - 1000) / 1024.f;
+    }
+    std::vector<short> shorts(data.size());
+    memcpy_to_i16_from_float(shorts.data(), data.data(), data.size());
+    std::vector<int> ints(data.size());
+    memcpy_to_i32_from_float(ints.data(), data.data(), data.size());
+
+    // the same data as float, short or int is written the same way, at the precision of both
+    std::vector<float> read[3];
+    for (int i = 0; i < 3; ++i) {
+        SF_INFO info{};
+        info.samplerate = 48000;
+        info.channels = kChannels;
+        info.format = SF_FORMAT_WAV | format;
+        SNDFILE *sf = sf_open(mPath.c_str(), SFM_WRITE, &info);
+        ASSERT_NE(nullptr, sf);
+        ASSERT_EQ(kFrames, i == 0 ? sf_writef_float(sf, data.data(), kFrames)
+                : i == 1 ? sf_writef_short(sf, shorts.data(), kFrames)
+                : sf_writef_int(sf, ints.data(), kFrames));
+        sf_close(sf);
+        read[i] = readFile(mPath, SFM_READ, sf_readf_float);
+        ASSERT_EQ(data.size(), read[i].size());
+    }
+    const bool narrow = format == SF_FORMAT_PCM_16 || format == SF_FORMAT_PCM_U8;
+    for (size_t j = 0; j < data.size(); ++j) {
+        // the conversions to u8 round differently
+        const float lsb = format == SF_FORMAT_PCM_U8 ? 1.f / (1 << 7) : 0;
+        ASSERT_NEAR(read[0][j], read[1][j], narrow ? lsb : 1.f / (1 << 15)) << j;
+        ASSERT_NEAR(read[0][j], read[2][j], narrow ? lsb : 1e-6f) << j;
+    }
+}
+
+TEST_P(SndfileTest, truncated) {
+    writeFile(mPath, GetParam());
+    std::vector<uint8_t> bytes = readBytes(mPath);
+    bytes.resize(bytes.size() - 100);
+    writeBytes(mPath, bytes);
+
+    // the mapping would extend past the end of the file, so stdio is used instead
+    SF_INFO info{};
+    SNDFILE *sf = sf_open(mPath.c_str(), SFM_READ_MMAP, &info);
+    ASSERT_NE(nullptr, sf);
+    std::vector<float> data(info.frames * info.channels);
+    EXPECT_GT(info.frames, sf_readf_float(sf, data.data(), info.frames));
+    sf_close(sf);
+}
+
+INSTANTIATE_TEST_CASE_P(
+        SndfileTestAll, SndfileTest,
+        ::testing::Values(SF_FORMAT_PCM_U8, SF_FORMAT_PCM_16, SF_FORMAT_FLOAT, SF_FORMAT_PCM_24,
+                SF_FORMAT_PCM_32));
+
+// Extensible multichannel files, written across several flushes of the write buffer.
+TEST(sndfile, extensible) {
+    const std::string path = tempPath("sndfile_tests_extensible");
+    for (int mode : {SFM_WRITE, SFM_WRITE_DIRECT}) {
+        for (int channels : {6, 32}) {
+            for (int format : {SF_FORMAT_FLOAT, SF_FORMAT_PCM_24}) {
+                constexpr sf_count_t frames = 10007;
+                std::vector<float> data(frames * channels);
+                for (size_t i = 0; i < data.size(); ++i) {
+                    data[i] = ((int) (i * 7919 % 2001) - 1000) / 1024.f;
+                }
+                SF_INFO info{};
+                info.samplerate = 48000;
+                info.channels = channels;
+                info.format = SF_FORMAT_WAV | format;
+                SNDFILE *sf = sf_open(path.c_str(), mode, &info);
+                ASSERT_NE(nullptr, sf);
+                // 5.1 by default, and unassigned beyond the standard layouts
+                EXPECT_EQ(channels == 6 ? 0x3Fu : 0u, sf_get_channel_mask(sf));
+                if (channels == 32) {
+                    EXPECT_EQ(0, sf_set_channel_mask(sf, 0x3F));
+                }
+                for (sf_count_t written = 0; written < frames; ) {
+                    const sf_count_t n = std::min<sf_count_t>(frames - written, 1000);
+                    ASSERT_EQ(n, sf_writef_float(sf, &data[written * channels], n));
+                    written += n;
+                }
+                sf_close(sf);
+
+                const std::vector<uint8_t> bytes = readBytes(path);
+                const size_t fmt = findChunk(bytes, "fmt ");
+                ASSERT_NE(0u, fmt);
+                EXPECT_EQ(0xFFFE, bytes[fmt + 8] | bytes[fmt + 9] << 8);
+                if (mode == SFM_WRITE_DIRECT) {
+                    // the data is aligned, even if the file system did not support O_DIRECT
+                    EXPECT_EQ(4096u - 8, findChunk(bytes, "data"));
+                }
+
+                sf = sf_open(path.c_str(), SFM_READ, &info);
+                ASSERT_NE(nullptr, sf);
+                EXPECT_EQ(channels, info.channels);
+                EXPECT_EQ(frames, info.frames);
+                EXPECT_EQ(format, info.format & SF_FORMAT_SUBMASK);
+                EXPECT_EQ(0x3Fu, sf_get_channel_mask(sf));
+                std::vector<float> read(data.size());
+                EXPECT_EQ(frames, sf_readf_float(sf, read.data(), frames));
+                sf_close(sf);
+                for (size_t i = 0; i < data.size(); ++i) {
+                    ASSERT_NEAR(data[i], read[i], format == SF_FORMAT_FLOAT ? 0 : 1e-6f) << i;
+                }
+            }
+        }
+    }
+    unlink(path.c_str());
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/stft.h>
+
+// 10 ms at 48 kHz
+static constexpr size_t kBufferFrames = 480;
+
+static void passThrough(void *, uint32_t, float *spectrum, size_t) {
+    benchmark::DoNotOptimize(spectrum);
+}
+
+/*
+On a host x86-64, medians of 15 interleaved repetitions; an iteration is one buffer of
+480 frames (10 ms at 48 kHz). The arguments are the frame size, the hop size, the channel
+count and whether the output is resynthesized.
+About half of the time is the inverse transforms, and the cost per buffer grows only with
+the log of the frame size at a given overlap.
+-------------------------------------------------------------------------------------------------
+Benchmark                                                        Time             CPU   Iterations
+-------------------------------------------------------------------------------------------------
+BM_Stft/frame:512/hop:256/channels:1/synthesis:1_median         6613 ns         6595 ns         15
+BM_Stft/frame:512/hop:128/channels:1/synthesis:1_median        12628 ns        12506 ns         15
+BM_Stft/frame:512/hop:128/channels:2/synthesis:1_median        26321 ns        26100 ns         15
+BM_Stft/frame:512/hop:128/channels:1/synthesis:0_median         6827 ns         6806 ns         15
+BM_Stft/frame:1024/hop:512/channels:1/synthesis:1_median        7057 ns         7025 ns         15
+BM_Stft/frame:1024/hop:256/channels:1/synthesis:1_median       13950 ns        13789 ns         15
+BM_Stft/frame:1024/hop:256/channels:2/synthesis:1_median       28615 ns        28353 ns         15
+BM_Stft/frame:1024/hop:256/channels:1/synthesis:0_median        8200 ns         8124 ns         15
+BM_Stft/frame:2048/hop:1024/channels:1/synthesis:1_median       8109 ns         8079 ns         15
+BM_Stft/frame:2048/hop:512/channels:1/synthesis:1_median       14533 ns        14086 ns         15
+BM_Stft/frame:2048/hop:512/channels:2/synthesis:1_median       33434 ns        33147 ns         15
+BM_Stft/frame:2048/hop:512/channels:1/synthesis:0_median        7380 ns         7297 ns         15
+*/
+
+static void BM_Stft(benchmark::State& state) {
+    const size_t frameSize = state.range(0);
+    const size_t hopSize = state.range(1);
+    const uint32_t channels = state.range(2);
+    const bool synthesize = state.range(3);
+    struct stft *stft;
+    if (create_stft(frameSize, hopSize, channels, passThrough, NULL, &stft) != 0) {
+        state.SkipWithError("create_stft failed");
+        return;
+    }
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    std::vector<float> in(kBufferFrames * channels);
+    for (auto &sample : in) {
+        sample = dis(gen);
+    }
+    std::vector<float> out(kBufferFrames * channels);
+    for (auto _ : state) {
+        stft_process(stft, in.data(), synthesize ? out.data() : NULL, kBufferFrames);
+        benchmark::ClobberMemory();
+    }
+    release_stft(stft);
+}
+
+static void StftArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"frame", "hop", "channels", "synthesis"});
+    for (int frameSize : {512, 1024, 2048}) {
+        b->Args({frameSize, frameSize / 2, 1, 1});
+        b->Args({frameSize, frameSize / 4, 1, 1});
+        b->Args({frameSize, frameSize / 4, 2, 1});
+        b->Args({frameSize, frameSize / 4, 1, 0});
+    }
+}
+
+BENCHMARK(BM_Stft)->Apply(StftArgs);
+
+BENCHMARK_MAIN();
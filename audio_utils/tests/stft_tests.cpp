@@ -0,0 +1,172 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <audio_utils/fft.h>
+#include <audio_utils/stft.h>
+
+static std::vector<float> makeNoise(size_t count) {
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.f, 1.f);
+    std::vector<float> noise(count);
+    for (auto &sample : noise) {
+        sample = dis(gen);
+    }
+    return noise;
+}
+
+static void passThrough(void *, uint32_t, float *, size_t) {
+}
+
+// Processes the input in chunks of the given sizes, repeated, and returns the output.
+static std::vector<float> process(struct stft *stft, const std::vector<float> &in,
+        uint32_t channels, const std::vector<size_t> &chunks) {
+    std::vector<float> out(in.size());
+    const size_t frames = in.size() / channels;
+    for (size_t i = 0, done = 0; done < frames; ++i) {
+        const size_t count = std::min(chunks[i % chunks.size()], frames - done);
+        stft_process(stft, &in[done * channels], &out[done * channels], count);
+        done += count;
+    }
+    return out;
+}
+
+TEST(audio_utils_stft, create) {
+    struct stft *stft;
+    EXPECT_EQ(-EINVAL, create_stft(1000, 250, 1, passThrough, NULL, &stft));
+    EXPECT_EQ(-EINVAL, create_stft(FFT_SIZE_MAX * 2, 1024, 1, passThrough, NULL, &stft));
+    EXPECT_EQ(-EINVAL, create_stft(1024, 1024, 1, passThrough, NULL, &stft));
+    EXPECT_EQ(-EINVAL, create_stft(1024, 384, 1, passThrough, NULL, &stft));
+    EXPECT_EQ(-EINVAL, create_stft(1024, 0, 1, passThrough, NULL, &stft));
+    EXPECT_EQ(-EINVAL, create_stft(1024, 512, 0, passThrough, NULL, &stft));
+    EXPECT_EQ(-EINVAL, create_stft(1024, 512, 1, NULL, NULL, &stft));
+    ASSERT_EQ(0, create_stft(1024, 256, 2, passThrough, NULL, &stft));
+    EXPECT_EQ(1024u, stft_latency(stft));
+    release_stft(stft);
+}
+
+// An unmodified spectrum resynthesizes the input delayed by the latency, from the start.
+TEST(audio_utils_stft, identity) {
+    for (size_t frameSize : {4, 512, 1024, 2048}) {
+        for (size_t hopDivisor : {2, 4}) {
+            for (uint32_t channels : {1, 2}) {
+                struct stft *stft;
+                ASSERT_EQ(0, create_stft(frameSize, frameSize / hopDivisor, channels,
+                        passThrough, NULL, &stft));
+                const size_t frames = 4 * frameSize + 123;
+                const std::vector<float> in = makeNoise(frames * channels);
+                const std::vector<float> out = process(stft, in, channels, {480});
+                const size_t latency = stft_latency(stft);
+                float error = 0.f;
+                for (size_t i = 0; i < frames * channels; ++i) {
+                    const float expected = i < latency * channels ? 0.f
+                            : in[i - latency * channels];
+                    error = std::max(error, fabsf(out[i] - expected));
+                }
+                EXPECT_LT(error, 1e-5f) << frameSize << " / " << hopDivisor << " " << channels;
+                release_stft(stft);
+            }
+        }
+    }
+}
+
+// The output does not depend on how the input is split, nor on whether it is in place.
+TEST(audio_utils_stft, chunks) {
+    constexpr uint32_t kChannels = 2;
+    const std::vector<float> in = makeNoise(10000 * kChannels);
+    struct stft *stft;
+    ASSERT_EQ(0, create_stft(512, 128, kChannels, passThrough, NULL, &stft));
+    const std::vector<float> expected = process(stft, in, kChannels, {in.size()});
+    for (const auto &chunks : std::vector<std::vector<size_t>>{{1}, {7, 128, 1000}, {480}}) {
+        stft_reset(stft);
+        EXPECT_EQ(expected, process(stft, in, kChannels, chunks)) << chunks[0];
+    }
+    stft_reset(stft);
+    std::vector<float> buffer = in;
+    stft_process(stft, buffer.data(), buffer.data(), buffer.size() / kChannels);
+    EXPECT_EQ(expected, buffer);
+    release_stft(stft);
+}
+
+struct Analysis {
+    size_t frameSize;
+    std::vector<size_t> calls;      // per channel
+    std::vector<size_t> peakBins;   // per channel, of the last frame
+    float gain;                     // applied to the spectrum
+};
+
+static void analyze(void *cookie, uint32_t channel, float *spectrum, size_t frameSize) {
+    Analysis *analysis = (Analysis *)cookie;
+    EXPECT_EQ(analysis->frameSize, frameSize);
+    ++analysis->calls[channel];
+    size_t peak = 0;
+    float peakMagnitude = 0.f;
+    for (size_t k = 1; k < frameSize / 2; ++k) {
+        const float magnitude = hypotf(spectrum[2 * k], spectrum[2 * k + 1]);
+        if (magnitude > peakMagnitude) {
+            peakMagnitude = magnitude;
+            peak = k;
+        }
+    }
+    analysis->peakBins[channel] = peak;
+    for (size_t i = 0; i < frameSize; ++i) {
+        spectrum[i] *= analysis->gain;
+    }
+}
+
+TEST(audio_utils_stft, callback) {
+    constexpr size_t kFrameSize = 1024;
+    constexpr size_t kHopSize = 256;
+    constexpr size_t kFrames = 48000;
+    constexpr uint32_t kChannels = 2;
+    constexpr size_t kBins[kChannels] = {50, 200};
+    Analysis analysis{kFrameSize, std::vector<size_t>(kChannels),
+            std::vector<size_t>(kChannels), 0.5f};
+    struct stft *stft;
+    ASSERT_EQ(0, create_stft(kFrameSize, kHopSize, kChannels, analyze, &analysis, &stft));
+
+    std::vector<float> in(kFrames * kChannels);
+    for (size_t i = 0; i < kFrames; ++i) {
+        for (uint32_t c = 0; c < kChannels; ++c) {
+            in[i * kChannels + c] = sin(2. * M_PI * kBins[c] * i / kFrameSize);
+        }
+    }
+    const std::vector<float> out = process(stft, in, kChannels, {441});
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        EXPECT_EQ(kFrames / kHopSize, analysis.calls[c]);
+        EXPECT_EQ(kBins[c], analysis.peakBins[c]);
+    }
+    for (size_t i = kFrameSize * kChannels; i < in.size(); ++i) {
+        ASSERT_NEAR(0.5f * in[i - kFrameSize * kChannels], out[i], 1e-5f) << i;
+    }
+
+    // analysis only
+    stft_reset(stft);
+    analysis.calls.assign(kChannels, 0);
+    stft_process(stft, in.data(), NULL, kFrames);
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        EXPECT_EQ(kFrames / kHopSize, analysis.calls[c]);
+        EXPECT_EQ(kBins[c], analysis.peakBins[c]);
+    }
+    release_stft(stft);
+}
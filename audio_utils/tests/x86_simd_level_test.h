@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_UTILS_TESTS_X86_SIMD_LEVEL_TEST_H
+#define ANDROID_AUDIO_UTILS_TESTS_X86_SIMD_LEVEL_TEST_H
+
+#include <gtest/gtest.h>
+
+#include "../private/x86_simd.h"
+
+// A test fixture run at each x86 vector kernel level, so that on an AVX2 host the SSE
+// fallbacks and the scalar code are covered too.  Instantiate with X86_SIMD_LEVELS.
+class X86SimdLevelTest : public ::testing::TestWithParam<audio_utils_x86_simd_level_t> {
+protected:
+    void SetUp() override {
+        mPrevious = audio_utils_set_x86_simd_level_for_test(GetParam());
+    }
+
+    void TearDown() override {
+        if (mPrevious >= 0) {
+            audio_utils_set_x86_simd_level_for_test((audio_utils_x86_simd_level_t) mPrevious);
+        }
+    }
+
+private:
+    int mPrevious = -1;
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define X86_SIMD_LEVELS ::testing::Values(AUDIO_UTILS_X86_SIMD_AVX2, AUDIO_UTILS_X86_SIMD_SSE, \
+        AUDIO_UTILS_X86_SIMD_NONE)
+#else
+// there is only the default level
+#define X86_SIMD_LEVELS ::testing::Values(AUDIO_UTILS_X86_SIMD_AVX2)
+#endif
+
+#endif // ANDROID_AUDIO_UTILS_TESTS_X86_SIMD_LEVEL_TEST_H
@@ -14,26 +14,72 @@
  * limitations under the License.
  */
 
+// off_t, fseeko() and ftello() are 64 bits even on 32-bit targets, for RF64 files
+#define _FILE_OFFSET_BITS 64
+// O_DIRECT for glibc hosts
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <system/audio.h>
 #include <audio_utils/sndfile.h>
+#include <audio_utils/format.h>
 #include <audio_utils/primitives.h>
+#include "private/sndfile_test.h"
 #ifdef HAVE_STDERR
 #include <stdio.h>
 #endif
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define WAVE_FORMAT_PCM         1
 #define WAVE_FORMAT_IEEE_FLOAT  3
 #define WAVE_FORMAT_EXTENSIBLE  0xFFFE
 
+// EBU Tech 3306 RF64 and ITU-R BS.2088 BW64: a 32-bit size of 0xFFFFFFFF defers to ds64
+#define RIFF_SIZE_IN_DS64       0xFFFFFFFFu
+#define DS64_SIZE               28
+
+#define SF_CHANNELS_MAX         32
+
+// The rf64Threshold of streams opened by sf_open(), which are only ever RIFF
+#define SF_RF64_NEVER           UINT64_MAX
+
+// Frames are converted directly into a write buffer of this size.  SFM_WRITE_DIRECT aligns
+// both the buffer and the writes to the file to SF_DIRECT_ALIGNMENT.
+#define SF_WRITE_BUFFER_BYTES   (1 << 20)
+#define SF_DIRECT_ALIGNMENT     4096
+
 struct SNDFILE_ {
     int mode;
-    uint8_t *temp;  // realloc buffer used for shrinking 16 bits to 8 bits and byte-swapping
+    uint8_t *temp;  // realloc buffer used for format conversion and byte-swapping on read
     FILE *stream;
     size_t bytesPerFrame;
-    size_t remaining;   // frames unread for SFM_READ, frames written for SFM_WRITE
-    SF_INFO info;
+    uint64_t remaining; // frames unread for SFM_READ, frames written for SFM_WRITE
+    SF_INFO64 info;
+    // SFM_READ_MMAP only, otherwise NULL
+    void *map;          // read-only mapping of the file up to the end of the data chunk
+    size_t mapLength;
+    const uint8_t *mapPosition; // next unread frame within the mapping
+    uint32_t channelMask;   // WAVE_FORMAT_EXTENSIBLE dwChannelMask, or 0
+    // SFM_WRITE and SFM_WRITE_DIRECT only
+    int fd;
+    uint8_t *header;    // up to and including the data chunk header, patched by sf_close()
+    size_t headerSize;
+    size_t factOffset;  // of the fact chunk, or 0 if none
+    size_t maskOffset;  // of the extensible fmt dwChannelMask, or 0 if none
+    uint8_t *buffer;    // header and then converted frames not yet written
+    size_t bufferFill;  // bytes used in buffer
+    size_t alignment;   // of writes to fd, SF_DIRECT_ALIGNMENT for O_DIRECT or else 1
+    uint64_t written;   // bytes written to fd, including the header
+    uint64_t rf64Threshold; // RIFF size from which sf_close() writes RF64, or SF_RF64_NEVER
+    int error;          // a write failed, so no more are attempted
 };
 
 static unsigned little2u(unsigned char *ptr)
@@ -43,7 +89,12 @@ static unsigned little2u(unsigned char *ptr)
 
 static unsigned little4u(unsigned char *ptr)
 {
-    return (ptr[3] << 24) + (ptr[2] << 16) + (ptr[1] << 8) + ptr[0];
+    return ((unsigned) ptr[3] << 24) + (ptr[2] << 16) + (ptr[1] << 8) + ptr[0];
+}
+
+static uint64_t little8u(unsigned char *ptr)
+{
+    return ((uint64_t) little4u(&ptr[4]) << 32) + little4u(ptr);
 }
 
 static int isLittleEndian(void)
@@ -62,7 +113,33 @@ static void my_swab(short *ptr, size_t numToSwap)
     }
 }
 
-static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
+// Maps the file through the end of the data chunk, which starts at dataTell.  Leaves the
+// stdio path in place if the data is empty or truncated, too large for the address space,
+// or the samples in the mapping would not be naturally aligned.
+static void sf_map(SNDFILE *handle, off_t dataTell)
+{
+    uint64_t length = (uint64_t) dataTell + handle->remaining * handle->bytesPerFrame;
+    size_t sampleSize = handle->bytesPerFrame / handle->info.channels;
+    size_t alignment = sampleSize == 3 ? 1 : sampleSize;
+    struct stat st;
+    if (handle->remaining == 0 || length > SIZE_MAX || dataTell % alignment != 0 ||
+            fstat(fileno(handle->stream), &st) != 0 || (uint64_t) st.st_size < length) {
+        return;
+    }
+    void *map = mmap(NULL, (size_t) length, PROT_READ, MAP_PRIVATE, fileno(handle->stream), 0);
+    if (map == MAP_FAILED) {
+#ifdef HAVE_STDERR
+        fprintf(stderr, "mmap failed errno %d, reading through stdio\n", errno);
+#endif
+        return;
+    }
+    (void) madvise(map, (size_t) length, MADV_SEQUENTIAL);
+    handle->map = map;
+    handle->mapLength = (size_t) length;
+    handle->mapPosition = (const uint8_t *) map + dataTell;
+}
+
+static SNDFILE *sf_open_read(const char *path, SF_INFO64 *info, int mmap_, int rf64Allowed)
 {
     FILE *stream = fopen(path, "rb");
     if (stream == NULL) {
@@ -72,7 +149,7 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
         return NULL;
     }
 
-    SNDFILE *handle = (SNDFILE *) malloc(sizeof(SNDFILE));
+    SNDFILE *handle = (SNDFILE *) calloc(1, sizeof(SNDFILE));
     handle->mode = SFM_READ;
     handle->temp = NULL;
     handle->stream = stream;
@@ -88,16 +165,24 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
 #endif
         goto close;
     }
-    if (memcmp(wav, "RIFF", 4)) {
+    // RF64 and BW64 have the same layout, with the 64-bit sizes in a leading ds64 chunk
+    int rf64 = !memcmp(wav, "RF64", 4) || !memcmp(wav, "BW64", 4);
+    if (!rf64 && memcmp(wav, "RIFF", 4)) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "wav != RIFF\n");
+        fprintf(stderr, "wav != RIFF or RF64 or BW64\n");
 #endif
         goto close;
     }
-    unsigned riffSize = little4u(&wav[4]);
+    if (rf64 && !rf64Allowed) {
+#ifdef HAVE_STDERR
+        fprintf(stderr, "RF64 and BW64 need sf_open64\n");
+#endif
+        goto close;
+    }
+    uint64_t riffSize = little4u(&wav[4]);
     if (riffSize < 4) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "riffSize %u < 4\n", riffSize);
+        fprintf(stderr, "riffSize %llu < 4\n", (unsigned long long) riffSize);
 #endif
         goto close;
     }
@@ -107,10 +192,12 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
 #endif
         goto close;
     }
-    size_t remaining = riffSize - 4;
+    uint64_t remaining = riffSize - 4;
+    int hadDs64 = 0;
+    uint64_t ds64DataSize = 0;
     int hadFmt = 0;
     int hadData = 0;
-    long dataTell = 0L;
+    off_t dataTell = 0;
     while (remaining >= 8) {
         unsigned char chunk[8];
         actual = fread(chunk, sizeof(char), sizeof(chunk), stream);
@@ -121,10 +208,50 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             goto close;
         }
         remaining -= 8;
-        unsigned chunkSize = little4u(&chunk[4]);
+        uint64_t chunkSize = little4u(&chunk[4]);
+        if (rf64 && !hadDs64) {
+            if (memcmp(&chunk[0], "ds64", 4) || chunkSize < DS64_SIZE) {
+#ifdef HAVE_STDERR
+                fprintf(stderr, "RF64 missing ds64\n");
+#endif
+                goto close;
+            }
+            unsigned char ds64[DS64_SIZE];
+            actual = fread(ds64, sizeof(char), sizeof(ds64), stream);
+            if (actual != sizeof(ds64)) {
+#ifdef HAVE_STDERR
+                fprintf(stderr, "actual %zu != %zu\n", actual, sizeof(ds64));
+#endif
+                goto close;
+            }
+            // ignore sample count, which is redundant for PCM, and the table of other sizes
+            if (chunkSize > DS64_SIZE) {
+                fseeko(stream, (off_t) (chunkSize - DS64_SIZE), SEEK_CUR);
+            }
+            if (riffSize == RIFF_SIZE_IN_DS64) {
+                riffSize = little8u(&ds64[0]);
+                if (riffSize < 4 + 8 + chunkSize) {
+#ifdef HAVE_STDERR
+                    fprintf(stderr, "ds64 riffSize %llu too small\n",
+                            (unsigned long long) riffSize);
+#endif
+                    goto close;
+                }
+                remaining = riffSize - 4 - 8 - chunkSize;
+            } else {
+                remaining -= chunkSize;
+            }
+            ds64DataSize = little8u(&ds64[8]);
+            hadDs64 = 1;
+            continue;
+        }
+        if (hadDs64 && chunkSize == RIFF_SIZE_IN_DS64 && !memcmp(&chunk[0], "data", 4)) {
+            chunkSize = ds64DataSize;
+        }
         if (chunkSize > remaining) {
 #ifdef HAVE_STDERR
-            fprintf(stderr, "chunkSize %u > remaining %zu\n", chunkSize, remaining);
+            fprintf(stderr, "chunkSize %llu > remaining %llu\n",
+                    (unsigned long long) chunkSize, (unsigned long long) remaining);
 #endif
             goto close;
         }
@@ -137,7 +264,7 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             }
             if (chunkSize < 2) {
 #ifdef HAVE_STDERR
-                fprintf(stderr, "chunkSize %u < 2\n", chunkSize);
+                fprintf(stderr, "chunkSize %llu < 2\n", (unsigned long long) chunkSize);
 #endif
                 goto close;
             }
@@ -167,22 +294,23 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             }
             if (chunkSize < minSize) {
 #ifdef HAVE_STDERR
-                fprintf(stderr, "chunkSize %u < minSize %zu\n", chunkSize, minSize);
+                fprintf(stderr, "chunkSize %llu < minSize %zu\n",
+                        (unsigned long long) chunkSize, minSize);
 #endif
                 goto close;
             }
             actual = fread(&fmt[2], sizeof(char), minSize - 2, stream);
             if (actual != minSize - 2) {
 #ifdef HAVE_STDERR
-                fprintf(stderr, "actual %zu != %zu\n", actual, minSize - 16);
+                fprintf(stderr, "actual %zu != %zu\n", actual, minSize - 2);
 #endif
                 goto close;
             }
             if (chunkSize > minSize) {
-                fseek(stream, (long) (chunkSize - minSize), SEEK_CUR);
+                fseeko(stream, (off_t) (chunkSize - minSize), SEEK_CUR);
             }
             unsigned channels = little2u(&fmt[2]);
-            if ((channels < 1) || (channels > FCC_8)) {
+            if ((channels < 1) || (channels > SF_CHANNELS_MAX)) {
 #ifdef HAVE_STDERR
                 fprintf(stderr, "unsupported channels %u\n", channels);
 #endif
@@ -205,6 +333,18 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
 #endif
                 goto close;
             }
+            if (format == WAVE_FORMAT_EXTENSIBLE) {
+                // valid bits per sample are ignored, the samples are used as a whole
+                handle->channelMask = little4u(&fmt[20]);
+                // the sub-format GUID starts with the format code
+                format = little2u(&fmt[24]);
+                if (format != WAVE_FORMAT_PCM && format != WAVE_FORMAT_IEEE_FLOAT) {
+#ifdef HAVE_STDERR
+                    fprintf(stderr, "unsupported extensible sub-format %u\n", format);
+#endif
+                    goto close;
+                }
+            }
             unsigned bytesPerFrame = (bitsPerSample >> 3) * channels;
             handle->bytesPerFrame = bytesPerFrame;
             handle->info.samplerate = samplerate;
@@ -242,15 +382,15 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             }
             handle->remaining = chunkSize / handle->bytesPerFrame;
             handle->info.frames = handle->remaining;
-            dataTell = ftell(stream);
+            dataTell = ftello(stream);
             if (chunkSize > 0) {
-                fseek(stream, (long) chunkSize, SEEK_CUR);
+                fseeko(stream, (off_t) chunkSize, SEEK_CUR);
             }
             hadData = 1;
-        } else if (!memcmp(&chunk[0], "fact", 4)) {
-            // ignore fact
+        } else if (!memcmp(&chunk[0], "fact", 4) || !memcmp(&chunk[0], "JUNK", 4)) {
+            // ignore fact, and JUNK which may be space reserved for a ds64
             if (chunkSize > 0) {
-                fseek(stream, (long) chunkSize, SEEK_CUR);
+                fseeko(stream, (off_t) chunkSize, SEEK_CUR);
             }
         } else {
             // ignore unknown chunk
@@ -259,14 +399,15 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
                     chunk[0], chunk[1], chunk[2], chunk[3]);
 #endif
             if (chunkSize > 0) {
-                fseek(stream, (long) chunkSize, SEEK_CUR);
+                fseeko(stream, (off_t) chunkSize, SEEK_CUR);
             }
         }
         remaining -= chunkSize;
     }
     if (remaining > 0) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "partial chunk at end of RIFF, remaining %zu\n", remaining);
+        fprintf(stderr, "partial chunk at end of RIFF, remaining %llu\n",
+                (unsigned long long) remaining);
 #endif
         goto close;
     }
@@ -276,7 +417,10 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
 #endif
         goto close;
     }
-    (void) fseek(stream, dataTell, SEEK_SET);
+    (void) fseeko(stream, dataTell, SEEK_SET);
+    if (mmap_) {
+        sf_map(handle, dataTell);
+    }
     *info = handle->info;
     return handle;
 
@@ -286,6 +430,12 @@ close:
     return NULL;
 }
 
+static void write2u(unsigned char *ptr, unsigned u)
+{
+    ptr[0] = u;
+    ptr[1] = u >> 8;
+}
+
 static void write4u(unsigned char *ptr, unsigned u)
 {
     ptr[0] = u;
@@ -294,40 +444,54 @@ static void write4u(unsigned char *ptr, unsigned u)
     ptr[3] = u >> 24;
 }
 
-static SNDFILE *sf_open_write(const char *path, SF_INFO *info)
+static void write8u(unsigned char *ptr, uint64_t u)
+{
+    write4u(ptr, (unsigned) u);
+    write4u(&ptr[4], (unsigned) (u >> 32));
+}
+
+static SNDFILE *sf_open_write(const char *path, const SF_INFO64 *info, int direct,
+        uint64_t rf64Threshold)
 {
     int sub = info->format & SF_FORMAT_SUBMASK;
     if (!(
             (info->samplerate > 0) &&
-            (info->channels > 0 && info->channels <= FCC_8) &&
+            (info->channels > 0 && info->channels <= SF_CHANNELS_MAX) &&
             ((info->format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV) &&
             (sub == SF_FORMAT_PCM_16 || sub == SF_FORMAT_PCM_U8 || sub == SF_FORMAT_FLOAT ||
                 sub == SF_FORMAT_PCM_24 || sub == SF_FORMAT_PCM_32)
           )) {
         return NULL;
     }
-    FILE *stream = fopen(path, "w+b");
-    if (stream == NULL) {
+    int fd = -1;
+    size_t alignment = 1;
+#ifdef O_DIRECT
+    if (direct) {
+        // not all file systems support O_DIRECT, in which case writes are buffered as usual
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+        if (fd >= 0) {
+            alignment = SF_DIRECT_ALIGNMENT;
+        }
+    }
+#endif
+    if (fd < 0) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    if (fd < 0) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "fopen %s failed errno %d\n", path, errno);
+        fprintf(stderr, "open %s failed errno %d\n", path, errno);
 #endif
         return NULL;
     }
-    unsigned char wav[58];
-    memset(wav, 0, sizeof(wav));
-    memcpy(wav, "RIFF", 4);
-    memcpy(&wav[8], "WAVEfmt ", 8);
-    if (sub == SF_FORMAT_FLOAT) {
-        wav[4] = 50;    // riffSize
-        wav[16] = 18;   // fmtSize
-        wav[20] = WAVE_FORMAT_IEEE_FLOAT;
-    } else {
-        wav[4] = 36;    // riffSize
-        wav[16] = 16;   // fmtSize
-        wav[20] = WAVE_FORMAT_PCM;
+    SNDFILE *handle = (SNDFILE *) calloc(1, sizeof(SNDFILE));
+    void *buffer = NULL;
+    if (handle == NULL || posix_memalign(&buffer, SF_DIRECT_ALIGNMENT,
+            SF_WRITE_BUFFER_BYTES) != 0) {
+        free(handle);
+        close(fd);
+        return NULL;
     }
-    wav[22] = info->channels;
-    write4u(&wav[24], info->samplerate);
+
     unsigned bitsPerSample;
     switch (sub) {
     case SF_FORMAT_PCM_16:
@@ -349,32 +513,165 @@ static SNDFILE *sf_open_write(const char *path, SF_INFO *info)
         bitsPerSample = 0;
         break;
     }
+    unsigned formatTag = sub == SF_FORMAT_FLOAT ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    // more than 2 channels need a channel mask
+    int extensible = info->channels > FCC_2;
+    unsigned fmtSize = extensible ? 40 : sub == SF_FORMAT_FLOAT ? 18 : 16;
+    size_t factSize = sub == SF_FORMAT_FLOAT ? 12 : 0;
+    // reserve space for a ds64, in case sf_close() finds the data too large for RIFF,
+    // and for O_DIRECT pad the header so that the data starts on an aligned block
+    int junk = rf64Threshold != SF_RF64_NEVER || direct;
+    size_t junkSize = rf64Threshold != SF_RF64_NEVER ? DS64_SIZE : 0;
+    size_t headerSize = 12 + (junk ? 8 + junkSize : 0) + 8 + fmtSize + factSize + 8;
+    if (direct) {
+        junkSize += SF_DIRECT_ALIGNMENT - headerSize;
+        headerSize = SF_DIRECT_ALIGNMENT;
+    }
+    unsigned char *wav = (unsigned char *) buffer;
+    memset(wav, 0, headerSize);
+    memcpy(wav, "RIFF", 4);
+    memcpy(&wav[8], "WAVE", 4);
+    size_t fmt = 12;
+    if (junk) {
+        memcpy(&wav[12], "JUNK", 4);
+        write4u(&wav[16], junkSize);
+        fmt += 8 + junkSize;
+    }
+    memcpy(&wav[fmt], "fmt ", 4);
+    write4u(&wav[fmt + 4], fmtSize);
+    write2u(&wav[fmt + 8], extensible ? WAVE_FORMAT_EXTENSIBLE : formatTag);
+    write2u(&wav[fmt + 10], info->channels);
+    write4u(&wav[fmt + 12], info->samplerate);
     unsigned blockAlignment = (bitsPerSample >> 3) * info->channels;
     unsigned byteRate = info->samplerate * blockAlignment;
-    write4u(&wav[28], byteRate);
-    wav[32] = blockAlignment;
-    wav[34] = bitsPerSample;
-    size_t extra = 0;
-    if (sub == SF_FORMAT_FLOAT) {
-        memcpy(&wav[38], "fact", 4);
-        wav[42] = 4;
-        memcpy(&wav[50], "data", 4);
-        extra = 14;
-    } else
-        memcpy(&wav[36], "data", 4);
+    write4u(&wav[fmt + 16], byteRate);
+    write2u(&wav[fmt + 20], blockAlignment);
+    write2u(&wav[fmt + 22], bitsPerSample);
+    if (extensible) {
+        // Android output position masks use the WAVE speaker positions, and channels beyond
+        // the standard layouts are left unassigned
+        audio_channel_mask_t channelMask = audio_channel_out_mask_from_count(info->channels);
+        handle->channelMask = channelMask == AUDIO_CHANNEL_INVALID ? 0 :
+                audio_channel_mask_get_bits(channelMask);
+        handle->maskOffset = fmt + 28;
+        write2u(&wav[fmt + 24], 22);                // cbSize
+        write2u(&wav[fmt + 26], bitsPerSample);     // wValidBitsPerSample
+        write4u(&wav[fmt + 28], handle->channelMask);
+        // KSDATAFORMAT_SUBTYPE_PCM or _IEEE_FLOAT, {0000xxxx-0000-0010-8000-00aa00389b71}
+        static const unsigned char guid[14] = {
+                0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+                0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71};
+        write2u(&wav[fmt + 32], formatTag);
+        memcpy(&wav[fmt + 34], guid, sizeof(guid));
+    } else if (fmtSize == 18) {
+        write2u(&wav[fmt + 24], 0);                 // cbSize
+    }
+    size_t offset = fmt + 8 + fmtSize;
+    if (factSize != 0) {
+        // sample length is filled in by sf_close()
+        handle->factOffset = offset;
+        memcpy(&wav[offset], "fact", 4);
+        wav[offset + 4] = 4;
+        offset += factSize;
+    }
     // dataSize is initially zero
-    (void) fwrite(wav, 44 + extra, 1, stream);
-    SNDFILE *handle = (SNDFILE *) malloc(sizeof(SNDFILE));
+    memcpy(&wav[offset], "data", 4);
+
+    handle->header = (uint8_t *) malloc(headerSize);
+    if (handle->header == NULL) {
+        free(buffer);
+        free(handle);
+        close(fd);
+        return NULL;
+    }
+    memcpy(handle->header, wav, headerSize);
     handle->mode = SFM_WRITE;
     handle->temp = NULL;
-    handle->stream = stream;
+    handle->stream = NULL;
     handle->bytesPerFrame = blockAlignment;
     handle->remaining = 0;
     handle->info = *info;
+    handle->fd = fd;
+    handle->headerSize = headerSize;
+    handle->buffer = (uint8_t *) buffer;
+    handle->bufferFill = headerSize;    // the header is written with the first frames
+    handle->alignment = alignment;
+    handle->rf64Threshold = rf64Threshold;
     return handle;
 }
 
-SNDFILE *sf_open(const char *path, int mode, SF_INFO *info)
+// Writes the aligned prefix of the buffer, or all of it if final, and moves any remainder
+// to the start of the buffer.
+static void sf_flush(SNDFILE *handle, int final)
+{
+    size_t length = handle->bufferFill;
+    if (!final) {
+        length &= ~(handle->alignment - 1);
+    } else if (handle->alignment > 1) {
+#ifdef O_DIRECT
+        // the unaligned tail is written without O_DIRECT
+        int flags = fcntl(handle->fd, F_GETFL);
+        (void) fcntl(handle->fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+        handle->alignment = 1;
+    }
+    size_t done = 0;
+    while (done < length && !handle->error) {
+        ssize_t actual = write(handle->fd, &handle->buffer[done], length - done);
+        if (actual > 0) {
+            done += actual;
+        } else if (actual < 0 && errno == EINTR) {
+            continue;
+        } else {
+#ifdef HAVE_STDERR
+            fprintf(stderr, "write failed errno %d\n", errno);
+#endif
+            handle->error = 1;
+        }
+    }
+    handle->written += done;
+    handle->bufferFill -= done;
+    if (handle->bufferFill > 0) {
+        memmove(handle->buffer, &handle->buffer[done], handle->bufferFill);
+    }
+}
+
+// Converts frames from srcFormat into the write buffer, writing it out as it fills.
+static sf_count_t sf_write_frames(SNDFILE *handle, const void *ptr, audio_format_t srcFormat,
+        sf_count_t desiredFrames)
+{
+    if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
+        return 0;
+    audio_format_t format = SF_format_to_audio_format(handle->info.format);
+    size_t srcFrameSize = audio_bytes_per_sample(srcFormat) * handle->info.channels;
+    const uint8_t *src = (const uint8_t *) ptr;
+    sf_count_t actualFrames = 0;
+    while (actualFrames < desiredFrames && !handle->error) {
+        size_t frames = (SF_WRITE_BUFFER_BYTES - handle->bufferFill) / handle->bytesPerFrame;
+        if (frames == 0) {
+            sf_flush(handle, 0 /* final */);
+            continue;
+        }
+        if (frames > (uint64_t) (desiredFrames - actualFrames)) {
+            frames = desiredFrames - actualFrames;
+        }
+        uint8_t *dst = &handle->buffer[handle->bufferFill];
+        size_t count = frames * handle->info.channels;
+        memcpy_by_audio_format(dst, format, src, srcFormat, count);
+        if (format == AUDIO_FORMAT_PCM_16_BIT && !isLittleEndian()) {
+            my_swab((short *) dst, count);
+        }
+        handle->bufferFill += frames * handle->bytesPerFrame;
+        src += frames * srcFrameSize;
+        actualFrames += frames;
+    }
+    handle->remaining += actualFrames;
+    return actualFrames;
+}
+
+// RF64 and BW64 are read, and written from a RIFF size of rf64Threshold, unless it is
+// SF_RF64_NEVER.
+static SNDFILE *sf_open_l(const char *path, int mode, SF_INFO64 *info, uint64_t rf64Threshold)
 {
     if (path == NULL || info == NULL) {
 #ifdef HAVE_STDERR
@@ -382,11 +679,16 @@ SNDFILE *sf_open(const char *path, int mode, SF_INFO *info)
 #endif
         return NULL;
     }
+    int rf64Allowed = rf64Threshold != SF_RF64_NEVER;
     switch (mode) {
     case SFM_READ:
-        return sf_open_read(path, info);
+        return sf_open_read(path, info, 0 /* mmap_ */, rf64Allowed);
+    case SFM_READ_MMAP:
+        return sf_open_read(path, info, 1 /* mmap_ */, rf64Allowed);
     case SFM_WRITE:
-        return sf_open_write(path, info);
+        return sf_open_write(path, info, 0 /* direct */, rf64Threshold);
+    case SFM_WRITE_DIRECT:
+        return sf_open_write(path, info, 1 /* direct */, rf64Threshold);
     default:
 #ifdef HAVE_STDERR
         fprintf(stderr, "mode=%d\n", mode);
@@ -395,248 +697,273 @@ SNDFILE *sf_open(const char *path, int mode, SF_INFO *info)
     }
 }
 
+SNDFILE *sf_open(const char *path, int mode, SF_INFO *info)
+{
+    SF_INFO64 info64;
+    if (info != NULL) {
+        info64.frames = info->frames;
+        info64.samplerate = info->samplerate;
+        info64.channels = info->channels;
+        info64.format = info->format;
+    }
+    SNDFILE *handle = sf_open_l(path, mode, info != NULL ? &info64 : NULL, SF_RF64_NEVER);
+    if (handle != NULL) {
+        // a RIFF file of 8-bit mono may have more frames than sf_count_t
+        info->frames = info64.frames < INT_MAX ? (sf_count_t) info64.frames : INT_MAX;
+        info->samplerate = info64.samplerate;
+        info->channels = info64.channels;
+        info->format = info64.format;
+    }
+    return handle;
+}
+
+SNDFILE *sf_open64(const char *path, int mode, SF_INFO64 *info)
+{
+    return sf_open_l(path, mode, info, RIFF_SIZE_IN_DS64);
+}
+
+SNDFILE *sf_open64_for_test(const char *path, int mode, SF_INFO64 *info,
+        uint64_t rf64Threshold)
+{
+    return sf_open_l(path, mode, info,
+            rf64Threshold < RIFF_SIZE_IN_DS64 ? rf64Threshold : RIFF_SIZE_IN_DS64);
+}
+
 void sf_close(SNDFILE *handle)
 {
     if (handle == NULL)
         return;
     free(handle->temp);
+    if (handle->map != NULL) {
+        (void) munmap(handle->map, handle->mapLength);
+    }
     if (handle->mode == SFM_WRITE) {
-        (void) fflush(handle->stream);
-        rewind(handle->stream);
-        unsigned char wav[58];
-        size_t extra = (handle->info.format & SF_FORMAT_SUBMASK) == SF_FORMAT_FLOAT ? 14 : 0;
-        (void) fread(wav, 44 + extra, 1, handle->stream);
-        unsigned dataSize = handle->remaining * handle->bytesPerFrame;
-        write4u(&wav[4], dataSize + 36 + extra);    // riffSize
-        write4u(&wav[40 + extra], dataSize);        // dataSize
-        rewind(handle->stream);
-        (void) fwrite(wav, 44 + extra, 1, handle->stream);
+        sf_flush(handle, 1 /* final */);
+        unsigned char *wav = handle->header;
+        size_t headerSize = handle->headerSize;
+        // frames whose write failed are not counted
+        uint64_t frames = handle->written > headerSize ?
+                (handle->written - headerSize) / handle->bytesPerFrame : 0;
+        uint64_t dataSize = frames * handle->bytesPerFrame;
+        uint64_t riffSize = headerSize - 8 + dataSize;
+        if (handle->rf64Threshold == SF_RF64_NEVER && riffSize >= RIFF_SIZE_IN_DS64) {
+            // streams opened by sf_open() stay RIFF, so only the frames within 4 GiB count
+            frames = (RIFF_SIZE_IN_DS64 - 1 - (headerSize - 8)) / handle->bytesPerFrame;
+            dataSize = frames * handle->bytesPerFrame;
+            riffSize = headerSize - 8 + dataSize;
+        }
+        if (riffSize < handle->rf64Threshold) {
+            write4u(&wav[4], (unsigned) riffSize);
+            write4u(&wav[headerSize - 4], (unsigned) dataSize);
+        } else {
+            // upgrade to RF64, replacing the JUNK chunk by a ds64 with an empty table
+            memcpy(wav, "RF64", 4);
+            write4u(&wav[4], RIFF_SIZE_IN_DS64);
+            memcpy(&wav[12], "ds64", 4);
+            write8u(&wav[20], riffSize);
+            write8u(&wav[28], dataSize);
+            write8u(&wav[36], frames);
+            write4u(&wav[headerSize - 4], RIFF_SIZE_IN_DS64);
+        }
+        if (handle->factOffset != 0) {
+            write4u(&wav[handle->factOffset + 8],
+                    frames < UINT32_MAX ? (unsigned) frames : UINT32_MAX);
+        }
+        if (handle->maskOffset != 0) {
+            write4u(&wav[handle->maskOffset], handle->channelMask);
+        }
+        // the header is patched only once, rather than after each write
+        if (handle->written >= headerSize) {
+            (void) pwrite(handle->fd, wav, headerSize, 0);
+        }
+        free(handle->header);
+        free(handle->buffer);
+        (void) close(handle->fd);
+        free(handle);
+        return;
     }
     (void) fclose(handle->stream);
     free(handle);
 }
 
-sf_count_t sf_readf_short(SNDFILE *handle, short *ptr, sf_count_t desiredFrames)
+// Returns the next *frames frames of the data chunk, and updates *frames to the number
+// actually available.  These are in place within the mapping for SFM_READ_MMAP.  Otherwise
+// they are read into ptr if its samples are the same size as those of the file, so that
+// the conversion can be in place, or else into handle->temp.
+static const void *sf_read_frames(SNDFILE *handle, void *ptr, size_t sampleSize,
+        size_t *frames)
 {
-    if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
-            desiredFrames <= 0) {
-        return 0;
-    }
-    if (handle->remaining < (size_t) desiredFrames) {
-        desiredFrames = handle->remaining;
+    if (handle->remaining < *frames) {
+        *frames = handle->remaining;
     }
     // does not check for numeric overflow
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes;
-    void *temp = NULL;
-    unsigned format = handle->info.format & SF_FORMAT_SUBMASK;
-    if (format == SF_FORMAT_PCM_32 || format == SF_FORMAT_FLOAT || format == SF_FORMAT_PCM_24) {
-        temp = malloc(desiredBytes);
-        actualBytes = fread(temp, sizeof(char), desiredBytes, handle->stream);
+    size_t desiredBytes = *frames * handle->bytesPerFrame;
+    const void *src;
+    if (handle->map != NULL) {
+        src = handle->mapPosition;
+        handle->mapPosition += desiredBytes;
     } else {
-        actualBytes = fread(ptr, sizeof(char), desiredBytes, handle->stream);
+        void *dst = ptr;
+        if (handle->bytesPerFrame != sampleSize * handle->info.channels) {
+            void *temp = realloc(handle->temp, desiredBytes);
+            if (temp == NULL) {
+                *frames = 0;
+                return NULL;
+            }
+            handle->temp = dst = temp;
+        }
+        size_t actualBytes = fread(dst, sizeof(char), desiredBytes, handle->stream);
+        *frames = actualBytes / handle->bytesPerFrame;
+        src = dst;
+    }
+    handle->remaining -= *frames;
+    return src;
+}
+
+sf_count64_t sf_readf_short64(SNDFILE *handle, short *ptr, sf_count64_t desiredFrames)
+{
+    if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
+            desiredFrames <= 0) {
+        return 0;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining -= actualFrames;
-    switch (format) {
+    size_t actualFrames = (uint64_t) desiredFrames < SIZE_MAX ?
+            (size_t) desiredFrames : SIZE_MAX;
+    const void *src = sf_read_frames(handle, ptr, sizeof(short), &actualFrames);
+    size_t count = actualFrames * handle->info.channels;
+    switch (handle->info.format & SF_FORMAT_SUBMASK) {
     case SF_FORMAT_PCM_U8:
-        memcpy_to_i16_from_u8(ptr, (unsigned char *) ptr, actualFrames * handle->info.channels);
+        memcpy_to_i16_from_u8(ptr, (const unsigned char *) src, count);
         break;
     case SF_FORMAT_PCM_16:
+        if (src != ptr)
+            memcpy(ptr, src, count * sizeof(short));
         if (!isLittleEndian())
-            my_swab(ptr, actualFrames * handle->info.channels);
+            my_swab(ptr, count);
         break;
     case SF_FORMAT_PCM_32:
-        memcpy_to_i16_from_i32(ptr, (const int *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_i16_from_i32(ptr, (const int *) src, count);
         break;
     case SF_FORMAT_FLOAT:
-        memcpy_to_i16_from_float(ptr, (const float *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_i16_from_float(ptr, (const float *) src, count);
         break;
     case SF_FORMAT_PCM_24:
-        memcpy_to_i16_from_p24(ptr, (const uint8_t *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_i16_from_p24(ptr, (const uint8_t *) src, count);
         break;
     default:
-        memset(ptr, 0, actualFrames * handle->info.channels * sizeof(short));
+        memset(ptr, 0, count * sizeof(short));
         break;
     }
     return actualFrames;
 }
 
-sf_count_t sf_readf_float(SNDFILE *handle, float *ptr, sf_count_t desiredFrames)
+sf_count64_t sf_readf_float64(SNDFILE *handle, float *ptr, sf_count64_t desiredFrames)
 {
     if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
             desiredFrames <= 0) {
         return 0;
     }
-    if (handle->remaining < (size_t) desiredFrames) {
-        desiredFrames = handle->remaining;
-    }
-    // does not check for numeric overflow
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes;
-    void *temp = NULL;
-    unsigned format = handle->info.format & SF_FORMAT_SUBMASK;
-    if (format == SF_FORMAT_PCM_16 || format == SF_FORMAT_PCM_U8 || format == SF_FORMAT_PCM_24) {
-        temp = malloc(desiredBytes);
-        actualBytes = fread(temp, sizeof(char), desiredBytes, handle->stream);
-    } else {
-        actualBytes = fread(ptr, sizeof(char), desiredBytes, handle->stream);
-    }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining -= actualFrames;
-    switch (format) {
+    size_t actualFrames = (uint64_t) desiredFrames < SIZE_MAX ?
+            (size_t) desiredFrames : SIZE_MAX;
+    const void *src = sf_read_frames(handle, ptr, sizeof(float), &actualFrames);
+    size_t count = actualFrames * handle->info.channels;
+    switch (handle->info.format & SF_FORMAT_SUBMASK) {
     case SF_FORMAT_PCM_U8:
-        memcpy_to_float_from_u8(ptr, (const unsigned char *) temp,
-                actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_float_from_u8(ptr, (const unsigned char *) src, count);
         break;
     case SF_FORMAT_PCM_16:
-        memcpy_to_float_from_i16(ptr, (const short *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_float_from_i16(ptr, (const short *) src, count);
         break;
     case SF_FORMAT_PCM_32:
-        memcpy_to_float_from_i32(ptr, (const int *) ptr, actualFrames * handle->info.channels);
+        memcpy_to_float_from_i32(ptr, (const int *) src, count);
         break;
     case SF_FORMAT_FLOAT:
+        if (src != ptr)
+            memcpy(ptr, src, count * sizeof(float));
         break;
     case SF_FORMAT_PCM_24:
-        memcpy_to_float_from_p24(ptr, (const uint8_t *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_float_from_p24(ptr, (const uint8_t *) src, count);
         break;
     default:
-        memset(ptr, 0, actualFrames * handle->info.channels * sizeof(float));
+        memset(ptr, 0, count * sizeof(float));
         break;
     }
     return actualFrames;
 }
 
-sf_count_t sf_readf_int(SNDFILE *handle, int *ptr, sf_count_t desiredFrames)
+sf_count64_t sf_readf_int64(SNDFILE *handle, int *ptr, sf_count64_t desiredFrames)
 {
     if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
             desiredFrames <= 0) {
         return 0;
     }
-    if (handle->remaining < (size_t) desiredFrames) {
-        desiredFrames = handle->remaining;
-    }
-    // does not check for numeric overflow
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    void *temp = NULL;
-    unsigned format = handle->info.format & SF_FORMAT_SUBMASK;
-    size_t actualBytes;
-    if (format == SF_FORMAT_PCM_16 || format == SF_FORMAT_PCM_U8 || format == SF_FORMAT_PCM_24) {
-        temp = malloc(desiredBytes);
-        actualBytes = fread(temp, sizeof(char), desiredBytes, handle->stream);
-    } else {
-        actualBytes = fread(ptr, sizeof(char), desiredBytes, handle->stream);
-    }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining -= actualFrames;
-    switch (format) {
+    size_t actualFrames = (uint64_t) desiredFrames < SIZE_MAX ?
+            (size_t) desiredFrames : SIZE_MAX;
+    const void *src = sf_read_frames(handle, ptr, sizeof(int), &actualFrames);
+    size_t count = actualFrames * handle->info.channels;
+    switch (handle->info.format & SF_FORMAT_SUBMASK) {
     case SF_FORMAT_PCM_U8:
-        memcpy_to_i32_from_u8(ptr, (const unsigned char *) temp,
-                actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_i32_from_u8(ptr, (const unsigned char *) src, count);
         break;
     case SF_FORMAT_PCM_16:
-        memcpy_to_i32_from_i16(ptr, (const short *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_i32_from_i16(ptr, (const short *) src, count);
         break;
     case SF_FORMAT_PCM_32:
+        if (src != ptr)
+            memcpy(ptr, src, count * sizeof(int));
         break;
     case SF_FORMAT_FLOAT:
-        memcpy_to_i32_from_float(ptr, (const float *) ptr, actualFrames * handle->info.channels);
+        memcpy_to_i32_from_float(ptr, (const float *) src, count);
         break;
     case SF_FORMAT_PCM_24:
-        memcpy_to_i32_from_p24(ptr, (const uint8_t *) temp, actualFrames * handle->info.channels);
-        free(temp);
+        memcpy_to_i32_from_p24(ptr, (const uint8_t *) src, count);
         break;
     default:
-        memset(ptr, 0, actualFrames * handle->info.channels * sizeof(int));
+        memset(ptr, 0, count * sizeof(int));
         break;
     }
     return actualFrames;
 }
 
+sf_count_t sf_readf_short(SNDFILE *handle, short *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_short64(handle, ptr, desiredFrames);
+}
+
+sf_count_t sf_readf_float(SNDFILE *handle, float *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_float64(handle, ptr, desiredFrames);
+}
+
+sf_count_t sf_readf_int(SNDFILE *handle, int *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_int64(handle, ptr, desiredFrames);
+}
+
 sf_count_t sf_writef_short(SNDFILE *handle, const short *ptr, sf_count_t desiredFrames)
 {
-    if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
-        return 0;
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes = 0;
-    switch (handle->info.format & SF_FORMAT_SUBMASK) {
-    case SF_FORMAT_PCM_U8:
-        handle->temp = realloc(handle->temp, desiredBytes);
-        memcpy_to_u8_from_i16(handle->temp, ptr, desiredBytes);
-        actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        break;
-    case SF_FORMAT_PCM_16:
-        // does not check for numeric overflow
-        if (isLittleEndian()) {
-            actualBytes = fwrite(ptr, sizeof(char), desiredBytes, handle->stream);
-        } else {
-            handle->temp = realloc(handle->temp, desiredBytes);
-            memcpy(handle->temp, ptr, desiredBytes);
-            my_swab((short *) handle->temp, desiredFrames * handle->info.channels);
-            actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        }
-        break;
-    case SF_FORMAT_FLOAT:
-        handle->temp = realloc(handle->temp, desiredBytes);
-        memcpy_to_float_from_i16((float *) handle->temp, ptr,
-                desiredFrames * handle->info.channels);
-        actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        break;
-    default:
-        break;
-    }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining += actualFrames;
-    return actualFrames;
+    return sf_write_frames(handle, ptr, AUDIO_FORMAT_PCM_16_BIT, desiredFrames);
 }
 
 sf_count_t sf_writef_float(SNDFILE *handle, const float *ptr, sf_count_t desiredFrames)
 {
-    if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
-        return 0;
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes = 0;
-    switch (handle->info.format & SF_FORMAT_SUBMASK) {
-    case SF_FORMAT_FLOAT:
-        actualBytes = fwrite(ptr, sizeof(char), desiredBytes, handle->stream);
-        break;
-    case SF_FORMAT_PCM_16:
-        handle->temp = realloc(handle->temp, desiredBytes);
-        memcpy_to_i16_from_float((short *) handle->temp, ptr,
-                desiredFrames * handle->info.channels);
-        actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        break;
-    case SF_FORMAT_PCM_U8:  // transcoding from float to byte not yet implemented
-    default:
-        break;
-    }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining += actualFrames;
-    return actualFrames;
+    return sf_write_frames(handle, ptr, AUDIO_FORMAT_PCM_FLOAT, desiredFrames);
 }
 
 sf_count_t sf_writef_int(SNDFILE *handle, const int *ptr, sf_count_t desiredFrames)
 {
-    if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
-        return 0;
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes = 0;
-    switch (handle->info.format & SF_FORMAT_SUBMASK) {
-    case SF_FORMAT_PCM_32:
-        actualBytes = fwrite(ptr, sizeof(char), desiredBytes, handle->stream);
-        break;
-    default:    // transcoding from other formats not yet implemented
-        break;
+    return sf_write_frames(handle, ptr, AUDIO_FORMAT_PCM_32_BIT, desiredFrames);
+}
+
+uint32_t sf_get_channel_mask(SNDFILE *handle)
+{
+    return handle != NULL ? handle->channelMask : 0;
+}
+
+int sf_set_channel_mask(SNDFILE *handle, uint32_t channelMask)
+{
+    if (handle == NULL || handle->mode != SFM_WRITE || handle->maskOffset == 0) {
+        return -EINVAL;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining += actualFrames;
-    return actualFrames;
+    handle->channelMask = channelMask;
+    return 0;
 }